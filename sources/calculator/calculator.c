@@ -1066,6 +1066,9 @@ if(priority > priority_##left_priority_pure) return result;\
                     {
                         print_error("Expected ':', but token of type %d encountered.",
                             (int)data->current_token_type);
+                        calc_essence_free(op2);
+                        calc_essence_free(result);
+                        return NULL;
                     }
                     debug0("Evaluate third operand for 'a ? b : c' operation...");\
                     op3 = parse_data_parse(data, priority_cond_right);
@@ -0,0 +1,146 @@
+/*
+ * Benchmark for the expression evaluator.
+ *
+ * Usage:
+ *   kedr_calc_bench [-n <evaluations>] [<corpus_file>]
+ *
+ * Each non-empty line of the corpus file not starting with '#' is an
+ * expression as it could be written to the "expression" file of a fault
+ * simulation point. The expression is parsed and then evaluated the given
+ * number of times with the values of the variables varying from call to
+ * call. The average time of kedr_calc_parse() and kedr_calc_evaluate()
+ * is output for each expression, along with the average time of an
+ * evaluation over the whole corpus.
+ *
+ * The default corpus is corpus.txt from the source directory.
+ */
+
+/* ========================================================================
+ * Copyright (C) 2012, KEDR development team
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation.
+ ======================================================================== */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "calc_env.h"
+
+#ifndef KEDR_CALC_BENCH_CORPUS
+#define KEDR_CALC_BENCH_CORPUS "corpus.txt"
+#endif
+
+// Number of the different sets of variables' values used in turn.
+#define VAR_SETS 64
+
+// Prevents the compiler from optimizing the evaluation away.
+static volatile kedr_calc_int_t result_sink;
+
+static unsigned long long
+now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (unsigned long long)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void
+usage(const char* name)
+{
+    fprintf(stderr, "Usage: %s [-n <evaluations>] [<corpus_file>]\n", name);
+}
+
+int main(int argc, char** argv)
+{
+    static kedr_calc_int_t values[VAR_SETS][calc_env_var_count];
+
+    const char* corpus = KEDR_CALC_BENCH_CORPUS;
+    unsigned long evaluations = 1000000;
+    FILE* f;
+    char line[1024];
+    int opt;
+    int i;
+
+    unsigned long long total_ns = 0;
+    unsigned long long total_evaluations = 0;
+    int n_exprs = 0;
+    int n_errors = 0;
+
+    while((opt = getopt(argc, argv, "n:")) != -1)
+    {
+        switch(opt)
+        {
+        case 'n':
+            evaluations = strtoul(optarg, NULL, 0);
+            break;
+        default:
+            usage(argv[0]);
+            return 1;
+        }
+    }
+    if(optind < argc) corpus = argv[optind];
+    if(evaluations == 0)
+    {
+        fprintf(stderr, "The number of evaluations must be positive.\n");
+        return 1;
+    }
+
+    f = fopen(corpus, "r");
+    if(f == NULL)
+    {
+        perror(corpus);
+        return 1;
+    }
+
+    for(i = 0; i < VAR_SETS; i++)
+        calc_env_set_vars(values[i], i + 1);
+
+    printf("%12s %12s  %s\n", "ns/eval", "ns/parse", "expression");
+    while(fgets(line, sizeof(line), f) != NULL)
+    {
+        kedr_calc_t* calc;
+        unsigned long long start, parse_ns, eval_ns;
+        unsigned long n;
+        size_t len = strlen(line);
+
+        while(len > 0 && (line[len - 1] == '\n' || line[len - 1] == '\r'))
+            line[--len] = '\0';
+        if(len == 0 || line[0] == '#') continue;
+
+        start = now_ns();
+        calc = calc_env_parse(line);
+        parse_ns = now_ns() - start;
+        if(calc == NULL)
+        {
+            fprintf(stderr, "Failed to parse expression '%s'.\n", line);
+            n_errors++;
+            continue;
+        }
+
+        start = now_ns();
+        for(n = 0; n < evaluations; n++)
+            result_sink = kedr_calc_evaluate(calc, values[n % VAR_SETS]);
+        eval_ns = now_ns() - start;
+
+        kedr_calc_delete(calc);
+
+        printf("%12.2f %12llu  %s\n", (double)eval_ns / evaluations,
+            parse_ns, line);
+
+        total_ns += eval_ns;
+        total_evaluations += evaluations;
+        n_exprs++;
+    }
+    fclose(f);
+
+    if(n_exprs != 0)
+        printf("%12.2f %12s  (average over %d expressions)\n",
+            (double)total_ns / total_evaluations, "", n_exprs);
+
+    return (n_errors != 0) ? 1 : 0;
+}
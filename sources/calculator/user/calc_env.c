@@ -0,0 +1,78 @@
+// The environment of the expressions for the user-space calculator tools.
+
+/* ========================================================================
+ * Copyright (C) 2012, KEDR development team
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation.
+ ======================================================================== */
+
+#include <stdlib.h>
+
+#include "calc_env.h"
+
+#define ARRAY_SIZE(arr) (sizeof(arr) / sizeof((arr)[0]))
+
+/* The values are not important here, only the names are. */
+static const struct kedr_calc_const constants[] =
+{
+    {"GFP_NOWAIT", 0x800},
+    {"GFP_KERNEL", 0xcc0},
+    {"GFP_USER", 0x100cc0},
+    {"GFP_ATOMIC", 0xa20},
+};
+
+static const struct kedr_calc_const_vec all_constants[] =
+{
+    { .n_elems = ARRAY_SIZE(constants), .elems = constants }
+};
+
+// In the order of enum calc_env_var.
+static const char* var_names[] =
+{
+    "times",
+    "size",
+    "flags",
+    "caller_address",
+};
+
+static kedr_calc_int_t in_init_weak_var_compute(void)
+{
+    return 0;
+}
+
+static kedr_calc_int_t rnd100_weak_var_compute(void)
+{
+    return rand() % 100;
+}
+
+static kedr_calc_int_t rnd10000_weak_var_compute(void)
+{
+    return rand() % 10000;
+}
+
+static const struct kedr_calc_weak_var weak_vars[] =
+{
+    { .name = "in_init", .compute = in_init_weak_var_compute },
+    { .name = "rnd100", .compute = rnd100_weak_var_compute },
+    { .name = "rnd10000", .compute = rnd10000_weak_var_compute },
+};
+
+kedr_calc_t*
+calc_env_parse(const char* expr)
+{
+    return kedr_calc_parse(expr,
+        ARRAY_SIZE(all_constants), all_constants,
+        ARRAY_SIZE(var_names), var_names,
+        ARRAY_SIZE(weak_vars), weak_vars);
+}
+
+void
+calc_env_set_vars(kedr_calc_int_t* values, kedr_calc_int_t times)
+{
+    values[calc_env_var_times] = times;
+    values[calc_env_var_size] = 8 << (times % 12);
+    values[calc_env_var_flags] = (times % 4 == 0) ? 0xa20 : 0xcc0;
+    values[calc_env_var_caller_address] = 0xfe2ab800 + (times % 64) * 8;
+}
@@ -0,0 +1,44 @@
+/*
+ * The environment of the expressions for the user-space tools built from
+ * the calculator: the same variables, weak variables and constants as
+ * the fault simulation indicator for kmalloc() provides (the "common"
+ * indicator provides a subset of these).
+ */
+
+/* ========================================================================
+ * Copyright (C) 2012, KEDR development team
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation.
+ ======================================================================== */
+
+#ifndef KEDR_CALC_ENV_H
+#define KEDR_CALC_ENV_H
+
+#include <kedr/calculator/calculator.h>
+
+/* Indices of the variables in the array passed to kedr_calc_evaluate(). */
+enum calc_env_var
+{
+    calc_env_var_times = 0,
+    calc_env_var_size,
+    calc_env_var_flags,
+    calc_env_var_caller_address,
+
+    calc_env_var_count
+};
+
+/* Parse 'expr' in this environment. */
+kedr_calc_t*
+calc_env_parse(const char* expr);
+
+/* 
+ * Fill 'values' (calc_env_var_count elements) with the values of the
+ * variables for the call number 'times'. The values vary from call to
+ * call the way the arguments of kmalloc() could.
+ */
+void
+calc_env_set_vars(kedr_calc_int_t* values, kedr_calc_int_t times);
+
+#endif /* KEDR_CALC_ENV_H */
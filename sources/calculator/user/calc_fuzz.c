@@ -0,0 +1,52 @@
+/*
+ * libFuzzer harness for kedr_calc_parse().
+ *
+ * The input is treated as an expression written to the "expression" file
+ * of a fault simulation point. The expression is parsed and, if parsing
+ * succeeds, deleted, so that crashes, memory errors and leaks in the
+ * parser are detected (with AddressSanitizer, which is enabled along with
+ * the fuzzer).
+ *
+ * The parsed expression is not evaluated: evaluation of the expressions
+ * like "1/0" is expected to fail.
+ *
+ * Usage (see libFuzzer documentation for the options):
+ *   kedr_calc_fuzz [<corpus_dir> ...]
+ * corpus.txt from the source directory contains a good set of seeds, one
+ * expression per line.
+ */
+
+/* ========================================================================
+ * Copyright (C) 2012, KEDR development team
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation.
+ ======================================================================== */
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "calc_env.h"
+
+int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size);
+
+int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size)
+{
+    kedr_calc_t* calc;
+    char* expr;
+
+    // The kernel gets a null-terminated string from the control file.
+    expr = malloc(size + 1);
+    if(expr == NULL) return 0;
+    memcpy(expr, data, size);
+    expr[size] = '\0';
+
+    calc = calc_env_parse(expr);
+    if(calc != NULL) kedr_calc_delete(calc);
+
+    free(expr);
+    return 0;
+}
@@ -0,0 +1,18 @@
+/*
+ * Character classes for the user-space build of the calculator.
+ */
+
+/* ========================================================================
+ * Copyright (C) 2012, KEDR development team
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation.
+ ======================================================================== */
+
+#ifndef KEDR_CALC_SHIM_CTYPE_H
+#define KEDR_CALC_SHIM_CTYPE_H
+
+#include <ctype.h>
+
+#endif /* KEDR_CALC_SHIM_CTYPE_H */
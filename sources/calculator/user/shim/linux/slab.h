@@ -0,0 +1,46 @@
+/*
+ * Minimal replacement of the kernel API used by the calculator, for
+ * building calculator.c in the user space (see ../../CMakeLists.txt).
+ *
+ * Only what calculator.c actually uses is provided here.
+ */
+
+/* ========================================================================
+ * Copyright (C) 2012, KEDR development team
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation.
+ ======================================================================== */
+
+#ifndef KEDR_CALC_SHIM_SLAB_H
+#define KEDR_CALC_SHIM_SLAB_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define GFP_KERNEL 0
+
+#define kmalloc(size, flags) malloc(size)
+#define kfree(p) free(p)
+
+/*
+ * Parse errors are expected when fuzzing, so the messages may be
+ * suppressed by defining KEDR_CALC_SHIM_QUIET.
+ */
+#ifdef KEDR_CALC_SHIM_QUIET
+#define pr_err(fmt, ...) do { } while(0)
+#else
+#define pr_err(fmt, ...) fprintf(stderr, fmt "\n", ##__VA_ARGS__)
+#endif
+
+#define pr_debug(fmt, ...) do { } while(0)
+
+/* abort() is reported as a crash by the fuzzer, as BUG() should be. */
+#define BUG() abort()
+#define BUG_ON(cond) do { if(cond) abort(); } while(0)
+#define WARN_ON(cond) \
+    ((cond) ? (fprintf(stderr, "WARNING at %s:%d\n", __FILE__, __LINE__), 1) : 0)
+
+#endif /* KEDR_CALC_SHIM_SLAB_H */
@@ -0,0 +1,338 @@
+/* callstat_module.c - aggregated statistics of the function calls.
+ *
+ * The statistics are kept in a keyed per-CPU table (see
+ * <kedr/util/percpu_stats.h>) per (function, call site). An entry contains
+ * the number of calls, the number of failed calls, the log2 histogram
+ * of the request sizes and the distribution of the return values. */
+
+/* ========================================================================
+ * Copyright (C) 2012, KEDR development team
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation.
+ ======================================================================== */
+
+#include <linux/module.h>
+#include <linux/moduleparam.h>
+#include <linux/init.h>
+#include <linux/kernel.h>
+#include <linux/errno.h>
+#include <linux/mutex.h>
+#include <linux/bitops.h>
+#include <linux/vmalloc.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include <linux/fs.h>
+
+#include <kedr/callstat/callstat.h>
+#include <kedr/util/percpu_stats.h>
+
+MODULE_AUTHOR("KEDR development team");
+MODULE_DESCRIPTION("KEDR call statistics");
+MODULE_LICENSE("GPL");
+/* ====================================================================== */
+
+/* Number of bits in the index of the per-CPU table. That is, each table
+ * contains (1 << table_bits) entries. */
+static unsigned int table_bits = 9;
+module_param(table_bits, uint, S_IRUGO);
+
+/* How many entries are checked when looking for (function, call site)
+ * in the table before giving up. */
+#define CALLSTAT_MAX_PROBES 16
+
+/* Bucket 0 is for the zero size, bucket 'i' (i > 0) is for the sizes
+ * from [2^(i-1), 2^i). */
+#define CALLSTAT_SIZE_BUCKETS (BITS_PER_LONG + 1)
+
+/* How many distinct return values are counted per (function, call site).
+ * The calls returning other values are counted together. Usually, these
+ * are error codes, so there are few of them. */
+#define CALLSTAT_RETVALS 4
+
+struct callstat_retval
+{
+	long value;
+
+	/* 0 if the slot is not used. */
+	unsigned long count;
+};
+
+struct callstat_entry
+{
+	/* (func, call_site) */
+	struct kedr_stat_key key;
+
+	unsigned long count;
+	unsigned long errors;
+	unsigned int sizes[CALLSTAT_SIZE_BUCKETS];
+
+	struct callstat_retval retvals[CALLSTAT_RETVALS];
+	unsigned long retvals_other;
+};
+
+static struct kedr_stat_table *table;
+
+/* Serializes readers of the statistics with the operations that change
+ * the keys of the entries (reset, forget). */
+static DEFINE_MUTEX(callstat_mutex);
+
+static struct dentry *dir_callstat;
+static struct dentry *file_stats;
+static struct dentry *file_reset;
+/* ====================================================================== */
+
+/* Add 'count' calls returning 'value' to the distribution in 'entry'. */
+static void
+retval_add(struct callstat_entry *entry, long value, unsigned long count)
+{
+	int i;
+
+	for (i = 0; i < CALLSTAT_RETVALS; ++i) {
+		struct callstat_retval *r = &entry->retvals[i];
+
+		if (r->count == 0)
+			r->value = value;
+		if (r->value == value) {
+			r->count += count;
+			return;
+		}
+	}
+	entry->retvals_other += count;
+}
+
+static void
+callstat_record(const struct kedr_callstat_func *func, void *call_site,
+	int is_error, unsigned long size, int has_size, long retval,
+	int has_retval)
+{
+	unsigned long irq_flags;
+	struct callstat_entry *entry;
+
+	local_irq_save(irq_flags);
+	entry = kedr_stat_table_get(table, (unsigned long)func,
+		(unsigned long)call_site);
+	if (entry != NULL) {
+		++entry->count;
+		if (is_error)
+			++entry->errors;
+		if (has_size)
+			++entry->sizes[fls_long(size)];
+		if (has_retval)
+			retval_add(entry, retval, 1);
+	}
+	local_irq_restore(irq_flags);
+}
+
+void
+kedr_callstat_record(const struct kedr_callstat_func *func,
+	void *call_site, int is_error)
+{
+	callstat_record(func, call_site, is_error, 0, 0, 0, 0);
+}
+EXPORT_SYMBOL(kedr_callstat_record);
+
+void
+kedr_callstat_record_size(const struct kedr_callstat_func *func,
+	void *call_site, int is_error, unsigned long size)
+{
+	callstat_record(func, call_site, is_error, size, 1, 0, 0);
+}
+EXPORT_SYMBOL(kedr_callstat_record_size);
+
+void
+kedr_callstat_record_retval(const struct kedr_callstat_func *func,
+	void *call_site, int is_error, unsigned long size, int has_size,
+	long retval)
+{
+	callstat_record(func, call_site, is_error, size, has_size, retval, 1);
+}
+EXPORT_SYMBOL(kedr_callstat_record_retval);
+/* ====================================================================== */
+
+static int
+entry_is_owned_by(const void *entry, void *owner)
+{
+	const struct callstat_entry *e = entry;
+	const struct kedr_callstat_func *func =
+		(const struct kedr_callstat_func *)e->key.k1;
+
+	return func->owner == owner;
+}
+
+void
+kedr_callstat_forget(struct module *owner)
+{
+	mutex_lock(&callstat_mutex);
+	kedr_stat_table_forget(table, entry_is_owned_by, owner);
+	mutex_unlock(&callstat_mutex);
+}
+EXPORT_SYMBOL(kedr_callstat_forget);
+/* ====================================================================== */
+
+static void
+entry_merge(void *total, const void *entry)
+{
+	struct callstat_entry *t = total;
+	const struct callstat_entry *e = entry;
+	int i;
+
+	t->count += e->count;
+	t->errors += e->errors;
+	for (i = 0; i < CALLSTAT_SIZE_BUCKETS; ++i)
+		t->sizes[i] += e->sizes[i];
+
+	for (i = 0; i < CALLSTAT_RETVALS; ++i) {
+		if (e->retvals[i].count != 0)
+			retval_add(t, e->retvals[i].value, e->retvals[i].count);
+	}
+	t->retvals_other += e->retvals_other;
+}
+
+static void
+stats_show_merged(struct seq_file *m, const struct callstat_entry *total)
+{
+	const struct kedr_callstat_func *func =
+		(const struct kedr_callstat_func *)total->key.k1;
+	void *call_site = (void *)total->key.k2;
+	int i;
+
+	seq_printf(m, "%s\t[<%p>] %pS\tcalls: %lu\terrors: %lu",
+		func->name, call_site, call_site,
+		total->count, total->errors);
+
+	for (i = 0; i < CALLSTAT_SIZE_BUCKETS; ++i) {
+		unsigned long lo;
+
+		if (total->sizes[i] == 0)
+			continue;
+
+		/* (lo << 1) - 1 is ULONG_MAX for the last bucket. */
+		lo = (i > 0) ? (1UL << (i - 1)) : 0;
+		seq_printf(m, "\t%lu-%lu: %u", lo,
+			(i > 0) ? (lo << 1) - 1 : 0, total->sizes[i]);
+	}
+
+	for (i = 0; i < CALLSTAT_RETVALS; ++i) {
+		if (total->retvals[i].count != 0) {
+			seq_printf(m, "\treturned %ld: %lu",
+				total->retvals[i].value,
+				total->retvals[i].count);
+		}
+	}
+	if (total->retvals_other != 0)
+		seq_printf(m, "\treturned other: %lu", total->retvals_other);
+	seq_putc(m, '\n');
+}
+
+static int
+stats_show(struct seq_file *m, void *v)
+{
+	void *merged;
+	unsigned long dropped;
+	long nr_merged;
+	long i;
+
+	/* The descriptions of the functions are used while the mutex is
+	 * locked, so they cannot go away with their owners. */
+	mutex_lock(&callstat_mutex);
+	nr_merged = kedr_stat_table_merge(table, entry_merge, &merged,
+		&dropped);
+	if (nr_merged < 0) {
+		mutex_unlock(&callstat_mutex);
+		return (int)nr_merged;
+	}
+
+	for (i = 0; i < nr_merged; ++i)
+		stats_show_merged(m, (struct callstat_entry *)merged + i);
+	seq_printf(m, "# Calls not counted (tables are full): %lu\n", dropped);
+	mutex_unlock(&callstat_mutex);
+
+	vfree(merged);
+	return 0;
+}
+
+static int
+stats_open(struct inode *inode, struct file *filp)
+{
+	return single_open(filp, stats_show, NULL);
+}
+
+static const struct file_operations stats_ops = {
+	.owner = THIS_MODULE,
+	.open = stats_open,
+	.read = seq_read,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
+static ssize_t
+reset_write(struct file *filp, const char __user *buf, size_t count,
+	loff_t *f_pos)
+{
+	mutex_lock(&callstat_mutex);
+	kedr_stat_table_reset(table);
+	mutex_unlock(&callstat_mutex);
+	return count;
+}
+
+static const struct file_operations reset_ops = {
+	.owner = THIS_MODULE,
+	.write = reset_write,
+};
+/* ====================================================================== */
+
+static int __init
+callstat_init(void)
+{
+	int ret;
+
+	if (table_bits == 0 || table_bits > 20) {
+		pr_err("[kedr_callstat] Invalid value of 'table_bits': %u\n",
+			table_bits);
+		return -EINVAL;
+	}
+
+	table = kedr_stat_table_create(table_bits, CALLSTAT_MAX_PROBES,
+		sizeof(struct callstat_entry));
+	if (table == NULL)
+		return -ENOMEM;
+
+	ret = -ENOMEM;
+	dir_callstat = debugfs_create_dir("kedr_callstat", NULL);
+	if (dir_callstat == NULL)
+		goto fail_dir;
+
+	file_stats = debugfs_create_file("stats", S_IRUSR, dir_callstat,
+		NULL, &stats_ops);
+	if (file_stats == NULL)
+		goto fail_stats;
+
+	file_reset = debugfs_create_file("reset", S_IWUSR, dir_callstat,
+		NULL, &reset_ops);
+	if (file_reset == NULL)
+		goto fail_reset;
+
+	return 0;
+
+fail_reset:
+	debugfs_remove(file_stats);
+fail_stats:
+	debugfs_remove(dir_callstat);
+fail_dir:
+	kedr_stat_table_destroy(table);
+	return ret;
+}
+
+static void __exit
+callstat_exit(void)
+{
+	debugfs_remove(file_reset);
+	debugfs_remove(file_stats);
+	debugfs_remove(dir_callstat);
+	kedr_stat_table_destroy(table);
+}
+
+module_init(callstat_init);
+module_exit(callstat_exit);
@@ -493,6 +493,15 @@ function(kedr_create_data_rules func)
 	
 	set(func_proc_data_file)
 	to_abs_path(func_proc_data_file ${func}.data)
+
+	# Latency of the functions listed in KEDR_TIMING_FUNCTIONS is measured
+	# in the trampolines.
+	set(timing_command)
+	list(FIND KEDR_TIMING_FUNCTIONS ${func} timing_index)
+	if(NOT timing_index EQUAL -1)
+		set(timing_command COMMAND printf "\"timing = yes\\n\""
+			>> "${func}_impl.data")
+	endif(NOT timing_index EQUAL -1)
 	
 	add_custom_command(OUTPUT "${func}_impl.data"
 		COMMAND printf "\"[group]\\n\"" > "${func}_impl.data"
@@ -501,6 +510,7 @@ function(kedr_create_data_rules func)
 		COMMAND printf "\"\\n\"" >> "${func}_impl.data"
 		COMMAND grep -E -v '\\[group\\]' 
 			"${func_proc_data_file}" >> "${func}_impl.data"
+		${timing_command}
 		DEPENDS
 			"${func_proc_data_file}"
 			"${func_db_data_file}"
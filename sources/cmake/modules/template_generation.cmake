@@ -4,6 +4,30 @@ set(template_generation_module_dir "${CMAKE_SOURCE_DIR}/cmake/modules")
 # Script for update dependencies for template generation process.
 set(update_dependencies_script "${template_generation_module_dir}/template_generation_files/update_deps.sh")
 
+# If KEDR_GEN_BATCH is set, the files are generated by a single call to
+# kedr_gen in batch mode (see kedr_generate_batch_finalize()) rather than
+# by a separate call for each file.
+option(KEDR_GEN_BATCH
+	"Generate all files from templates with a single call to kedr_gen."
+	OFF
+)
+
+# Manifest listing the files to be generated in batch mode.
+set(KEDR_GEN_BATCH_MANIFEST "${CMAKE_BINARY_DIR}/kedr_gen_batch.manifest")
+
+# kedr_gen keeps the parsed templates in this directory and loads them from
+# there rather than parses them again (see --template-cache option of 
+# kedr_gen). The directory may be removed at any time. If the value is 
+# empty, the cache is not used.
+set(KEDR_GEN_TEMPLATE_CACHE "${CMAKE_BINARY_DIR}/kedr_gen_cache" CACHE PATH
+	"Directory for the cache of precompiled templates used by kedr_gen (empty - no cache)."
+)
+if(KEDR_GEN_TEMPLATE_CACHE)
+    set(kedr_gen_cache_options --template-cache "${KEDR_GEN_TEMPLATE_CACHE}")
+else(KEDR_GEN_TEMPLATE_CACHE)
+    set(kedr_gen_cache_options)
+endif(KEDR_GEN_TEMPLATE_CACHE)
+
 # Generate file using kedr_gen tool.
 #
 # kedr_generate (filename datafile template_dir)
@@ -43,18 +67,52 @@ function(kedr_generate filename datafile template_dir)
     # 'deps_file' set 'deps_list' variable to list of real dependencies.
     include("${deps_file}")
     
+    if(KEDR_GEN_BATCH)
+	# Only record the job here, the rule to generate the file is created
+	# in kedr_generate_batch_finalize().
+	set_property(GLOBAL APPEND PROPERTY KEDR_GEN_BATCH_JOBS
+	    "${template_dir} ${datafile_abs} ${output_file} ${deps_file}"
+	)
+	set_property(GLOBAL APPEND PROPERTY KEDR_GEN_BATCH_OUTPUTS
+	    "${output_file}"
+	)
+	set_property(GLOBAL APPEND PROPERTY KEDR_GEN_BATCH_DEPENDS
+	    ${datafile_abs} ${deps_list}
+	)
+	# The file is actually created when 'kedr_gen_batch' target is built.
+	# This rule makes the targets using the file depend on that target.
+	add_custom_command(OUTPUT "${output_file}"
+	    COMMAND test -f "${output_file}"
+	    DEPENDS kedr_gen_batch
+	)
+	return()
+    endif(KEDR_GEN_BATCH)
+    
+    # kedr_gen rewrites the output file only if its contents have changed.
+    # If they have not, the timestamp of the file is kept, so the files
+    # depending on it (e.g. the sources of kernel modules) are not rebuilt
+    # after the data file or a template is touched.
+    #
+    # As the output file is not necessarily updated, a stamp file records
+    # when the generation has been done last time.
+    #
+    # kedr_gen also updates dependencies file if dependencies changed.
+    # Because 'deps_file' is used in include() cmake command, its changing
+    # will trigger reconfiguration at the next build.
+    set(stamp_file "${CMAKE_CURRENT_BINARY_DIR}/.${filename}.stamp")
+    add_custom_command(OUTPUT "${stamp_file}"
+	COMMAND ${KEDR_GEN_TOOL} ${template_dir} ${datafile_abs}
+	    --output "${output_file}" --depfile "${deps_file}"
+	    ${kedr_gen_cache_options}
+	COMMAND ${CMAKE_COMMAND} -E touch "${stamp_file}"
+	DEPENDS ${datafile_abs} ${deps_list}
+    )
     add_custom_command(OUTPUT "${output_file}"
-# Because output file is created via shell redirection mechanizm, it exists
-# whenever generation process is succeed or failed.
-#
-# Second part of the COMMAND(after ||) remove output file in case of error, and also return error.
-	    COMMAND ${KEDR_GEN_TOOL} ${template_dir} ${datafile_abs} > "${output_file}" || (rm ${output_file} && /bin/false)
-# Update dependencies file if dependencies changed.
-#
-# Because 'deps_file' is used in include() cmake command, its changing
-# will trigger reconfiguration at the next build.
-	    COMMAND sh "${update_dependencies_script}" "${deps_file}" ${template_dir}
-	    DEPENDS ${datafile_abs} ${deps_list}
+	COMMAND test -f "${output_file}" ||
+	    ${KEDR_GEN_TOOL} ${template_dir} ${datafile_abs}
+	    --output "${output_file}" --depfile "${deps_file}"
+	    ${kedr_gen_cache_options}
+	DEPENDS "${stamp_file}"
     )
 
 # NOTE: If any template file, used by previous generation process,
@@ -67,4 +125,61 @@ function(kedr_generate filename datafile template_dir)
 # 1) delete deps file and resulting file. Then, futher invocation of
 #    'make' runs cmake, which clears dependencies, then builds
 #    resulting file again and regenerates depencies file.
-endfunction(kedr_generate filename datafile template_dir)
\ No newline at end of file
+endfunction(kedr_generate filename datafile template_dir)
+
+# kedr_generate_batch_finalize()
+#
+# Create the rule to generate all the files requested by kedr_generate()
+# with a single call to kedr_gen in batch mode. The files are generated
+# when 'kedr_gen_batch' target is built.
+#
+# Should be called after all the files are requested, i.e. after all
+# add_subdirectory() commands. Does nothing if KEDR_GEN_BATCH is not set.
+function(kedr_generate_batch_finalize)
+    if(NOT KEDR_GEN_BATCH)
+	return()
+    endif(NOT KEDR_GEN_BATCH)
+
+    get_property(batch_jobs GLOBAL PROPERTY KEDR_GEN_BATCH_JOBS)
+    if(NOT batch_jobs)
+	return()
+    endif(NOT batch_jobs)
+    get_property(batch_outputs GLOBAL PROPERTY KEDR_GEN_BATCH_OUTPUTS)
+    get_property(batch_depends GLOBAL PROPERTY KEDR_GEN_BATCH_DEPENDS)
+
+    set(manifest_contents "# Generated by CMake, do not edit.\n")
+    foreach(job ${batch_jobs})
+	set(manifest_contents "${manifest_contents}${job}\n")
+    endforeach(job ${batch_jobs})
+
+    # Rewrite the manifest only if it has changed, so that its timestamp
+    # does not trigger generation of all files after each reconfiguration.
+    file(WRITE "${KEDR_GEN_BATCH_MANIFEST}.new" "${manifest_contents}")
+    configure_file("${KEDR_GEN_BATCH_MANIFEST}.new"
+	"${KEDR_GEN_BATCH_MANIFEST}"
+	COPYONLY
+    )
+    file(REMOVE "${KEDR_GEN_BATCH_MANIFEST}.new")
+
+    if(batch_depends)
+	list(REMOVE_DUPLICATES batch_depends)
+    endif(batch_depends)
+    # The files generated in batch mode may be used as data files for
+    # the others, they must not be listed as the dependencies here.
+    if(batch_outputs)
+	list(REMOVE_ITEM batch_depends ${batch_outputs})
+    endif(batch_outputs)
+
+    # The rules for the generated files themselves are created in the 
+    # directories where the files were requested, so a stamp file is used
+    # here as the output.
+    set(batch_stamp "${CMAKE_BINARY_DIR}/kedr_gen_batch.stamp")
+    add_custom_command(OUTPUT "${batch_stamp}"
+	COMMAND ${KEDR_GEN_TOOL} --batch "${KEDR_GEN_BATCH_MANIFEST}"
+	    ${kedr_gen_cache_options}
+	COMMAND ${CMAKE_COMMAND} -E touch "${batch_stamp}"
+	DEPENDS "${KEDR_GEN_BATCH_MANIFEST}" ${batch_depends}
+	COMMENT "Generating files from templates"
+    )
+    add_custom_target(kedr_gen_batch DEPENDS "${batch_stamp}")
+endfunction(kedr_generate_batch_finalize)
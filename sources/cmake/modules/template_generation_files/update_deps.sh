@@ -28,10 +28,14 @@ fi
 #
 # Print full names of template files in the given directory. 
 # Each name is enclosed into "".
+#
+# The list must be the same as kedr_gen writes with --depfile option
+# (sorted, only the files kedr_gen loads), otherwise the dependencies
+# file would be rewritten at each build.
 template_files_in_dir()
 {
     if test -d $1; then
-        find "$1" -name "*.tpl" -printf "\"%p\"\n"
+        find "$1" -maxdepth 1 -name "*.tpl" -printf "\"%p\"\n" | LC_ALL=C sort
     fi
     #
     # Also add dependency on directory itself.
@@ -30,6 +30,9 @@
 
 #include <linux/list.h>
 #include <linux/hash.h> /* hash_ptr() */
+#include <linux/bitops.h>
+#include <linux/bitmap.h>
+#include <linux/string.h>
 
 #include <linux/mutex.h>
 
@@ -62,6 +65,12 @@ struct payload_elem
 	struct list_head list;
 	
 	struct kedr_payload *payload;
+	
+	/*
+	 * Bitmap of the targets the payload is applied to in the current
+	 * session. NULL means all targets.
+	 */
+	unsigned long* targets_mask;
 };
 
 /* Look for a given element in the list. */
@@ -74,11 +83,20 @@ static void payload_elem_release(struct payload_elem* elem);
 static int payload_elem_fix_all(struct list_head *elems);
 static void payload_elem_release_all(struct list_head *elems);
 
+/*
+ * Bind all payloads to the targets with given names, according to
+ * the binding set by the user or declared by the payloads.
+ */
+static int payload_elem_bind_all(struct list_head *elems,
+	const char* const* target_names, int n_targets);
+static void payload_elem_unbind_all(struct list_head *elems);
+
 /* Call corresponding callbacks for all used payloads. */
 static void payloads_on_session_start(void);
 static void payloads_on_session_end(void);
-static void payloads_on_target_loaded(struct module* m);
-static void payloads_on_target_about_to_unloaded(struct module* m);
+static void payloads_on_target_loaded(struct module* m, int target_index);
+static void payloads_on_target_about_to_unloaded(struct module* m,
+	int target_index);
 
 
 /* Mark all functions which intercepted by payload as used*/
@@ -157,6 +175,37 @@ static struct functions_map replaced_functions_map;
 
 static struct kedr_base_interception_info* info_array_current;
 
+/*
+ * Number of targets in the current session.
+ * 
+ * Nonzero only if some payloads are applied to some targets but not to
+ * all of them. In that case interception info contains per-target
+ * information.
+ */
+static int per_target_n_targets = 0;
+
+/*
+ * Binding of the payloads to the targets set by the user
+ * (see kedr_base_set_payload_targets()). NULL if not set.
+ */
+static char* payload_targets_user = NULL;
+
+/* Whether payload is applied to the target with given index. */
+static inline int
+payload_elem_is_bound(struct payload_elem* elem, int target_index)
+{
+	return (elem->targets_mask == NULL)
+		|| test_bit(target_index, elem->targets_mask);
+}
+
+/* Whether payload is applied to at least one target. */
+static inline int
+payload_elem_is_used(struct payload_elem* elem)
+{
+	return (elem->targets_mask == NULL)
+		|| !bitmap_empty(elem->targets_mask, per_target_n_targets);
+}
+
 /* Whether newly registered payloads should support several targets. */
 int should_force_several_targets = 0;
 
@@ -253,10 +302,14 @@ function_counters_table_begin(struct function_counters_table* table,
 
 static void function_counters_table_iter_next(struct function_counters_table_iter* iter);
 
-/* Initialize arrays for kedr_base_interception_info */
+/*
+ * Initialize arrays for kedr_base_interception_info.
+ * 
+ * If 'n_targets' is not 0, per-target arrays are initialized too.
+ */
 static int
 interception_info_init(struct kedr_base_interception_info* info,
-    void* orig, int n_pre, int is_replaced, int n_post);
+    void* orig, int n_pre, int is_replaced, int n_post, int n_targets);
 
 /* Add pre-function to the intermediate info */
 static void
@@ -274,6 +327,22 @@ interception_info_set_replace(struct kedr_base_interception_info* info,
 	void* replace_function);
 
 
+/* Add pre- and post-functions to the per-target intermediate info */
+static void
+intermediate_info_add_pre(struct kedr_intermediate_info* info,
+	void* pre_function);
+static void
+intermediate_info_add_post(struct kedr_intermediate_info* info,
+	void* post_function);
+
+/*
+ * Free per-target arrays which are empty, so the function is treated
+ * as not intercepted in the corresponding targets.
+ */
+static void
+interception_info_compact(struct kedr_base_interception_info* info,
+	int n_targets);
+
 static void
 interception_info_destroy(struct kedr_base_interception_info* info);
 
@@ -305,7 +374,13 @@ kedr_base_init(void)
 		"initializing\n");
 
 	result = functions_map_init(&replaced_functions_map, 20);
-    if(result) return result;
+	if(result)
+	{
+		/* Binding may be set before initialization. */
+		kfree(payload_targets_user);
+		payload_targets_user = NULL;
+		return result;
+	}
 	
 	return 0;
 }
@@ -314,6 +389,9 @@ void
 kedr_base_destroy(void)
 {
 	functions_map_destroy(&replaced_functions_map);
+	
+	kfree(payload_targets_user);
+	payload_targets_user = NULL;
 	return;
 }
 
@@ -365,6 +443,106 @@ void unforce_several_targets(void)
 	should_force_several_targets = 0;
 	if(can_use_lock) mutex_unlock(&base_mutex);
 }
+
+/*
+ * Check format of the binding of the payloads to the targets.
+ * 
+ * Return 0 if format is correct, -EINVAL otherwise.
+ */
+static int
+payload_targets_check(const char* payload_targets)
+{
+	const char* beg = payload_targets;
+	
+	while(*beg)
+	{
+		size_t len = strcspn(beg, ";\n");
+		if(len)
+		{
+			size_t name_len = strcspn(beg, ":;\n");
+			if((name_len == 0) || (name_len == len))
+			{
+				kedr_err("Incorrect binding of the payload to the targets: '%.*s'.\n",
+					(int)len, beg);
+				return -EINVAL;
+			}
+		}
+		
+		beg += len;
+		if(*beg) beg++;
+	}
+	
+	return 0;
+}
+
+/*
+ * kedr_base_set_payload_targets() is used in module parameter's set
+ * callback, so check param_set_can_use_lock() as for
+ * force_several_targets().
+ */
+int kedr_base_set_payload_targets(const char* payload_targets)
+{
+	int result;
+	char* payload_targets_new = NULL;
+	int can_use_lock = param_set_can_use_lock();
+	
+	result = payload_targets_check(payload_targets);
+	if(result) return result;
+	
+	if(strspn(payload_targets, ";\n") != strlen(payload_targets))
+	{
+		char* p;
+		
+		payload_targets_new = kstrdup(payload_targets, GFP_KERNEL);
+		if(payload_targets_new == NULL) return -ENOMEM;
+		/* Newlines are treated as separators of the entries. */
+		for(p = payload_targets_new; *p; p++)
+		{
+			if(*p == '\n') *p = ';';
+		}
+		/* Remove trailing separators (e.g., from 'echo'). */
+		while((p != payload_targets_new) && (*(p - 1) == ';'))
+			*--p = '\0';
+	}
+	
+	if(can_use_lock) mutex_lock(&base_mutex);
+	
+	if(payloads_are_used)
+	{
+		kedr_err0("Cannot change binding of the payloads to the targets while a target is loaded.\n");
+		result = -EBUSY;
+	}
+	else
+	{
+		kfree(payload_targets_user);
+		payload_targets_user = payload_targets_new;
+		payload_targets_new = NULL;
+	}
+	
+	if(can_use_lock) mutex_unlock(&base_mutex);
+	
+	kfree(payload_targets_new);
+	
+	return result;
+}
+
+int kedr_base_get_payload_targets(char* buf, size_t size)
+{
+	size_t len = 0;
+	
+	mutex_lock(&base_mutex);
+	
+	if(payload_targets_user)
+	{
+		len = strlen(payload_targets_user);
+		if(len > size) len = size;
+		memcpy(buf, payload_targets_user, len);
+	}
+	
+	mutex_unlock(&base_mutex);
+	
+	return (int)len;
+}
 /* =================Interface implementation================== */
 
 /*
@@ -377,7 +555,8 @@ void unforce_several_targets(void)
  * NB: on_session_end() callbacks should be called after it, without mutex locked.
  */
 static int
-kedr_base_session_start_internal(void)
+kedr_base_session_start_internal(const char* const* target_names,
+	int n_targets)
 {
 	int result;
 
@@ -388,9 +567,17 @@ kedr_base_session_start_internal(void)
 	result = payload_elem_fix_all(&payload_list);
 	if(result) return result;
 	
+	result = payload_elem_bind_all(&payload_list, target_names, n_targets);
+	if(result)
+	{
+		payload_elem_release_all(&payload_list);
+		return result;
+	}
+	
 	info_array = interception_info_array_create();
 	if(IS_ERR(info_array))
 	{
+		payload_elem_unbind_all(&payload_list);
 		payload_elem_release_all(&payload_list);
 		return PTR_ERR(info_array);
 	}
@@ -414,7 +601,7 @@ kedr_base_session_start_internal(void)
  * at kedr_target_unload_callback() call.
  */
 const struct kedr_base_interception_info*
-kedr_base_session_start(void)
+kedr_base_session_start(const char* const* target_names, int n_targets)
 {
 	/* 0 - return info_array_current, otherwise return ERR_PTR(result)*/
 	int result;
@@ -423,7 +610,7 @@ kedr_base_session_start(void)
 
 	if(result) return ERR_PTR(result);
 	
-	result = kedr_base_session_start_internal();
+	result = kedr_base_session_start_internal(target_names, n_targets);
 
 	mutex_unlock(&base_mutex);
 	
@@ -447,19 +634,20 @@ void kedr_base_session_stop(void)
 	
 	payloads_are_used = 0;
 	interception_info_array_free(info_array_current);
+	payload_elem_unbind_all(&payload_list);
 	payload_elem_release_all(&payload_list);
 	
 	mutex_unlock(&base_mutex);
 }
 
-void kedr_base_target_load(struct module* m)
+void kedr_base_target_load(struct module* m, int target_index)
 {
-	payloads_on_target_loaded(m);
+	payloads_on_target_loaded(m, target_index);
 }
 
-void kedr_base_target_unload(struct module* m)
+void kedr_base_target_unload(struct module* m, int target_index)
 {
-	payloads_on_target_about_to_unloaded(m);
+	payloads_on_target_about_to_unloaded(m, target_index);
 }
 
 
@@ -672,6 +860,169 @@ payload_elem_release_all(struct list_head *elems)
 	}
 }
 
+/*
+ * Whether 'name' of length 'len' is the name of the module 'mod_name'.
+ * 
+ * Dashes in 'name' are treated as underscores, as in the names of the
+ * modules.
+ */
+static int
+module_name_matches(const char* name, size_t len, const char* mod_name)
+{
+	size_t i;
+	
+	if(strlen(mod_name) != len) return 0;
+	
+	for(i = 0; i < len; i++)
+	{
+		char c = (name[i] == '-') ? '_' : name[i];
+		if(c != mod_name[i]) return 0;
+	}
+	return 1;
+}
+
+/*
+ * Look for the binding of the payload from module 'mod_name' in the
+ * binding set by the user.
+ * 
+ * Return list of targets for the payload or NULL. Length of the list is
+ * stored into 'len'.
+ */
+static const char*
+payload_targets_user_find(const char* mod_name, size_t* len)
+{
+	const char* beg = payload_targets_user;
+	
+	if(beg == NULL) return NULL;
+	
+	while(*beg)
+	{
+		size_t entry_len = strcspn(beg, ";");
+		size_t name_len = strcspn(beg, ":;");
+		
+		if((name_len < entry_len)
+			&& module_name_matches(beg, name_len, mod_name))
+		{
+			*len = entry_len - name_len - 1;
+			return beg + name_len + 1;
+		}
+		
+		beg += entry_len;
+		if(*beg) beg++;
+	}
+	return NULL;
+}
+
+static int
+payload_elem_bind(struct payload_elem* elem,
+	const char* const* target_names, int n_targets)
+{
+	struct kedr_payload* payload = elem->payload;
+	const char* targets = NULL;
+	size_t targets_len = 0;
+	const char* beg;
+	int i;
+	
+	elem->targets_mask = NULL;
+	
+	if(payload->mod)
+		targets = payload_targets_user_find(module_name(payload->mod),
+			&targets_len);
+	
+	if((targets == NULL) && (payload->targets != NULL))
+	{
+		targets = payload->targets;
+		targets_len = strlen(targets);
+	}
+	
+	if(targets == NULL) return 0; /* All targets */
+	
+	elem->targets_mask = kzalloc(BITS_TO_LONGS(n_targets)
+		* sizeof(*elem->targets_mask), GFP_KERNEL);
+	if(elem->targets_mask == NULL)
+	{
+		pr_err("payload_elem_bind: Failed to allocate targets mask.");
+		return -ENOMEM;
+	}
+	
+	for(beg = targets; beg < targets + targets_len;)
+	{
+		size_t len = strcspn(beg, ",;");
+		if(beg + len > targets + targets_len)
+			len = targets + targets_len - beg;
+		
+		for(i = 0; i < n_targets; i++)
+		{
+			if(module_name_matches(beg, len, target_names[i]))
+				set_bit(i, elem->targets_mask);
+		}
+		
+		beg += len + 1;
+	}
+	
+	if(bitmap_full(elem->targets_mask, n_targets))
+	{
+		kfree(elem->targets_mask);
+		elem->targets_mask = NULL;
+	}
+	
+	return 0;
+}
+
+static int
+payload_elem_bind_all(struct list_head *elems,
+	const char* const* target_names, int n_targets)
+{
+	struct payload_elem* elem;
+	
+	per_target_n_targets = 0;
+	
+	list_for_each_entry(elem, elems, list)
+	{
+		int result;
+		
+		if(n_targets == 0)
+		{
+			elem->targets_mask = NULL;
+			continue;
+		}
+		
+		result = payload_elem_bind(elem, target_names, n_targets);
+		if(result)
+		{
+			list_for_each_entry_continue_reverse(elem, elems, list)
+			{
+				kfree(elem->targets_mask);
+				elem->targets_mask = NULL;
+			}
+			per_target_n_targets = 0;
+			return result;
+		}
+		
+		/* 
+		 * Payload which is not applied to any target is simply
+		 * ignored. Otherwise per-target interception info is needed.
+		 */
+		if((elem->targets_mask != NULL)
+			&& !bitmap_empty(elem->targets_mask, n_targets))
+			per_target_n_targets = n_targets;
+	}
+	
+	return 0;
+}
+
+static void
+payload_elem_unbind_all(struct list_head *elems)
+{
+	struct payload_elem* elem;
+	list_for_each_entry(elem, elems, list)
+	{
+		kfree(elem->targets_mask);
+		elem->targets_mask = NULL;
+	}
+	per_target_n_targets = 0;
+}
+
 /*
  * Execute some actions(e.g. call callbacks) for every payload registered.
  * 
@@ -688,12 +1039,14 @@ payload_elem_release_all(struct list_head *elems)
 #define for_each_payload_reverse(elem) list_for_each_entry_reverse(elem, &payload_list, list)
 
 static void
-payloads_on_target_loaded(struct module* m)
+payloads_on_target_loaded(struct module* m, int target_index)
 {
 	struct payload_elem* elem;
 	struct kedr_payload* payload;
 	for_each_payload(elem)
 	{
+		if(!payload_elem_is_bound(elem, target_index)) continue;
+		
 		payload = elem->payload;
 		if(payload->on_target_loaded)
 			payload->on_target_loaded(m);
@@ -703,12 +1056,14 @@ payloads_on_target_loaded(struct module* m)
 	}
 }
 static void
-payloads_on_target_about_to_unloaded(struct module* m)
+payloads_on_target_about_to_unloaded(struct module* m, int target_index)
 {
 	struct payload_elem* elem;
 	struct kedr_payload* payload;
 	for_each_payload_reverse(elem)
 	{
+		if(!payload_elem_is_bound(elem, target_index)) continue;
+		
 		payload = elem->payload;
 		if(payload->on_target_about_to_unload)
 			payload->on_target_about_to_unload(m);
@@ -1158,10 +1513,53 @@ function_counters_table_iter_next(struct function_counters_table_iter* iter)
 	return;
 }
 
+/*
+ * Allocate empty NULL-terminated array for 'n' functions.
+ * If 'n' is 0, array is set to NULL.
+ */
+static int
+functions_array_init(void*** array, int n)
+{
+	if(n > 0)
+	{
+		*array = kmalloc((n + 1) * sizeof(**array), GFP_KERNEL);
+		if(*array == NULL)
+		{
+			pr_err("Failed to allocate array of functions.");
+			return -ENOMEM;
+		}
+		/* initially array is empty*/
+		(*array)[0] = NULL;
+	}
+	else
+	{
+		*array = NULL;
+	}
+	return 0;
+}
+
+static void
+intermediate_info_array_destroy(struct kedr_intermediate_info* per_target,
+	int n_targets)
+{
+	int t;
+	
+	if(per_target == NULL) return;
+	
+	for(t = 0; t < n_targets; t++)
+	{
+		kfree(per_target[t].pre);
+		kfree(per_target[t].post);
+	}
+	kfree(per_target);
+}
+
 int
 interception_info_init(struct kedr_base_interception_info* info,
-	void* orig, int n_pre, int is_replaced, int n_post)
+	void* orig, int n_pre, int is_replaced, int n_post, int n_targets)
 {
+	int t;
+	
 	info->orig = orig;
 
 	if(n_pre > 0)
@@ -1203,8 +1601,36 @@ interception_info_init(struct kedr_base_interception_info* info,
 	(void)is_replaced;
 	
 	info->replace = NULL;
+	
+	info->per_target = NULL;
+	if(n_targets == 0) return 0;
+	
+	/* kzalloc() makes all per-target arrays NULL initially. */
+	info->per_target = kzalloc(n_targets * sizeof(*info->per_target),
+		GFP_KERNEL);
+	if(info->per_target == NULL)
+	{
+		pr_err("Failed to allocate array of per-target interception info.");
+		goto err_per_target;
+	}
+	
+	for(t = 0; t < n_targets; t++)
+	{
+		if(functions_array_init(&info->per_target[t].pre, n_pre)
+			|| functions_array_init(&info->per_target[t].post, n_post))
+		{
+			goto err_per_target;
+		}
+	}
 
 	return 0;
+
+err_per_target:
+	intermediate_info_array_destroy(info->per_target, n_targets);
+	info->per_target = NULL;
+	kfree(info->pre);
+	kfree(info->post);
+	return -ENOMEM;
 }
 
 /* Add pre-function to the interception info */
@@ -1243,11 +1669,62 @@ interception_info_set_replace(struct kedr_base_interception_info* info,
 	info->replace = replace_function;
 }
 
+/* Add pre-function to the per-target intermediate info */
+void
+intermediate_info_add_pre(struct kedr_intermediate_info* info,
+	void* pre_function)
+{
+	void** pre_elem;
+	BUG_ON(info->pre == NULL);
+	for(pre_elem = info->pre; *pre_elem != NULL; pre_elem++);
+	
+	*pre_elem = pre_function;
+	*(pre_elem + 1) = NULL;
+}
+
+/* Add post-function to the per-target intermediate info */
+void
+intermediate_info_add_post(struct kedr_intermediate_info* info,
+	void* post_function)
+{
+	void** post_elem;
+	BUG_ON(info->post == NULL);
+	for(post_elem = info->post; *post_elem != NULL; post_elem++);
+	
+	*post_elem = post_function;
+	*(post_elem + 1) = NULL;
+}
+
+void
+interception_info_compact(struct kedr_base_interception_info* info,
+	int n_targets)
+{
+	int t;
+	
+	if(info->per_target == NULL) return;
+	
+	for(t = 0; t < n_targets; t++)
+	{
+		struct kedr_intermediate_info* target_info = &info->per_target[t];
+		if((target_info->pre != NULL) && (target_info->pre[0] == NULL))
+		{
+			kfree(target_info->pre);
+			target_info->pre = NULL;
+		}
+		if((target_info->post != NULL) && (target_info->post[0] == NULL))
+		{
+			kfree(target_info->post);
+			target_info->post = NULL;
+		}
+	}
+}
+
 void
 interception_info_destroy(struct kedr_base_interception_info* info)
 {
 	kfree(info->pre);
 	kfree(info->post);
+	intermediate_info_array_destroy(info->per_target, per_target_n_targets);
 }
 
 /* Allocate appropriate amount of memory and combine the interception
@@ -1266,6 +1743,8 @@ interception_info_array_create(void)
 	struct function_counters_table function_counters;
 	struct function_counters_table_iter iter;
 	int i;
+	/* Index of the target */
+	int t;
 	
 	if (function_counters_table_init(&function_counters, 100))
 	{
@@ -1276,6 +1755,8 @@ interception_info_array_create(void)
 	{
 		struct kedr_payload* payload;
 		
+		if(!payload_elem_is_used(elem)) continue;
+		
 		payload = elem->payload;
 		if(payload->pre_pairs != NULL)
 		{
@@ -1347,7 +1828,8 @@ interception_info_array_create(void)
 		/* initialize interception info for given function */
 		result = interception_info_init(&info_array[i],
             iter.elem->function, iter.elem->n_pre,
-            iter.elem->is_replaced, iter.elem->n_post);
+            iter.elem->is_replaced, iter.elem->n_post,
+            per_target_n_targets);
 		if(result)
 		{
 			goto err_interception_info;
@@ -1362,6 +1844,8 @@ interception_info_array_create(void)
 	{
 		struct kedr_payload* payload;
 		
+		if(!payload_elem_is_used(elem)) continue;
+		
 		payload = elem->payload;
 		if(payload->pre_pairs != NULL)
 		{
@@ -1372,6 +1856,12 @@ interception_info_array_create(void)
 					interception_info_array_find(info_array, pre_pair->orig);
 				BUG_ON(info_elem == NULL);
 				interception_info_add_pre(info_elem, pre_pair->pre);
+				for(t = 0; t < per_target_n_targets; t++)
+				{
+					if(payload_elem_is_bound(elem, t))
+						intermediate_info_add_pre(
+							&info_elem->per_target[t], pre_pair->pre);
+				}
 			}
 		}
 		
@@ -1384,6 +1874,12 @@ interception_info_array_create(void)
 					interception_info_array_find(info_array, replace_pair->orig);
 				BUG_ON(info_elem == NULL);
 				interception_info_set_replace(info_elem, replace_pair->replace);
+				for(t = 0; t < per_target_n_targets; t++)
+				{
+					if(payload_elem_is_bound(elem, t))
+						info_elem->per_target[t].replace =
+							replace_pair->replace;
+				}
 			}
 		}
 
@@ -1396,10 +1892,21 @@ interception_info_array_create(void)
 					interception_info_array_find(info_array, post_pair->orig);
 				BUG_ON(info_elem == NULL);
 				interception_info_add_post(info_elem, post_pair->post);
+				for(t = 0; t < per_target_n_targets; t++)
+				{
+					if(payload_elem_is_bound(elem, t))
+						intermediate_info_add_post(
+							&info_elem->per_target[t], post_pair->post);
+				}
 			}
 		}
 	}
 	
+	for(i = 0; i < function_counters.n_functions; i++)
+	{
+		interception_info_compact(&info_array[i], per_target_n_targets);
+	}
+	
 	function_counters_table_destroy(&function_counters);
 	
 	return info_array;
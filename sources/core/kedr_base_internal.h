@@ -8,6 +8,8 @@
 
 #include <linux/module.h>
 
+#include <kedr/core/kedr_functions_support.h> /* struct kedr_intermediate_info */
+
 /* 
  * When register payload, this callback is called for every function
  * which payload require to intercept.
@@ -39,12 +41,29 @@ struct kedr_base_interception_info
     void** post;
     // replacement function or NULL.
     void* replace;
+    
+    /*
+     * Array of per-target interception information, indexed by
+     * the index of the target, or NULL if the function is intercepted
+     * the same way for all targets.
+     * 
+     * If all fields of the element are NULL, the function should not be
+     * intercepted in that target at all.
+     */
+    struct kedr_intermediate_info* per_target;
 };
 
 /*
  * Fix all payloads and return array of functions with information
  * how them should be intercepted.
  * 
+ * 'target_names' is an array of 'n_targets' names of the target modules
+ * watched for in the session. Index of the name in that array is
+ * the index of the target. The names are used for binding payloads
+ * to the targets (see 'targets' field of struct kedr_payload and
+ * kedr_base_set_payload_targets()). If 'n_targets' is 0, all payloads
+ * are applied to all targets.
+ * 
  * Last element in the array contains NULL in 'orig' field.
  * 
  * On error, return ERR_PTR.
@@ -53,7 +72,7 @@ struct kedr_base_interception_info
  * at kedr_base_session_end() call.
  */
 const struct kedr_base_interception_info*
-kedr_base_session_start(void);
+kedr_base_session_start(const char* const* target_names, int n_targets);
 
 /*
  * Make all payloads available to unload.
@@ -61,9 +80,38 @@ kedr_base_session_start(void);
 void kedr_base_session_stop(void);
 
 
-/* Inform payloads about target module being loaded/unloaded. */
-void kedr_base_target_load(struct module* m);
-void kedr_base_target_unload(struct module* m);
+/*
+ * Inform payloads about target module being loaded/unloaded.
+ * 
+ * Only the payloads bound to the target with index 'target_index'
+ * are informed.
+ */
+void kedr_base_target_load(struct module* m, int target_index);
+void kedr_base_target_unload(struct module* m, int target_index);
+
+/*
+ * Set binding of the payloads to the targets, which overrides one
+ * declared by the payloads themselves.
+ * 
+ * Format of the binding is
+ * 
+ * <payload_module>:<target>[,<target>...][;<payload_module>:...]
+ * 
+ * Binding for the payloads not listed is not changed. An empty string
+ * clears the binding.
+ * 
+ * Binding cannot be changed while a target is loaded.
+ * 
+ * NOTE: Function is allowed to be called even before kedr_base_init().
+ */
+int kedr_base_set_payload_targets(const char* payload_targets);
+
+/*
+ * Fill buffer with the current binding of the payloads to the targets.
+ * 
+ * Return number of characters written.
+ */
+int kedr_base_get_payload_targets(char* buf, size_t size);
 
 /*
  * Initialize and destroy KEDR base functionality.
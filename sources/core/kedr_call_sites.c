@@ -0,0 +1,562 @@
+/*
+ * Lists of the call sites in the target modules prepared in advance
+ * from the relocations in the module files.
+ *
+ * The lists are written to "kedr_call_sites/sites" file in debugfs in
+ * the following format (the sizes and the offsets are hexadecimal):
+ *
+ *   target <module_name> <core_text_size> <init_text_size>
+ *   c <offset>
+ *   ...
+ *   i <offset>
+ *   ...
+ *   end
+ *
+ * 'c' and 'i' lines specify the call sites in the "core" and "init" code
+ * areas of the module, respectively. The list is used only after "end"
+ * line has been written, it replaces the list for the same module if
+ * there was one. "clear" line removes all the lists. Empty lines and
+ * the lines starting with '#' are ignored.
+ */
+
+/* ========================================================================
+ * Copyright (C) 2012-2014, KEDR development team
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation.
+ ======================================================================== */
+
+#include "kedr_call_sites_internal.h"
+
+#include <linux/module.h>
+#include <linux/kernel.h>
+#include <linux/errno.h>
+#include <linux/list.h>
+#include <linux/mutex.h>
+#include <linux/slab.h>
+#include <linux/vmalloc.h>
+#include <linux/string.h>
+#include <linux/ctype.h>
+#include <linux/uaccess.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include <linux/fs.h>
+
+#define COMPONENT_STRING "call_sites: "
+
+/* Maximum length of a line written to "sites" file. */
+#define SITES_LINE_MAX 128
+
+/* 'call rel32' and 'jmp rel32' instructions are 5 bytes long. */
+#define CALL_INSN_SIZE 5
+
+enum call_sites_status
+{
+    CALL_SITES_NOT_USED,
+    CALL_SITES_USED,
+    CALL_SITES_MISMATCH,
+};
+
+struct call_sites_elem
+{
+    struct list_head list;
+    char name[MODULE_NAME_LEN];
+
+    struct kedr_call_sites sites;
+
+    /* The arrays of offsets, the capacity is in elements. */
+    u32* core_offsets;
+    unsigned int core_capacity;
+    u32* init_offsets;
+    unsigned int init_capacity;
+
+    /* What has happened when the list was used the last time. */
+    enum call_sites_status status;
+};
+
+/* The lists which can be used. Protected by 'call_sites_mutex'. */
+static LIST_HEAD(call_sites_lists);
+static DEFINE_MUTEX(call_sites_mutex);
+
+/* The state of "sites" file opened for writing. */
+struct sites_writer
+{
+    char line[SITES_LINE_MAX];
+    size_t len;
+
+    /* The list being written, not visible to the instrumentor yet. */
+    struct call_sites_elem* pending;
+};
+
+static struct dentry* dir_call_sites = NULL;
+static struct dentry* file_sites = NULL;
+static struct dentry* file_status = NULL;
+
+/* ================================================================ */
+static void
+call_sites_elem_destroy(struct call_sites_elem* elem)
+{
+    if(elem == NULL) return;
+
+    vfree(elem->core_offsets);
+    vfree(elem->init_offsets);
+    kfree(elem);
+}
+
+/* Should be executed with mutex locked. */
+static struct call_sites_elem*
+call_sites_elem_find(const char* name)
+{
+    struct call_sites_elem* elem;
+
+    list_for_each_entry(elem, &call_sites_lists, list)
+    {
+        if(strcmp(elem->name, name) == 0) return elem;
+    }
+    return NULL;
+}
+
+/* Should be executed with mutex locked. */
+static void
+call_sites_lists_clear(void)
+{
+    while(!list_empty(&call_sites_lists))
+    {
+        struct call_sites_elem* elem = list_first_entry(&call_sites_lists,
+            struct call_sites_elem, list);
+        list_del(&elem->list);
+        call_sites_elem_destroy(elem);
+    }
+}
+
+/*
+ * Append 'offset' to the array of offsets, reallocating the array if
+ * needed.
+ */
+static int
+offsets_append(u32** offsets, unsigned int* n, unsigned int* capacity,
+    u32 offset)
+{
+    if(*n == *capacity)
+    {
+        unsigned int capacity_new = (*capacity != 0) ? *capacity * 2 : 256;
+        u32* offsets_new = vmalloc(capacity_new * sizeof(u32));
+        if(offsets_new == NULL) return -ENOMEM;
+
+        if(*n != 0)
+            memcpy(offsets_new, *offsets, *n * sizeof(u32));
+        vfree(*offsets);
+        *offsets = offsets_new;
+        *capacity = capacity_new;
+    }
+    (*offsets)[(*n)++] = offset;
+    return 0;
+}
+
+/* ================================================================ */
+/* Parsing of the lines written to "sites" file */
+
+/* Split the next whitespace-separated word off 'str'. */
+static char*
+next_word(char** str)
+{
+    char* word = skip_spaces(*str);
+    char* end = word;
+
+    while(*end != '\0' && !isspace(*end)) ++end;
+    if(*end != '\0') *end++ = '\0';
+    *str = end;
+
+    return (*word != '\0') ? word : NULL;
+}
+
+static int
+parse_target_line(struct sites_writer* writer, char* args)
+{
+    struct call_sites_elem* elem;
+    char* name = next_word(&args);
+    char* core_size = next_word(&args);
+    char* init_size = next_word(&args);
+    char* p;
+    int result;
+
+    if(writer->pending != NULL)
+    {
+        pr_err(COMPONENT_STRING "the previous list is not ended.\n");
+        return -EINVAL;
+    }
+
+    if(name == NULL || init_size == NULL || next_word(&args) != NULL)
+    {
+        pr_err(COMPONENT_STRING "invalid format of 'target' line.\n");
+        return -EINVAL;
+    }
+
+    if(strlen(name) >= MODULE_NAME_LEN)
+    {
+        pr_err(COMPONENT_STRING "module name is too long: %s\n", name);
+        return -EINVAL;
+    }
+
+    elem = kzalloc(sizeof(*elem), GFP_KERNEL);
+    if(elem == NULL) return -ENOMEM;
+
+    strcpy(elem->name, name);
+    // The kernel build system replaces '-' with '_' in module names.
+    for(p = elem->name; *p != '\0'; ++p)
+    {
+        if(*p == '-') *p = '_';
+    }
+
+    result = kstrtoul(core_size, 16, &elem->sites.core_size);
+    if(!result) result = kstrtoul(init_size, 16, &elem->sites.init_size);
+    if(result)
+    {
+        pr_err(COMPONENT_STRING "invalid size of code area.\n");
+        kfree(elem);
+        return result;
+    }
+
+    elem->status = CALL_SITES_NOT_USED;
+    writer->pending = elem;
+    return 0;
+}
+
+static int
+parse_site_line(struct sites_writer* writer, char area, char* args)
+{
+    struct call_sites_elem* elem = writer->pending;
+    char* offset_str = next_word(&args);
+    unsigned long size;
+    unsigned int* n;
+    u32 offset;
+    int result;
+
+    if(elem == NULL)
+    {
+        pr_err(COMPONENT_STRING "call site is specified before 'target'.\n");
+        return -EINVAL;
+    }
+
+    if(offset_str == NULL || next_word(&args) != NULL)
+    {
+        pr_err(COMPONENT_STRING "invalid format of call site line.\n");
+        return -EINVAL;
+    }
+
+    result = kstrtou32(offset_str, 16, &offset);
+    if(result) return result;
+
+    size = (area == 'c') ? elem->sites.core_size : elem->sites.init_size;
+    n = (area == 'c') ? &elem->sites.n_core : &elem->sites.n_init;
+
+    // The operand is preceded by the opcode and is 4 bytes long.
+    if(offset == 0 || (unsigned long)offset + 4 > size)
+    {
+        pr_err(COMPONENT_STRING
+            "call site is out of the code area of module \"%s\": %x\n",
+            elem->name, (unsigned int)offset);
+        return -EINVAL;
+    }
+
+    // Sanity check to avoid using too much memory for a broken list.
+    if(*n >= size / CALL_INSN_SIZE + 1)
+    {
+        pr_err(COMPONENT_STRING
+            "too many call sites listed for module \"%s\".\n", elem->name);
+        return -EINVAL;
+    }
+
+    if(area == 'c')
+        return offsets_append(&elem->core_offsets, n,
+            &elem->core_capacity, offset);
+    else
+        return offsets_append(&elem->init_offsets, n,
+            &elem->init_capacity, offset);
+}
+
+static int
+parse_end_line(struct sites_writer* writer)
+{
+    struct call_sites_elem* elem = writer->pending;
+    struct call_sites_elem* elem_old;
+    int result;
+
+    if(elem == NULL)
+    {
+        pr_err(COMPONENT_STRING "'end' is specified before 'target'.\n");
+        return -EINVAL;
+    }
+
+    elem->sites.core_offsets = elem->core_offsets;
+    elem->sites.init_offsets = elem->init_offsets;
+
+    result = mutex_lock_killable(&call_sites_mutex);
+    if(result) return result;
+
+    elem_old = call_sites_elem_find(elem->name);
+    if(elem_old != NULL)
+    {
+        list_del(&elem_old->list);
+        call_sites_elem_destroy(elem_old);
+    }
+    list_add_tail(&elem->list, &call_sites_lists);
+
+    mutex_unlock(&call_sites_mutex);
+
+    writer->pending = NULL;
+    return 0;
+}
+
+static int
+parse_clear_line(struct sites_writer* writer)
+{
+    int result;
+
+    if(writer->pending != NULL)
+    {
+        pr_err(COMPONENT_STRING "the previous list is not ended.\n");
+        return -EINVAL;
+    }
+
+    result = mutex_lock_killable(&call_sites_mutex);
+    if(result) return result;
+
+    call_sites_lists_clear();
+
+    mutex_unlock(&call_sites_mutex);
+    return 0;
+}
+
+static int
+parse_line(struct sites_writer* writer, char* line)
+{
+    char* command;
+
+    line = strim(line);
+    if(*line == '\0' || *line == '#') return 0;
+
+    command = next_word(&line);
+
+    if(strcmp(command, "c") == 0 || strcmp(command, "i") == 0)
+        return parse_site_line(writer, command[0], line);
+    else if(strcmp(command, "target") == 0)
+        return parse_target_line(writer, line);
+    else if(strcmp(command, "end") == 0)
+        return parse_end_line(writer);
+    else if(strcmp(command, "clear") == 0)
+        return parse_clear_line(writer);
+
+    pr_err(COMPONENT_STRING "unknown command: \"%s\"\n", command);
+    return -EINVAL;
+}
+
+/* ================================================================ */
+/* "sites" file */
+
+static int
+sites_open(struct inode* inode, struct file* filp)
+{
+    struct sites_writer* writer = kzalloc(sizeof(*writer), GFP_KERNEL);
+    if(writer == NULL) return -ENOMEM;
+
+    filp->private_data = writer;
+    return nonseekable_open(inode, filp);
+}
+
+static int
+sites_release(struct inode* inode, struct file* filp)
+{
+    struct sites_writer* writer = filp->private_data;
+
+    // The last line may lack '\n'.
+    if(writer->len != 0)
+    {
+        writer->line[writer->len] = '\0';
+        writer->len = 0;
+        parse_line(writer, writer->line);
+    }
+
+    // The list which has not been ended is incomplete, drop it.
+    if(writer->pending != NULL)
+    {
+        pr_warning(COMPONENT_STRING
+            "incomplete list of call sites for module \"%s\" is ignored.\n",
+            writer->pending->name);
+        call_sites_elem_destroy(writer->pending);
+    }
+
+    kfree(writer);
+    return 0;
+}
+
+static ssize_t
+sites_write(struct file* filp, const char __user* buf, size_t count,
+    loff_t* f_pos)
+{
+    struct sites_writer* writer = filp->private_data;
+    char chunk[64];
+    size_t done = 0;
+    int result;
+
+    while(done < count)
+    {
+        size_t chunk_size = min(count - done, sizeof(chunk));
+        size_t i;
+
+        if(copy_from_user(chunk, buf + done, chunk_size))
+            return -EFAULT;
+
+        for(i = 0; i < chunk_size; ++i)
+        {
+            if(chunk[i] != '\n')
+            {
+                // One byte is reserved for the terminating 0.
+                if(writer->len + 1 >= SITES_LINE_MAX)
+                {
+                    pr_err(COMPONENT_STRING "the line is too long.\n");
+                    result = -EINVAL;
+                    goto fail;
+                }
+                writer->line[writer->len++] = chunk[i];
+                continue;
+            }
+
+            writer->line[writer->len] = '\0';
+            writer->len = 0;
+            result = parse_line(writer, writer->line);
+            if(result) goto fail;
+        }
+        done += chunk_size;
+    }
+
+    return count;
+
+fail:
+    // The rest of the list cannot be trusted after an error.
+    call_sites_elem_destroy(writer->pending);
+    writer->pending = NULL;
+    writer->len = 0;
+    return result;
+}
+
+static const struct file_operations sites_ops =
+{
+    .owner = THIS_MODULE,
+    .open = sites_open,
+    .write = sites_write,
+    .release = sites_release,
+    .llseek = no_llseek,
+};
+
+/* ================================================================ */
+/* "status" file */
+
+static int
+status_show(struct seq_file* m, void* v)
+{
+    static const char* status_names[] = {
+        [CALL_SITES_NOT_USED] = "not used",
+        [CALL_SITES_USED] = "used",
+        [CALL_SITES_MISMATCH] = "mismatch",
+    };
+    struct call_sites_elem* elem;
+    int result = mutex_lock_killable(&call_sites_mutex);
+    if(result) return result;
+
+    list_for_each_entry(elem, &call_sites_lists, list)
+    {
+        seq_printf(m, "%s: core: %u, init: %u, status: %s",
+            elem->name, elem->sites.n_core, elem->sites.n_init,
+            status_names[elem->status]);
+        if(elem->status == CALL_SITES_USED)
+            seq_printf(m, ", replaced: %u", elem->sites.n_replaced);
+        seq_printf(m, "\n");
+    }
+
+    mutex_unlock(&call_sites_mutex);
+    return 0;
+}
+
+static int
+status_open(struct inode* inode, struct file* filp)
+{
+    return single_open(filp, status_show, NULL);
+}
+
+static const struct file_operations status_ops =
+{
+    .owner = THIS_MODULE,
+    .open = status_open,
+    .read = seq_read,
+    .llseek = seq_lseek,
+    .release = single_release,
+};
+
+/* ================================================================ */
+int
+kedr_call_sites_process(struct module* m,
+    int (*process)(struct module* m, struct kedr_call_sites* sites,
+        void* data),
+    void* data)
+{
+    struct call_sites_elem* elem;
+    int result;
+
+    mutex_lock(&call_sites_mutex);
+
+    elem = call_sites_elem_find(module_name(m));
+    if(elem == NULL)
+    {
+        mutex_unlock(&call_sites_mutex);
+        return -ENOENT;
+    }
+
+    elem->sites.n_replaced = 0;
+    result = process(m, &elem->sites, data);
+    if(result == 0)
+        elem->status = CALL_SITES_USED;
+    else if(result == -EINVAL)
+        elem->status = CALL_SITES_MISMATCH;
+
+    mutex_unlock(&call_sites_mutex);
+    return result;
+}
+
+int
+kedr_call_sites_init(void)
+{
+    dir_call_sites = debugfs_create_dir("kedr_call_sites", NULL);
+    if(dir_call_sites == NULL) goto fail_dir;
+
+    file_sites = debugfs_create_file("sites", S_IWUSR, dir_call_sites,
+        NULL, &sites_ops);
+    if(file_sites == NULL) goto fail_sites;
+
+    file_status = debugfs_create_file("status", S_IRUSR, dir_call_sites,
+        NULL, &status_ops);
+    if(file_status == NULL) goto fail_status;
+
+    return 0;
+
+fail_status:
+    debugfs_remove(file_sites);
+fail_sites:
+    debugfs_remove(dir_call_sites);
+fail_dir:
+    pr_err(COMPONENT_STRING "failed to create files in debugfs.\n");
+    return -ENOMEM;
+}
+
+void
+kedr_call_sites_destroy(void)
+{
+    debugfs_remove(file_status);
+    debugfs_remove(file_sites);
+    debugfs_remove(dir_call_sites);
+
+    mutex_lock(&call_sites_mutex);
+    call_sites_lists_clear();
+    mutex_unlock(&call_sites_mutex);
+}
@@ -0,0 +1,62 @@
+#ifndef KEDR_CALL_SITES_INTERNAL_H
+#define KEDR_CALL_SITES_INTERNAL_H
+
+/*
+ * Lists of the call sites in the target modules prepared in advance.
+ *
+ * kedr_call_sites tool finds the calls to the kernel functions in the file
+ * of a target module from the relocations there. The list of these call
+ * sites is written to "kedr_call_sites/sites" file in debugfs before the
+ * target is loaded. When the target is loaded, the instrumentor only
+ * checks the listed places instead of decoding the whole code of the
+ * target. If the list does not match the loaded module, the instrumentor
+ * decodes the code as usual.
+ *
+ * "kedr_call_sites/status" file in debugfs shows the lists and whether
+ * they have been used.
+ */
+
+#include <linux/module.h> /* 'struct module' definition */
+#include <linux/types.h>
+
+/*
+ * The list of call sites in a target module. Each site is the offset of
+ * the 32-bit operand of a 'call' or 'jmp' instruction from the beginning
+ * of the area of the module containing the instruction.
+ */
+struct kedr_call_sites
+{
+    /* The sizes of code areas of the module the list has been prepared for */
+    unsigned long core_size;
+    unsigned long init_size;
+
+    const u32* core_offsets;
+    unsigned int n_core;
+
+    const u32* init_offsets;
+    unsigned int n_init;
+
+    /* The number of calls replaced, should be set by the user of the list. */
+    unsigned int n_replaced;
+};
+
+/*
+ * If the list of call sites has been provided for module 'm', call
+ * 'process' for this list and return its result. The list cannot be
+ * changed or removed while 'process' is running.
+ *
+ * 'process' should return -EINVAL if the list does not match the module.
+ *
+ * -ENOENT is returned if there is no list for the module.
+ *
+ * Should be executed in process context.
+ */
+int kedr_call_sites_process(struct module* m,
+    int (*process)(struct module* m, struct kedr_call_sites* sites,
+        void* data),
+    void* data);
+
+int kedr_call_sites_init(void);
+void kedr_call_sites_destroy(void);
+
+#endif /* KEDR_CALL_SITES_INTERNAL_H */
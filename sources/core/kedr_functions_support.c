@@ -32,6 +32,7 @@
 #include <kedr/core/kedr_functions_support.h>
 
 #include "kedr_functions_support_internal.h"
+#include "kedr_timing_internal.h"
 
 #include "config.h"
 
@@ -386,6 +387,12 @@ int kedr_functions_support_register(struct kedr_functions_support* functions_sup
 {
     int result;
     
+    if(functions_support->timing)
+    {
+        result = kedr_timing_enable();
+        if(result) return result;
+    }
+    
     result = mutex_lock_killable(&functions_support_mutex);
     if(result) return result;
     
@@ -576,6 +583,7 @@ kedr_functions_support_prepare_internal(
         info_elem->intermediate_info->pre = interception_info_elem->pre;
         info_elem->intermediate_info->post = interception_info_elem->post;
         info_elem->intermediate_info->replace = interception_info_elem->replace;
+        info_elem->intermediate_info->per_target = interception_info_elem->per_target;
     }
     
     replace_pair->orig = NULL;
@@ -596,6 +604,7 @@ err_function_use:
         info_elem->intermediate_info->pre = NULL;
         info_elem->intermediate_info->post = NULL;
         info_elem->intermediate_info->replace = NULL;
+        info_elem->intermediate_info->per_target = NULL;
 
         function_info_elem_unuse_support(info_elem);
     }
@@ -664,6 +673,7 @@ void kedr_functions_support_release(void)
         info_elem->intermediate_info->pre = NULL;
         info_elem->intermediate_info->post = NULL;
         info_elem->intermediate_info->replace = NULL;
+        info_elem->intermediate_info->per_target = NULL;
 
         function_info_elem_unuse_support(info_elem);
     }
@@ -41,6 +41,9 @@ void kedr_functions_support_function_unuse(void* function);
  * 
  * Returning array will be freed at kedr_function_support_release() call.
  * 
+ * Elements of the returning array correspond to the elements of 'info'
+ * in the same order.
+ * 
  * On error return ERR_PTR().
  * */
 const struct kedr_instrumentor_replace_pair*
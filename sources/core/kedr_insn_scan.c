@@ -0,0 +1,203 @@
+/*
+ * Decoding of the code of the target modules for the instrumentor: 
+ * finding 'call' and 'jmp' instructions to be processed.
+ */
+ 
+/* ========================================================================
+ * Copyright (C) 2012, KEDR development team
+ * Copyright (C) 2010-2012, Institute for System Programming 
+ *                          of the Russian Academy of Sciences (ISPRAS)
+ * Authors: 
+ *      Eugene A. Shatokhin <spectre@ispras.ru>
+ *      Andrey V. Tsyvarev  <tsyvarev@ispras.ru>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation.
+ ======================================================================== */
+
+#include <linux/kernel.h>
+#include <linux/types.h>
+
+#include <kedr/core/kedr.h>
+#include <kedr/asm/insn.h>       /* instruction decoder machinery */
+
+#include "kedr_insn_scan_internal.h"
+
+/* ================================================================ */
+/* This string will be used in debug output to specify the name of 
+ * the current component of KEDR
+ */
+#define COMPONENT_STRING "kedr_instrumentor: "
+
+/* ================================================================ */
+/* Decode and process the instruction ('c_insn') at
+ * the address 'kaddr' - see the description of kedr_process_area for details. 
+ * 
+ * Check if we get past the end of the buffer [kaddr, end_kaddr)
+ * 
+ * The function returns the length of the instruction in bytes. 
+ * 0 is returned in case of failure.
+ */
+static unsigned int
+do_process_insn(struct insn* c_insn, void* kaddr, void* end_kaddr,
+	kedr_process_call_func process, void* data)
+{
+	/* ptr to the 32-bit offset argument in the instruction */
+	u32* offset = NULL; 
+	
+	static const unsigned char op_call = 0xe8; /* 'call <offset>' */
+	static const unsigned char op_jmp  = 0xe9; /* 'jmp  <offset>' */
+	
+	/* Decode the instruction and populate 'insn' structure */
+	kernel_insn_init(c_insn, kaddr);
+	insn_get_length(c_insn);
+	
+	if (c_insn->length == 0)
+	{
+		return 0;
+	}
+	
+	if (kaddr + c_insn->length > end_kaddr)
+	{
+	/* Note: it is OK to stop at 'end_kaddr' but no further */
+		KEDR_MSG(COMPONENT_STRING
+	"instruction decoder stopped past the end of the section.\n");
+		insn_get_opcode(c_insn);
+		printk(KERN_ALERT COMPONENT_STRING 
+	"kaddr=%lx, end_kaddr=%lx, c_insn->length=%d, opcode=0x%x\n",
+			(unsigned long)kaddr,
+			(unsigned long)end_kaddr,
+			(int)c_insn->length,
+			(unsigned int)c_insn->opcode.value
+		);
+		WARN_ON(1);
+	}
+		
+/* This call may be overkill as insn_get_length() probably has to decode 
+ * the instruction completely.
+ * Still, to operate safely, we need insn_get_opcode() before we can access
+ * c_insn->opcode. 
+ * The call is cheap anyway, no re-decoding is performed.
+ */
+	insn_get_opcode(c_insn); 
+	if (c_insn->opcode.value != op_call &&
+		c_insn->opcode.value != op_jmp)
+	{
+		/* Neither 'call' nor 'jmp' instruction, nothing to do. */
+		return c_insn->length;
+	}
+	
+/* [NB] For some reason, the decoder stores the argument of 'call' and 'jmp'
+ * as 'immediate' rather than 'displacement' (as Intel manuals name it).
+ * May be it is a bug, may be it is not. 
+ * Meanwhile, I'll call this value 'offset' to avoid confusion.
+ */
+
+	/* Call this before trying to access c_insn->immediate */
+	insn_get_immediate(c_insn);
+	if (c_insn->immediate.nbytes != 4)
+	{
+		KEDR_MSG(COMPONENT_STRING 
+	"at 0x%lx: "
+	"opcode: 0x%x, "
+	"immediate field is %u rather than 32 bits in size; "
+	"insn.length = %u, insn.imm = %u, off_immed = %d\n",
+			(unsigned long)kaddr,
+			(unsigned int)c_insn->opcode.value,
+			8 * (unsigned int)c_insn->immediate.nbytes,
+			c_insn->length,
+			(unsigned int)c_insn->immediate.value,
+			insn_offset_immediate(c_insn));
+		WARN_ON(1);
+		return c_insn->length;
+	}
+	
+	offset = (u32*)(kaddr + insn_offset_immediate(c_insn));
+	process(kaddr, c_insn->length, offset, data);
+	
+	return c_insn->length;
+}
+
+/* Process the instructions in [kbeg, kend) area, see the description in
+ * kedr_insn_scan_internal.h. */
+void
+kedr_process_area(void* kbeg, void* kend, 
+	kedr_process_call_func process, void* data)
+{
+	struct insn c_insn; /* current instruction */
+	void* pos = NULL;
+	
+	BUG_ON(kbeg == NULL);
+	BUG_ON(kend == NULL);
+	BUG_ON(kend < kbeg);
+		
+	for (pos = kbeg; pos + 4 < kend; )
+	{
+		unsigned int len;
+		unsigned int k;
+
+/* 'pos + 4 < kend' is based on another "heuristics". 'call' and 'jmp' 
+ * instructions we need to instrument are 5 bytes long on x86 and x86-64 
+ * machines. So if there are no more than 4 bytes left before the end, they
+ * cannot contain the instruction of this kind, we do not need to check 
+ * these bytes. 
+ * This allows to avoid "decoder stopped past the end of the section"
+ * conditions (see do_process_insn()). There, the decoder tries to chew 
+ * the trailing 1-2 zero bytes of the section (padding) and gets past 
+ * the end of the section.
+ * It seems that the length of the instruction that consists of zeroes
+ * only is 3 bytes (it is a flavour of 'add'), i.e. shorter than that 
+ * kind of 'call' we are instrumenting.
+ *
+ * [NB] The above check automatically handles 'pos == kend' case.
+ */
+	   
+		len = do_process_insn(&c_insn, pos, kend,
+			process, data);
+		if (len == 0)   
+		{
+			KEDR_MSG(COMPONENT_STRING
+				"do_process_insn() returned 0\n");
+			WARN_ON(1);
+			break;
+		}
+
+		if (pos + len > kend)
+		{
+			break;
+		}
+		
+/* If the decoded instruction contains only zero bytes (this is the case,
+ * for example, for one flavour of 'add'), skip to the first nonzero byte
+ * after it. 
+ * This is to avoid problems if there are two or more sections in the area
+ * being analyzed. 
+ * 
+ * As we are not interested in instrumenting 'add' or the like, we can skip 
+ * to the next instruction that does not begin with 0 byte. If we are 
+ * actually past the last instruction in the section, we get to the next 
+ * section or to the end of the area this way which is what we want in this
+ * case.
+ */
+		for (k = 0; k < len; ++k)
+		{
+			if (*((unsigned char*)pos + k) != 0) 
+			{
+				break;
+			}
+		}
+		pos += len;
+		
+		if (k == len) 
+		{
+			/* all bytes are zero, skip the following 0s */
+			while (pos < kend && *(unsigned char*)pos == 0)
+			{
+				++pos;
+			}
+		}
+	}
+	
+	return;
+}
@@ -0,0 +1,73 @@
+#ifndef KEDR_INSN_SCAN_INTERNAL_H
+#define KEDR_INSN_SCAN_INTERNAL_H
+
+/*
+ * Finding the 'call' and 'jmp' instructions in the code of the target
+ * modules.
+ *
+ * The code here only decodes the instructions and does not depend on the
+ * rest of KEDR core, so it can be built in the user space as well (see
+ * user/CMakeLists.txt).
+ */
+
+#include <linux/types.h>
+
+/* CALL_ADDR_FROM_OFFSET()
+ * 
+ * Calculate the memory address being the operand of a given instruction 
+ * (usually, 'call'). 
+ *   'insn_addr' is the address of the instruction itself,
+ *   'insn_len' is length of the instruction in bytes,
+ *   'offset' is the offset of the destination address from the first byte
+ *   past the instruction.
+ * 
+ * For x86_64 architecture, the offset value is sign-extended here first.
+ * 
+ * "Intel x86 Instruction Set Reference" states the following 
+ * concerning 'call rel32':
+ * 
+ * "Call near, relative, displacement relative to next instruction.
+ * 32-bit displacement sign extended to 64 bits in 64-bit mode."
+ * *****************************************************************
+ * 
+ * CALL_OFFSET_FROM_ADDR()
+ * 
+ * The reverse of CALL_ADDR_FROM_OFFSET: calculates the offset value
+ * to be used in 'call' instruction given the address and length of the
+ * instruction and the address of the destination function.
+ * 
+ * */
+#ifdef CONFIG_X86_64
+#  define CALL_ADDR_FROM_OFFSET(insn_addr, insn_len, offset) \
+	(void*)((s64)(insn_addr) + (s64)(insn_len) + (s64)(s32)(offset))
+
+#else /* CONFIG_X86_32 */
+#  define CALL_ADDR_FROM_OFFSET(insn_addr, insn_len, offset) \
+	(void*)((u32)(insn_addr) + (u32)(insn_len) + (u32)(offset))
+#endif
+
+#define CALL_OFFSET_FROM_ADDR(insn_addr, insn_len, dest_addr) \
+	(u32)(dest_addr - (insn_addr + (u32)insn_len))
+
+/*
+ * The function to be called for each 'call' and 'jmp' instruction with
+ * a 32-bit offset found in the code.
+ *   'kaddr' is the address of the instruction,
+ *   'len' is the length of the instruction in bytes,
+ *   'offset' points to the offset argument of the instruction,
+ *   'data' is the data passed to kedr_process_area().
+ *
+ * The function may change the offset argument of the instruction.
+ */
+typedef void (*kedr_process_call_func)(void* kaddr, unsigned int len,
+	u32* offset, void* data);
+
+/*
+ * Decode the instructions in [kbeg, kend) area and call 'process' for
+ * each 'call' and 'jmp' instruction with a 32-bit offset.
+ */
+void
+kedr_process_area(void* kbeg, void* kend,
+	kedr_process_call_func process, void* data);
+
+#endif /* KEDR_INSN_SCAN_INTERNAL_H */
@@ -30,7 +30,6 @@
 #include <linux/hash.h> /* hash_ptr definition */
 
 #include <kedr/core/kedr.h>
-#include <kedr/asm/insn.h>       /* instruction decoder machinery */
 
 #include <asm/cacheflush.h> 	/* set_memory_ro, set_memory_rw */
 #include <linux/pfn.h> 		/* PFN_* macros */
@@ -38,6 +37,8 @@
 #include <linux/kallsyms.h>
 
 #include "kedr_instrumentor_internal.h"
+#include "kedr_call_sites_internal.h"
+#include "kedr_insn_scan_internal.h"
 #include "config.h"
 
 /* ================================================================ */
@@ -183,240 +184,139 @@ repl_hash_table_get_repl(struct repl_hash_table* table, void* orig)
 }
 
 /* ================================================================ */
-/* Helpers */
-
-/* CALL_ADDR_FROM_OFFSET()
- * 
- * Calculate the memory address being the operand of a given instruction 
- * (usually, 'call'). 
- *   'insn_addr' is the address of the instruction itself,
- *   'insn_len' is length of the instruction in bytes,
- *   'offset' is the offset of the destination address from the first byte
- *   past the instruction.
- * 
- * For x86_64 architecture, the offset value is sign-extended here first.
- * 
- * "Intel x86 Instruction Set Reference" states the following 
- * concerning 'call rel32':
- * 
- * "Call near, relative, displacement relative to next instruction.
- * 32-bit displacement sign extended to 64 bits in 64-bit mode."
- * *****************************************************************
- * 
- * CALL_OFFSET_FROM_ADDR()
- * 
- * The reverse of CALL_ADDR_FROM_OFFSET: calculates the offset value
- * to be used in 'call' instruction given the address and length of the
- * instruction and the address of the destination function.
+/* Make the 'call' or 'jmp' instruction at 'kaddr' call the replacement
+ * function if it calls one of the target functions. 'offset' points to 
+ * the 32-bit offset argument of the instruction, 'len' is the length of 
+ * the instruction.
  * 
- * */
-#ifdef CONFIG_X86_64
-#  define CALL_ADDR_FROM_OFFSET(insn_addr, insn_len, offset) \
-	(void*)((s64)(insn_addr) + (s64)(insn_len) + (s64)(s32)(offset))
-
-#else /* CONFIG_X86_32 */
-#  define CALL_ADDR_FROM_OFFSET(insn_addr, insn_len, offset) \
-	(void*)((u32)(insn_addr) + (u32)(insn_len) + (u32)(offset))
-#endif
-
-#define CALL_OFFSET_FROM_ADDR(insn_addr, insn_len, dest_addr) \
-	(u32)(dest_addr - (insn_addr + (u32)insn_len))
-/* ================================================================ */
-
-/* ================================================================ */
-/* Decode and process the instruction ('c_insn') at
- * the address 'kaddr' - see the description of do_process_area for details. 
- * 
- * Check if we get past the end of the buffer [kaddr, end_kaddr)
- * 
- * The function returns the length of the instruction in bytes. 
- * 0 is returned in case of failure.
+ * Returns true if the instruction has been changed, false otherwise.
  */
-static unsigned int
-do_process_insn(struct insn* c_insn, void* kaddr, void* end_kaddr,
+static bool
+replace_call(void* kaddr, unsigned int len, u32* offset,
 	struct repl_hash_table* repl_table)
 {
-	/* ptr to the 32-bit offset argument in the instruction */
-	u32* offset = NULL; 
-	
 	/* address of the function being called */
-	void* addr = NULL;
-	void* repl_addr; 
-	
-	static const unsigned char op_call = 0xe8; /* 'call <offset>' */
-	static const unsigned char op_jmp  = 0xe9; /* 'jmp  <offset>' */
-	
-	/* Decode the instruction and populate 'insn' structure */
-	kernel_insn_init(c_insn, kaddr);
-	insn_get_length(c_insn);
-	
-	if (c_insn->length == 0)
-	{
-		return 0;
-	}
-	
-	if (kaddr + c_insn->length > end_kaddr)
-	{
-	/* Note: it is OK to stop at 'end_kaddr' but no further */
-		KEDR_MSG(COMPONENT_STRING
-	"instruction decoder stopped past the end of the section.\n");
-		insn_get_opcode(c_insn);
-		printk(KERN_ALERT COMPONENT_STRING 
-	"kaddr=%lx, end_kaddr=%lx, c_insn->length=%d, opcode=0x%x\n",
-			(unsigned long)kaddr,
-			(unsigned long)end_kaddr,
-			(int)c_insn->length,
-			(unsigned int)c_insn->opcode.value
-		);
-		WARN_ON(1);
-	}
-		
-/* This call may be overkill as insn_get_length() probably has to decode 
- * the instruction completely.
- * Still, to operate safely, we need insn_get_opcode() before we can access
- * c_insn->opcode. 
- * The call is cheap anyway, no re-decoding is performed.
- */
-	insn_get_opcode(c_insn); 
-	if (c_insn->opcode.value != op_call &&
-		c_insn->opcode.value != op_jmp)
-	{
-		/* Neither 'call' nor 'jmp' instruction, nothing to do. */
-		return c_insn->length;
-	}
-	
-/* [NB] For some reason, the decoder stores the argument of 'call' and 'jmp'
- * as 'immediate' rather than 'displacement' (as Intel manuals name it).
- * May be it is a bug, may be it is not. 
- * Meanwhile, I'll call this value 'offset' to avoid confusion.
- */
-
-	/* Call this before trying to access c_insn->immediate */
-	insn_get_immediate(c_insn);
-	if (c_insn->immediate.nbytes != 4)
-	{
-		KEDR_MSG(COMPONENT_STRING 
-	"at 0x%lx: "
-	"opcode: 0x%x, "
-	"immediate field is %u rather than 32 bits in size; "
-	"insn.length = %u, insn.imm = %u, off_immed = %d\n",
-			(unsigned long)kaddr,
-			(unsigned int)c_insn->opcode.value,
-			8 * (unsigned int)c_insn->immediate.nbytes,
-			c_insn->length,
-			(unsigned int)c_insn->immediate.value,
-			insn_offset_immediate(c_insn));
-		WARN_ON(1);
-		return c_insn->length;
-	}
-	
-	offset = (u32*)(kaddr + insn_offset_immediate(c_insn));
-	addr = CALL_ADDR_FROM_OFFSET(kaddr, c_insn->length, *offset);
+	void* addr = CALL_ADDR_FROM_OFFSET(kaddr, len, *offset);
+	void* repl_addr;
 	
 	/* Check if one of the functions of interest is called */
 	repl_addr = repl_hash_table_get_repl(repl_table, addr);
-	if (repl_addr != NULL)
-	{
-		/* Change the address of the function to be called */
-		*offset = CALL_OFFSET_FROM_ADDR(
-			kaddr, 
-			c_insn->length,
-			repl_addr
-		);
-	}
+	if (repl_addr == NULL)
+		return false;
 	
-	return c_insn->length;
+	/* Change the address of the function to be called */
+	*offset = CALL_OFFSET_FROM_ADDR(kaddr, len, repl_addr);
+	return true;
 }
 
-/* Process the instructions in [kbeg, kend) area.
- * Each 'call' instruction calling one of the target functions will be 
- * changed so as to call the corresponding replacement function instead.
- * The addresses of target and replacement fucntions are given in
- * 'from_funcs' and 'to_funcs', respectively, the number of the elements
- * to process in these arrays being 'nfuncs'.
- * For each i=0..nfuncs-1, from_funcs[i] corresponds to to_funcs[i].
- */
+/* A callback for kedr_process_area(), 'data' is the replacement table. */
 static void
-do_process_area(void* kbeg, void* kend, 
-	struct repl_hash_table* repl_table)
+process_call(void* kaddr, unsigned int len, u32* offset, void* data)
+{
+	replace_call(kaddr, len, offset, data);
+}
+
+/* ================================================================ */
+/* Processing of the call sites listed in advance (see 
+ * kedr_call_sites_internal.h). */
+
+/* Check if the size of the code area of the module is the one the list of 
+ * call sites has been prepared for. The kernel may align the size of the 
+ * area to the page boundary. */
+static bool
+area_size_matches(unsigned long size, unsigned long expected_size)
 {
-	struct insn c_insn; /* current instruction */
-	void* pos = NULL;
+	return (size == expected_size || size == PAGE_ALIGN(expected_size));
+}
+
+/* Check that each of the call sites in the area starting at 'kbeg' is
+ * a 'call' or 'jmp' instruction with a 32-bit offset. 
+ * The offsets of the call sites are checked against the size of the area 
+ * when the list is loaded. */
+static bool
+sites_are_calls(void* kbeg, const u32* offsets, unsigned int n)
+{
+	unsigned int i;
 	
-	BUG_ON(kbeg == NULL);
-	BUG_ON(kend == NULL);
-	BUG_ON(kend < kbeg);
-		
-	for (pos = kbeg; pos + 4 < kend; )
+	for (i = 0; i < n; ++i)
 	{
-		unsigned int len;
-		unsigned int k;
-
-/* 'pos + 4 < kend' is based on another "heuristics". 'call' and 'jmp' 
- * instructions we need to instrument are 5 bytes long on x86 and x86-64 
- * machines. So if there are no more than 4 bytes left before the end, they
- * cannot contain the instruction of this kind, we do not need to check 
- * these bytes. 
- * This allows to avoid "decoder stopped past the end of the section"
- * conditions (see do_process_insn()). There, the decoder tries to chew 
- * the trailing 1-2 zero bytes of the section (padding) and gets past 
- * the end of the section.
- * It seems that the length of the instruction that consists of zeroes
- * only is 3 bytes (it is a flavour of 'add'), i.e. shorter than that 
- * kind of 'call' we are instrumenting.
- *
- * [NB] The above check automatically handles 'pos == kend' case.
- */
-	   
-		len = do_process_insn(&c_insn, pos, kend,
-			repl_table);
-		if (len == 0)   
+		unsigned char opcode = *((unsigned char*)kbeg + offsets[i] - 1);
+		if (opcode != 0xe8 && opcode != 0xe9)
 		{
-			KEDR_MSG(COMPONENT_STRING
-				"do_process_insn() returned 0\n");
-			WARN_ON(1);
-			break;
+			KEDR_MSG(COMPONENT_STRING 
+	"no 'call' or 'jmp' instruction at the call site 0x%lx\n",
+				(unsigned long)(kbeg + offsets[i] - 1));
+			return false;
 		}
+	}
+	return true;
+}
 
-		if (pos + len > kend)
-		{
-			break;
-		}
+/* Replace the calls at the given call sites in the area starting at 
+ * 'kbeg'. Returns the number of the calls replaced. */
+static unsigned int
+replace_calls_at_sites(void* kbeg, const u32* offsets, unsigned int n,
+	struct repl_hash_table* repl_table)
+{
+	unsigned int i;
+	unsigned int n_replaced = 0;
+	
+	for (i = 0; i < n; ++i)
+	{
+		/* the instruction and its 32-bit offset argument */
+		void* kaddr = kbeg + offsets[i] - 1;
+		u32* offset = (u32*)(kbeg + offsets[i]);
 		
-/* If the decoded instruction contains only zero bytes (this is the case,
- * for example, for one flavour of 'add'), skip to the first nonzero byte
- * after it. 
- * This is to avoid problems if there are two or more sections in the area
- * being analyzed. 
+		if (replace_call(kaddr, 5, offset, repl_table))
+			++n_replaced;
+	}
+	return n_replaced;
+}
+
+/* Replace the calls at the call sites listed in 'sites'. If the list
+ * does not match the module, nothing is changed and -EINVAL is returned. 
  * 
- * As we are not interested in instrumenting 'add' or the like, we can skip 
- * to the next instruction that does not begin with 0 byte. If we are 
- * actually past the last instruction in the section, we get to the next 
- * section or to the end of the area this way which is what we want in this
- * case.
- */
-		for (k = 0; k < len; ++k)
-		{
-			if (*((unsigned char*)pos + k) != 0) 
-			{
-				break;
-			}
-		}
-		pos += len;
-		
-		if (k == len) 
-		{
-			/* all bytes are zero, skip the following 0s */
-			while (pos < kend && *(unsigned char*)pos == 0)
-			{
-				++pos;
-			}
-		}
+ * 'data' is the replacement table. */
+static int
+process_call_sites(struct module* mod, struct kedr_call_sites* sites,
+	void* data)
+{
+	struct repl_hash_table* repl_table = data;
+	void* core_addr = module_core_addr(mod);
+	void* init_addr = module_init_addr(mod);
+	
+	if (!area_size_matches(core_text_size(mod), sites->core_size))
+		return -EINVAL;
+	
+	if (init_addr != NULL) 
+	{
+		if (!area_size_matches(init_text_size(mod), sites->init_size))
+			return -EINVAL;
+	}
+	else if (sites->n_init != 0)
+	{
+		return -EINVAL;
 	}
 	
-	return;
+	/* Check all the call sites before changing anything. */
+	if (!sites_are_calls(core_addr, sites->core_offsets, sites->n_core))
+		return -EINVAL;
+	
+	if (init_addr != NULL && 
+	    !sites_are_calls(init_addr, sites->init_offsets, sites->n_init))
+		return -EINVAL;
+	
+	sites->n_replaced = replace_calls_at_sites(core_addr,
+		sites->core_offsets, sites->n_core, repl_table);
+	
+	if (init_addr != NULL)
+		sites->n_replaced += replace_calls_at_sites(init_addr,
+			sites->init_offsets, sites->n_init, repl_table);
+	
+	return 0;
 }
 
+/* ================================================================ */
 /* Starting from commit 4982223e51e8ea9d09bb33c8323b5ec1877b2b51 which went 
  * into kernel 3.16, the code of a kernel module becomes read only before
  * the notification about MODULE_STATE_COMING triggers.
@@ -547,6 +447,7 @@ replace_calls_in_module(struct module* mod,
 {
 	bool core_text_rw = false;
 	bool init_text_rw = false;
+	int result;
 
 	BUG_ON(mod == NULL);
 	BUG_ON(!module_core_addr(mod));
@@ -559,25 +460,45 @@ replace_calls_in_module(struct module* mod,
 	if (!init_text_rw)
 		set_module_init_text_rw(mod);
 	
+	/* If the call sites have been listed in advance, only these places
+	 * need to be processed. */
+	result = kedr_call_sites_process(mod, process_call_sites, repl_table);
+	if (result == 0)
+	{
+		KEDR_MSG(COMPONENT_STRING 
+			"target module: \"%s\", used the list of call sites\n",
+			module_name(mod));
+		goto out;
+	}
+	
+	if (result != -ENOENT)
+	{
+		pr_info(COMPONENT_STRING 
+	"the list of call sites does not match the module \"%s\", "
+	"its code will be decoded instead\n",
+			module_name(mod));
+	}
+	
 	if (module_init_addr(mod))
 	{
 		KEDR_MSG(COMPONENT_STRING 
 			"target module: \"%s\", processing \"init\" area\n",
 			module_name(mod));
 			
-		do_process_area(module_init_addr(mod),
+		kedr_process_area(module_init_addr(mod),
 			module_init_addr(mod) + init_text_size(mod),
-			repl_table);
+			process_call, repl_table);
 	}
 
 	KEDR_MSG(COMPONENT_STRING 
 		"target module: \"%s\", processing \"core\" area\n",
 		module_name(mod));
 		
-	do_process_area(module_core_addr(mod),
+	kedr_process_area(module_core_addr(mod),
 		module_core_addr(mod) + core_text_size(mod),
-		repl_table);
-	
+		process_call, repl_table);
+
+out:
 	if (!core_text_rw)
 		set_module_core_text_ro(mod);
 	if (!init_text_rw)
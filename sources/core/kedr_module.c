@@ -22,6 +22,9 @@
 #include "kedr_instrumentor_internal.h"
 #include "kedr_functions_support_internal.h"
 #include "kedr_target_detector_internal.h"
+#include "kedr_timing_internal.h"
+#include "kedr_overhead_internal.h"
+#include "kedr_call_sites_internal.h"
 
 #include <linux/version.h>
 #include <linux/module.h>
@@ -125,68 +128,291 @@ module_param_call(target_name,
 #error Unknown way to create module parameter with callbacks
 #endif
 
+/* 
+ * Module parameter with binding of the payloads to the targets, e.g.
+ *  echo "kedr_leak_check:module1;kedr_cm_counter:module1,module2" > \
+ *      /sys/module/kedr/parameters/payload_targets
+ * 
+ * See kedr_base_set_payload_targets() for details.
+ */
+static int
+payload_targets_param_get(char* buffer,
+#if defined(MODULE_PARAM_CREATE_USE_OPS_STRUCT)
+    const struct kernel_param *kp
+#elif defined(MODULE_PARAM_CREATE_USE_OPS)
+    struct kernel_param *kp
+#else 
+#error Unknown way to create module parameter with callbacks
+#endif
+)
+{
+    // 'buffer' is of 4K size.
+    return kedr_base_get_payload_targets(buffer, 4096);
+}
+
+static int
+payload_targets_param_set(const char* val,
+#if defined(MODULE_PARAM_CREATE_USE_OPS_STRUCT)
+    const struct kernel_param *kp
+#elif defined(MODULE_PARAM_CREATE_USE_OPS)
+    struct kernel_param *kp
+#else 
+#error Unknown way to create module parameter with callbacks
+#endif
+)
+{
+    return kedr_base_set_payload_targets(val);
+}
+
+#if defined(MODULE_PARAM_CREATE_USE_OPS_STRUCT)
+static const struct kernel_param_ops payload_targets_param_ops =
+{
+    .set = payload_targets_param_set,
+    .get = payload_targets_param_get,
+};
+module_param_cb(payload_targets,
+    &payload_targets_param_ops,
+    NULL,
+    S_IRUGO | S_IWUSR);
+#elif defined(MODULE_PARAM_CREATE_USE_OPS)
+module_param_call(payload_targets,
+    payload_targets_param_set, payload_targets_param_get,
+    NULL,
+    S_IRUGO | S_IWUSR);
+#else 
+#error Unknown way to create module parameter with callbacks
+#endif
+
 
 /********************************************************************/
 /* Replace pairs for current session. */
 static const struct kedr_instrumentor_replace_pair* replace_pairs;
+/* Interception information for current session. */
+static const struct kedr_base_interception_info* interception_info;
 
-// Called when target module is loaded.
-int
-on_target_load(struct module* m)
+/*
+ * Code areas of the targets, indexed by the index of the target.
+ * 
+ * The area of the target is set before its code is instrumented and
+ * is cleared when the target is unloaded, so kedr_target_index()
+ * may be called from the intermediate functions without locks.
+ */
+struct target_area
+{
+    unsigned long core_start;
+    unsigned long core_size;
+    unsigned long init_start;
+    unsigned long init_size;
+};
+
+static struct target_area* target_areas;
+static int n_target_areas;
+
+int kedr_target_index(void* addr)
+{
+    int i;
+    for(i = 0; i < n_target_areas; i++)
+    {
+        struct target_area* area = &target_areas[i];
+        if(((unsigned long)addr - area->core_start) < area->core_size)
+            return i;
+        if(((unsigned long)addr - area->init_start) < area->init_size)
+            return i;
+    }
+    return -1;
+}
+
+/* Start new session. */
+static int
+session_start(void)
 {
     int result;
+    int i;
+    int n_targets = kedr_target_detector_n_targets();
+    const char** target_names;
     
-    if(!n_targets_loaded)
+    target_names = kmalloc(n_targets * sizeof(*target_names), GFP_KERNEL);
+    if(target_names == NULL) return -ENOMEM;
+    
+    for(i = 0; i < n_targets; i++)
+        target_names[i] = kedr_target_detector_target_name(i);
+    
+    target_areas = kzalloc(n_targets * sizeof(*target_areas), GFP_KERNEL);
+    if(target_areas == NULL)
+    {
+        result = -ENOMEM;
+        goto err_areas;
+    }
+    n_target_areas = n_targets;
+    
+    interception_info = kedr_base_session_start(target_names, n_targets);
+    if(IS_ERR(interception_info))
+    {
+        result = PTR_ERR(interception_info);
+        goto err_session;
+    }
+    
+    replace_pairs = kedr_functions_support_prepare(interception_info);
+    if(IS_ERR(replace_pairs))
+    {
+        result = PTR_ERR(replace_pairs);
+        goto err_prepare;
+    }
+    
+    kfree(target_names);
+    return 0;
+
+err_prepare:
+    kedr_base_session_stop();
+err_session:
+    n_target_areas = 0;
+    kfree(target_areas);
+    target_areas = NULL;
+err_areas:
+    kfree(target_names);
+    return result;
+}
+
+/* Stop current session. */
+static void
+session_stop(void)
+{
+    kedr_functions_support_release();
+    kedr_base_session_stop();
+    
+    n_target_areas = 0;
+    kfree(target_areas);
+    target_areas = NULL;
+}
+
+/*
+ * Return replace pairs for the target with given index, that is,
+ * only for the functions intercepted by the payloads applied to this
+ * target.
+ * 
+ * If the functions are intercepted the same way for all targets,
+ * 'replace_pairs' itself is returned. Otherwise returning array should
+ * be freed with kfree().
+ */
+static const struct kedr_instrumentor_replace_pair*
+target_replace_pairs_create(int target_index)
+{
+    const struct kedr_base_interception_info* info_elem;
+    struct kedr_instrumentor_replace_pair* pairs;
+    int n_pairs = 0;
+    int i;
+    
+    for(info_elem = interception_info; info_elem->orig != NULL; info_elem++)
     {
-        // Start new session
-        const struct kedr_base_interception_info* interception_info =
-            kedr_base_session_start();
+        if(info_elem->per_target) break;
+    }
+    if(info_elem->orig == NULL) return replace_pairs;
+    
+    for(info_elem = interception_info; info_elem->orig != NULL; info_elem++)
+        n_pairs++;
+    
+    pairs = kmalloc((n_pairs + 1) * sizeof(*pairs), GFP_KERNEL);
+    if(pairs == NULL) return ERR_PTR(-ENOMEM);
+    
+    for(i = 0, n_pairs = 0; interception_info[i].orig != NULL; i++)
+    {
+        const struct kedr_intermediate_info* target_info;
         
-        if(IS_ERR(interception_info))
+        info_elem = &interception_info[i];
+        if(info_elem->per_target)
         {
-            return PTR_ERR(interception_info);
+            target_info = &info_elem->per_target[target_index];
+            if((target_info->pre == NULL) && (target_info->post == NULL)
+                && (target_info->replace == NULL))
+                continue; // Not intercepted in this target
         }
         
-        replace_pairs = kedr_functions_support_prepare(interception_info);
-        
-        if(IS_ERR(replace_pairs))
-        {
-            kedr_base_session_stop();
-            return PTR_ERR(replace_pairs);
-        }
+        BUG_ON(replace_pairs[i].orig != info_elem->orig);
+        pairs[n_pairs++] = replace_pairs[i];
+    }
+    pairs[n_pairs].orig = NULL;
+    
+    return pairs;
+}
+
+// Called when target module is loaded.
+int
+on_target_load(struct module* m, int target_index)
+{
+    int result;
+    const struct kedr_instrumentor_replace_pair* target_replace_pairs;
+    struct target_area* area;
+    
+    if(!n_targets_loaded)
+    {
+        result = session_start();
+        if(result) return result;
     }
     
-    result = kedr_instrumentor_replace_functions(m, replace_pairs);
-    if(result)
+    area = &target_areas[target_index];
+    area->core_start = (unsigned long)module_core_addr(m);
+    area->core_size = core_text_size(m);
+    area->init_start = (unsigned long)module_init_addr(m);
+    area->init_size = init_text_size(m);
+    /* Area should be visible before the code of the target is changed. */
+    smp_wmb();
+    
+    target_replace_pairs = target_replace_pairs_create(target_index);
+    if(IS_ERR(target_replace_pairs))
     {
-        if(!n_targets_loaded)
-        {
-            kedr_functions_support_release();
-            kedr_base_session_stop();
-        }
-        return result;
+        result = PTR_ERR(target_replace_pairs);
+        goto err;
     }
     
-    kedr_base_target_load(m);
+    /* 
+     * If no payload is applied to this target, its code is not changed
+     * at all.
+     */
+    result = (target_replace_pairs[0].orig != NULL)
+        ? kedr_instrumentor_replace_functions(m, target_replace_pairs)
+        : 0;
+    
+    if(target_replace_pairs != replace_pairs)
+        kfree(target_replace_pairs);
+    
+    if(result) goto err;
+    
+    kedr_base_target_load(m, target_index);
     
     n_targets_loaded++;
     
     return 0;
+
+err:
+    memset(area, 0, sizeof(*area));
+    if(!n_targets_loaded) session_stop();
+    return result;
+}
+
+// Called when target module has finished its initialization.
+void
+on_target_init_done(struct module* m, int target_index)
+{
+    struct target_area* area = &target_areas[target_index];
+    
+    /* 
+     * Memory of the init area is freed, so the code of other modules
+     * may be placed there.
+     */
+    area->init_size = 0;
+    area->init_start = 0;
 }
 
 // Called when target module is unloaded.
 void
-on_target_unload(struct module* m)
+on_target_unload(struct module* m, int target_index)
 {
-    kedr_base_target_unload(m);
+    kedr_base_target_unload(m, target_index);
     kedr_instrumentor_replace_clean(m);
+    memset(&target_areas[target_index], 0, sizeof(target_areas[target_index]));
     n_targets_loaded--;
     
-    if(!n_targets_loaded)
-    {
-        kedr_functions_support_release();
-        kedr_base_session_stop();
-    }
+    if(!n_targets_loaded) session_stop();
 }
 
 
@@ -201,17 +427,32 @@ kedr_module_init(void)
     result = kedr_instrumentor_init();
     if (result) goto instrumentor_err;
     
+    result = kedr_call_sites_init();
+    if (result) goto call_sites_err;
+    
     result = kedr_base_init();
     if (result) goto base_err;
     
     result = kedr_target_detector_init();
     if (result) goto target_detector_err;
     
+    result = kedr_timing_init();
+    if (result) goto timing_err;
+    
+    result = kedr_overhead_init();
+    if (result) goto overhead_err;
+    
     return 0;
 
+overhead_err:
+    kedr_timing_destroy();
+timing_err:
+    kedr_target_detector_destroy();
 target_detector_err:
     kedr_base_destroy();
 base_err:
+    kedr_call_sites_destroy();
+call_sites_err:
     kedr_instrumentor_destroy();
 instrumentor_err:
     kedr_functions_support_destroy();
@@ -222,8 +463,11 @@ functions_support_err:
 static void __exit
 kedr_module_exit(void)
 {
+    kedr_overhead_destroy();
+    kedr_timing_destroy();
     kedr_target_detector_destroy();
     kedr_base_destroy();
+    kedr_call_sites_destroy();
     kedr_instrumentor_destroy();
     kedr_functions_support_destroy();
 }
@@ -237,5 +481,8 @@ EXPORT_SYMBOL(kedr_payload_unregister);
 
 EXPORT_SYMBOL(kedr_functions_support_register);
 EXPORT_SYMBOL(kedr_functions_support_unregister);
+/* kedr_timing_begin() and kedr_timing_end() are exported in kedr_timing.c */
+/* kedr_overhead_account() is exported in kedr_overhead.c */
 
 EXPORT_SYMBOL(kedr_target_module_in_init);
+EXPORT_SYMBOL(kedr_target_index);
@@ -0,0 +1,354 @@
+/*
+ * Statistics about the overhead of KEDR itself.
+ *
+ * The statistics are kept in a keyed per-CPU table (see
+ * <kedr/util/percpu_stats.h>) per (stage, key), see
+ * <kedr/core/kedr_overhead.h>. An entry contains the number of times the
+ * stage has been executed for the key, the total and the maximum number
+ * of cycles spent there.
+ *
+ * The statistics are shown in "kedr_overhead/overhead" file. Writing to
+ * "kedr_overhead/reset" clears them.
+ */
+
+/* ========================================================================
+ * Copyright (C) 2012-2014, KEDR development team
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation.
+ ======================================================================== */
+
+#include "kedr_overhead_internal.h"
+
+#include <linux/module.h>
+#include <linux/moduleparam.h>
+#include <linux/kernel.h>
+#include <linux/errno.h>
+#include <linux/mutex.h>
+#include <linux/vmalloc.h>
+#include <linux/slab.h>
+#include <linux/string.h>
+#include <linux/kallsyms.h>
+#include <linux/math64.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include <linux/fs.h>
+
+#include <kedr/util/percpu_stats.h>
+
+#define COMPONENT_STRING "overhead: "
+
+/*
+ * Number of bits in the index of the per-CPU table. That is, each table
+ * contains (1 << overhead_table_bits) entries.
+ */
+static unsigned int overhead_table_bits = 10;
+module_param(overhead_table_bits, uint, S_IRUGO);
+
+/*
+ * How many entries are checked when looking for (stage, key) in the table
+ * before giving up.
+ */
+#define OVERHEAD_MAX_PROBES 16
+
+/* At most this number of modules are shown in the summary per module. */
+#define OVERHEAD_MAX_MODULES 64
+
+static const char* stage_names[KEDR_OVERHEAD_NR_STAGES] =
+{
+    [KEDR_OVERHEAD_INTERMEDIATE] = "intermediate",
+    [KEDR_OVERHEAD_PRE] = "pre",
+    [KEDR_OVERHEAD_REPLACE] = "replace",
+    [KEDR_OVERHEAD_POST] = "post",
+    [KEDR_OVERHEAD_TRACE_RESERVE] = "trace_reserve",
+    [KEDR_OVERHEAD_TRACE_COMMIT] = "trace_commit",
+    [KEDR_OVERHEAD_RESOURCE_INFO] = "resource_info_create",
+    [KEDR_OVERHEAD_STACK_TRACE] = "save_stack_trace",
+    [KEDR_OVERHEAD_FSIM_SIMULATE] = "fsim_point_simulate",
+};
+
+struct overhead_entry
+{
+    /* (stage + 1, key) */
+    struct kedr_stat_key key;
+
+    unsigned long count;
+    u64 cycles;
+    u64 max;
+};
+
+static struct kedr_stat_table* table;
+
+/* Serializes readers of the statistics with reset. */
+static DEFINE_MUTEX(overhead_mutex);
+
+static struct dentry* dir_overhead;
+static struct dentry* file_overhead;
+static struct dentry* file_reset;
+
+/* Totals for a module, see overhead_add_module_stats(). */
+struct overhead_module_stats
+{
+    char name[MODULE_NAME_LEN];
+    unsigned long count;
+    u64 cycles;
+};
+
+/* ================================================================ */
+/* Implementation of public API                                     */
+/* ================================================================ */
+void
+kedr_overhead_account(unsigned int stage, const void* key, u64 cycles)
+{
+    unsigned long irq_flags;
+    struct overhead_entry* entry;
+
+    /* This is the hot path of the instrumented code, do not crash. */
+    if(WARN_ON_ONCE(stage >= KEDR_OVERHEAD_NR_STAGES))
+        return;
+
+    /* Cycle counter of other CPU could be used for the start. */
+    if((s64)cycles < 0)
+        cycles = 0;
+
+    local_irq_save(irq_flags);
+    entry = kedr_stat_table_get(table, stage + 1, (unsigned long)key);
+    if(entry != NULL)
+    {
+        ++entry->count;
+        entry->cycles += cycles;
+        if(cycles > entry->max)
+            entry->max = cycles;
+    }
+    local_irq_restore(irq_flags);
+}
+EXPORT_SYMBOL(kedr_overhead_account);
+
+/* ================================================================ */
+static void
+entry_merge(void* merged, const void* entry_data)
+{
+    struct overhead_entry* total = merged;
+    const struct overhead_entry* entry = entry_data;
+
+    total->count += entry->count;
+    total->cycles += entry->cycles;
+    if(entry->max > total->max)
+        total->max = entry->max;
+}
+
+/* The entry may be read while it is being claimed, so 'count' may be 0. */
+static inline u64
+overhead_avg(u64 cycles, unsigned long count)
+{
+    return count ? div64_u64(cycles, count) : 0;
+}
+
+static void
+overhead_show_merged(struct seq_file* m, const struct overhead_entry* total)
+{
+    const char* stage_name = stage_names[total->key.k1 - 1];
+    void* key = (void*)total->key.k2;
+
+    if(key != NULL)
+        seq_printf(m, "%s\t%pS\t", stage_name, key);
+    else
+        seq_printf(m, "%s\t-\t", stage_name);
+
+    seq_printf(m, "count: %lu\tcycles: %llu\tavg: %llu\tmax: %llu\n",
+        total->count,
+        (unsigned long long)total->cycles,
+        (unsigned long long)overhead_avg(total->cycles, total->count),
+        (unsigned long long)total->max);
+}
+
+/*
+ * Add the totals for 'entry' to the totals for the module containing
+ * entry->key if 'entry' is for a handler. The handlers are attributed to
+ * the payload modules this way. The other stages are not summed up here:
+ * they are either keyed by the kernel functions or nested in the handlers.
+ */
+static void
+overhead_add_module_stats(struct overhead_module_stats* modules,
+    unsigned int* nr_modules, const struct overhead_entry* entry)
+{
+    char symbol[KSYM_SYMBOL_LEN];
+    const char* name = "kernel";
+    char* start;
+    char* end;
+    unsigned int i;
+
+    if(entry->key.k1 != KEDR_OVERHEAD_PRE + 1 &&
+        entry->key.k1 != KEDR_OVERHEAD_REPLACE + 1 &&
+        entry->key.k1 != KEDR_OVERHEAD_POST + 1)
+        return;
+
+    /* "function+0x10/0x20 [module]" */
+    sprint_symbol(symbol, entry->key.k2);
+    start = strchr(symbol, '[');
+    if(start != NULL)
+    {
+        end = strchr(++start, ']');
+        if(end != NULL)
+        {
+            *end = '\0';
+            name = start;
+        }
+    }
+
+    for(i = 0; i < *nr_modules; ++i)
+    {
+        if(strcmp(modules[i].name, name) == 0) break;
+    }
+    if(i == *nr_modules)
+    {
+        if(i == OVERHEAD_MAX_MODULES) return;
+        snprintf(modules[i].name, sizeof(modules[i].name), "%s", name);
+        ++*nr_modules;
+    }
+    modules[i].count += entry->count;
+    modules[i].cycles += entry->cycles;
+}
+
+static int
+overhead_show(struct seq_file* m, void* v)
+{
+    void* merged = NULL;
+    struct overhead_module_stats* modules;
+    unsigned int nr_modules = 0;
+    unsigned long dropped;
+    long nr_merged;
+    long i;
+    int result;
+
+    modules = kcalloc(OVERHEAD_MAX_MODULES, sizeof(*modules), GFP_KERNEL);
+    if(modules == NULL) return -ENOMEM;
+
+    result = mutex_lock_killable(&overhead_mutex);
+    if(result) goto out;
+
+    nr_merged = kedr_stat_table_merge(table, entry_merge, &merged,
+        &dropped);
+    mutex_unlock(&overhead_mutex);
+
+    if(nr_merged < 0)
+    {
+        result = (int)nr_merged;
+        goto out;
+    }
+
+    seq_printf(m, "# Stages are nested, the values are in cycles.\n");
+    for(i = 0; i < nr_merged; ++i)
+    {
+        const struct overhead_entry* total =
+            (struct overhead_entry*)merged + i;
+
+        overhead_show_merged(m, total);
+        overhead_add_module_stats(modules, &nr_modules, total);
+    }
+
+    seq_printf(m, "# Per module (handlers only):\n");
+    for(i = 0; i < nr_modules; ++i)
+    {
+        seq_printf(m, "module\t%s\tcount: %lu\tcycles: %llu\tavg: %llu\n",
+            modules[i].name, modules[i].count,
+            (unsigned long long)modules[i].cycles,
+            (unsigned long long)overhead_avg(modules[i].cycles,
+                modules[i].count));
+    }
+
+    seq_printf(m, "# Events not counted (tables are full): %lu\n", dropped);
+
+out:
+    vfree(merged);
+    kfree(modules);
+    return result;
+}
+
+static int
+overhead_open(struct inode* inode, struct file* filp)
+{
+    return single_open(filp, overhead_show, NULL);
+}
+
+static const struct file_operations overhead_ops =
+{
+    .owner = THIS_MODULE,
+    .open = overhead_open,
+    .read = seq_read,
+    .llseek = seq_lseek,
+    .release = single_release,
+};
+
+static ssize_t
+reset_write(struct file* filp, const char __user* buf, size_t count,
+    loff_t* f_pos)
+{
+    int result = mutex_lock_killable(&overhead_mutex);
+    if(result) return result;
+
+    kedr_stat_table_reset(table);
+
+    mutex_unlock(&overhead_mutex);
+    return count;
+}
+
+static const struct file_operations reset_ops =
+{
+    .owner = THIS_MODULE,
+    .write = reset_write,
+};
+
+/* ================================================================ */
+int
+kedr_overhead_init(void)
+{
+    if((overhead_table_bits == 0) || (overhead_table_bits > 20))
+    {
+        pr_err(COMPONENT_STRING
+            "invalid value of 'overhead_table_bits': %u\n",
+            overhead_table_bits);
+        return -EINVAL;
+    }
+
+    table = kedr_stat_table_create(overhead_table_bits,
+        OVERHEAD_MAX_PROBES, sizeof(struct overhead_entry));
+    if(table == NULL)
+    {
+        pr_err(COMPONENT_STRING
+            "failed to allocate tables for overhead statistics.\n");
+        return -ENOMEM;
+    }
+
+    dir_overhead = debugfs_create_dir("kedr_overhead", NULL);
+    if(dir_overhead == NULL) goto fail_dir;
+
+    file_overhead = debugfs_create_file("overhead", S_IRUSR, dir_overhead,
+        NULL, &overhead_ops);
+    if(file_overhead == NULL) goto fail_overhead;
+
+    file_reset = debugfs_create_file("reset", S_IWUSR, dir_overhead,
+        NULL, &reset_ops);
+    if(file_reset == NULL) goto fail_reset;
+
+    return 0;
+
+fail_reset:
+    debugfs_remove(file_overhead);
+fail_overhead:
+    debugfs_remove(dir_overhead);
+fail_dir:
+    pr_err(COMPONENT_STRING "failed to create files in debugfs.\n");
+    kedr_stat_table_destroy(table);
+    return -ENOMEM;
+}
+
+void
+kedr_overhead_destroy(void)
+{
+    debugfs_remove(file_reset);
+    debugfs_remove(file_overhead);
+    debugfs_remove(dir_overhead);
+    kedr_stat_table_destroy(table);
+}
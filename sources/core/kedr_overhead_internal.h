@@ -0,0 +1,22 @@
+#ifndef KEDR_OVERHEAD_INTERNAL_H
+#define KEDR_OVERHEAD_INTERNAL_H
+
+/*
+ * Statistics about the overhead of KEDR itself, see
+ * <kedr/core/kedr_overhead.h>.
+ *
+ * The statistics is collected only if KEDR is built with
+ * KEDR_ENABLE_OVERHEAD, kedr_overhead.c is not compiled otherwise.
+ */
+
+#include <kedr/core/kedr_overhead.h>
+
+#if defined(KEDR_ENABLE_OVERHEAD)
+int kedr_overhead_init(void);
+void kedr_overhead_destroy(void);
+#else
+static inline int kedr_overhead_init(void) { return 0; }
+static inline void kedr_overhead_destroy(void) {}
+#endif
+
+#endif /* KEDR_OVERHEAD_INTERNAL_H */
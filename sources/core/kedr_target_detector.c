@@ -224,6 +224,17 @@ int kedr_target_detector_get_target_name(char* buf, size_t size)
 	return bw.size;
 }
 
+int kedr_target_detector_n_targets(void)
+{
+	return targets.n;
+}
+
+const char* kedr_target_detector_target_name(int target_index)
+{
+	BUG_ON((target_index < 0) || (target_index >= targets.n));
+	return targets.arr[target_index].name;
+}
+
 /* 
  * Set 'targets' according to value of 'targets_pending' with checks.
  * 
@@ -371,7 +382,7 @@ detector_notifier_call(struct notifier_block *nb,
 	switch(mod_state)
 	{
 	case MODULE_STATE_COMING: /* the module has just loaded */
-		if(on_target_load(mod)) goto out;
+		if(on_target_load(mod, i)) goto out;
 		target->m = mod;
 		target->in_init = 1;
 		atomic_inc(&target_init_counter);
@@ -379,6 +390,7 @@ detector_notifier_call(struct notifier_block *nb,
 	case MODULE_STATE_LIVE: /* the module has just initialized */
 		target->in_init = 0;
 		atomic_dec(&target_init_counter);
+		on_target_init_done(mod, i);
 	break;
 	case MODULE_STATE_GOING: /* the module is going to unload */
 		/* 
@@ -389,7 +401,7 @@ detector_notifier_call(struct notifier_block *nb,
 		 * NOTE: This is the only reason for 'in_init' field in
 		 * 'target_struct'.
 		 */
-		on_target_unload(mod);
+		on_target_unload(mod, i);
 		if(target->in_init)
 		{
 			target->in_init = 0;
@@ -11,10 +11,21 @@
 /* 
  * These two callbacks are called when target module is loading/unloading.
  * 
+ * 'target_index' is the index of the target in the list of
+ * targets (see kedr_target_detector_target_name()).
+ * 
+ * Should be implemented elsewhere.
+ */
+extern int on_target_load(struct module* m, int target_index);
+extern void on_target_unload(struct module* m, int target_index);
+
+/*
+ * This callback is called when target module has finished its
+ * initialization, so its init area is freed.
+ * 
  * Should be implemented elsewhere.
  */
-extern int on_target_load(struct module* m);
-extern void on_target_unload(struct module* m);
+extern void on_target_init_done(struct module* m, int target_index);
 
 /*
  * This callback is called when detector should watch for several
@@ -64,4 +75,13 @@ int kedr_target_detector_set_target_name(const char* target_name);
  */
 int kedr_target_detector_get_target_name(char* buf, size_t size);
 
+/*
+ * Return number of targets and the name of the target with given index.
+ * 
+ * May be called only from on_target_load() and on_target_unload()
+ * callbacks: the targets cannot be changed while one of them is loaded.
+ */
+int kedr_target_detector_n_targets(void);
+const char* kedr_target_detector_target_name(int target_index);
+
 #endif /* KEDR_TARGET_DETECTOR_INTERNAL_H */
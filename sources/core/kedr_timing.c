@@ -0,0 +1,380 @@
+/*
+ * Latency statistics for the functions called from the intermediate
+ * functions.
+ *
+ * The statistics are kept in a keyed per-CPU table (see
+ * <kedr/util/percpu_stats.h>) per (original function, call site). An entry
+ * contains a log-linear histogram of the durations of the calls: the
+ * values below TIMING_SUB_COUNT ns are counted exactly, each larger power
+ * of two range is split into TIMING_SUB_COUNT equal buckets. So the
+ * relative error of the reported percentiles does not exceed
+ * 1/TIMING_SUB_COUNT.
+ *
+ * The statistics are shown in "kedr_timing/latency" file. Writing to
+ * "kedr_timing/reset" clears them.
+ */
+
+/* ========================================================================
+ * Copyright (C) 2012-2014, KEDR development team
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation.
+ ======================================================================== */
+
+#include <kedr/core/kedr_functions_support.h>
+
+#include "kedr_timing_internal.h"
+
+#include <linux/version.h>
+#include <linux/module.h>
+#include <linux/moduleparam.h>
+#include <linux/kernel.h>
+#include <linux/errno.h>
+#include <linux/mutex.h>
+#include <linux/bitops.h>
+#include <linux/vmalloc.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include <linux/fs.h>
+#include <linux/sched.h>
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(4, 11, 0)
+#include <linux/sched/clock.h>
+#endif
+
+#include <kedr/util/percpu_stats.h>
+
+#define COMPONENT_STRING "timing: "
+
+/*
+ * Number of bits in the index of the per-CPU table. That is, each table
+ * contains (1 << timing_table_bits) entries.
+ */
+static unsigned int timing_table_bits = 8;
+module_param(timing_table_bits, uint, S_IRUGO);
+
+/*
+ * How many entries are checked when looking for (function, call site)
+ * in the table before giving up.
+ */
+#define TIMING_MAX_PROBES 16
+
+/* Each power of two range is split into (1 << TIMING_SUB_BITS) buckets. */
+#define TIMING_SUB_BITS 3
+#define TIMING_SUB_COUNT (1 << TIMING_SUB_BITS)
+
+/*
+ * The durations of 2^(TIMING_MAX_EXP + 1) ns (about 18 minutes) and more
+ * fall into the last bucket.
+ */
+#define TIMING_MAX_EXP 39
+
+#define TIMING_BUCKETS \
+    ((TIMING_MAX_EXP - TIMING_SUB_BITS + 2) * TIMING_SUB_COUNT)
+
+struct timing_entry
+{
+    /* (orig, call_site) */
+    struct kedr_stat_key key;
+
+    unsigned long count;
+    u64 max;
+    u32 buckets[TIMING_BUCKETS];
+};
+
+/* NULL until some functions support requests timing. */
+static struct kedr_stat_table* table;
+
+/*
+ * Protects allocation of the table and serializes readers of
+ * the statistics with reset.
+ */
+static DEFINE_MUTEX(timing_mutex);
+
+static struct dentry* dir_timing;
+static struct dentry* file_latency;
+static struct dentry* file_reset;
+
+/* ================================================================ */
+static inline unsigned int
+duration_to_bucket(u64 duration)
+{
+    unsigned int e;
+
+    if(duration < TIMING_SUB_COUNT)
+        return (unsigned int)duration;
+
+    e = fls64(duration) - 1;
+    if(e > TIMING_MAX_EXP)
+        return TIMING_BUCKETS - 1;
+
+    return (e - TIMING_SUB_BITS + 1) * TIMING_SUB_COUNT
+        + (unsigned int)((duration >> (e - TIMING_SUB_BITS))
+            & (TIMING_SUB_COUNT - 1));
+}
+
+/* The largest duration which falls into the given bucket. */
+static u64
+bucket_upper_bound(unsigned int bucket)
+{
+    unsigned int shift;
+    u64 lower;
+
+    if(bucket < TIMING_SUB_COUNT)
+        return bucket;
+
+    shift = bucket / TIMING_SUB_COUNT - 1;
+    lower = (u64)(TIMING_SUB_COUNT + bucket % TIMING_SUB_COUNT) << shift;
+
+    return lower + (1ULL << shift) - 1;
+}
+
+/* ================================================================ */
+/* Implementation of public API                                     */
+/* ================================================================ */
+u64
+kedr_timing_begin(void)
+{
+    return local_clock();
+}
+EXPORT_SYMBOL(kedr_timing_begin);
+
+void
+kedr_timing_end(void* orig, void* call_site, u64 start)
+{
+    unsigned long irq_flags;
+    struct kedr_stat_table* t;
+    struct timing_entry* entry;
+    u64 now = local_clock();
+    u64 duration;
+
+    /*
+     * Clock of other CPU could be used for 'start' if the task has
+     * migrated, and that clock may be ahead of the current one.
+     */
+    duration = (now > start) ? (now - start) : 0;
+
+    /* Pairs with smp_wmb() in table_create(). */
+    t = READ_ONCE(table);
+    if(t == NULL) return;
+
+    local_irq_save(irq_flags);
+    entry = kedr_stat_table_get(t, (unsigned long)orig,
+        (unsigned long)call_site);
+    if(entry != NULL)
+    {
+        ++entry->count;
+        ++entry->buckets[duration_to_bucket(duration)];
+        if(duration > entry->max)
+            entry->max = duration;
+    }
+    local_irq_restore(irq_flags);
+}
+EXPORT_SYMBOL(kedr_timing_end);
+
+/* ================================================================ */
+static void
+entry_merge(void* merged, const void* entry_data)
+{
+    struct timing_entry* total = merged;
+    const struct timing_entry* entry = entry_data;
+    unsigned int k;
+
+    total->count += entry->count;
+    if(entry->max > total->max)
+        total->max = entry->max;
+    for(k = 0; k < TIMING_BUCKETS; ++k)
+        total->buckets[k] += entry->buckets[k];
+}
+
+/*
+ * Return the duration such that at least 'num'/'den' part of the calls
+ * took no longer than that. The value is the upper bound of the bucket,
+ * but not greater than the maximum duration observed.
+ */
+static u64
+entry_percentile(const struct timing_entry* total,
+    unsigned long num, unsigned long den)
+{
+    /* Overflow-safe ceil(count * num / den). */
+    unsigned long rank = total->count / den * num
+        + (total->count % den * num + den - 1) / den;
+    unsigned long seen = 0;
+    unsigned int i;
+
+    if(rank == 0) rank = 1;
+
+    for(i = 0; i < TIMING_BUCKETS; ++i)
+    {
+        seen += total->buckets[i];
+        if(seen >= rank)
+        {
+            u64 bound = bucket_upper_bound(i);
+            return (bound < total->max) ? bound : total->max;
+        }
+    }
+    return total->max;
+}
+
+static void
+latency_show_merged(struct seq_file* m, const struct timing_entry* total)
+{
+    void* call_site = (void*)total->key.k2;
+
+    seq_printf(m, "%ps\t[<%p>] %pS\tcalls: %lu\t"
+        "p50: %llu\tp99: %llu\tp999: %llu\tmax: %llu\n",
+        (void*)total->key.k1, call_site, call_site, total->count,
+        (unsigned long long)entry_percentile(total, 50, 100),
+        (unsigned long long)entry_percentile(total, 99, 100),
+        (unsigned long long)entry_percentile(total, 999, 1000),
+        (unsigned long long)total->max);
+}
+
+static int
+latency_show(struct seq_file* m, void* v)
+{
+    void* merged;
+    unsigned long dropped;
+    long nr_merged;
+    long i;
+    int result;
+
+    result = mutex_lock_killable(&timing_mutex);
+    if(result) return result;
+
+    seq_printf(m, "# Durations are in nanoseconds.\n");
+    if(table == NULL)
+    {
+        mutex_unlock(&timing_mutex);
+        return 0;
+    }
+
+    nr_merged = kedr_stat_table_merge(table, entry_merge, &merged,
+        &dropped);
+    mutex_unlock(&timing_mutex);
+
+    if(nr_merged < 0) return (int)nr_merged;
+
+    for(i = 0; i < nr_merged; ++i)
+        latency_show_merged(m, (struct timing_entry*)merged + i);
+
+    seq_printf(m, "# Calls not counted (tables are full): %lu\n", dropped);
+
+    vfree(merged);
+    return 0;
+}
+
+static int
+latency_open(struct inode* inode, struct file* filp)
+{
+    return single_open(filp, latency_show, NULL);
+}
+
+static const struct file_operations latency_ops =
+{
+    .owner = THIS_MODULE,
+    .open = latency_open,
+    .read = seq_read,
+    .llseek = seq_lseek,
+    .release = single_release,
+};
+
+static ssize_t
+reset_write(struct file* filp, const char __user* buf, size_t count,
+    loff_t* f_pos)
+{
+    int result = mutex_lock_killable(&timing_mutex);
+    if(result) return result;
+
+    if(table != NULL)
+        kedr_stat_table_reset(table);
+
+    mutex_unlock(&timing_mutex);
+    return count;
+}
+
+static const struct file_operations reset_ops =
+{
+    .owner = THIS_MODULE,
+    .write = reset_write,
+};
+
+/* ================================================================ */
+/* Should be executed with mutex locked. */
+static int
+table_create(void)
+{
+    struct kedr_stat_table* table_new;
+
+    table_new = kedr_stat_table_create(timing_table_bits, TIMING_MAX_PROBES,
+        sizeof(struct timing_entry));
+    if(table_new == NULL) return -ENOMEM;
+
+    /* The table is initialized before the writers may see it. */
+    smp_wmb();
+    table = table_new;
+
+    return 0;
+}
+
+int
+kedr_timing_enable(void)
+{
+    int result = mutex_lock_killable(&timing_mutex);
+    if(result) return result;
+
+    if(table == NULL)
+    {
+        result = table_create();
+        if(result)
+            pr_err(COMPONENT_STRING
+                "failed to allocate tables for latency statistics.\n");
+    }
+
+    mutex_unlock(&timing_mutex);
+    return result;
+}
+
+int
+kedr_timing_init(void)
+{
+    if((timing_table_bits == 0) || (timing_table_bits > 20))
+    {
+        pr_err(COMPONENT_STRING "invalid value of 'timing_table_bits': %u\n",
+            timing_table_bits);
+        return -EINVAL;
+    }
+
+    table = NULL;
+
+    dir_timing = debugfs_create_dir("kedr_timing", NULL);
+    if(dir_timing == NULL) goto fail_dir;
+
+    file_latency = debugfs_create_file("latency", S_IRUSR, dir_timing,
+        NULL, &latency_ops);
+    if(file_latency == NULL) goto fail_latency;
+
+    file_reset = debugfs_create_file("reset", S_IWUSR, dir_timing,
+        NULL, &reset_ops);
+    if(file_reset == NULL) goto fail_reset;
+
+    return 0;
+
+fail_reset:
+    debugfs_remove(file_latency);
+fail_latency:
+    debugfs_remove(dir_timing);
+fail_dir:
+    pr_err(COMPONENT_STRING "failed to create files in debugfs.\n");
+    return -ENOMEM;
+}
+
+void
+kedr_timing_destroy(void)
+{
+    debugfs_remove(file_reset);
+    debugfs_remove(file_latency);
+    debugfs_remove(dir_timing);
+    kedr_stat_table_destroy(table);
+    table = NULL;
+}
@@ -0,0 +1,26 @@
+#ifndef KEDR_TIMING_INTERNAL_H
+#define KEDR_TIMING_INTERNAL_H
+
+/*
+ * Latency statistics for the original functions called from
+ * the intermediate ones.
+ *
+ * Only the functions with 'timing' set in the payload data are measured.
+ * The statistics is collected per (function, call site) and is available
+ * in "kedr_timing/latency" file in debugfs.
+ */
+
+/*
+ * Allocate the tables for the statistics if they are not allocated yet.
+ *
+ * Called when the functions support which measures the latency of some
+ * functions is registered.
+ *
+ * Should be executed in process context.
+ */
+int kedr_timing_enable(void);
+
+int kedr_timing_init(void);
+void kedr_timing_destroy(void);
+
+#endif /* KEDR_TIMING_INTERNAL_H */
@@ -0,0 +1,379 @@
+/*
+ * Replay of the code scanning done by the instrumentor over kernel module
+ * files, without loading the modules.
+ *
+ * Usage:
+ *   kedr_insn_replay [-q] [-r <repeat>] <module_file.ko> ...
+ *
+ * For each module file, the code sections are placed in the "core" and
+ * "init" areas the same way as the kernel does it when loading the
+ * module. The areas are then processed by kedr_process_area(), the same
+ * code the instrumentor uses for the loaded modules, and the following is
+ * reported for each file:
+ *
+ * - the number of 'call' and 'jmp' instructions with 32-bit offsets the
+ *   decoder has found ("call sites");
+ * - the number of the calls to the functions imported by the module
+ *   according to the relocations ("imported calls", these are the calls
+ *   KEDR may intercept) and how many of them the decoder has not found
+ *   ("missed"), e.g. because it lost track of instruction boundaries;
+ * - the number of warnings from the decoder, like "instruction decoder
+ *   stopped past the end of the section". The messages themselves are
+ *   output to stderr unless -q is specified.
+ *
+ * Each area is processed <repeat> times (1 by default), the total time is
+ * used to compute the decoding speed reported at the end.
+ *
+ * The relocations are not applied, this does not matter for decoding.
+ * Only the modules for the architecture the tool is built for can be
+ * processed. Compressed module files (.ko.xz, etc.) should be unpacked
+ * first.
+ *
+ * Exit status is 0 if all files have been processed and no call sites have
+ * been missed and no warnings issued, 2 if there were missed call sites or
+ * warnings, 1 if some of the files could not be processed.
+ */
+
+/* ========================================================================
+ * Copyright (C) 2012, KEDR development team
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation.
+ ======================================================================== */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <elf.h>
+
+#include "kedr_insn_scan_internal.h"
+#include "module_file.h"
+
+/* The maximum length of an x86 instruction, in bytes. */
+#define MAX_INSN_LENGTH 15
+
+/* These are used by the shim of the kernel API. */
+unsigned long kedr_shim_warnings = 0;
+int kedr_shim_quiet = 0;
+
+/* A code area of the module and the call sites found there. */
+struct area
+{
+    char name;
+    unsigned char* code;
+    unsigned long size;
+
+    /* The offsets of the operands of the call sites, in ascending order */
+    unsigned long* sites;
+    unsigned long n_sites;
+    unsigned long capacity;
+};
+
+/* The results for a module file or for all files. */
+struct stats
+{
+    unsigned long bytes;
+    unsigned long sites;
+    unsigned long imported;
+    unsigned long missed;
+    unsigned long warnings;
+};
+
+static const char* prog_name = "kedr_insn_replay";
+
+static void
+usage(void)
+{
+    fprintf(stderr,
+        "Usage: %s [-q] [-r <repeat>] <module_file.ko> ...\n",
+        prog_name);
+}
+
+static double
+get_time(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+/* A callback for kedr_process_area(), 'data' is the area. */
+static void
+record_call_site(void* kaddr, unsigned int len, u32* offset, void* data)
+{
+    struct area* area = data;
+    (void)kaddr;
+    (void)len;
+
+    if(area->n_sites == area->capacity)
+    {
+        unsigned long capacity = area->capacity ? 2 * area->capacity : 256;
+        unsigned long* sites = realloc(area->sites,
+            capacity * sizeof(*sites));
+        if(sites == NULL)
+        {
+            fprintf(stderr, "%s: not enough memory\n", prog_name);
+            exit(EXIT_FAILURE);
+        }
+        area->sites = sites;
+        area->capacity = capacity;
+    }
+    area->sites[area->n_sites++] =
+        (unsigned long)((unsigned char*)offset - area->code);
+}
+
+static void
+area_destroy(struct area* area)
+{
+    free(area->code);
+    free(area->sites);
+}
+
+/*
+ * Copy the code sections placed in the area to it. The gaps between the
+ * sections are filled with zeros like in the kernel.
+ *
+ * The decoder may read past the end of the area if the last instruction
+ * there is incomplete, so there is room for the longest instruction after
+ * the area.
+ */
+static int
+area_fill(struct area* area, const struct module_file* mf,
+    const struct placement* placements)
+{
+    unsigned int i;
+    struct section sec;
+
+    area->code = calloc(area->size + MAX_INSN_LENGTH, 1);
+    if(area->code == NULL)
+    {
+        fprintf(stderr, "%s: not enough memory\n", prog_name);
+        return -1;
+    }
+
+    for(i = 0; i < mf->shnum; ++i)
+    {
+        if(placements[i].area != area->name) continue;
+        if(module_file_get_section(mf, i, &sec)) return -1;
+        if(sec.type == SHT_NOBITS) continue;
+        memcpy(area->code + placements[i].offset, mf->data + sec.offset,
+            sec.size);
+    }
+    return 0;
+}
+
+/* Data for check_call_site(). */
+struct check_data
+{
+    const struct module_file* mf;
+    const struct area* area;
+    struct stats* stats;
+};
+
+/*
+ * A callback for module_file_for_each_call_site(): check if the decoder
+ * has found the call site the relocations point to.
+ */
+static int
+check_call_site(unsigned long offset, void* data)
+{
+    struct check_data* check = data;
+    const struct area* area = check->area;
+    unsigned long lo = 0;
+    unsigned long hi = area->n_sites;
+
+    ++check->stats->imported;
+    while(lo < hi)
+    {
+        unsigned long mid = lo + (hi - lo) / 2;
+        if(area->sites[mid] == offset) return 0;
+        if(area->sites[mid] < offset)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+
+    ++check->stats->missed;
+    if(!kedr_shim_quiet)
+    {
+        fprintf(stderr, "%s: the decoder missed the call site at %s+0x%lx\n",
+            check->mf->file_name, (area->name == 'i') ? "init" : "core",
+            offset - 1);
+    }
+    return 0;
+}
+
+/*
+ * Process the module file. The results are stored in 'stats', 'elapsed'
+ * is increased by the time spent in kedr_process_area().
+ */
+static int
+replay_module(const char* file_name, unsigned int repeat,
+    struct stats* stats, double* elapsed)
+{
+    struct module_file mf;
+    struct placement* placements = NULL;
+    struct area areas[2];
+    struct check_data check;
+    unsigned long warnings;
+    unsigned int r;
+    unsigned int a;
+    double start;
+    int quiet = kedr_shim_quiet;
+    int result = -1;
+
+    memset(areas, 0, sizeof(areas));
+    areas[0].name = 'c';
+    areas[1].name = 'i';
+    memset(stats, 0, sizeof(*stats));
+
+    if(module_file_open(&mf, file_name)) return -1;
+
+    if(mf.is_64 != (sizeof(void*) == 8))
+    {
+        fprintf(stderr, "%s: the module is for a different architecture\n",
+            file_name);
+        goto out;
+    }
+
+    placements = calloc(mf.shnum ? mf.shnum : 1, sizeof(*placements));
+    if(placements == NULL)
+    {
+        fprintf(stderr, "%s: not enough memory\n", prog_name);
+        goto out;
+    }
+
+    if(module_file_layout(&mf, placements, &areas[0].size, &areas[1].size))
+        goto out;
+
+    for(a = 0; a < 2; ++a)
+    {
+        if(area_fill(&areas[a], &mf, placements)) goto out;
+    }
+
+    /* The warnings are counted and reported for the first pass only. */
+    warnings = kedr_shim_warnings;
+    for(r = 0; r < repeat; ++r)
+    {
+        if(r == 1) kedr_shim_quiet = 1;
+
+        start = get_time();
+        for(a = 0; a < 2; ++a)
+        {
+            areas[a].n_sites = 0;
+            kedr_process_area(areas[a].code, areas[a].code + areas[a].size,
+                record_call_site, &areas[a]);
+        }
+        *elapsed += get_time() - start;
+    }
+    kedr_shim_quiet = quiet;
+    stats->warnings = kedr_shim_warnings - warnings;
+
+    check.mf = &mf;
+    check.stats = stats;
+    for(a = 0; a < 2; ++a)
+    {
+        stats->bytes += areas[a].size * repeat;
+        stats->sites += areas[a].n_sites;
+
+        check.area = &areas[a];
+        if(module_file_for_each_call_site(&mf, placements, areas[a].name,
+            check_call_site, &check))
+            goto out;
+    }
+
+    printf("%s: core: %lu bytes, init: %lu bytes, call sites: %lu, "
+        "imported calls: %lu, missed: %lu, warnings: %lu\n",
+        file_name, areas[0].size, areas[1].size, stats->sites,
+        stats->imported, stats->missed, stats->warnings);
+    result = 0;
+out:
+    for(a = 0; a < 2; ++a)
+        area_destroy(&areas[a]);
+    free(placements);
+    module_file_close(&mf);
+    return result;
+}
+
+int
+main(int argc, char* argv[])
+{
+    int opt;
+    unsigned int repeat = 1;
+    struct stats total;
+    struct stats stats;
+    unsigned long n_files = 0;
+    unsigned long n_failed = 0;
+    double elapsed = 0.0;
+    int i;
+
+    while((opt = getopt(argc, argv, "qr:h")) != -1)
+    {
+        char* end;
+        long value;
+
+        switch(opt)
+        {
+        case 'q':
+            kedr_shim_quiet = 1;
+            break;
+        case 'r':
+            value = strtol(optarg, &end, 10);
+            if(*optarg == '\0' || *end != '\0' || value <= 0)
+            {
+                fprintf(stderr, "%s: invalid number of repetitions: %s\n",
+                    prog_name, optarg);
+                return EXIT_FAILURE;
+            }
+            repeat = (unsigned int)value;
+            break;
+        case 'h':
+            usage();
+            return EXIT_SUCCESS;
+        default:
+            usage();
+            return EXIT_FAILURE;
+        }
+    }
+
+    if(optind >= argc)
+    {
+        usage();
+        return EXIT_FAILURE;
+    }
+
+    memset(&total, 0, sizeof(total));
+    for(i = optind; i < argc; ++i)
+    {
+        if(replay_module(argv[i], repeat, &stats, &elapsed))
+        {
+            ++n_failed;
+            continue;
+        }
+
+        ++n_files;
+        total.bytes += stats.bytes;
+        total.sites += stats.sites;
+        total.imported += stats.imported;
+        total.missed += stats.missed;
+        total.warnings += stats.warnings;
+    }
+
+    printf("Total: %lu file(s), call sites: %lu, imported calls: %lu, "
+        "missed: %lu, warnings: %lu\n",
+        n_files, total.sites, total.imported, total.missed, total.warnings);
+    if(elapsed > 0.0)
+    {
+        printf("Decoded %lu bytes in %.6f s, %.2f MB/s\n",
+            total.bytes, elapsed, (double)total.bytes / elapsed / 1e6);
+    }
+    if(n_failed != 0)
+        printf("Failed to process %lu file(s)\n", n_failed);
+
+    if(n_failed != 0)
+        return EXIT_FAILURE;
+    return (total.missed != 0 || total.warnings != 0) ? 2 : EXIT_SUCCESS;
+}
@@ -0,0 +1,20 @@
+/*
+ * Branch prediction hints for the user-space build of the instruction
+ * decoder.
+ */
+
+/* ========================================================================
+ * Copyright (C) 2012, KEDR development team
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation.
+ ======================================================================== */
+
+#ifndef KEDR_INSN_SHIM_COMPILER_H
+#define KEDR_INSN_SHIM_COMPILER_H
+
+#define likely(x)   __builtin_expect(!!(x), 1)
+#define unlikely(x) __builtin_expect(!!(x), 0)
+
+#endif /* KEDR_INSN_SHIM_COMPILER_H */
@@ -0,0 +1,47 @@
+/*
+ * Minimal replacement of the kernel API used by the instruction decoder
+ * and the code scanning part of the instrumentor, for building them in
+ * the user space (see ../../CMakeLists.txt).
+ *
+ * Only what these files actually use is provided here.
+ */
+
+/* ========================================================================
+ * Copyright (C) 2012, KEDR development team
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation.
+ ======================================================================== */
+
+#ifndef KEDR_INSN_SHIM_KERNEL_H
+#define KEDR_INSN_SHIM_KERNEL_H
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <linux/compiler.h>
+#include <linux/types.h>
+
+/*
+ * The number of WARN_ON() conditions triggered so far. The user of the
+ * code defines this variable.
+ */
+extern unsigned long kedr_shim_warnings;
+
+/* If nonzero, the messages are not output. */
+extern int kedr_shim_quiet;
+
+#define KERN_ALERT  ""
+#define KERN_ERR    ""
+#define KERN_INFO   ""
+#define KERN_DEBUG  ""
+
+#define printk(fmt, ...) \
+    do { if(!kedr_shim_quiet) fprintf(stderr, fmt, ##__VA_ARGS__); } while(0)
+
+#define BUG_ON(cond) do { if(cond) abort(); } while(0)
+#define WARN_ON(cond) \
+    ({ int __warn = !!(cond); if(__warn) ++kedr_shim_warnings; __warn; })
+
+#endif /* KEDR_INSN_SHIM_KERNEL_H */
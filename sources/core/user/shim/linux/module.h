@@ -0,0 +1,21 @@
+/*
+ * Only 'struct module' is needed as an opaque type in the user-space build
+ * of the instruction decoder (kedr.h uses it).
+ */
+
+/* ========================================================================
+ * Copyright (C) 2012, KEDR development team
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation.
+ ======================================================================== */
+
+#ifndef KEDR_INSN_SHIM_MODULE_H
+#define KEDR_INSN_SHIM_MODULE_H
+
+#include <linux/kernel.h>
+
+struct module;
+
+#endif /* KEDR_INSN_SHIM_MODULE_H */
@@ -0,0 +1,21 @@
+/*
+ * String functions for the user-space build of the instruction decoder.
+ */
+
+/* ========================================================================
+ * Copyright (C) 2012, KEDR development team
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation.
+ ======================================================================== */
+
+#ifndef KEDR_INSN_SHIM_STRING_H
+#define KEDR_INSN_SHIM_STRING_H
+
+#include <string.h>
+
+/* The kernel headers provide these too. */
+#include <linux/compiler.h>
+
+#endif /* KEDR_INSN_SHIM_STRING_H */
@@ -0,0 +1,30 @@
+/*
+ * Kernel integer types for the user-space build of the instruction
+ * decoder and the code scanning part of the instrumentor.
+ */
+
+/* ========================================================================
+ * Copyright (C) 2012, KEDR development team
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation.
+ ======================================================================== */
+
+#ifndef KEDR_INSN_SHIM_TYPES_H
+#define KEDR_INSN_SHIM_TYPES_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+typedef uint8_t  u8;
+typedef uint16_t u16;
+typedef uint32_t u32;
+typedef uint64_t u64;
+
+typedef int8_t  s8;
+typedef int16_t s16;
+typedef int32_t s32;
+typedef int64_t s64;
+
+#endif /* KEDR_INSN_SHIM_TYPES_H */
@@ -18,25 +18,29 @@
 #include <linux/errno.h>
 #include <linux/err.h>
 #include <linux/mutex.h>
-#include <linux/spinlock.h>
-#include <linux/uaccess.h>
 #include <linux/debugfs.h>
 
 #include <kedr/core/kedr.h>
-
-#include "counters.h"
+#include <kedr/util/percpu_stats.h>
 
 /* ================================================================ */
 MODULE_AUTHOR("Eugene A. Shatokhin");
 MODULE_LICENSE("GPL");
 /* ================================================================ */
 
-/* A directory in debugfs to contain the files that will represent 
+/* A directory in debugfs to contain the file that will represent 
  * the counters. */
 struct dentry *dir_counters = NULL;
 
-/* The counters, the spinlocks to protect them and the files in debugfs
- * to represent these counters.
+/* The file in debugfs showing all the counters, one per line. */
+struct dentry *file_counters = NULL;
+
+/* The counters.
+ *
+ * Each CPU updates its own copy of a counter, the copies are summed up
+ * when the counters are read (see <kedr/util/percpu_stats.h>). So the 
+ * handlers neither take any locks nor make the CPUs fight for the same 
+ * cache lines.
  *
  * [NB] No checks for overflow will be made for the counters.
  *
@@ -51,131 +55,74 @@ struct dentry *dir_counters = NULL;
  */
  
 /* Number of memory allocation attempts */
-u64 cnt_alloc_total = 0;
-DEFINE_SPINLOCK(spinlock_alloc_total);
-struct dentry *file_alloc_total = NULL;
+struct kedr_stat_counter cnt_alloc_total;
 
 /* Number of failed memory allocation attempts  */
-u64 cnt_alloc_failed = 0;
-DEFINE_SPINLOCK(spinlock_alloc_failed);
-struct dentry *file_alloc_failed = NULL;
+struct kedr_stat_counter cnt_alloc_failed;
 
 /* Max. chunk size requiested in an allocation attempt. 
  * Note that only kmalloc and krealloc are taken into account here.
  */
-size_t cnt_alloc_max_size = 0;
-DEFINE_SPINLOCK(spinlock_alloc_max_size);
-struct dentry *file_alloc_max_size = NULL;
+struct kedr_stat_max cnt_alloc_max_size;
+
+/* Distribution of the sizes requested in the allocation attempts */
+struct kedr_stat_hist cnt_alloc_sizes;
 
 /* Number of successful mutex acquisitions */
-u64 cnt_mutex_locks = 0;
-DEFINE_SPINLOCK(spinlock_mutex_locks);
-struct dentry *file_mutex_locks = NULL;
+struct kedr_stat_counter cnt_mutex_locks;
 
 /* Mutex acquisitions minus mutex releases */
-s64 cnt_mutex_balance = 0;
-DEFINE_SPINLOCK(spinlock_mutex_balance);
-struct dentry *file_mutex_balance = NULL;
-
-/* ================================================================ */
-/* 
- * Copying functions for the counters. 
- * Each function creates a copy of the counter and returns a pointer to 
- * the copy in *ppdata.
- * The caller is responsible to call kfree() for that pointer to free 
- * the memory occupied by the copy when it is no longer needed.
- * 
- * Each function returns 0 if OK, negative error code otherwise.
- */
-
-/* A helper macro to define copying functions for the counters.
- * __cnt_name - the name of the counter (without "cnt_" prefix)
- * __numeric_type - the type of the counter
- */
-#undef COUNTERS_DEFINE_COPY_FUNCTION
-#define COUNTERS_DEFINE_COPY_FUNCTION(__cnt_name, __numeric_type)       \
-static int get_copy_ ## __cnt_name(__numeric_type **ppdata)             \
-{                                                                       \
-    unsigned long irq_flags;                                                \
-    BUG_ON(ppdata == NULL);                                             \
-                                                                        \
-    *ppdata =                                                           \
-        (__numeric_type *)kmalloc(sizeof(__numeric_type), GFP_KERNEL);  \
-    if (*ppdata == NULL) return -ENOMEM;                                \
-                                                                        \
-    spin_lock_irqsave(&spinlock_ ## __cnt_name, irq_flags);             \
-    *(*ppdata) = cnt_ ## __cnt_name; /* Copy the data */                \
-    spin_unlock_irqrestore(&spinlock_ ## __cnt_name, irq_flags);        \
-    return 0;                                                           \
-}
-
-COUNTERS_DEFINE_COPY_FUNCTION(alloc_total, u64);
-COUNTERS_DEFINE_COPY_FUNCTION(alloc_failed, u64);
-COUNTERS_DEFINE_COPY_FUNCTION(alloc_max_size, size_t);
-COUNTERS_DEFINE_COPY_FUNCTION(mutex_locks, u64);
-COUNTERS_DEFINE_COPY_FUNCTION(mutex_balance, s64);
-
-/* ================================================================ */
-/* Using the helper to define file_operations structures */
-COUNTERS_DEFINE_FOPS_RO(fops_alloc_total_ro, 
-    u64, get_copy_alloc_total, 
-    "Memory allocation attempts: %llu\n");
-COUNTERS_DEFINE_FOPS_RO(fops_alloc_failed_ro,
-    u64, get_copy_alloc_failed, 
-    "Memory allocation attempts failed: %llu\n");
-COUNTERS_DEFINE_FOPS_RO(fops_alloc_max_size_ro,
-    size_t, get_copy_alloc_max_size, 
-    "Maximum size of a memory chunk requested: %zu\n");
-COUNTERS_DEFINE_FOPS_RO(fops_mutex_locks_ro,
-    u64, get_copy_mutex_locks, 
-    "Mutex acquisitions: %llu\n");
-COUNTERS_DEFINE_FOPS_RO(fops_mutex_balance_ro,
-    s64, get_copy_mutex_balance, 
-    "Mutex balance: %lld\n");
+struct kedr_stat_counter cnt_mutex_balance;
+
+static const struct kedr_stat_desc counters_desc[] = {
+    KEDR_STAT_DESC_COUNTER("alloc_total", &cnt_alloc_total),
+    KEDR_STAT_DESC_COUNTER("alloc_failed", &cnt_alloc_failed),
+    KEDR_STAT_DESC_MAX("alloc_max_size", &cnt_alloc_max_size),
+    KEDR_STAT_DESC_HIST("alloc_sizes", &cnt_alloc_sizes),
+    KEDR_STAT_DESC_COUNTER("mutex_locks", &cnt_mutex_locks),
+    KEDR_STAT_DESC_COUNTER("mutex_balance", &cnt_mutex_balance),
+    KEDR_STAT_DESC_END
+};
 
 /* ================================================================ */
 static void
-remove_debugfs_files(void)
+destroy_counters(void)
 {
-    if (file_alloc_total    != NULL) debugfs_remove(file_alloc_total);
-    if (file_alloc_failed   != NULL) debugfs_remove(file_alloc_failed);
-    if (file_alloc_max_size != NULL) debugfs_remove(file_alloc_max_size);
-    if (file_mutex_locks    != NULL) debugfs_remove(file_mutex_locks);
-    if (file_mutex_balance  != NULL) debugfs_remove(file_mutex_balance);
-    return;
+    kedr_stat_counter_destroy(&cnt_mutex_balance);
+    kedr_stat_counter_destroy(&cnt_mutex_locks);
+    kedr_stat_hist_destroy(&cnt_alloc_sizes);
+    kedr_stat_max_destroy(&cnt_alloc_max_size);
+    kedr_stat_counter_destroy(&cnt_alloc_failed);
+    kedr_stat_counter_destroy(&cnt_alloc_total);
 }
-    
+
 static int
-create_debugfs_files(void)
+init_counters(void)
 {
-    file_alloc_total = debugfs_create_file("alloc_total", S_IRUGO,
-        dir_counters, NULL, &fops_alloc_total_ro);
-    if (file_alloc_total == NULL) goto fail;
-    
-    file_alloc_failed = debugfs_create_file("alloc_failed", S_IRUGO,
-        dir_counters, NULL, &fops_alloc_failed_ro);
-    if (file_alloc_failed == NULL) goto fail;
-    
-    file_alloc_max_size = debugfs_create_file("alloc_max_size", S_IRUGO,
-        dir_counters, NULL, &fops_alloc_max_size_ro);
-    if (file_alloc_max_size == NULL) goto fail;
-    
-    file_mutex_locks = debugfs_create_file("mutex_locks", S_IRUGO,
-        dir_counters, NULL, &fops_mutex_locks_ro);
-    if (file_mutex_locks == NULL) goto fail;
-    
-    file_mutex_balance = debugfs_create_file("mutex_balance", S_IRUGO,
-        dir_counters, NULL, &fops_mutex_balance_ro);
-    if (file_mutex_balance == NULL) goto fail;
-
+    /* free_percpu(NULL) is a no-op, so it is safe to destroy all the 
+     * counters if some of them have not been created. */
+    if (kedr_stat_counter_init(&cnt_alloc_total) != 0 ||
+        kedr_stat_counter_init(&cnt_alloc_failed) != 0 ||
+        kedr_stat_max_init(&cnt_alloc_max_size) != 0 ||
+        kedr_stat_hist_init(&cnt_alloc_sizes) != 0 ||
+        kedr_stat_counter_init(&cnt_mutex_locks) != 0 ||
+        kedr_stat_counter_init(&cnt_mutex_balance) != 0) {
+        printk(KERN_ERR "[counters] not enough memory for the counters\n");
+        destroy_counters();
+        return -ENOMEM;
+    }
     return 0;
+}
 
-fail:
-    printk(KERN_ERR "[counters] "
-        "failed to create file for a counter in debugfs\n"
-    );
-    remove_debugfs_files();
-    return -EINVAL;    
+/* Update the counters for an allocation attempt */
+static void
+account_alloc(size_t size, const void *ret_val)
+{
+    kedr_stat_counter_inc(&cnt_alloc_total);
+    if (ret_val == NULL) 
+        kedr_stat_counter_inc(&cnt_alloc_failed);
+    kedr_stat_max_update(&cnt_alloc_max_size, size);
+    kedr_stat_hist_add(&cnt_alloc_sizes, size);
 }
 
 /* ================================================================ */
@@ -184,19 +131,7 @@ static void
 post___kmalloc(size_t size, gfp_t flags, void* ret_val,
     struct kedr_function_call_info* call_info)
 {
-    unsigned long irq_flags;
-    
-    spin_lock_irqsave(&spinlock_alloc_total, irq_flags);
-    ++cnt_alloc_total;
-    spin_unlock_irqrestore(&spinlock_alloc_total, irq_flags);
-    
-    spin_lock_irqsave(&spinlock_alloc_failed, irq_flags);
-    if (ret_val == NULL) ++cnt_alloc_failed;
-    spin_unlock_irqrestore(&spinlock_alloc_failed, irq_flags);
-    
-    spin_lock_irqsave(&spinlock_alloc_max_size, irq_flags);
-    if (size > cnt_alloc_max_size) cnt_alloc_max_size = size;
-    spin_unlock_irqrestore(&spinlock_alloc_max_size, irq_flags);
+    account_alloc(size, ret_val);
 }
 
 static void
@@ -204,20 +139,8 @@ post_krealloc(const void* p, size_t size, gfp_t flags,
     void* ret_val,
     struct kedr_function_call_info* call_info)
 {
-    unsigned long irq_flags;
-    
-    spin_lock_irqsave(&spinlock_alloc_total, irq_flags);
     /* For now, we don't care about the case when size <= ksize(p) */
-    ++cnt_alloc_total;
-    spin_unlock_irqrestore(&spinlock_alloc_total, irq_flags);
-    
-    spin_lock_irqsave(&spinlock_alloc_failed, irq_flags);
-    if (ret_val == NULL) ++cnt_alloc_failed;
-    spin_unlock_irqrestore(&spinlock_alloc_failed, irq_flags);
-    
-    spin_lock_irqsave(&spinlock_alloc_max_size, irq_flags);
-    if (size > cnt_alloc_max_size) cnt_alloc_max_size = size;
-    spin_unlock_irqrestore(&spinlock_alloc_max_size, irq_flags);
+    account_alloc(size, ret_val);
 }
 
 static void
@@ -225,70 +148,38 @@ post_kmem_cache_alloc(struct kmem_cache* mc, gfp_t flags,
     void* ret_val,
     struct kedr_function_call_info* call_info)
 {
-    unsigned long irq_flags;
-    size_t size;
-    
-    /* 'size' may be somewhat larger than the actual size of the requested
-     * memory block but this is not critical for now.
+    /* The size may be somewhat larger than the actual size of the 
+     * requested memory block but this is not critical for now.
      */
-    size = (size_t)kmem_cache_size(mc);
-
-    spin_lock_irqsave(&spinlock_alloc_total, irq_flags);
-    ++cnt_alloc_total;
-    spin_unlock_irqrestore(&spinlock_alloc_total, irq_flags);
-    
-    spin_lock_irqsave(&spinlock_alloc_failed, irq_flags);
-    if (ret_val == NULL) ++cnt_alloc_failed;
-    spin_unlock_irqrestore(&spinlock_alloc_failed, irq_flags);
-    
-    spin_lock_irqsave(&spinlock_alloc_max_size, irq_flags);
-    if (size > cnt_alloc_max_size) cnt_alloc_max_size = size;
-    spin_unlock_irqrestore(&spinlock_alloc_max_size, irq_flags);
+    account_alloc((size_t)kmem_cache_size(mc), ret_val);
 }
 
 #ifndef CONFIG_DEBUG_LOCK_ALLOC
 static void
 post_mutex_lock(struct mutex* lock, struct kedr_function_call_info* call_info)
 {
-    unsigned long irq_flags;
-    
-    spin_lock_irqsave(&spinlock_mutex_locks, irq_flags);
-    ++cnt_mutex_locks;
-    spin_unlock_irqrestore(&spinlock_mutex_locks, irq_flags);
-    
-    spin_lock_irqsave(&spinlock_mutex_balance, irq_flags);
-    ++cnt_mutex_balance;
-    spin_unlock_irqrestore(&spinlock_mutex_balance, irq_flags);
+    kedr_stat_counter_inc(&cnt_mutex_locks);
+    kedr_stat_counter_inc(&cnt_mutex_balance);
 }
 
 static void
 post_mutex_lock_interruptible(struct mutex* lock, int ret_val,
     struct kedr_function_call_info* call_info)
 {
-    unsigned long irq_flags;
-   
-    spin_lock_irqsave(&spinlock_mutex_locks, irq_flags);
-    if (ret_val == 0) ++cnt_mutex_locks;
-    spin_unlock_irqrestore(&spinlock_mutex_locks, irq_flags);
-    
-    spin_lock_irqsave(&spinlock_mutex_balance, irq_flags);
-    if (ret_val == 0) ++cnt_mutex_balance;
-    spin_unlock_irqrestore(&spinlock_mutex_balance, irq_flags);
+    if (ret_val == 0) {
+        kedr_stat_counter_inc(&cnt_mutex_locks);
+        kedr_stat_counter_inc(&cnt_mutex_balance);
+    }
 }
 
 static void
 post_mutex_lock_killable(struct mutex* lock, int ret_val,
     struct kedr_function_call_info* call_info)
 {
-    unsigned long irq_flags;
-    
-    spin_lock_irqsave(&spinlock_mutex_locks, irq_flags);
-    if (ret_val == 0) ++cnt_mutex_locks;
-    spin_unlock_irqrestore(&spinlock_mutex_locks, irq_flags);
-    
-    spin_lock_irqsave(&spinlock_mutex_balance, irq_flags);
-    if (ret_val == 0) ++cnt_mutex_balance;
-    spin_unlock_irqrestore(&spinlock_mutex_balance, irq_flags);
+    if (ret_val == 0) {
+        kedr_stat_counter_inc(&cnt_mutex_locks);
+        kedr_stat_counter_inc(&cnt_mutex_balance);
+    }
 }
 #endif /* CONFIG_DEBUG_LOCK_ALLOC */
 
@@ -296,33 +187,24 @@ static void
 post_mutex_trylock(struct mutex* lock, int ret_val,
     struct kedr_function_call_info* call_info)
 {
-    unsigned long irq_flags;
-    
-    spin_lock_irqsave(&spinlock_mutex_locks, irq_flags);
-    if (ret_val == 1) ++cnt_mutex_locks;
-    spin_unlock_irqrestore(&spinlock_mutex_locks, irq_flags);
-    
-    spin_lock_irqsave(&spinlock_mutex_balance, irq_flags);
-    if (ret_val == 1) ++cnt_mutex_balance;
-    spin_unlock_irqrestore(&spinlock_mutex_balance, irq_flags);
+    if (ret_val == 1) {
+        kedr_stat_counter_inc(&cnt_mutex_locks);
+        kedr_stat_counter_inc(&cnt_mutex_balance);
+    }
 }
 
 static void
 pre_mutex_unlock(struct mutex* lock,
     struct kedr_function_call_info* call_info)
 {
-    unsigned long irq_flags;
-    
-    spin_lock_irqsave(&spinlock_mutex_balance, irq_flags);
-    --cnt_mutex_balance;
-    spin_unlock_irqrestore(&spinlock_mutex_balance, irq_flags);
+    kedr_stat_counter_dec(&cnt_mutex_balance);
 }
 /* ================================================================ */
 
 /* [NB] If CONFIG_DEBUG_LOCK_ALLOC is defined, mutex_lock & Ko are not 
  * exported by the kernel. For simplicity, we just disable collection of 
- * mutex-related statistics in this case. The corresponding files in 
- * debugfs will be created though but they will contain 0.
+ * mutex-related statistics in this case. The corresponding counters will
+ * be shown in debugfs though but they will contain 0.
  */
 
 /* Names and addresses of the functions of interest */
@@ -396,43 +278,57 @@ counters_init(void)
 {
     int ret = 0;
     
+    ret = init_counters();
+    if (ret < 0)
+        return ret;
+    
     dir_counters = debugfs_create_dir("kedr_counters_example", NULL);
     if (IS_ERR(dir_counters)) {
         printk(KERN_ERR "[counters] debugfs is not supported\n");
-        return -ENODEV;
+        ret = -ENODEV;
+        goto fail_dir;
     }
     
     if (dir_counters == NULL) {
         printk(KERN_ERR 
             "[counters] failed to create a directory in debugfs\n");
-        return -EINVAL;
+        ret = -EINVAL;
+        goto fail_dir;
     }
     
-    ret = create_debugfs_files();
-    if (ret < 0) {
-        debugfs_remove(dir_counters);
-        return ret;
+    file_counters = kedr_stat_debugfs_create("counters", dir_counters,
+        counters_desc);
+    if (file_counters == NULL) {
+        printk(KERN_ERR "[counters] "
+            "failed to create file for the counters in debugfs\n");
+        ret = -EINVAL;
+        goto fail_file;
     }
     
     ret = functions_support_register();
     if(ret)
     {
         printk(KERN_ERR "[counters] failed to register functions support for payload.\n");
-        remove_debugfs_files();
-        debugfs_remove(dir_counters);
-        return ret;
+        goto fail_support;
     }
     
     ret = kedr_payload_register(&counters_payload);
     if (ret < 0)
     {
         printk(KERN_ERR "[counters] failed to register payload module.\n");
-        functions_support_unregister();
-        remove_debugfs_files();
-        debugfs_remove(dir_counters);
-        return ret;
+        goto fail_payload;
     }
     return 0;
+
+fail_payload:
+    functions_support_unregister();
+fail_support:
+    debugfs_remove(file_counters);
+fail_file:
+    debugfs_remove(dir_counters);
+fail_dir:
+    destroy_counters();
+    return ret;
 }
 
 static void
@@ -441,46 +337,12 @@ counters_exit(void)
     kedr_payload_unregister(&counters_payload);
     functions_support_unregister();
     
-    remove_debugfs_files();
+    debugfs_remove(file_counters);
     debugfs_remove(dir_counters);
+    destroy_counters();
     return;
 }
 
 module_init(counters_init);
 module_exit(counters_exit);
 /* ================================================================ */
-
-/* Helpers for file operations common to all read-only files in this 
- * example. */
-int 
-counters_release_common(struct inode *inode, struct file *filp)
-{
-    kfree(filp->private_data);
-    return 0;
-}
-
-ssize_t 
-counters_read_common(struct file *filp, char __user *buf, size_t count,
-    loff_t *f_pos)
-{
-    size_t dataLen;
-    loff_t pos = *f_pos;
-    const char *data = (const char *)filp->private_data;
-    
-    if (data == NULL) return -EINVAL;
-    dataLen = strlen(data) + 1;
-    
-    /* Reading outside of the data buffer is not allowed */
-    if ((pos < 0) || (pos > dataLen)) return -EINVAL;
-    
-    /* EOF reached or 0 bytes requested */
-    if ((count == 0) || (pos == dataLen)) return 0;
-    
-    if (pos + count > dataLen) count = dataLen - pos;
-    if (copy_to_user(buf, &data[pos], count) != 0)
-        return -EFAULT;
-    
-    *f_pos += count;
-    return count;
-}
-/* ================================================================ */
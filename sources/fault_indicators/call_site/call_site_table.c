@@ -0,0 +1,576 @@
+/*
+ * Table of the call sites for 'call_site' indicator, see call_site_table.h.
+ */
+
+/* ========================================================================
+ * Copyright (C) 2012, KEDR development team
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation.
+ ======================================================================== */
+
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/slab.h>
+#include <linux/list.h>
+#include <linux/string.h>
+#include <linux/ctype.h>
+#include <linux/hash.h>
+#include <linux/err.h>
+#include <linux/kallsyms.h>
+#include <linux/random.h> /* random32(), prandom_u32() */
+#include <asm/atomic.h>
+
+#include "call_site_table.h"
+#include "config.h"
+
+#define print_error(str, ...) printk(KERN_ERR "%s: " str "\n", __func__, __VA_ARGS__)
+#define print_error0(str) print_error("%s", str)
+
+#define CALL_SITE_TABLE_BITS_MIN 4
+#define CALL_SITE_TABLE_BITS_MAX 16
+
+enum call_site_policy
+{
+	call_site_always,
+	call_site_nth,
+	call_site_prob,
+};
+
+struct call_site
+{
+	// Organization of the hash table
+	struct hlist_node hnode;
+	// List of the call sites in the order they were given
+	struct list_head list;
+
+	// The return address of the call
+	unsigned long addr;
+	// The call site as it was given
+	char* spec;
+
+	enum call_site_policy policy;
+	// N for 'nth' policy, P for 'prob' policy
+	unsigned int value;
+
+	// Nonzero if the number of faults is limited
+	int limited;
+	unsigned int count;
+	// The number of faults which may yet be simulated if limited
+	atomic_t budget;
+
+	atomic_t calls;
+	atomic_t faults;
+};
+
+struct call_site_table
+{
+	struct list_head sites;
+	unsigned int bits;
+	struct hlist_head heads[0];
+};
+
+static void
+call_site_free(struct call_site* site)
+{
+	kfree(site->spec);
+	kfree(site);
+}
+
+/*
+ * Return the next token from '*str' separated by spaces, NULL if there
+ * are no tokens left. The token is terminated in place.
+ */
+static char*
+next_token(char** str)
+{
+	char* token = *str;
+	char* end;
+
+	while(isspace(*token)) token++;
+	if(*token == '\0') return NULL;
+
+	for(end = token; *end != '\0' && !isspace(*end); end++);
+	if(*end != '\0')
+		*end++ = '\0';
+	*str = end;
+
+	return token;
+}
+
+/*
+ * Return the end of the token starting at 'str' (which may be preceded by
+ * spaces) without changing the string.
+ */
+static const char*
+token_end(const char* str, const char** start)
+{
+	while(isspace(*str)) str++;
+	*start = str;
+	while(*str != '\0' && !isspace(*str)) str++;
+	return str;
+}
+
+/*
+ * The line copied from 'last_fault' file looks like
+ *
+ *   <function> at [<<address>>] <symbol>+<offset>/<size> [<module>]
+ *
+ * Return the part of 'line' after "<function> at [<<address>>]" prefix or
+ * 'line' itself if there is no such prefix. The address is not used: it
+ * may be hashed or hidden depending on 'kptr_restrict'.
+ */
+static char*
+skip_fault_prefix(char* line)
+{
+	const char* start;
+	const char* end;
+
+	end = token_end(line, &start);
+	if(end == start) return line;
+
+	end = token_end(end, &start);
+	if(end - start != 2 || strncmp(start, "at", 2) != 0) return line;
+
+	end = token_end(end, &start);
+	if(end - start < 4 || strncmp(start, "[<", 2) != 0 ||
+		strncmp(end - 2, ">]", 2) != 0)
+		return line;
+
+	return (char*)end;
+}
+
+/*
+ * Return the name of the module if 'token' is "[<module>]", as %pS prints
+ * it after the symbol, NULL otherwise. The token is modified.
+ */
+static char*
+parse_module_token(char* token)
+{
+	size_t len = strlen(token);
+
+	if(len < 3 || token[0] != '[' || token[len - 1] != ']') return NULL;
+
+	token[len - 1] = '\0';
+	return token + 1;
+}
+
+/*
+ * Parse the value of the option in 'token', e.g. "nth=3". Return 1 if
+ * 'token' is the option 'name', 0 if it is not and -EINVAL if its value is
+ * not a valid number.
+ */
+static int
+parse_option(const char* token, const char* name, unsigned int* value)
+{
+	size_t len = strlen(name);
+
+	if(strncmp(token, name, len) != 0 || token[len] != '=') return 0;
+	if(kstrtouint(token + len + 1, 0, value))
+	{
+		print_error("Invalid value in '%s'.", token);
+		return -EINVAL;
+	}
+	return 1;
+}
+
+/*
+ * Resolve the call site given as the address or as
+ * '[<module>:]<symbol>[+<offset>[/<size>]]'. 'spec' is modified.
+ *
+ * 'module' is the name of the module given separately, as %pS prints it,
+ * NULL if not given.
+ */
+static int
+resolve_site(char* spec, const char* module, unsigned long* addr)
+{
+	char* offset_str;
+	char* name;
+	unsigned long offset = 0;
+	unsigned long symbol_addr;
+
+	if(isdigit(spec[0]))
+	{
+		if(module != NULL)
+		{
+			print_error("Module '%s' is given for address '%s'.",
+				module, spec);
+			return -EINVAL;
+		}
+		if(kstrtoul(spec, 0, addr))
+		{
+			print_error("Invalid address '%s'.", spec);
+			return -EINVAL;
+		}
+		return 0;
+	}
+
+	offset_str = strchr(spec, '+');
+	if(offset_str != NULL)
+	{
+		char* size_str = strchr(offset_str, '/');
+		// The size of the function, as %pS prints it, is not needed.
+		if(size_str != NULL) *size_str = '\0';
+
+		*offset_str++ = '\0';
+		if(kstrtoul(offset_str, 0, &offset))
+		{
+			print_error("Invalid offset '%s' for symbol '%s'.",
+				offset_str, spec);
+			return -EINVAL;
+		}
+	}
+
+	// kallsyms_lookup_name() accepts '<module>:<symbol>'.
+	if(module != NULL)
+	{
+		if(strchr(spec, ':') != NULL)
+		{
+			print_error("Module is given twice for symbol '%s'.", spec);
+			return -EINVAL;
+		}
+
+		name = kasprintf(GFP_KERNEL, "%s:%s", module, spec);
+		if(name == NULL)
+		{
+			print_error0("Cannot allocate name of the symbol.");
+			return -ENOMEM;
+		}
+	}
+	else
+	{
+		name = spec;
+	}
+
+	symbol_addr = kallsyms_lookup_name(name);
+	if(symbol_addr == 0)
+		print_error("Cannot find symbol '%s'.", name);
+	if(name != spec) kfree(name);
+
+	if(symbol_addr == 0) return -ENOENT;
+
+	*addr = symbol_addr + offset;
+	return 0;
+}
+
+/*
+ * Parse the line describing the call site. Return the call site created,
+ * NULL if the line is empty or a comment, ERR_PTR() on error.
+ */
+static struct call_site*
+parse_site(char* line)
+{
+	struct call_site* site;
+	const char* start;
+	char* token;
+	char* site_token;
+	char* module = NULL;
+	int policy_set = 0;
+	int error;
+
+	token_end(line, &start);
+	if(*start == '\0' || *start == '#') return NULL;
+
+	line = skip_fault_prefix(line);
+	site_token = next_token(&line);
+	if(site_token == NULL)
+	{
+		print_error0("No call site after the function name.");
+		return ERR_PTR(-EINVAL);
+	}
+
+	token = next_token(&line);
+	if(token != NULL)
+	{
+		module = parse_module_token(token);
+		if(module != NULL) token = next_token(&line);
+	}
+
+	site = kzalloc(sizeof(*site), GFP_KERNEL);
+	if(site == NULL)
+	{
+		print_error0("Cannot allocate call site.");
+		return ERR_PTR(-ENOMEM);
+	}
+
+	// The call site is shown as '[<module>:]<symbol>...'.
+	if(module != NULL)
+		site->spec = kasprintf(GFP_KERNEL, "%s:%s", module, site_token);
+	else
+		site->spec = kstrdup(site_token, GFP_KERNEL);
+	if(site->spec == NULL)
+	{
+		print_error0("Cannot allocate call site.");
+		error = -ENOMEM;
+		goto err;
+	}
+
+	error = resolve_site(site_token, module, &site->addr);
+	if(error) goto err;
+
+	site->policy = call_site_always;
+	for(; token != NULL; token = next_token(&line))
+	{
+		int is_policy = 1;
+		int found;
+
+		if(strcmp(token, "always") == 0)
+		{
+			site->policy = call_site_always;
+			found = 1;
+		}
+		else if((found = parse_option(token, "nth", &site->value)) != 0)
+		{
+			site->policy = call_site_nth;
+			if(found > 0 && site->value == 0) found = -EINVAL;
+		}
+		else if((found = parse_option(token, "prob", &site->value)) != 0)
+		{
+			site->policy = call_site_prob;
+			if(found > 0 && site->value > 100) found = -EINVAL;
+		}
+		else if((found = parse_option(token, "count", &site->count)) != 0)
+		{
+			if(site->limited) found = -EINVAL;
+			site->limited = 1;
+			is_policy = 0;
+		}
+
+		if(found == 0)
+		{
+			print_error("Unknown policy '%s' for call site '%s'.",
+				token, site->spec);
+			error = -EINVAL;
+			goto err;
+		}
+		if(found < 0 || (is_policy && policy_set))
+		{
+			print_error("Invalid policy for call site '%s'.", site->spec);
+			error = -EINVAL;
+			goto err;
+		}
+		if(is_policy) policy_set = 1;
+	}
+
+	atomic_set(&site->budget, site->count);
+	atomic_set(&site->calls, 0);
+	atomic_set(&site->faults, 0);
+
+	return site;
+
+err:
+	call_site_free(site);
+	return ERR_PTR(error);
+}
+
+static struct call_site*
+call_site_table_lookup(struct call_site_table* table, unsigned long addr)
+{
+	struct call_site* site;
+	struct hlist_head* head = &table->heads[hash_long(addr, table->bits)];
+
+	kedr_hlist_for_each_entry(site, head, hnode)
+	{
+		if(site->addr == addr) return site;
+	}
+	return NULL;
+}
+
+struct call_site_table*
+call_site_table_create(const char* str)
+{
+	LIST_HEAD(sites);
+	struct call_site_table* table;
+	struct call_site* site;
+	struct call_site* tmp;
+	unsigned int n_sites = 0;
+	unsigned int bits = CALL_SITE_TABLE_BITS_MIN;
+	unsigned int i;
+	char* buf;
+	char* str_rest;
+	char* line;
+	int error = 0;
+
+	buf = kstrdup(str, GFP_KERNEL);
+	if(buf == NULL)
+	{
+		print_error0("Cannot allocate buffer for call sites.");
+		return ERR_PTR(-ENOMEM);
+	}
+
+	str_rest = buf;
+	while((line = strsep(&str_rest, "\n;")) != NULL)
+	{
+		site = parse_site(line);
+		if(site == NULL) continue;
+		if(IS_ERR(site))
+		{
+			error = PTR_ERR(site);
+			goto out;
+		}
+		list_add_tail(&site->list, &sites);
+		n_sites++;
+	}
+
+	if(n_sites == 0)
+	{
+		table = NULL;
+		goto out;
+	}
+
+	// Keep the chains short: at least two buckets per call site.
+	while(bits < CALL_SITE_TABLE_BITS_MAX && (1U << bits) < 2 * n_sites)
+		bits++;
+
+	table = kzalloc(sizeof(*table) + sizeof(table->heads[0]) * (1U << bits),
+		GFP_KERNEL);
+	if(table == NULL)
+	{
+		print_error0("Cannot allocate table of call sites.");
+		error = -ENOMEM;
+		goto out;
+	}
+	INIT_LIST_HEAD(&table->sites);
+	table->bits = bits;
+	for(i = 0; i < (1U << bits); i++)
+		INIT_HLIST_HEAD(&table->heads[i]);
+
+	list_for_each_entry_safe(site, tmp, &sites, list)
+	{
+		if(call_site_table_lookup(table, site->addr) != NULL)
+		{
+			print_error("Call site '%s' is listed twice.", site->spec);
+			error = -EINVAL;
+			break;
+		}
+		list_move_tail(&site->list, &table->sites);
+		hlist_add_head(&site->hnode,
+			&table->heads[hash_long(site->addr, bits)]);
+	}
+
+	if(error) call_site_table_destroy(table);
+
+out:
+	list_for_each_entry_safe(site, tmp, &sites, list)
+	{
+		list_del(&site->list);
+		call_site_free(site);
+	}
+	kfree(buf);
+
+	return error ? ERR_PTR(error) : table;
+}
+
+void
+call_site_table_destroy(struct call_site_table* table)
+{
+	struct call_site* site;
+	struct call_site* tmp;
+
+	if(table == NULL) return;
+
+	list_for_each_entry_safe(site, tmp, &table->sites, list)
+	{
+		list_del(&site->list);
+		call_site_free(site);
+	}
+	kfree(table);
+}
+
+int
+call_site_table_simulate(struct call_site_table* table,
+	unsigned long caller_address)
+{
+	struct call_site* site = call_site_table_lookup(table, caller_address);
+	unsigned int calls;
+
+	if(site == NULL) return 0;
+
+	calls = (unsigned int)atomic_inc_return(&site->calls);
+	switch(site->policy)
+	{
+	case call_site_always:
+		break;
+	case call_site_nth:
+		if(calls != site->value) return 0;
+		break;
+	case call_site_prob:
+		if(kedr_random32() % 100 >= site->value) return 0;
+		break;
+	}
+
+	if(site->limited && !atomic_add_unless(&site->budget, -1, 0))
+		return 0;
+
+	atomic_inc(&site->faults);
+	return 1;
+}
+
+/*
+ * Print the description of the call site to 'buf' like snprintf() does.
+ */
+static int
+call_site_print(const struct call_site* site, char* buf, size_t size)
+{
+	// Enough for "prob=4294967295" and " count=4294967295"
+	char policy[32];
+	char count[32] = "";
+
+	switch(site->policy)
+	{
+	case call_site_nth:
+		snprintf(policy, sizeof(policy), "nth=%u", site->value);
+		break;
+	case call_site_prob:
+		snprintf(policy, sizeof(policy), "prob=%u", site->value);
+		break;
+	default:
+		strcpy(policy, "always");
+		break;
+	}
+
+	if(site->limited)
+		snprintf(count, sizeof(count), " count=%u", site->count);
+
+	return snprintf(buf, size, "%s [<%p>] %s%s calls: %u, faults: %u\n",
+		site->spec, (void*)site->addr, policy, count,
+		(unsigned int)atomic_read(&site->calls),
+		(unsigned int)atomic_read(&site->faults));
+}
+
+char*
+call_site_table_print(struct call_site_table* table)
+{
+	struct call_site* site;
+	size_t size = 0;
+	size_t len = 0;
+	char* str;
+
+	if(table == NULL) return kstrdup("", GFP_KERNEL);
+
+	/*
+	 * The counters may change between the passes, so the size of the
+	 * numbers is reserved in advance.
+	 */
+	list_for_each_entry(site, &table->sites, list)
+		size += call_site_print(site, NULL, 0) + 2 * 10;
+
+	str = kmalloc(size + 1, GFP_KERNEL);
+	if(str == NULL)
+	{
+		print_error0("Cannot allocate string for call sites.");
+		return NULL;
+	}
+	str[0] = '\0';
+
+	list_for_each_entry(site, &table->sites, list)
+	{
+		size_t site_len = call_site_print(site, str + len, size + 1 - len);
+		if(len + site_len > size) break;
+		len += site_len;
+	}
+	str[len] = '\0';
+
+	return str;
+}
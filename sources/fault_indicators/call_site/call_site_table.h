@@ -0,0 +1,79 @@
+#ifndef CALL_SITE_TABLE_H_1044_INCLUDED
+#define CALL_SITE_TABLE_H_1044_INCLUDED
+
+/*
+ * Table of the call sites the faults should be simulated at.
+ *
+ * Each call site is identified by the return address of the call, i.e.
+ * by the value of 'caller_address' passed to the indicator, and has its
+ * own policy of fault simulation and its own counters.
+ *
+ * The table is a hash keyed by the return address, so the cost of the
+ * lookup does not depend on the number of the call sites in it.
+ *
+ * The table is never changed after it is created except for the
+ * counters. To change the set of call sites, a new table should be created
+ * and published instead of the old one. So the table may be looked up
+ * under rcu_read_lock() while it is being replaced.
+ */
+
+struct call_site_table;
+
+/*
+ * Create the table from the string describing the call sites.
+ *
+ * The string consists of the lines separated by '\n' or ';', one line per
+ * call site. Empty lines and lines starting with '#' are ignored. Each line
+ * has the following format:
+ *
+ *   <site> [always | nth=<N> | prob=<P>] [count=<N>]
+ *
+ * <site> is one of the following:
+ * - the address of the call site (decimal or hexadecimal with '0x'
+ *   prefix);
+ * - '[<module>:]<symbol>[+<offset>[/<size>]]';
+ * - '<symbol>[+<offset>[/<size>]] [<module>]', the form in which %pS
+ *   prints the addresses.
+ *
+ * The line of 'last_fault' file may be used as is, i.e. <site> may be
+ * preceded by '<function> at [<<address>>]'. The symbol is resolved when
+ * the table is created, so the module containing it should be loaded by
+ * that time.
+ *
+ * The policy is:
+ * - 'always' - each call at the site fails (default);
+ * - 'nth=<N>' - only the <N>-th call at the site fails, N >= 1;
+ * - 'prob=<P>' - a call at the site fails with probability <P> percent.
+ *
+ * 'count=<N>' limits the number of faults simulated at the site.
+ *
+ * Return the table created, NULL if the string contains no call sites or
+ * ERR_PTR() on error.
+ */
+struct call_site_table*
+call_site_table_create(const char* str);
+
+void
+call_site_table_destroy(struct call_site_table* table);
+
+/*
+ * Return nonzero if the fault should be simulated for the call with return
+ * address 'caller_address' and update the counters for the call site.
+ *
+ * May be called in atomic context.
+ */
+int
+call_site_table_simulate(struct call_site_table* table,
+	unsigned long caller_address);
+
+/*
+ * Return the string describing the call sites in the table and their
+ * counters, one line per call site. The string should be freed by the
+ * caller with kfree().
+ *
+ * 'table' may be NULL, an empty string is returned then.
+ */
+char*
+call_site_table_print(struct call_site_table* table);
+
+#endif /* CALL_SITE_TABLE_H_1044_INCLUDED */
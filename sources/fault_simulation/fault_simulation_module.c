@@ -28,7 +28,16 @@
 
 #include <linux/string.h> /* memcpy */
 
+#include <linux/hash.h> /* hash_long() */
+#include <linux/err.h> /* ERR_PTR() */
+#include <linux/version.h>
+
 #include <kedr/control_file/control_file.h>
+#include <kedr/core/kedr_overhead.h>
+#include <kedr/util/read_once.h>
+
+#include "fsim_campaign.h"
+#include "config.h"
 	
 MODULE_AUTHOR("Tsyvarev");
 MODULE_LICENSE("GPL");
@@ -41,6 +50,16 @@ MODULE_LICENSE("GPL");
 
 struct indicator_instance;
 
+/*
+ * Control directory of the point and the files in it.
+ */
+struct point_files
+{
+	struct dentry* control_dir;
+	struct dentry* format_string_file;
+	struct dentry* indicator_file;
+};
+
 /*
  * Structure described simulation point
  */
@@ -51,19 +70,20 @@ struct kedr_simulation_point
 	struct indicator_instance* current_instance;
 	// List organization for point.
 	struct list_head list;
+	// Organization of the points hash table(by name).
+	struct hlist_node hnode;
 	const char* name;
 	const char* format_string;
-	// Control directory for the point
-	struct dentry* control_dir;
-	// .. and files in it
-	struct dentry* format_string_file;
-	struct dentry* indicator_file;
+	// Control directory for the point and files in it
+	struct point_files files;
 };
 
 struct kedr_simulation_indicator
 {
 	// List organization of indicators
 	struct list_head list;
+	// Organization of the indicators hash table(by name).
+	struct hlist_node hnode;
 	// Indicators's data
 	const char* name;
 	const char* format_string;
@@ -110,11 +130,20 @@ u8 verbose = 2;
 static LIST_HEAD(points);
 //List of indicators
 static LIST_HEAD(indicators);
+
+/* 
+ * Hash tables of points and indicators by name, so that reconfiguring
+ * many points does not require scanning the lists for each one.
+ */
+#define FSIM_HASH_BITS 6
+#define FSIM_HASH_SIZE (1 << FSIM_HASH_BITS)
+static struct hlist_head points_hash[FSIM_HASH_SIZE];
+static struct hlist_head indicators_hash[FSIM_HASH_SIZE];
 /*
  *  Mutex protecting from concurrent access:
  * 
- * -list of points
- * -list of indicators
+ * -list and hash table of points
+ * -list and hash table of indicators
  * -indicator instance for the point(only writes, r/w is protected by rcu)
  */
 static DEFINE_MUTEX(fsim_mutex);
@@ -127,6 +156,8 @@ static struct dentry* indicators_root_directory;
 static struct dentry* last_fault_file;
 // File for access 'verbose' property.
 static struct dentry* verbose_file;
+// File for setting indicators for many points at once.
+static struct dentry* batch_file;
 
 static char kedr_fsim_fault_message_buf[KEDR_FSIM_FAULT_MESSAGE_LEN + 1] = "none";
 static DEFINE_SPINLOCK(kedr_fsim_fault_message_lock);
@@ -149,6 +180,11 @@ static struct kedr_simulation_point* lookup_point(const char* name);
 
 static struct kedr_simulation_indicator* lookup_indicator(const char* name);
 
+/*
+ * Index of the name in the hash tables of points and indicators.
+ */
+static unsigned long name_hash(const char* name);
+
 /*
  * Destroy instance of indicator.
  * 
@@ -190,12 +226,29 @@ static void kedr_fsim_point_clear_indicator_internal(
 	struct kedr_simulation_point* point);
 
 /*
- * Create directories and files for new point.
+ * Set indicators for the points according to the batch description
+ * (see batch_file_set_str()).
  *
  * Should be executed with mutex locked.
  */
-static int create_point_files(struct kedr_simulation_point* point);
-static void delete_point_files(struct kedr_simulation_point* point);
+static int kedr_fsim_set_indicators_internal(char* batch);
+
+/*
+ * Create control directory with name 'dir_name' and files in it for
+ * the point.
+ *
+ * Should be executed with mutex locked.
+ */
+static int create_point_files(struct kedr_simulation_point* point,
+	const char* dir_name, struct point_files* files);
+static void delete_point_files(struct point_files* files);
+
+/*
+ * Rename control directory of the point.
+ *
+ * Should be executed with mutex locked.
+ */
+static int rename_point_dir(struct dentry* control_dir, const char* name);
 
 /*
  * Create directory for indicator
@@ -233,7 +286,7 @@ kedr_fsim_point_register(const char* point_name,
 	point->format_string = format_string ? format_string : "";
 	point->current_instance = NULL;
 	
-	if(create_point_files(point))
+	if(create_point_files(point, point->name, &point->files))
 	{
 		kfree(point);
 		point = NULL;
@@ -241,6 +294,7 @@ kedr_fsim_point_register(const char* point_name,
 	}
 
 	list_add(&point->list, &points);
+	hlist_add_head(&point->hnode, &points_hash[name_hash(point_name)]);
 
 	mutex_unlock(&fsim_mutex);
 
@@ -259,7 +313,8 @@ void kedr_fsim_point_unregister(struct kedr_simulation_point* point)
 	kedr_fsim_point_clear_indicator_internal(point);
 
 	list_del(&point->list);
-	delete_point_files(point);
+	hlist_del(&point->hnode);
+	delete_point_files(&point->files);
 	kfree(point);
 
 	mutex_unlock(&fsim_mutex);
@@ -299,6 +354,7 @@ kedr_fsim_indicator_register(const char* indicator_name,
 	indicator->destroy_instance = destroy_instance;
 	INIT_LIST_HEAD(&indicator->instances);
 	INIT_LIST_HEAD(&indicator->list);
+	INIT_HLIST_NODE(&indicator->hnode);
 	
 	if(create_indicator_files(indicator))
 	{
@@ -308,6 +364,8 @@ kedr_fsim_indicator_register(const char* indicator_name,
 	}
 
 	list_add(&indicator->list, &indicators);
+	hlist_add_head(&indicator->hnode,
+		&indicators_hash[name_hash(indicator_name)]);
 
 out:
 	mutex_unlock(&fsim_mutex);
@@ -342,6 +400,7 @@ void kedr_fsim_indicator_unregister(struct kedr_simulation_indicator* indicator)
 	}
 
 	list_del(&indicator->list);
+	hlist_del(&indicator->hnode);
 	delete_indicator_files(indicator);
 	kfree(indicator);
 
@@ -412,6 +471,7 @@ int kedr_fsim_point_simulate(struct kedr_simulation_point* point,
 {
 	int result;
 	struct indicator_instance* current_instance;
+	u64 overhead_start = kedr_overhead_begin();
 
 	rcu_read_lock();
 	
@@ -424,6 +484,17 @@ int kedr_fsim_point_simulate(struct kedr_simulation_point* point,
 
 	rcu_read_unlock();
 
+	/* 
+	 * In a campaign, the indicator only selects the candidates for 
+	 * the fault simulation. 
+	 */
+	if(result && READ_ONCE(fsim_campaign_running)
+		&& !fsim_campaign_simulate(point->name,
+			(unsigned long)__builtin_return_address(0)))
+	{
+		result = 0;
+	}
+
     if(result)
     {
         if(verbose >= 1)
@@ -436,6 +507,9 @@ int kedr_fsim_point_simulate(struct kedr_simulation_point* point,
         }
     }
 
+	kedr_overhead_end(KEDR_OVERHEAD_FSIM_SIMULATE,
+		__builtin_return_address(0), overhead_start);
+
 	return result;
 }
 EXPORT_SYMBOL(kedr_fsim_point_simulate);
@@ -459,6 +533,17 @@ int kedr_fsim_fault_message(const char* fmt, ...)
 EXPORT_SYMBOL(kedr_fsim_fault_message);
 ///////////////////Implementation of auxiliary functions/////////////////////
 
+static unsigned long
+name_hash(const char* name)
+{
+	unsigned long hash = 5381;
+	
+	while(*name)
+		hash = hash * 33 + (unsigned char)*name++;
+	
+	return hash_long(hash, FSIM_HASH_BITS);
+}
+
 /*
  * Return simulation point with given name or NULL.
  *
@@ -469,7 +554,7 @@ static struct kedr_simulation_point *
 lookup_point(const char* name)
 {
 	struct kedr_simulation_point* point;
-	list_for_each_entry(point, &points, list)
+	kedr_hlist_for_each_entry(point, &points_hash[name_hash(name)], hnode)
 	{
 		if(strcmp(point->name, name) == 0) return point;
 	}
@@ -484,13 +569,11 @@ static struct kedr_simulation_indicator *
 lookup_indicator(const char* name)
 {
 	struct kedr_simulation_indicator* indicator;
-	list_for_each_entry(indicator, &indicators, list)
+	kedr_hlist_for_each_entry(indicator, &indicators_hash[name_hash(name)], hnode)
 	{
 		if(strcmp(indicator->name, name) == 0) return indicator;
 	}
 	return NULL;
-
-
 }
 
 static void 
@@ -527,18 +610,23 @@ is_data_format_compatible(const char* point_format_string,
 		strlen(indicator_format_string)) == 0;
 }
 
-static int 
-kedr_fsim_point_set_indicator_internal(struct kedr_simulation_point* point,
-	const char* indicator_name, const char* params)
+/*
+ * Look up indicator with given name and check that it may be set
+ * for the point.
+ * 
+ * Return indicator on success, ERR_PTR() on fail.
+ */
+static struct kedr_simulation_indicator*
+lookup_indicator_for_point(struct kedr_simulation_point* point,
+	const char* indicator_name)
 {
-	struct indicator_instance *instance;
 	struct kedr_simulation_indicator* indicator;
 	
 	indicator = lookup_indicator(indicator_name);
 	if(indicator == NULL)
 	{
 		print_error("Indicator with name '%s' does not exist.", indicator_name);
-		return -ENODEV;
+		return ERR_PTR(-ENODEV);
 	}
 
 	if(!is_data_format_compatible(point->format_string, indicator->format_string))
@@ -547,27 +635,32 @@ kedr_fsim_point_set_indicator_internal(struct kedr_simulation_point* point,
 			"which is not compatible with format '%s' used by the point with name '%s'.",
 			indicator_name, indicator->format_string,
 			point->format_string, point->name);
-		return -EINVAL;
+		return ERR_PTR(-EINVAL);
 	}
 	
-	instance = kmalloc(sizeof(*instance), GFP_KERNEL);
-	if(instance == NULL)
-	{
-		print_error0("Cannot allocate memory for instance of indicator.");
-		return -ENOMEM;
-	}
-
-	kedr_fsim_point_clear_indicator_internal(point);
+	return indicator;
+}
 
+/*
+ * Create instance of the indicator for the point. Control files of the
+ * instance are created in 'control_dir'.
+ * 
+ * Instance is not set for the point.
+ */
+static int
+indicator_instance_create(struct kedr_simulation_point* point,
+	struct kedr_simulation_indicator* indicator, const char* params,
+	struct dentry* control_dir, struct indicator_instance* instance)
+{
 	instance->indicator_state = NULL;
 	if(indicator->create_instance)
 	{
 		int result = indicator->create_instance(
-			&instance->indicator_state, params, point->control_dir);
+			&instance->indicator_state, params, control_dir);
 		if(result)
 		{
-			print_error("Failed to create instance of the indicator '%s'.", indicator_name);
-			kfree(instance);
+			print_error("Failed to create instance of the indicator '%s'.",
+				indicator->name);
 			return result;
 		}
 	}
@@ -576,7 +669,39 @@ kedr_fsim_point_set_indicator_internal(struct kedr_simulation_point* point,
 	list_add_tail(&instance->list, &indicator->instances);
 
 	instance->current_point = point;
-	point->current_instance = instance;
+	
+	return 0;
+}
+
+static int 
+kedr_fsim_point_set_indicator_internal(struct kedr_simulation_point* point,
+	const char* indicator_name, const char* params)
+{
+	struct indicator_instance *instance;
+	struct kedr_simulation_indicator* indicator;
+	int result;
+	
+	indicator = lookup_indicator_for_point(point, indicator_name);
+	if(IS_ERR(indicator)) return PTR_ERR(indicator);
+	
+	instance = kmalloc(sizeof(*instance), GFP_KERNEL);
+	if(instance == NULL)
+	{
+		print_error0("Cannot allocate memory for instance of indicator.");
+		return -ENOMEM;
+	}
+
+	kedr_fsim_point_clear_indicator_internal(point);
+
+	result = indicator_instance_create(point, indicator, params,
+		point->files.control_dir, instance);
+	if(result)
+	{
+		kfree(instance);
+		return result;
+	}
+	
+	rcu_assign_pointer(point->current_instance, instance);
 	
 	return 0;
 }
@@ -593,6 +718,366 @@ kedr_fsim_point_clear_indicator_internal(
 	synchronize_rcu();
 	indicator_instance_destroy(instance);
 }
+
+/* One line of the batch: new indicator for the point. */
+struct fsim_batch_entry
+{
+	struct kedr_simulation_point* point;
+	// New indicator for the point. NULL if indicator should be cleared.
+	struct kedr_simulation_indicator* indicator;
+	const char* params;
+	// Instance which was set for the point before the batch, if any.
+	struct indicator_instance* old_instance;
+	// Instance for the new indicator, preallocated.
+	struct indicator_instance* new_instance;
+	/*
+	 * Control directory and files of the point for the new instance.
+	 * 
+	 * The files of the old instance may have the same names as ones of
+	 * the new instance, so the new instance is created in the separate
+	 * directory. This directory takes the name of the current control
+	 * directory of the point before the batch is committed, see
+	 * fsim_batch_swap_dirs().
+	 */
+	struct point_files new_files;
+	// Whether 'new_instance' and 'new_files' are created.
+	int is_prepared;
+};
+
+/*
+ * Parse line of the batch and fill 'entry' with it.
+ * 
+ * Line is modified during parsing.
+ */
+static int fsim_batch_parse_line(char* line, struct fsim_batch_entry* entry)
+{
+	char* point_name;
+	char* indicator_name;
+	char* params;
+	char* eq = strchr(line, '=');
+	
+	if(eq == NULL)
+	{
+		print_error("Expected '<point>=<indicator>[(<params>)]', got '%s'.", line);
+		return -EINVAL;
+	}
+	*eq = '\0';
+	point_name = strim(line);
+	indicator_name = eq + 1;
+	
+	params = strchr(indicator_name, '(');
+	if(params)
+	{
+		char* params_end;
+		
+		*params++ = '\0';
+		params_end = strrchr(params, ')');
+		if((params_end == NULL) || (*strim(params_end + 1) != '\0'))
+		{
+			print_error("Unterminated parameters of the indicator for the point '%s'.",
+				point_name);
+			return -EINVAL;
+		}
+		*params_end = '\0';
+		params = strim(params);
+	}
+	else
+	{
+		params = "";
+	}
+	indicator_name = strim(indicator_name);
+	
+	entry->point = lookup_point(point_name);
+	if(entry->point == NULL)
+	{
+		print_error("Point with name '%s' does not exist.", point_name);
+		return -ENOENT;
+	}
+	
+	if(strcmp(indicator_name, indicator_name_not_set) == 0)
+	{
+		entry->indicator = NULL;
+	}
+	else
+	{
+		entry->indicator = lookup_indicator_for_point(entry->point,
+			indicator_name);
+		if(IS_ERR(entry->indicator)) return PTR_ERR(entry->indicator);
+	}
+	entry->params = params;
+	
+	return 0;
+}
+
+/*
+ * Destroy new instances and their control directories created for the
+ * first 'n' entries of the batch. The points are not affected.
+ */
+static void fsim_batch_abort(struct fsim_batch_entry* entries, int n)
+{
+	int i;
+	
+	for(i = 0; i < n; i++)
+	{
+		if(!entries[i].is_prepared) continue;
+		
+		indicator_instance_destroy(entries[i].new_instance);
+		entries[i].new_instance = NULL;
+		delete_point_files(&entries[i].new_files);
+		entries[i].is_prepared = 0;
+	}
+}
+
+/*
+ * Create new instances of the indicators for the points of the batch.
+ * 
+ * On error, everything created is destroyed, and the points are not
+ * affected.
+ */
+static int fsim_batch_prepare(struct fsim_batch_entry* entries, int n)
+{
+	int i;
+	int result;
+	// Temporary name of the control directory for the new instance.
+	char dir_name[32];
+	
+	for(i = 0; i < n; i++)
+	{
+		struct fsim_batch_entry* entry = &entries[i];
+		
+		if(!entry->indicator) continue;
+		
+		snprintf(dir_name, sizeof(dir_name), ".batch.%d", i);
+		result = create_point_files(entry->point, dir_name,
+			&entry->new_files);
+		if(result) goto fail;
+		
+		result = indicator_instance_create(entry->point,
+			entry->indicator, entry->params,
+			entry->new_files.control_dir, entry->new_instance);
+		if(result)
+		{
+			delete_point_files(&entry->new_files);
+			goto fail;
+		}
+		entry->is_prepared = 1;
+	}
+	
+	return 0;
+
+fail:
+	fsim_batch_abort(entries, i);
+	return result;
+}
+
+/*
+ * Give the control directory of the point 'points/.old.<i>' name and
+ * give the one prepared for the new instance the name of the point.
+ * 
+ * On error, the names are not changed.
+ */
+static int fsim_batch_swap_dirs_one(struct fsim_batch_entry* entry, int i)
+{
+	int result;
+	char dir_name[32];
+	
+	snprintf(dir_name, sizeof(dir_name), ".old.%d", i);
+	result = rename_point_dir(entry->point->files.control_dir, dir_name);
+	if(result) return result;
+	
+	result = rename_point_dir(entry->new_files.control_dir,
+		entry->point->name);
+	if(result)
+	{
+		if(rename_point_dir(entry->point->files.control_dir,
+			entry->point->name))
+		{
+			print_error("Cannot restore name of the control directory of the point '%s', "
+				"it remains in 'points/%s'.",
+				entry->point->name, dir_name);
+		}
+		return result;
+	}
+	
+	return 0;
+}
+
+/* Revert fsim_batch_swap_dirs_one(). */
+static void fsim_batch_unswap_dirs_one(struct fsim_batch_entry* entry, int i)
+{
+	char dir_name[32];
+	
+	snprintf(dir_name, sizeof(dir_name), ".batch.%d", i);
+	if(rename_point_dir(entry->new_files.control_dir, dir_name)
+		|| rename_point_dir(entry->point->files.control_dir,
+			entry->point->name))
+	{
+		print_error("Cannot restore name of the control directory of the point '%s'.",
+			entry->point->name);
+	}
+}
+
+/*
+ * Swap names of the current control directories of the points and of
+ * the ones prepared for the new instances.
+ * 
+ * The old directories are renamed aside rather than removed, so a point
+ * is absent from 'points' only between two renames, and the renames may
+ * be reverted if some of them fails. On error, the names are not changed.
+ */
+static int fsim_batch_swap_dirs(struct fsim_batch_entry* entries, int n)
+{
+	int i;
+	int result;
+	
+	for(i = 0; i < n; i++)
+	{
+		if(!entries[i].is_prepared) continue;
+		
+		result = fsim_batch_swap_dirs_one(&entries[i], i);
+		if(result)
+		{
+			print_error("Cannot rename control directory of the point '%s'.",
+				entries[i].point->name);
+			goto fail;
+		}
+	}
+	
+	return 0;
+
+fail:
+	while(--i >= 0)
+	{
+		if(entries[i].is_prepared)
+			fsim_batch_unswap_dirs_one(&entries[i], i);
+	}
+	return result;
+}
+
+/*
+ * Set new instances for all points of the batch, and destroy the old
+ * instances after a single grace period.
+ * 
+ * Should be called after fsim_batch_swap_dirs(). Cannot fail.
+ */
+static void fsim_batch_commit(struct fsim_batch_entry* entries, int n)
+{
+	int i;
+	int need_sync = 0;
+	
+	for(i = 0; i < n; i++)
+	{
+		struct kedr_simulation_point* point = entries[i].point;
+		
+		entries[i].old_instance = point->current_instance;
+		if(entries[i].old_instance) need_sync = 1;
+		
+		rcu_assign_pointer(point->current_instance,
+			entries[i].is_prepared ? entries[i].new_instance : NULL);
+	}
+	
+	/*
+	 * Instances cannot be freed via call_rcu(): destroy_instance()
+	 * callbacks may sleep(e.g., removing files in debugfs).
+	 */
+	if(need_sync) synchronize_rcu();
+	
+	for(i = 0; i < n; i++)
+	{
+		struct fsim_batch_entry* entry = &entries[i];
+		struct point_files old_files;
+		
+		if(entry->old_instance)
+			indicator_instance_destroy(entry->old_instance);
+		
+		if(!entry->is_prepared) continue;
+		entry->new_instance = NULL; // Owned by the point now.
+		
+		/* The old control directory has been renamed aside. */
+		old_files = entry->point->files;
+		entry->point->files = entry->new_files;
+		delete_point_files(&old_files);
+	}
+}
+
+static int kedr_fsim_set_indicators_internal(char* batch)
+{
+	struct fsim_batch_entry* entries;
+	int n_lines = 1;
+	int n = 0;
+	int i;
+	int result = 0;
+	char* line;
+	char* p;
+	
+	for(p = batch; *p; p++)
+		if(*p == '\n') n_lines++;
+	
+	entries = kcalloc(n_lines, sizeof(*entries), GFP_KERNEL);
+	if(entries == NULL)
+	{
+		print_error0("Cannot allocate batch of indicators.");
+		return -ENOMEM;
+	}
+	
+	/* Parse and verify everything before changing anything. */
+	while((line = strsep(&batch, "\n")) != NULL)
+	{
+		line = strim(line);
+		if((*line == '\0') || (*line == '#')) continue;
+		
+		result = fsim_batch_parse_line(line, &entries[n]);
+		if(result) goto out;
+		
+		for(i = 0; i < n; i++)
+		{
+			if(entries[i].point == entries[n].point)
+			{
+				print_error("Point '%s' is set twice in the batch.",
+					entries[n].point->name);
+				result = -EINVAL;
+				goto out;
+			}
+		}
+		
+		if(entries[n].indicator)
+		{
+			entries[n].new_instance = kmalloc(sizeof(struct indicator_instance),
+				GFP_KERNEL);
+			if(entries[n].new_instance == NULL)
+			{
+				print_error0("Cannot allocate memory for instance of indicator.");
+				result = -ENOMEM;
+				goto out;
+			}
+		}
+		n++;
+	}
+	
+	/*
+	 * Create all new instances while the old ones are still in use,
+	 * then switch the points to them at once.
+	 */
+	result = fsim_batch_prepare(entries, n);
+	if(result) goto out;
+	
+	result = fsim_batch_swap_dirs(entries, n);
+	if(result)
+	{
+		fsim_batch_abort(entries, n);
+		goto out;
+	}
+	
+	fsim_batch_commit(entries, n);
+
+out:
+	for(i = 0; i < n_lines; i++)
+		kfree(entries[i].new_instance);
+	kfree(entries);
+	
+	return result;
+}
+
 ///////////////////////////Files operations///////////////////////
 static char* point_indicator_file_get_str(struct inode* inode);
 static int point_indicator_file_set_str(const char* str, struct inode* inode);
@@ -612,32 +1097,38 @@ static int last_fault_file_set_str(const char* str, struct inode* inode);
 CONTROL_FILE_OPS(last_fault_file_operations,
 	last_fault_file_get_str, last_fault_file_set_str);
 
+static int batch_file_set_str(const char* str, struct inode* inode);
+
+CONTROL_FILE_OPS(batch_file_operations,
+	NULL, batch_file_set_str);
+
 
 static int
-create_point_files(struct kedr_simulation_point* point)
+create_point_files(struct kedr_simulation_point* point,
+	const char* dir_name, struct point_files* files)
 {
-	point->control_dir = debugfs_create_dir(point->name, points_root_directory);
-	if(point->control_dir == NULL)
+	files->control_dir = debugfs_create_dir(dir_name, points_root_directory);
+	if(files->control_dir == NULL)
 	{
 		print_error0("Cannot create control directory for the point.");
 		goto err_control_dir;
 	}
 
-	point->indicator_file = debugfs_create_file("current_indicator",
+	files->indicator_file = debugfs_create_file("current_indicator",
 		S_IRUGO | S_IWUSR | S_IWGRP,
-		point->control_dir,
+		files->control_dir,
 		point, &point_indicator_file_operations);
-	if(point->indicator_file == NULL)
+	if(files->indicator_file == NULL)
 	{
 		print_error0("Cannot create indicator file for the fault simulation point.");
 		goto err_indicator_file;
 	}
 
-	point->format_string_file = debugfs_create_file("format_string", 
+	files->format_string_file = debugfs_create_file("format_string",
 		S_IRUGO,
-		point->control_dir,
+		files->control_dir,
 		point, &point_format_string_file_operations);
-	if(point->format_string_file == NULL)
+	if(files->format_string_file == NULL)
 	{
 		print_error0("Cannot create format string file for the point.");
 		goto err_format_string_file;
@@ -646,28 +1137,42 @@ create_point_files(struct kedr_simulation_point* point)
 	return 0;
 
 err_format_string_file:
-	debugfs_remove(point->indicator_file);
+	debugfs_remove(files->indicator_file);
 err_indicator_file:
-	debugfs_remove(point->control_dir);
+	debugfs_remove(files->control_dir);
 err_control_dir:
 
 	return -EINVAL;
 }
 
 static void
-delete_point_files(struct kedr_simulation_point* point)
+delete_point_files(struct point_files* files)
 {
 	//mark opened instances of file as invalide
-	point->format_string_file->d_inode->i_private = NULL;
-	
-	debugfs_remove(point->format_string_file);
+	files->format_string_file->d_inode->i_private = NULL;
+
+	debugfs_remove(files->format_string_file);
 
 	//mark opened instances of indicator file as invalid
-	point->indicator_file->d_inode->i_private = NULL;
-   
-	debugfs_remove(point->indicator_file);
+	files->indicator_file->d_inode->i_private = NULL;
+
+	debugfs_remove(files->indicator_file);
+
+	debugfs_remove(files->control_dir);
+}
+
+static int
+rename_point_dir(struct dentry* control_dir, const char* name)
+{
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(6, 14, 0)
+	return debugfs_change_name(control_dir, "%s", name);
+#else
+	struct dentry* result = debugfs_rename(points_root_directory,
+		control_dir, points_root_directory, name);
 
-	debugfs_remove(point->control_dir);
+	if(IS_ERR_OR_NULL(result)) return result ? PTR_ERR(result) : -EINVAL;
+	return 0;
+#endif
 }
 
 /*
@@ -696,6 +1201,14 @@ delete_indicator_files(struct kedr_simulation_indicator* indicator)
 static int __init
 kedr_fault_simulation_init(void)
 {
+	int i;
+	
+	for(i = 0; i < FSIM_HASH_SIZE; i++)
+	{
+		INIT_HLIST_HEAD(&points_hash[i]);
+		INIT_HLIST_HEAD(&indicators_hash[i]);
+	}
+	
 	root_directory = debugfs_create_dir("kedr_fault_simulation", NULL);
 	if(root_directory == NULL)
 	{
@@ -733,9 +1246,27 @@ kedr_fault_simulation_init(void)
 		goto err_verbose_file;
 	}
 
+	batch_file = debugfs_create_file("batch",
+		S_IWUSR | S_IWGRP,
+		root_directory,
+		NULL, &batch_file_operations);
+	if(batch_file == NULL)
+	{
+		print_error0("Cannot create 'batch' file in debugfs.");
+		goto err_batch_file;
+	}
+
+	if(fsim_campaign_init(root_directory))
+	{
+		goto err_campaign;
+	}
     
 	return 0;
 
+err_campaign:
+    debugfs_remove(batch_file);
+err_batch_file:
+    debugfs_remove(verbose_file);
 err_verbose_file:
     debugfs_remove(last_fault_file);
 err_last_fault_file:
@@ -754,6 +1285,8 @@ kedr_fault_simulation_exit(void)
 	BUG_ON(!list_empty(&points));
 	BUG_ON(!list_empty(&indicators));
 
+    fsim_campaign_destroy();
+    debugfs_remove(batch_file);
     debugfs_remove(verbose_file);
     debugfs_remove(last_fault_file);
     debugfs_remove(points_root_directory);
@@ -900,3 +1433,42 @@ last_fault_file_set_str(const char* str, struct inode* inode)
 	
 	return 0;
 }
+
+/*
+ * Each line of the string written has format
+ * 
+ * <point>=<indicator>[(<params>)]
+ * 
+ * Empty lines and lines started with '#' are ignored. "none" as
+ * <indicator> clears indicator for the point.
+ * 
+ * All lines are verified and all new indicator instances are created
+ * before any point is changed, so on error nothing is changed. Points of
+ * the batch are switched to the new indicators with a single RCU grace
+ * period.
+ */
+static int
+batch_file_set_str(const char* str, struct inode* inode)
+{
+	int error;
+	char* batch = kstrdup(str, GFP_KERNEL);
+	
+	if(batch == NULL)
+	{
+		pr_err("Cannot allocate batch of indicators.\n");
+		return -ENOMEM;
+	}
+	
+	if(mutex_lock_killable(&fsim_mutex))
+	{
+		kfree(batch);
+		return -EINTR;
+	}
+	
+	error = kedr_fsim_set_indicators_internal(batch);
+	
+	mutex_unlock(&fsim_mutex);
+	kfree(batch);
+	
+	return error;
+}
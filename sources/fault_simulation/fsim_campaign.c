@@ -0,0 +1,519 @@
+/*
+ * Fault simulation campaign, see fsim_campaign.h.
+ */
+
+/* ========================================================================
+ * Copyright (C) 2012, KEDR development team
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation.
+ ======================================================================== */
+
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/slab.h>
+#include <linux/list.h>
+#include <linux/spinlock.h>
+#include <linux/string.h>
+#include <linux/ctype.h>
+#include <linux/jhash.h>
+#include <linux/seq_file.h>
+#include <linux/debugfs.h>
+
+#include <kedr/control_file/control_file.h>
+#include <kedr/util/stack_trace.h>
+#include <kedr/util/read_once.h>
+#include <kedr/core/kedr_overhead.h>
+
+#include "fsim_campaign.h"
+#include "config.h"
+
+#define print_error(str, ...) printk(KERN_ERR "%s: " str "\n", __func__, __VA_ARGS__)
+#define print_error0(str) print_error("%s", str)
+
+/*
+ * The contexts are not recorded beyond that number, the faults are not
+ * simulated in such contexts.
+ */
+#define FSIM_CAMPAIGN_MAX_CONTEXTS 4096
+
+#define FSIM_CAMPAIGN_HASH_BITS 8
+#define FSIM_CAMPAIGN_HASH_SIZE (1 << FSIM_CAMPAIGN_HASH_BITS)
+
+#define FSIM_CAMPAIGN_STACK_DEPTH_DEFAULT 8
+
+/* The context of the calls to kedr_fsim_point_simulate(). */
+struct fsim_context
+{
+	// Organization of the hash table of contexts
+	struct hlist_node hnode;
+	// List of contexts in the order they were found
+	struct list_head list;
+
+	u32 hash;
+	unsigned int nr_entries;
+	unsigned long entries[KEDR_MAX_FRAMES];
+
+	// Number of the candidate calls in this context
+	unsigned long hits;
+	// The run in which the fault has been simulated, 0 if not yet.
+	unsigned int failed_in_run;
+
+	// The name of the point, the point itself may be unregistered.
+	char point_name[];
+};
+
+int fsim_campaign_running = 0;
+
+/*
+ * The state of the campaign. Protected by 'campaign_lock', except
+ * 'stack_depth_param' which is only read when the campaign starts.
+ */
+static DEFINE_SPINLOCK(campaign_lock);
+
+static struct hlist_head contexts_hash[FSIM_CAMPAIGN_HASH_SIZE];
+static LIST_HEAD(contexts);
+
+static unsigned int n_contexts;
+static unsigned int n_failed;
+// Number of the contexts not recorded due to the limit or lack of memory
+static unsigned long n_dropped;
+
+// The current run, starting from 1.
+static unsigned int current_run;
+// Nonzero if a fault has been simulated in the current run.
+static int injected;
+// The number of stack frames to identify the context with.
+static unsigned int stack_depth;
+
+static u8 stack_depth_param = FSIM_CAMPAIGN_STACK_DEPTH_DEFAULT;
+
+static struct dentry* campaign_dir;
+static struct dentry* control_file;
+static struct dentry* stack_depth_file;
+static struct dentry* progress_file;
+static struct dentry* contexts_file;
+
+static struct fsim_context*
+lookup_context(u32 hash, const char* point_name,
+	const unsigned long* entries, unsigned int nr_entries)
+{
+	struct fsim_context* context;
+
+	kedr_hlist_for_each_entry(context,
+		&contexts_hash[hash & (FSIM_CAMPAIGN_HASH_SIZE - 1)], hnode)
+	{
+		if((context->hash == hash)
+			&& (context->nr_entries == nr_entries)
+			&& (memcmp(context->entries, entries,
+				nr_entries * sizeof(*entries)) == 0)
+			&& (strcmp(context->point_name, point_name) == 0))
+			return context;
+	}
+	return NULL;
+}
+
+/* Should be executed with 'campaign_lock' locked. */
+static struct fsim_context*
+add_context(u32 hash, const char* point_name,
+	const unsigned long* entries, unsigned int nr_entries)
+{
+	struct fsim_context* context;
+	size_t name_len = strlen(point_name);
+
+	if(n_contexts >= FSIM_CAMPAIGN_MAX_CONTEXTS) return NULL;
+
+	context = kmalloc(sizeof(*context) + name_len + 1, GFP_ATOMIC);
+	if(context == NULL) return NULL;
+
+	context->hash = hash;
+	context->nr_entries = nr_entries;
+	memcpy(context->entries, entries, nr_entries * sizeof(*entries));
+	context->hits = 0;
+	context->failed_in_run = 0;
+	memcpy(context->point_name, point_name, name_len + 1);
+
+	hlist_add_head(&context->hnode,
+		&contexts_hash[hash & (FSIM_CAMPAIGN_HASH_SIZE - 1)]);
+	list_add_tail(&context->list, &contexts);
+	n_contexts++;
+
+	return context;
+}
+
+/*
+ * Remove all the contexts. Should be executed with 'campaign_lock'
+ * locked.
+ */
+static void
+clear_contexts(void)
+{
+	int i;
+
+	while(!list_empty(&contexts))
+	{
+		struct fsim_context* context = list_first_entry(&contexts,
+			struct fsim_context, list);
+		list_del(&context->list);
+		kfree(context);
+	}
+
+	for(i = 0; i < FSIM_CAMPAIGN_HASH_SIZE; i++)
+		INIT_HLIST_HEAD(&contexts_hash[i]);
+
+	n_contexts = 0;
+	n_failed = 0;
+	n_dropped = 0;
+}
+
+int
+fsim_campaign_simulate(const char* point_name, unsigned long caller_address)
+{
+	unsigned long entries[KEDR_MAX_FRAMES];
+	unsigned int nr_entries;
+	unsigned int depth;
+	unsigned long flags;
+	struct fsim_context* context;
+	u32 hash;
+	u64 stack_start;
+	int result = 0;
+
+	if(!READ_ONCE(fsim_campaign_running))
+	{
+		// The campaign has just been stopped, the indicator decides.
+		return 1;
+	}
+
+	/*
+	 * The stack trace is captured and hashed outside of the lock, so the
+	 * candidate calls on different CPUs are not serialized. The lock
+	 * protects only the table of the contexts.
+	 */
+	depth = READ_ONCE(stack_depth);
+
+	stack_start = kedr_overhead_begin();
+	kedr_save_stack_trace(entries, depth, &nr_entries, caller_address);
+	kedr_overhead_end(KEDR_OVERHEAD_STACK_TRACE, NULL, stack_start);
+
+	hash = jhash(point_name, strlen(point_name), 0);
+	hash = jhash(entries, nr_entries * sizeof(*entries), hash);
+
+	spin_lock_irqsave(&campaign_lock, flags);
+
+	if(!fsim_campaign_running)
+	{
+		result = 1;
+		goto out;
+	}
+
+	/*
+	 * The campaign has been restarted with another stack depth after
+	 * the stack trace was captured: do not record the context.
+	 */
+	if(depth != stack_depth)
+		goto out;
+
+	context = lookup_context(hash, point_name, entries, nr_entries);
+	if(context == NULL)
+	{
+		context = add_context(hash, point_name, entries, nr_entries);
+		if(context == NULL)
+		{
+			n_dropped++;
+			goto out;
+		}
+	}
+
+	context->hits++;
+	if(!injected && !context->failed_in_run)
+	{
+		context->failed_in_run = current_run;
+		injected = 1;
+		n_failed++;
+		result = 1;
+	}
+
+out:
+	spin_unlock_irqrestore(&campaign_lock, flags);
+	return result;
+}
+
+//////////////////////////// Files operations ///////////////////////////////
+
+/*
+ * Check if the string written to a control file is the given command,
+ * possibly surrounded by whitespace.
+ */
+static int
+is_command(const char* str, const char* command)
+{
+	size_t len = strlen(command);
+
+	while(isspace(*str)) str++;
+	if(strncmp(str, command, len) != 0) return 0;
+
+	for(str += len; *str != '\0'; str++)
+		if(!isspace(*str)) return 0;
+
+	return 1;
+}
+
+static char*
+control_file_get_str(struct inode* inode)
+{
+	return kstrdup(READ_ONCE(fsim_campaign_running) ? "running" : "stopped",
+		GFP_KERNEL);
+}
+
+/*
+ * Commands:
+ *
+ * "start" - forget all the contexts and start the first run;
+ * "next" - start the next run;
+ * "stop" - stop the campaign, the contexts are kept.
+ */
+static int
+control_file_set_str(const char* str, struct inode* inode)
+{
+	unsigned long flags;
+	int error = 0;
+	unsigned int depth = stack_depth_param;
+
+	if((depth == 0) || (depth > KEDR_MAX_FRAMES))
+		depth = KEDR_MAX_FRAMES;
+
+	spin_lock_irqsave(&campaign_lock, flags);
+
+	if(is_command(str, "start"))
+	{
+		clear_contexts();
+		WRITE_ONCE(stack_depth, depth);
+		current_run = 1;
+		injected = 0;
+		WRITE_ONCE(fsim_campaign_running, 1);
+	}
+	else if(is_command(str, "next"))
+	{
+		if(fsim_campaign_running)
+		{
+			current_run++;
+			injected = 0;
+		}
+		else
+		{
+			error = -EINVAL;
+		}
+	}
+	else if(is_command(str, "stop"))
+	{
+		WRITE_ONCE(fsim_campaign_running, 0);
+	}
+	else
+	{
+		error = -EINVAL;
+	}
+
+	spin_unlock_irqrestore(&campaign_lock, flags);
+
+	if(error)
+		pr_err("Expected 'start', 'next' or 'stop' for the campaign.\n");
+	return error;
+}
+
+CONTROL_FILE_OPS(control_file_operations,
+	control_file_get_str, control_file_set_str);
+
+static char*
+progress_file_get_str(struct inode* inode)
+{
+	unsigned long flags;
+	unsigned int run;
+	int running;
+	int run_injected;
+	unsigned int contexts_seen;
+	unsigned int contexts_failed;
+	unsigned long contexts_dropped;
+
+	spin_lock_irqsave(&campaign_lock, flags);
+	running = fsim_campaign_running;
+	run = current_run;
+	run_injected = injected;
+	contexts_seen = n_contexts;
+	contexts_failed = n_failed;
+	contexts_dropped = n_dropped;
+	spin_unlock_irqrestore(&campaign_lock, flags);
+
+	return kasprintf(GFP_KERNEL,
+		"state: %s\n"
+		"run: %u\n"
+		"injected in this run: %s\n"
+		"contexts: %u\n"
+		"failed: %u\n"
+		"pending: %u\n"
+		"dropped: %lu\n",
+		running ? "running" : "stopped",
+		run,
+		run_injected ? "yes" : "no",
+		contexts_seen,
+		contexts_failed,
+		contexts_seen - contexts_failed,
+		contexts_dropped);
+}
+
+CONTROL_FILE_OPS(progress_file_operations,
+	progress_file_get_str, NULL);
+
+/*
+ * "contexts" file: the contexts in the order they were found.
+ *
+ * The list cannot change while it is output, 'campaign_lock' is held from
+ * start() to stop(). The file is read in process context, so interrupts
+ * are simply enabled again in stop().
+ */
+static void*
+contexts_start(struct seq_file* m, loff_t* pos)
+{
+	spin_lock_irq(&campaign_lock);
+	return seq_list_start(&contexts, *pos);
+}
+
+static void*
+contexts_next(struct seq_file* m, void* v, loff_t* pos)
+{
+	return seq_list_next(v, &contexts, pos);
+}
+
+static void
+contexts_stop(struct seq_file* m, void* v)
+{
+	spin_unlock_irq(&campaign_lock);
+}
+
+static int
+contexts_show(struct seq_file* m, void* v)
+{
+	struct fsim_context* context = list_entry(v, struct fsim_context, list);
+	unsigned int i;
+
+	seq_printf(m, "%s %08x hits: %lu ", context->point_name,
+		(unsigned int)context->hash, context->hits);
+	if(context->failed_in_run)
+		seq_printf(m, "failed in run %u\n", context->failed_in_run);
+	else
+		seq_puts(m, "pending\n");
+
+	for(i = 0; i < context->nr_entries; i++)
+	{
+		seq_printf(m, "\t[<%lx>] %pS\n",
+			context->entries[i], (void*)context->entries[i]);
+	}
+	return 0;
+}
+
+static const struct seq_operations contexts_seq_ops = {
+	.start = contexts_start,
+	.next  = contexts_next,
+	.stop  = contexts_stop,
+	.show  = contexts_show,
+};
+
+static int
+contexts_open(struct inode* inode, struct file* filp)
+{
+	return seq_open(filp, &contexts_seq_ops);
+}
+
+static const struct file_operations contexts_file_operations = {
+	.owner      = THIS_MODULE,
+	.open       = contexts_open,
+	.read       = seq_read,
+	.llseek     = seq_lseek,
+	.release    = seq_release,
+};
+/////////////////////////////////////////////////////////////////////////////
+
+int
+fsim_campaign_init(struct dentry* root_directory)
+{
+	int i;
+
+	for(i = 0; i < FSIM_CAMPAIGN_HASH_SIZE; i++)
+		INIT_HLIST_HEAD(&contexts_hash[i]);
+
+	campaign_dir = debugfs_create_dir("campaign", root_directory);
+	if(campaign_dir == NULL)
+	{
+		print_error0("Cannot create directory in debugfs for the campaign.");
+		goto err_dir;
+	}
+
+	control_file = debugfs_create_file("control",
+		S_IRUGO | S_IWUSR | S_IWGRP,
+		campaign_dir,
+		NULL, &control_file_operations);
+	if(control_file == NULL)
+	{
+		print_error0("Cannot create 'control' file for the campaign.");
+		goto err_control_file;
+	}
+
+	stack_depth_file = debugfs_create_u8("stack_depth",
+		S_IRUGO | S_IWUSR | S_IWGRP,
+		campaign_dir, &stack_depth_param);
+	if(stack_depth_file == NULL)
+	{
+		print_error0("Cannot create 'stack_depth' file for the campaign.");
+		goto err_stack_depth_file;
+	}
+
+	progress_file = debugfs_create_file("progress",
+		S_IRUGO,
+		campaign_dir,
+		NULL, &progress_file_operations);
+	if(progress_file == NULL)
+	{
+		print_error0("Cannot create 'progress' file for the campaign.");
+		goto err_progress_file;
+	}
+
+	contexts_file = debugfs_create_file("contexts",
+		S_IRUSR | S_IRGRP,
+		campaign_dir,
+		NULL, &contexts_file_operations);
+	if(contexts_file == NULL)
+	{
+		print_error0("Cannot create 'contexts' file for the campaign.");
+		goto err_contexts_file;
+	}
+
+	return 0;
+
+err_contexts_file:
+	debugfs_remove(progress_file);
+err_progress_file:
+	debugfs_remove(stack_depth_file);
+err_stack_depth_file:
+	debugfs_remove(control_file);
+err_control_file:
+	debugfs_remove(campaign_dir);
+err_dir:
+	return -EINVAL;
+}
+
+void
+fsim_campaign_destroy(void)
+{
+	unsigned long flags;
+
+	debugfs_remove(contexts_file);
+	debugfs_remove(progress_file);
+	debugfs_remove(stack_depth_file);
+	debugfs_remove(control_file);
+	debugfs_remove(campaign_dir);
+
+	spin_lock_irqsave(&campaign_lock, flags);
+	WRITE_ONCE(fsim_campaign_running, 0);
+	clear_contexts();
+	spin_unlock_irqrestore(&campaign_lock, flags);
+}
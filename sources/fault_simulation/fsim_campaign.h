@@ -0,0 +1,61 @@
+#ifndef FSIM_CAMPAIGN_H_1043_INCLUDED
+#define FSIM_CAMPAIGN_H_1043_INCLUDED
+
+/*
+ * Fault simulation campaign: each fault is simulated in a distinct context
+ * only once.
+ *
+ * A context is the point and the stack trace of the call to
+ * kedr_fsim_point_simulate(). When the campaign is running, the indicator
+ * of a point only selects the candidate calls: if it decides to simulate a
+ * fault, the context of the call is recorded and the fault is actually
+ * simulated only if no fault has been simulated in this context before and
+ * no fault has been simulated in the current run of the workload yet.
+ *
+ * So each run of the workload fails in the next context not failed yet,
+ * and the workload has to be rerun as many times as there are distinct
+ * contexts rather than as many times as there are calls.
+ *
+ * The campaign is controlled via the files in "campaign" directory of the
+ * fault simulation in debugfs:
+ * - "control" - write "start" to forget all contexts and start the first
+ *   run, "next" to start the next run, "stop" to stop the campaign (the
+ *   indicators then decide as usual). Reading it gives the state of the
+ *   campaign;
+ * - "stack_depth" - the number of stack frames to identify the context
+ *   with, used starting from the next "start";
+ * - "progress" - the current run, the numbers of contexts seen, failed and
+ *   not failed yet;
+ * - "contexts" - the contexts seen, with their stack traces.
+ */
+
+#include <linux/debugfs.h>
+
+/*
+ * Nonzero if the campaign is running. Changed under the campaign lock,
+ * read with READ_ONCE() outside of it.
+ */
+extern int fsim_campaign_running;
+
+/*
+ * Decide whether to simulate a fault for the call at 'point_name', the
+ * indicator of which has decided to simulate it. 'caller_address' is the
+ * return address of kedr_fsim_point_simulate().
+ *
+ * Return nonzero if the fault should be simulated.
+ *
+ * May be called in atomic context.
+ */
+int
+fsim_campaign_simulate(const char* point_name, unsigned long caller_address);
+
+/*
+ * Create the files of the campaign in 'root_directory' in debugfs.
+ */
+int
+fsim_campaign_init(struct dentry* root_directory);
+
+void
+fsim_campaign_destroy(void);
+
+#endif /* FSIM_CAMPAIGN_H_1043_INCLUDED */
@@ -0,0 +1,55 @@
+/* callstat.h
+ * API of the call statistics subsystem (kedr_callstat module).
+ *
+ * Instead of recording each call into the trace, payload modules count
+ * calls in the per-CPU tables keyed by (function, call site). Tables are
+ * merged when the statistics is read from
+ * <debugfs>/kedr_callstat/stats. */
+
+#ifndef KEDR_CALLSTAT_H_1022_INCLUDED
+#define KEDR_CALLSTAT_H_1022_INCLUDED
+
+#include <linux/module.h>
+
+/* The function which calls are counted.
+ *
+ * Usually this is a static variable in the payload module. */
+struct kedr_callstat_func
+{
+	/* Name of the function as it is shown in the statistics. */
+	const char *name;
+	
+	/* The module that owns this structure (usually, THIS_MODULE). */
+	struct module *owner;
+};
+
+/* Account the call of the function 'func' made from 'call_site'.
+ * 'is_error' is nonzero if the call has failed.
+ *
+ * May be called in atomic context. */
+void
+kedr_callstat_record(const struct kedr_callstat_func *func,
+	void *call_site, int is_error);
+
+/* Same as kedr_callstat_record() but also accounts 'size' of the request
+ * in the log2 histogram of sizes for (func, call_site). */
+void
+kedr_callstat_record_size(const struct kedr_callstat_func *func,
+	void *call_site, int is_error, unsigned long size);
+
+/* Same as kedr_callstat_record_size() but also accounts the return value
+ * 'retval' in the distribution of the return values for
+ * (func, call_site). 'size' is ignored if 'has_size' is 0. */
+void
+kedr_callstat_record_retval(const struct kedr_callstat_func *func,
+	void *call_site, int is_error, unsigned long size, int has_size,
+	long retval);
+
+/* Drop statistics for all functions which belong to the module 'owner'.
+ *
+ * Should be called when the module is about to unload, after its
+ * payload is unregistered. */
+void
+kedr_callstat_forget(struct module *owner);
+
+#endif /* KEDR_CALLSTAT_H_1022_INCLUDED */
@@ -173,6 +173,21 @@ struct kedr_payload
 	 * Descriptor of the module loaded is passed as function's argument.
 	 */
 	void (*target_unload_callback)(struct module *target_module);
+
+	/*
+	 * Names of the target modules the payload should be applied to,
+	 * separated with ','. If NULL, the payload is applied to all
+	 * targets.
+	 *
+	 * When several targets are watched for, the calls made by a target
+	 * the payload is not applied to are not intercepted by this payload
+	 * and on_target_loaded()/on_target_about_to_unload() callbacks are
+	 * not called for that target.
+	 *
+	 * NOTE: The user may override this binding with 'payload_targets'
+	 * parameter of KEDR core.
+	 */
+	const char *targets;
 };
 
 /* Registers a payload module with the KEDR core. 
@@ -7,6 +7,7 @@
 #define KEDR_FUNCTIONS_SUPPORT_H
 
 #include <linux/module.h> /* struct module */
+#include <linux/types.h> /* u64 */
 
 /**********************************************************************
  * Public API
@@ -23,8 +24,42 @@ struct kedr_intermediate_info
 	void** post;
 	// replacement function or NULL.
 	void* replace;
+	/*
+	 * Per-target variants of the information above, indexed by the
+	 * index of the target (see kedr_target_index()).
+	 * 
+	 * NULL if all targets are handled the same way. Otherwise, some
+	 * payloads are bound only to some of the targets and the
+	 * intermediate function should use the variant for the target
+	 * it is called from (see kedr_intermediate_info_get()).
+	 */
+	struct kedr_intermediate_info* per_target;
 };
 
+/*
+ * Return index of the target module which code contains 'addr',
+ * or -1 if 'addr' doesn't belong to any target.
+ * 
+ * It is allowed to call this function from atomic context.
+ */
+int kedr_target_index(void* addr);
+
+/*
+ * Return information which should be used by the intermediate function
+ * when it is called from 'return_address'.
+ */
+static inline const struct kedr_intermediate_info*
+kedr_intermediate_info_get(const struct kedr_intermediate_info* info,
+	void* return_address)
+{
+	int target_index;
+	
+	if(info->per_target == NULL) return info;
+	
+	target_index = kedr_target_index(return_address);
+	return (target_index >= 0) ? &info->per_target[target_index] : info;
+}
+
 /*
  * Information about one intermediate replacement function implementation.
  * 
@@ -63,6 +98,13 @@ struct kedr_functions_support
 	 * Last element of the array should hold NULL in 'orig'.
 	 */
 	struct kedr_intermediate_impl* intermediate_impl;
+
+	/*
+	 * Nonzero if some of the intermediate functions measure the latency
+	 * of the original functions (see kedr_timing_begin() and
+	 * kedr_timing_end() below).
+	 */
+	int timing;
 };
 /*
  * Register kedr support for some functions set.
@@ -74,4 +116,19 @@ struct kedr_functions_support
 int kedr_functions_support_register(struct kedr_functions_support* functions_support);
 int kedr_functions_support_unregister(struct kedr_functions_support* functions_support);
 
+/*
+ * Latency measurement for the original functions.
+ * 
+ * An intermediate function calls kedr_timing_begin() right before
+ * the original function and passes the result to kedr_timing_end()
+ * right after it. The duration of the call is accounted for
+ * (orig, call_site) in the per-CPU histograms, percentiles are
+ * available in "kedr_timing/latency" file in debugfs.
+ * 
+ * These functions may be used only by the functions support registered
+ * with 'timing' field set.
+ */
+u64 kedr_timing_begin(void);
+void kedr_timing_end(void* orig, void* call_site, u64 start);
+
 #endif /* KEDR_H */
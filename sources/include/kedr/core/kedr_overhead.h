@@ -0,0 +1,87 @@
+/*
+ * Accounting of the overhead introduced by KEDR itself.
+ *
+ * If KEDR is built with KEDR_ENABLE_OVERHEAD, the stages of processing
+ * of the intercepted calls are timed with the cycle counter, and the
+ * totals are accumulated per (stage, key) on each CPU. The statistics is
+ * available in "kedr_overhead/overhead" file in debugfs.
+ *
+ * Otherwise, the functions below do nothing and cost nothing.
+ */
+
+#ifndef KEDR_OVERHEAD_H
+#define KEDR_OVERHEAD_H
+
+#include <kedr/defs.h>
+#include <linux/types.h>
+
+#if defined(KEDR_ENABLE_OVERHEAD)
+#include <asm/timex.h> /* get_cycles() */
+#endif
+
+/*
+ * The stages are nested: e.g. the time of the pre-handlers is accounted
+ * for both KEDR_OVERHEAD_PRE and KEDR_OVERHEAD_INTERMEDIATE.
+ */
+enum kedr_overhead_stage
+{
+    /*
+     * The intermediate function except the original function.
+     * Key: the original function.
+     */
+    KEDR_OVERHEAD_INTERMEDIATE = 0,
+    /* Key: the handler. */
+    KEDR_OVERHEAD_PRE,
+    /* Includes the original function if the replacement calls it. */
+    KEDR_OVERHEAD_REPLACE,
+    KEDR_OVERHEAD_POST,
+    /* Reservation and commit of the messages in the trace. */
+    KEDR_OVERHEAD_TRACE_RESERVE,
+    KEDR_OVERHEAD_TRACE_COMMIT,
+    /* The top half of LeakCheck, including the stack trace. */
+    KEDR_OVERHEAD_RESOURCE_INFO,
+    KEDR_OVERHEAD_STACK_TRACE,
+    /* Key: the caller of kedr_fsim_point_simulate(). */
+    KEDR_OVERHEAD_FSIM_SIMULATE,
+
+    KEDR_OVERHEAD_NR_STAGES
+};
+
+#if defined(KEDR_ENABLE_OVERHEAD)
+
+static inline u64
+kedr_overhead_begin(void)
+{
+    return (u64)get_cycles();
+}
+
+/*
+ * Account for 'cycles' spent in the stage 'stage' for 'key' (may be NULL).
+ *
+ * May be called in atomic context.
+ */
+void kedr_overhead_account(unsigned int stage, const void* key, u64 cycles);
+
+#else /* !defined(KEDR_ENABLE_OVERHEAD) */
+
+static inline u64
+kedr_overhead_begin(void)
+{
+    return 0;
+}
+
+static inline void
+kedr_overhead_account(unsigned int stage, const void* key, u64 cycles)
+{
+}
+
+#endif /* defined(KEDR_ENABLE_OVERHEAD) */
+
+/* Account for the cycles since 'start' returned by kedr_overhead_begin(). */
+static inline void
+kedr_overhead_end(unsigned int stage, const void* key, u64 start)
+{
+    kedr_overhead_account(stage, key, kedr_overhead_begin() - start);
+}
+
+#endif /* KEDR_OVERHEAD_H */
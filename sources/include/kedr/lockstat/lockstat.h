@@ -0,0 +1,36 @@
+/* lockstat.h
+ * API of the lock profiling subsystem (kedr_lockstat module).
+ *
+ * Payload modules report the acquisitions and releases of the locks made
+ * by the target. For each (lock, call site of the acquisition), the time
+ * spent waiting for the lock and the time the lock was held are
+ * accumulated in the per-CPU tables. The locks with the largest total
+ * times are reported in <debugfs>/kedr_lockstat/top_wait and
+ * <debugfs>/kedr_lockstat/top_hold. */
+
+#ifndef KEDR_LOCKSTAT_H_1646_INCLUDED
+#define KEDR_LOCKSTAT_H_1646_INCLUDED
+
+/* Should be called right before the function that acquires 'lock'.
+ *
+ * May be called in atomic context. */
+void
+kedr_lockstat_acquire_begin(void *lock);
+
+/* Should be called right after the function that acquires 'lock' made
+ * from 'call_site' returns. 'acquired' is zero if the function has failed
+ * to acquire the lock (e.g. mutex_trylock() returned 0). For each
+ * kedr_lockstat_acquire_begin(), this function should be called exactly
+ * once, in the same task.
+ *
+ * May be called in atomic context. */
+void
+kedr_lockstat_acquire_end(void *lock, void *call_site, int acquired);
+
+/* Should be called right before the function that releases 'lock'.
+ *
+ * May be called in atomic context. */
+void
+kedr_lockstat_release(void *lock);
+
+#endif /* KEDR_LOCKSTAT_H_1646_INCLUDED */
@@ -0,0 +1,737 @@
+/* percpu_stats.h
+ * Per-CPU statistics helpers for payload modules in KEDR: counters,
+ * maximum/minimum trackers, log2 histograms and keyed tables of records.
+ *
+ * Each CPU updates only its own copy of the data, so no locks are needed
+ * and no cache lines are shared between the CPUs in the hot path. The
+ * per-CPU copies are aggregated when the value is read. As a result,
+ * reading is relatively expensive and the value read is not a snapshot:
+ * the updates made on other CPUs during the read may or may not be seen.
+ * This is usually acceptable for the statistics.
+ *
+ * All update functions may be called in atomic context, including the
+ * interrupt handlers. Init and destroy functions should be called in
+ * process context.
+ *
+ * A set of statistics may be shown in a single file in debugfs, see
+ * kedr_stat_debugfs_create() below.
+ *
+ * The helpers are implemented in this header only, so that the payload
+ * modules built out of the KEDR tree (see the examples) could use them
+ * without additional source files. */
+
+#ifndef KEDR_PERCPU_STATS_H_1733_INCLUDED
+#define KEDR_PERCPU_STATS_H_1733_INCLUDED
+
+#include <linux/kernel.h>
+#include <linux/types.h>
+#include <linux/errno.h>
+#include <linux/percpu.h>
+#include <linux/cpumask.h>
+#include <linux/irqflags.h>
+#include <linux/bitops.h>
+#include <linux/slab.h>
+#include <linux/vmalloc.h>
+#include <linux/string.h>
+#include <linux/hash.h>
+#include <linux/smp.h>
+#include <linux/sort.h>
+#include <linux/module.h>
+#include <linux/fs.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+
+#include <kedr/util/read_once.h>
+
+/* ====================================================================== */
+/* Counters */
+
+struct kedr_stat_counter
+{
+	s64 __percpu *values;
+};
+
+static inline int
+kedr_stat_counter_init(struct kedr_stat_counter *c)
+{
+	c->values = alloc_percpu(s64);
+	return (c->values != NULL) ? 0 : -ENOMEM;
+}
+
+static inline void
+kedr_stat_counter_destroy(struct kedr_stat_counter *c)
+{
+	free_percpu(c->values);
+	c->values = NULL;
+}
+
+static inline void
+kedr_stat_counter_add(struct kedr_stat_counter *c, s64 delta)
+{
+	this_cpu_add(*c->values, delta);
+}
+
+static inline void
+kedr_stat_counter_inc(struct kedr_stat_counter *c)
+{
+	this_cpu_inc(*c->values);
+}
+
+static inline void
+kedr_stat_counter_dec(struct kedr_stat_counter *c)
+{
+	this_cpu_dec(*c->values);
+}
+
+static inline s64
+kedr_stat_counter_read(const struct kedr_stat_counter *c)
+{
+	s64 sum = 0;
+	int cpu;
+
+	for_each_possible_cpu(cpu)
+		sum += *per_cpu_ptr(c->values, cpu);
+	return sum;
+}
+
+/* ====================================================================== */
+/* Maximum and minimum trackers.
+ *
+ * The comparison and the update are done with interrupts disabled on the
+ * local CPU, which is enough because only the local CPU writes to its copy
+ * of the value. */
+
+struct kedr_stat_max
+{
+	u64 __percpu *values;
+};
+
+struct kedr_stat_min
+{
+	u64 __percpu *values;
+};
+
+static inline int
+kedr_stat_max_init(struct kedr_stat_max *m)
+{
+	m->values = alloc_percpu(u64);
+	return (m->values != NULL) ? 0 : -ENOMEM;
+}
+
+static inline void
+kedr_stat_max_destroy(struct kedr_stat_max *m)
+{
+	free_percpu(m->values);
+	m->values = NULL;
+}
+
+static inline void
+kedr_stat_max_update(struct kedr_stat_max *m, u64 value)
+{
+	unsigned long irq_flags;
+	u64 *cur;
+
+	local_irq_save(irq_flags);
+	cur = this_cpu_ptr(m->values);
+	if (value > *cur)
+		*cur = value;
+	local_irq_restore(irq_flags);
+}
+
+/* Returns 0 if there have been no updates. */
+static inline u64
+kedr_stat_max_read(const struct kedr_stat_max *m)
+{
+	u64 result = 0;
+	int cpu;
+
+	for_each_possible_cpu(cpu) {
+		u64 value = *per_cpu_ptr(m->values, cpu);
+		if (value > result)
+			result = value;
+	}
+	return result;
+}
+
+static inline int
+kedr_stat_min_init(struct kedr_stat_min *m)
+{
+	int cpu;
+
+	m->values = alloc_percpu(u64);
+	if (m->values == NULL)
+		return -ENOMEM;
+
+	for_each_possible_cpu(cpu)
+		*per_cpu_ptr(m->values, cpu) = ~(u64)0;
+	return 0;
+}
+
+static inline void
+kedr_stat_min_destroy(struct kedr_stat_min *m)
+{
+	free_percpu(m->values);
+	m->values = NULL;
+}
+
+static inline void
+kedr_stat_min_update(struct kedr_stat_min *m, u64 value)
+{
+	unsigned long irq_flags;
+	u64 *cur;
+
+	local_irq_save(irq_flags);
+	cur = this_cpu_ptr(m->values);
+	if (value < *cur)
+		*cur = value;
+	local_irq_restore(irq_flags);
+}
+
+/* Returns ~(u64)0 if there have been no updates. */
+static inline u64
+kedr_stat_min_read(const struct kedr_stat_min *m)
+{
+	u64 result = ~(u64)0;
+	int cpu;
+
+	for_each_possible_cpu(cpu) {
+		u64 value = *per_cpu_ptr(m->values, cpu);
+		if (value < result)
+			result = value;
+	}
+	return result;
+}
+
+/* ====================================================================== */
+/* Log2 histograms.
+ *
+ * Bucket 0 is for the value 0, bucket 'i' (i > 0) is for the values from
+ * [2^(i-1), 2^i). */
+
+#define KEDR_STAT_HIST_BUCKETS (64 + 1)
+
+struct kedr_stat_hist_data
+{
+	u64 buckets[KEDR_STAT_HIST_BUCKETS];
+};
+
+struct kedr_stat_hist
+{
+	struct kedr_stat_hist_data __percpu *values;
+};
+
+static inline int
+kedr_stat_hist_init(struct kedr_stat_hist *h)
+{
+	h->values = alloc_percpu(struct kedr_stat_hist_data);
+	return (h->values != NULL) ? 0 : -ENOMEM;
+}
+
+static inline void
+kedr_stat_hist_destroy(struct kedr_stat_hist *h)
+{
+	free_percpu(h->values);
+	h->values = NULL;
+}
+
+static inline void
+kedr_stat_hist_add(struct kedr_stat_hist *h, u64 value)
+{
+	this_cpu_inc(h->values->buckets[fls64(value)]);
+}
+
+/* Sums the per-CPU histograms into 'result'. */
+static inline void
+kedr_stat_hist_read(const struct kedr_stat_hist *h,
+	struct kedr_stat_hist_data *result)
+{
+	int cpu;
+	int i;
+
+	memset(result, 0, sizeof(*result));
+	for_each_possible_cpu(cpu) {
+		const struct kedr_stat_hist_data *data =
+			per_cpu_ptr(h->values, cpu);
+
+		for (i = 0; i < KEDR_STAT_HIST_BUCKETS; ++i)
+			result->buckets[i] += data->buckets[i];
+	}
+}
+
+/* ====================================================================== */
+/* Keyed tables.
+ *
+ * A table maps the keys, the pairs of unsigned long values, to the records
+ * of the statistics, e.g. the number of calls per (function, call site).
+ * Each CPU has its own open-addressing table of 2^bits entries. An entry
+ * is the record of the user, the first member of which must be
+ * 'struct kedr_stat_key'. The first part of the key, 'k1', must be neither
+ * 0 nor KEDR_STAT_KEY_REMOVED, these values are reserved.
+ *
+ * The entries are looked up and updated with interrupts disabled on the
+ * local CPU, see kedr_stat_table_get(). If the key is not found among
+ * 'max_probes' entries starting from its hash, and none of them is free
+ * or removed, the event is counted as dropped.
+ *
+ * kedr_stat_table_merge(), kedr_stat_table_reset() and
+ * kedr_stat_table_forget() should be serialized by the user. */
+
+struct kedr_stat_key
+{
+	/* 0 if the entry is not used. */
+	unsigned long k1;
+	unsigned long k2;
+};
+
+/* 'k1' of the entries removed by kedr_stat_table_forget(). Such entries
+ * are not free, so the probe sequences for other keys are not broken, but
+ * they are reused for new keys. */
+#define KEDR_STAT_KEY_REMOVED (~0UL)
+
+struct kedr_stat_table_cpu
+{
+	void *entries;
+
+	/* Number of events which were not accounted for because the table
+	 * was full. */
+	unsigned long dropped;
+};
+
+struct kedr_stat_table
+{
+	struct kedr_stat_table_cpu __percpu *cpu_tables;
+	unsigned int bits;
+	unsigned int max_probes;
+	size_t entry_size;
+};
+
+static inline unsigned long
+kedr_stat_table_size(const struct kedr_stat_table *t)
+{
+	return 1UL << t->bits;
+}
+
+static inline struct kedr_stat_key *
+kedr_stat_table_entry(const struct kedr_stat_table *t,
+	const struct kedr_stat_table_cpu *cpu_table, unsigned long i)
+{
+	return (struct kedr_stat_key *)
+		((char *)cpu_table->entries + i * t->entry_size);
+}
+
+static inline int
+kedr_stat_key_is_used(const struct kedr_stat_key *key)
+{
+	unsigned long k1 = READ_ONCE(key->k1);
+	return (k1 != 0 && k1 != KEDR_STAT_KEY_REMOVED);
+}
+
+static inline int
+kedr_stat_key_compare(const struct kedr_stat_key *a,
+	const struct kedr_stat_key *b)
+{
+	if (a->k1 != b->k1)
+		return (a->k1 < b->k1) ? -1 : 1;
+	if (a->k2 != b->k2)
+		return (a->k2 < b->k2) ? -1 : 1;
+	return 0;
+}
+
+static inline void
+kedr_stat_table_destroy(struct kedr_stat_table *t)
+{
+	int cpu;
+
+	if (t == NULL)
+		return;
+
+	for_each_possible_cpu(cpu)
+		vfree(per_cpu_ptr(t->cpu_tables, cpu)->entries);
+	free_percpu(t->cpu_tables);
+	kfree(t);
+}
+
+/* Create a table with the entries of 'entry_size' bytes, all of them are
+ * free. Returns NULL if there is not enough memory. */
+static inline struct kedr_stat_table *
+kedr_stat_table_create(unsigned int bits, unsigned int max_probes,
+	size_t entry_size)
+{
+	struct kedr_stat_table *t;
+	int cpu;
+
+	t = kzalloc(sizeof(*t), GFP_KERNEL);
+	if (t == NULL)
+		return NULL;
+
+	t->bits = bits;
+	t->max_probes = max_probes;
+	t->entry_size = entry_size;
+
+	/* The per-CPU data are zeroed. */
+	t->cpu_tables = alloc_percpu(struct kedr_stat_table_cpu);
+	if (t->cpu_tables == NULL) {
+		kfree(t);
+		return NULL;
+	}
+
+	for_each_possible_cpu(cpu) {
+		struct kedr_stat_table_cpu *cpu_table =
+			per_cpu_ptr(t->cpu_tables, cpu);
+
+		cpu_table->entries = vmalloc(kedr_stat_table_size(t) *
+			entry_size);
+		if (cpu_table->entries == NULL) {
+			kedr_stat_table_destroy(t);
+			return NULL;
+		}
+		memset(cpu_table->entries, 0,
+			kedr_stat_table_size(t) * entry_size);
+	}
+	return t;
+}
+
+/* Find the entry for (k1, k2) in the table of the current CPU, claim a
+ * free or removed one if not found. Returns NULL and counts the event as
+ * dropped if the table has no room for the key.
+ *
+ * Should be called with interrupts disabled on the local CPU. */
+static inline void *
+kedr_stat_table_get(struct kedr_stat_table *t, unsigned long k1,
+	unsigned long k2)
+{
+	struct kedr_stat_table_cpu *cpu_table = this_cpu_ptr(t->cpu_tables);
+	unsigned long mask = kedr_stat_table_size(t) - 1;
+	unsigned long i = hash_long(k1 ^ k2, t->bits);
+	struct kedr_stat_key *claimed = NULL;
+	unsigned int n;
+
+	for (n = 0; n < t->max_probes; ++n, i = (i + 1) & mask) {
+		struct kedr_stat_key *key =
+			kedr_stat_table_entry(t, cpu_table, i);
+
+		if (key->k1 == k1 && key->k2 == k2)
+			return key;
+
+		/* The key may follow a removed entry but not a free one. */
+		if (key->k1 == KEDR_STAT_KEY_REMOVED) {
+			if (claimed == NULL)
+				claimed = key;
+		} else if (key->k1 == 0) {
+			if (claimed == NULL)
+				claimed = key;
+			break;
+		}
+	}
+
+	if (claimed == NULL) {
+		++cpu_table->dropped;
+		return NULL;
+	}
+
+	/* The rest of a removed entry has been zeroed by
+	 * kedr_stat_table_forget(). */
+	claimed->k2 = k2;
+	/* The readers check 'k1' first. */
+	smp_wmb();
+	WRITE_ONCE(claimed->k1, k1);
+	return claimed;
+}
+
+/* Count an event as dropped for a reason other than the table being full.
+ * May be called in any context. */
+static inline void
+kedr_stat_table_drop(struct kedr_stat_table *t)
+{
+	this_cpu_inc(t->cpu_tables->dropped);
+}
+
+static inline int
+kedr_stat_table_ptr_compare(const void *lhs, const void *rhs)
+{
+	return kedr_stat_key_compare(*(const struct kedr_stat_key **)lhs,
+		*(const struct kedr_stat_key **)rhs);
+}
+
+static inline void
+kedr_stat_table_ptr_swap(void *lhs, void *rhs, int size)
+{
+	struct kedr_stat_key **a = lhs;
+	struct kedr_stat_key **b = rhs;
+	struct kedr_stat_key *tmp = *a;
+
+	*a = *b;
+	*b = tmp;
+}
+
+/* Merge the per-CPU tables. For each key, an entry is created in the
+ * array '*merged' with the key set and the rest zeroed, and
+ * merge(total, entry) is called for it and each entry for this key from
+ * the per-CPU tables. The merged entries are sorted by the key.
+ *
+ * The caller should vfree() '*merged'. '*dropped' is the total number of
+ * the dropped events.
+ *
+ * Returns the number of the merged entries or negative error code. */
+static inline long
+kedr_stat_table_merge(struct kedr_stat_table *t,
+	void (*merge)(void *total, const void *entry),
+	void **merged, unsigned long *dropped)
+{
+	struct kedr_stat_key **used;
+	char *result;
+	unsigned long nr_used = 0;
+	unsigned long nr_merged = 0;
+	unsigned long i;
+	int cpu;
+
+	used = vmalloc(num_possible_cpus() * kedr_stat_table_size(t) *
+		sizeof(*used));
+	if (used == NULL)
+		return -ENOMEM;
+
+	*dropped = 0;
+	for_each_possible_cpu(cpu) {
+		struct kedr_stat_table_cpu *cpu_table =
+			per_cpu_ptr(t->cpu_tables, cpu);
+
+		for (i = 0; i < kedr_stat_table_size(t); ++i) {
+			struct kedr_stat_key *key =
+				kedr_stat_table_entry(t, cpu_table, i);
+
+			if (!kedr_stat_key_is_used(key))
+				continue;
+			/* Pairs with smp_wmb() in kedr_stat_table_get(). */
+			smp_rmb();
+			used[nr_used++] = key;
+		}
+		*dropped += cpu_table->dropped;
+	}
+
+	/* Entries for the same key from different CPUs become adjacent. */
+	sort(used, nr_used, sizeof(*used), kedr_stat_table_ptr_compare,
+		kedr_stat_table_ptr_swap);
+
+	for (i = 0; i < nr_used; ++i) {
+		if (i == 0 || kedr_stat_key_compare(used[i - 1], used[i]) != 0)
+			++nr_merged;
+	}
+
+	/* One more entry so that an empty array is not allocated. */
+	result = vmalloc((nr_merged + 1) * t->entry_size);
+	if (result == NULL) {
+		vfree(used);
+		return -ENOMEM;
+	}
+	memset(result, 0, (nr_merged + 1) * t->entry_size);
+
+	nr_merged = 0;
+	for (i = 0; i < nr_used; ++i) {
+		struct kedr_stat_key *total;
+
+		if (i > 0 && kedr_stat_key_compare(used[i - 1], used[i]) != 0)
+			++nr_merged;
+
+		total = (struct kedr_stat_key *)
+			(result + nr_merged * t->entry_size);
+		total->k1 = used[i]->k1;
+		total->k2 = used[i]->k2;
+		merge(total, used[i]);
+	}
+	if (nr_used > 0)
+		++nr_merged;
+
+	vfree(used);
+	*merged = result;
+	return (long)nr_merged;
+}
+
+/* The functions below are executed on each CPU via on_each_cpu(), with
+ * interrupts disabled, so they cannot race with the writers to the table
+ * of that CPU. */
+static inline void
+kedr_stat_table_reset_on_cpu(void *info)
+{
+	struct kedr_stat_table *t = info;
+	struct kedr_stat_table_cpu *cpu_table = this_cpu_ptr(t->cpu_tables);
+
+	memset(cpu_table->entries, 0, kedr_stat_table_size(t) * t->entry_size);
+	cpu_table->dropped = 0;
+}
+
+struct kedr_stat_table_forget_info
+{
+	struct kedr_stat_table *t;
+	int (*match)(const void *entry, void *data);
+	void *data;
+};
+
+static inline void
+kedr_stat_table_forget_on_cpu(void *info)
+{
+	struct kedr_stat_table_forget_info *fi = info;
+	struct kedr_stat_table_cpu *cpu_table =
+		this_cpu_ptr(fi->t->cpu_tables);
+	unsigned long i;
+
+	for (i = 0; i < kedr_stat_table_size(fi->t); ++i) {
+		struct kedr_stat_key *key =
+			kedr_stat_table_entry(fi->t, cpu_table, i);
+
+		if (kedr_stat_key_is_used(key) && fi->match(key, fi->data)) {
+			WRITE_ONCE(key->k1, KEDR_STAT_KEY_REMOVED);
+			/* The entry may be claimed for another key later. */
+			memset(key + 1, 0, fi->t->entry_size - sizeof(*key));
+		}
+	}
+}
+
+/* Free all entries of the table and reset the counts of the dropped
+ * events. Should be called in process context. */
+static inline void
+kedr_stat_table_reset(struct kedr_stat_table *t)
+{
+	on_each_cpu(kedr_stat_table_reset_on_cpu, t, 1);
+}
+
+/* Remove the entries for which match(entry, data) returns nonzero, e.g.
+ * the ones which keys refer to the module being unloaded. The removed
+ * entries may be claimed for new keys. Should be called in process
+ * context. */
+static inline void
+kedr_stat_table_forget(struct kedr_stat_table *t,
+	int (*match)(const void *entry, void *data), void *data)
+{
+	struct kedr_stat_table_forget_info fi = {
+		.t = t,
+		.match = match,
+		.data = data,
+	};
+
+	on_each_cpu(kedr_stat_table_forget_on_cpu, &fi, 1);
+}
+
+/* ====================================================================== */
+/* A set of statistics in a single file in debugfs.
+ *
+ * The set is described by an array of struct kedr_stat_desc, the last
+ * element of which has NULL 'name'. The file contains one line per
+ * element: "<name>: <value>". For a histogram, the line contains the
+ * nonempty buckets: "<name>: <low>-<high>: <count> ...". */
+
+enum kedr_stat_type
+{
+	KEDR_STAT_COUNTER,
+	KEDR_STAT_MAX,
+	KEDR_STAT_MIN,
+	KEDR_STAT_HIST
+};
+
+struct kedr_stat_desc
+{
+	const char *name;
+	enum kedr_stat_type type;
+	const void *stat;
+};
+
+#define KEDR_STAT_DESC_COUNTER(__name, __counter) \
+	{ .name = (__name), .type = KEDR_STAT_COUNTER, .stat = (__counter) }
+#define KEDR_STAT_DESC_MAX(__name, __max) \
+	{ .name = (__name), .type = KEDR_STAT_MAX, .stat = (__max) }
+#define KEDR_STAT_DESC_MIN(__name, __min) \
+	{ .name = (__name), .type = KEDR_STAT_MIN, .stat = (__min) }
+#define KEDR_STAT_DESC_HIST(__name, __hist) \
+	{ .name = (__name), .type = KEDR_STAT_HIST, .stat = (__hist) }
+#define KEDR_STAT_DESC_END { .name = NULL }
+
+static inline void
+kedr_stat_show_hist(struct seq_file *m, const struct kedr_stat_hist *h)
+{
+	struct kedr_stat_hist_data *data;
+	int i;
+
+	/* Too large for the stack. */
+	data = kmalloc(sizeof(*data), GFP_KERNEL);
+	if (data == NULL) {
+		seq_printf(m, " <not enough memory>");
+		return;
+	}
+
+	kedr_stat_hist_read(h, data);
+	for (i = 0; i < KEDR_STAT_HIST_BUCKETS; ++i) {
+		unsigned long long lo;
+
+		if (data->buckets[i] == 0)
+			continue;
+
+		/* (lo << 1) - 1 is the maximum u64 for the last bucket. */
+		lo = (i > 0) ? (1ULL << (i - 1)) : 0;
+		seq_printf(m, " %llu-%llu: %llu", lo,
+			(i > 0) ? (lo << 1) - 1 : 0,
+			(unsigned long long)data->buckets[i]);
+	}
+	kfree(data);
+}
+
+static inline int
+kedr_stat_show(struct seq_file *m, void *v)
+{
+	const struct kedr_stat_desc *desc;
+
+	for (desc = m->private; desc->name != NULL; ++desc) {
+		seq_printf(m, "%s:", desc->name);
+
+		switch (desc->type) {
+		case KEDR_STAT_COUNTER:
+			seq_printf(m, " %lld", (long long)
+				kedr_stat_counter_read(desc->stat));
+			break;
+		case KEDR_STAT_MAX:
+			seq_printf(m, " %llu", (unsigned long long)
+				kedr_stat_max_read(desc->stat));
+			break;
+		case KEDR_STAT_MIN: {
+			u64 value = kedr_stat_min_read(desc->stat);
+			if (value == ~(u64)0)
+				seq_printf(m, " -");
+			else
+				seq_printf(m, " %llu", (unsigned long long)value);
+			break;
+		}
+		case KEDR_STAT_HIST:
+			kedr_stat_show_hist(m, desc->stat);
+			break;
+		}
+		seq_putc(m, '\n');
+	}
+	return 0;
+}
+
+static inline int
+kedr_stat_open(struct inode *inode, struct file *filp)
+{
+	return single_open(filp, kedr_stat_show, inode->i_private);
+}
+
+static const struct file_operations kedr_stat_fops = {
+	.owner = THIS_MODULE,
+	.open = kedr_stat_open,
+	.read = seq_read,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
+/* Create a file in debugfs showing the statistics described by 'descs'.
+ * 'descs' and the statistics should live until the file is removed with
+ * debugfs_remove().
+ *
+ * Returns what debugfs_create_file() returns. */
+static inline struct dentry *
+kedr_stat_debugfs_create(const char *name, struct dentry *parent,
+	const struct kedr_stat_desc *descs)
+{
+	return debugfs_create_file(name, S_IRUGO, parent, (void *)descs,
+		&kedr_stat_fops);
+}
+
+#endif /* KEDR_PERCPU_STATS_H_1733_INCLUDED */
@@ -0,0 +1,25 @@
+/* read_once.h
+ * READ_ONCE() and WRITE_ONCE() for the kernels which do not provide them.
+ *
+ * ACCESS_ONCE() has been removed from the kernel in 4.15 in favour of
+ * these macros, which appeared in 3.19. KEDR uses READ_ONCE() and
+ * WRITE_ONCE() only, this header provides them for the older kernels.
+ *
+ * The fallbacks are not suitable for the aggregates, but KEDR does not
+ * access those this way. */
+
+#ifndef KEDR_READ_ONCE_H_1712_INCLUDED
+#define KEDR_READ_ONCE_H_1712_INCLUDED
+
+#include <linux/compiler.h>
+
+#ifndef READ_ONCE
+#define READ_ONCE(x) (*(volatile typeof(x) *)&(x))
+#endif
+
+#ifndef WRITE_ONCE
+#define WRITE_ONCE(x, val) \
+	do { *(volatile typeof(x) *)&(x) = (val); } while (0)
+#endif
+
+#endif /* KEDR_READ_ONCE_H_1712_INCLUDED */
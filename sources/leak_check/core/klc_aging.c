@@ -0,0 +1,279 @@
+/* klc_aging.c - statistics about the age of the allocations not freed yet,
+ * per call site. */
+
+/* ========================================================================
+ * Copyright (C) 2012, KEDR development team
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation.
+ ======================================================================== */
+
+#include <linux/kernel.h>
+#include <linux/errno.h>
+#include <linux/list.h>
+#include <linux/mutex.h>
+#include <linux/hash.h>
+#include <linux/slab.h>
+#include <linux/jiffies.h>
+#include <linux/math64.h>
+#include <linux/seq_file.h>
+
+#include "leak_check_impl.h"
+#include "klc_aging.h"
+
+#include "config.h"
+/* ====================================================================== */
+
+/* The statistics for a call site.
+ *
+ * The allocations made during the last KLC_AGE_EPOCHS epochs (including
+ * the current one) are counted separately for each epoch: 'counts[e %
+ * KLC_AGE_EPOCHS]' is the number of the allocations made during epoch 'e'
+ * and not freed yet. The allocations made earlier are counted in
+ * 'nr_older'. */
+struct klc_site
+{
+	struct hlist_node hlist;
+
+	/* The return address of the call to the allocation function. */
+	unsigned long call_site;
+
+	/* The number of the allocations made here and not freed yet. */
+	unsigned long nr_live;
+
+	/* The epoch 'counts' corresponds to. */
+	u64 last_epoch;
+
+	unsigned long counts[KLC_AGE_EPOCHS];
+	unsigned long nr_older;
+};
+
+/* The maximum number of the call sites shown by klc_aging_show(). */
+#define KLC_AGING_TOP 16
+/* ====================================================================== */
+
+static u64
+klc_epoch(u64 time)
+{
+	unsigned int epoch = (age_epoch != 0) ? age_epoch : 1;
+	return div_u64(time, epoch * HZ);
+}
+
+static u64
+klc_current_epoch(void)
+{
+	return klc_epoch(get_jiffies_64());
+}
+
+/* Make the counters of 'site' correspond to epoch 'epoch': the
+ * allocations that do not belong to the last KLC_AGE_EPOCHS epochs any
+ * longer are moved to 'nr_older'. */
+static void
+klc_site_advance(struct klc_site *site, u64 epoch)
+{
+	u64 steps;
+	u64 i;
+
+	if (epoch <= site->last_epoch)
+		return;
+
+	steps = epoch - site->last_epoch;
+	if (steps > KLC_AGE_EPOCHS)
+		steps = KLC_AGE_EPOCHS;
+
+	for (i = 1; i <= steps; ++i) {
+		unsigned int slot =
+			(unsigned int)((site->last_epoch + i) % KLC_AGE_EPOCHS);
+		site->nr_older += site->counts[slot];
+		site->counts[slot] = 0;
+	}
+	site->last_epoch = epoch;
+}
+
+/* Returns the counter for an allocation made during 'alloc_epoch',
+ * 'site' should already correspond to the current epoch. */
+static unsigned long *
+klc_site_counter(struct klc_site *site, u64 alloc_epoch)
+{
+	if (site->last_epoch - alloc_epoch >= KLC_AGE_EPOCHS)
+		return &site->nr_older;
+
+	return &site->counts[alloc_epoch % KLC_AGE_EPOCHS];
+}
+
+static struct klc_site *
+klc_site_lookup_or_create(struct kedr_leak_check *lc,
+	unsigned long call_site, u64 epoch)
+{
+	struct hlist_head *head;
+	struct klc_site *site;
+
+	head = &lc->sites[hash_long(call_site, KLC_SITE_HASH_BITS)];
+	kedr_hlist_for_each_entry(site, head, hlist) {
+		if (site->call_site == call_site)
+			return site;
+	}
+
+	site = kzalloc(sizeof(*site), GFP_KERNEL);
+	if (site == NULL)
+		return NULL;
+
+	site->call_site = call_site;
+	site->last_epoch = epoch;
+	hlist_add_head(&site->hlist, head);
+	return site;
+}
+/* ====================================================================== */
+
+void
+klc_aging_add(struct kedr_leak_check *lc, struct kedr_lc_resource_info *ri)
+{
+	u64 epoch = klc_current_epoch();
+	struct klc_site *site;
+
+	site = klc_site_lookup_or_create(lc, ri->call_site, epoch);
+	if (site == NULL) {
+		pr_warning(KEDR_LC_MSG_PREFIX "klc_aging_add(): "
+			"not enough memory to create the statistics "
+			"for a call site\n");
+		return;
+	}
+
+	klc_site_advance(site, epoch);
+	++*klc_site_counter(site, klc_epoch(ri->alloc_time));
+	++site->nr_live;
+	ri->site = site;
+}
+
+void
+klc_aging_remove(struct kedr_leak_check *lc,
+	struct kedr_lc_resource_info *ri)
+{
+	struct klc_site *site = ri->site;
+
+	if (site == NULL)
+		return;
+
+	klc_site_advance(site, klc_current_epoch());
+	--*klc_site_counter(site, klc_epoch(ri->alloc_time));
+	--site->nr_live;
+	ri->site = NULL;
+}
+
+void
+klc_aging_clear(struct kedr_leak_check *lc)
+{
+	struct klc_site *site;
+	struct hlist_head *head;
+	unsigned int i;
+
+	for (i = 0; i < KLC_SITE_TABLE_SIZE; ++i) {
+		head = &lc->sites[i];
+		while (!hlist_empty(head)) {
+			site = hlist_entry(head->first, struct klc_site,
+				hlist);
+			hlist_del(&site->hlist);
+			kfree(site);
+		}
+	}
+}
+/* ====================================================================== */
+
+struct klc_site_stats
+{
+	struct klc_site *site;
+
+	/* The number of the allocations older than the threshold. */
+	unsigned long nr_old;
+
+	/* The number of the allocations that have become older than the
+	 * threshold during the current epoch. */
+	unsigned long growth;
+};
+
+/* Insert 'stats' into 'top' (containing 'n' elements, ordered by 'growth'
+ * and then by 'nr_old', in descending order) if it is among the first
+ * KLC_AGING_TOP elements. Returns the new number of elements in 'top'. */
+static unsigned int
+klc_top_insert(struct klc_site_stats *top, unsigned int n,
+	const struct klc_site_stats *stats)
+{
+	unsigned int i = n;
+
+	while (i > 0 && (top[i - 1].growth < stats->growth ||
+		(top[i - 1].growth == stats->growth &&
+		 top[i - 1].nr_old < stats->nr_old))) {
+		if (i < KLC_AGING_TOP)
+			top[i] = top[i - 1];
+		--i;
+	}
+
+	if (i < KLC_AGING_TOP)
+		top[i] = *stats;
+
+	return (n < KLC_AGING_TOP) ? n + 1 : n;
+}
+
+int
+klc_aging_show(struct seq_file *m, struct kedr_leak_check *lc)
+{
+	struct klc_site_stats *top;
+	struct klc_site_stats stats;
+	struct klc_site *site;
+	unsigned int threshold;
+	unsigned int n = 0;
+	unsigned int i;
+	unsigned int k;
+	u64 epoch;
+
+	/* The threshold in epochs. There should be at least one epoch
+	 * younger than the threshold to count the growth. */
+	threshold = DIV_ROUND_UP(age_threshold, (age_epoch != 0) ? age_epoch : 1);
+	if (threshold == 0)
+		threshold = 1;
+	if (threshold > KLC_AGE_EPOCHS - 1)
+		threshold = KLC_AGE_EPOCHS - 1;
+
+	top = kcalloc(KLC_AGING_TOP, sizeof(*top), GFP_KERNEL);
+	if (top == NULL)
+		return -ENOMEM;
+
+	if (mutex_lock_killable(&lc->report_lock) != 0) {
+		kfree(top);
+		return -EINTR;
+	}
+
+	epoch = klc_current_epoch();
+	for (i = 0; i < KLC_SITE_TABLE_SIZE; ++i) {
+		kedr_hlist_for_each_entry(site, &lc->sites[i], hlist) {
+			klc_site_advance(site, epoch);
+
+			stats.site = site;
+			stats.nr_old = site->nr_older;
+			for (k = threshold; k < KLC_AGE_EPOCHS; ++k)
+				stats.nr_old += site->counts[
+					(epoch - k) % KLC_AGE_EPOCHS];
+			stats.growth = site->counts[
+				(epoch - threshold) % KLC_AGE_EPOCHS];
+
+			if (stats.nr_old != 0)
+				n = klc_top_insert(top, n, &stats);
+		}
+	}
+
+	seq_printf(m, "Epoch: %u s, age threshold: %u s\n",
+		(age_epoch != 0) ? age_epoch : 1,
+		threshold * ((age_epoch != 0) ? age_epoch : 1));
+	for (i = 0; i < n; ++i) {
+		seq_printf(m,
+		"[<%lx>] %pS: live: %lu, old: %lu, growth: %lu\n",
+			top[i].site->call_site, (void *)top[i].site->call_site,
+			top[i].site->nr_live, top[i].nr_old, top[i].growth);
+	}
+
+	mutex_unlock(&lc->report_lock);
+	kfree(top);
+	return 0;
+}
+/* ====================================================================== */
@@ -0,0 +1,42 @@
+/* klc_aging.h - statistics about the age of the allocations not freed yet.
+ *
+ * For each call site of the allocation functions in the target, LeakCheck
+ * counts the allocations made there and not freed yet, grouped by the
+ * "epoch" they were made in. An epoch is a period of 'age_epoch' seconds.
+ * The statistics is updated when the allocation and deallocation events
+ * are processed, so it is not needed to walk the storage of the
+ * allocations to find which call sites hold the old allocations. */
+
+#ifndef KLC_AGING_H_1207_INCLUDED
+#define KLC_AGING_H_1207_INCLUDED
+
+struct seq_file;
+struct kedr_leak_check;
+struct kedr_lc_resource_info;
+
+/* Account for the allocation event 'ri'.
+ *
+ * klc_aging_* functions should be called with 'lc->report_lock' locked.
+ * They cannot be used in atomic context. */
+void
+klc_aging_add(struct kedr_leak_check *lc, struct kedr_lc_resource_info *ri);
+
+/* Account for the deallocation of the resource described by 'ri' which
+ * has been passed to klc_aging_add() before. */
+void
+klc_aging_remove(struct kedr_leak_check *lc,
+	struct kedr_lc_resource_info *ri);
+
+/* Clear the statistics. */
+void
+klc_aging_clear(struct kedr_leak_check *lc);
+
+/* Output the call sites with the most allocations that have become older
+ * than 'age_threshold' seconds recently.
+ *
+ * Unlike other klc_aging_* functions, this one locks 'lc->report_lock'
+ * itself. */
+int
+klc_aging_show(struct seq_file *m, struct kedr_leak_check *lc);
+
+#endif /* KLC_AGING_H_1207_INCLUDED */
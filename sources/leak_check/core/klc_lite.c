@@ -0,0 +1,426 @@
+/* klc_lite.c - "lite" mode of LeakCheck, see klc_lite.h. */
+
+/* ========================================================================
+ * Copyright (C) 2012, KEDR development team
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation.
+ ======================================================================== */
+
+#include <linux/kernel.h>
+#include <linux/errno.h>
+#include <linux/hash.h>
+#include <linux/percpu.h>
+#include <linux/smp.h>
+#include <linux/irqflags.h>
+#include <linux/vmalloc.h>
+#include <linux/slab.h>
+#include <linux/string.h>
+#include <linux/seq_file.h>
+#include <asm/atomic.h>
+
+#include <kedr/util/read_once.h>
+
+#include "klc_lite.h"
+
+#include "config.h"
+/* ====================================================================== */
+
+/* The maximum number of the call sites that can be tracked. Must be a
+ * power of 2. */
+#define KLC_LITE_SITE_BITS	10
+#define KLC_LITE_SITES		(1 << KLC_LITE_SITE_BITS)
+
+/* How many entries are checked when looking for an object in the table
+ * before giving up. */
+#define KLC_LITE_MAX_PROBES	32
+
+/* The per-CPU changes of the counters of a call site are folded into the
+ * counters of the call site when they reach these values. */
+#define KLC_LITE_BATCH		64
+#define KLC_LITE_BATCH_BYTES	(1L << 20)
+
+/* The maximum number of the call sites shown by klc_lite_show(). */
+#define KLC_LITE_TOP		16
+
+/* A live object. 'addr' is 0 if the entry is not used. */
+struct klc_lite_object
+{
+	unsigned long addr;
+	u32 site;
+	/* The size of the object, sizes above U32_MAX are saturated. The
+	 * per-site totals use the saturated size too, so that they return
+	 * to 0 when all the objects are freed. */
+	u32 size;
+};
+
+/* A call site of the allocation functions. 'call_site' is 0 if the entry
+ * is not used. The entries are never released until the table is
+ * cleared. */
+struct klc_lite_site
+{
+	unsigned long call_site;
+
+	/* The number and the total size of the objects allocated here and
+	 * not freed yet, except the changes not folded from the per-CPU
+	 * batches yet. */
+	atomic_long_t count;
+	atomic_long_t bytes;
+};
+
+/* The data updated on a single CPU only, with interrupts disabled. */
+struct klc_lite_cpu
+{
+	/* The changes of the counters of the call sites not folded yet. */
+	int count[KLC_LITE_SITES];
+	long bytes[KLC_LITE_SITES];
+
+	unsigned long allocs;
+	unsigned long frees;
+	unsigned long untracked_frees;
+	/* The allocations not tracked because there was no room for the
+	 * object or for the call site. */
+	unsigned long dropped;
+};
+
+struct klc_lite
+{
+	struct klc_lite_object *objects;
+	unsigned int object_bits;
+
+	struct klc_lite_site *sites;
+
+	struct klc_lite_cpu __percpu *cpu;
+};
+
+/* The statistics for a call site collected for the report. */
+struct klc_lite_stats
+{
+	unsigned long call_site;
+	long count;
+	long bytes;
+};
+/* ====================================================================== */
+
+static unsigned long
+klc_lite_nr_objects(const struct klc_lite *lite)
+{
+	return 1UL << lite->object_bits;
+}
+
+/* Find the call site in the table, add it if it is not there. Returns the
+ * index of the call site or -1 if the table is full. */
+static int
+klc_lite_get_site(struct klc_lite *lite, unsigned long call_site)
+{
+	unsigned long i = hash_long(call_site, KLC_LITE_SITE_BITS);
+	unsigned int n;
+
+	/* The entries are never released, so the lookup may stop at the
+	 * first unused entry. */
+	for (n = 0; n < KLC_LITE_SITES; ++n, i = (i + 1) & (KLC_LITE_SITES - 1)) {
+		unsigned long cur = READ_ONCE(lite->sites[i].call_site);
+
+		if (cur == 0) {
+			cur = cmpxchg(&lite->sites[i].call_site, 0, call_site);
+			if (cur == 0)
+				return (int)i;
+		}
+		if (cur == call_site)
+			return (int)i;
+	}
+	return -1;
+}
+
+/* Claim an entry for the object. Returns NULL if there is no room. */
+static struct klc_lite_object *
+klc_lite_object_claim(struct klc_lite *lite, unsigned long addr)
+{
+	unsigned long mask = klc_lite_nr_objects(lite) - 1;
+	unsigned long i = hash_long(addr, lite->object_bits);
+	unsigned int n;
+
+	for (n = 0; n < KLC_LITE_MAX_PROBES; ++n, i = (i + 1) & mask) {
+		struct klc_lite_object *obj = &lite->objects[i];
+
+		if (READ_ONCE(obj->addr) != 0)
+			continue;
+		if (cmpxchg(&obj->addr, 0, addr) == 0)
+			return obj;
+	}
+	return NULL;
+}
+
+/* The released entries are not marked specially, so the whole probe
+ * window is checked. */
+static struct klc_lite_object *
+klc_lite_object_find(struct klc_lite *lite, unsigned long addr)
+{
+	unsigned long mask = klc_lite_nr_objects(lite) - 1;
+	unsigned long i = hash_long(addr, lite->object_bits);
+	unsigned int n;
+
+	for (n = 0; n < KLC_LITE_MAX_PROBES; ++n, i = (i + 1) & mask) {
+		if (READ_ONCE(lite->objects[i].addr) == addr)
+			return &lite->objects[i];
+	}
+	return NULL;
+}
+
+/* Add the changes to the per-CPU batch for the call site, fold the batch
+ * into the counters of the call site if it is large enough.
+ *
+ * Should be called with interrupts disabled. */
+static void
+klc_lite_account(struct klc_lite *lite, struct klc_lite_cpu *cpu,
+	unsigned int site, int count, long bytes)
+{
+	count += cpu->count[site];
+	bytes += cpu->bytes[site];
+
+	if (count >= KLC_LITE_BATCH || count <= -KLC_LITE_BATCH ||
+	    bytes >= KLC_LITE_BATCH_BYTES || bytes <= -KLC_LITE_BATCH_BYTES) {
+		atomic_long_add(count, &lite->sites[site].count);
+		atomic_long_add(bytes, &lite->sites[site].bytes);
+		count = 0;
+		bytes = 0;
+	}
+
+	cpu->count[site] = count;
+	cpu->bytes[site] = bytes;
+}
+/* ====================================================================== */
+
+void
+klc_lite_alloc(struct klc_lite *lite, const void *addr, size_t size,
+	const void *caller_address)
+{
+	struct klc_lite_object *obj = NULL;
+	struct klc_lite_cpu *cpu;
+	unsigned long irq_flags;
+	int site;
+
+	if (addr == NULL)
+		return;
+
+	site = klc_lite_get_site(lite, (unsigned long)caller_address);
+	if (site >= 0)
+		obj = klc_lite_object_claim(lite, (unsigned long)addr);
+
+	if (obj != NULL) {
+		/* The object cannot be freed until the allocation function
+		 * returns, so no one looks at these fields yet. */
+		obj->site = (u32)site;
+		obj->size = (size > U32_MAX) ? U32_MAX : (u32)size;
+	}
+
+	local_irq_save(irq_flags);
+	cpu = this_cpu_ptr(lite->cpu);
+	++cpu->allocs;
+	if (obj != NULL)
+		klc_lite_account(lite, cpu, (unsigned int)site, 1,
+			(long)obj->size);
+	else
+		++cpu->dropped;
+	local_irq_restore(irq_flags);
+}
+
+void
+klc_lite_free(struct klc_lite *lite, const void *addr)
+{
+	struct klc_lite_object *obj;
+	struct klc_lite_cpu *cpu;
+	unsigned long irq_flags;
+	unsigned int site = 0;
+	u32 size = 0;
+
+	if (addr == NULL)
+		return;
+
+	obj = klc_lite_object_find(lite, (unsigned long)addr);
+	if (obj != NULL) {
+		site = obj->site;
+		size = obj->size;
+
+		/* The fields are read before the entry may be claimed
+		 * again. */
+		smp_mb();
+		WRITE_ONCE(obj->addr, 0);
+	}
+
+	local_irq_save(irq_flags);
+	cpu = this_cpu_ptr(lite->cpu);
+	if (obj != NULL) {
+		++cpu->frees;
+		klc_lite_account(lite, cpu, site, -1, -(long)size);
+	}
+	else {
+		++cpu->untracked_frees;
+	}
+	local_irq_restore(irq_flags);
+}
+/* ====================================================================== */
+
+static void
+klc_lite_clear_cpu_data(struct klc_lite *lite)
+{
+	int cpu;
+
+	for_each_possible_cpu(cpu)
+		memset(per_cpu_ptr(lite->cpu, cpu), 0,
+			sizeof(struct klc_lite_cpu));
+}
+
+struct klc_lite *
+klc_lite_create(unsigned int object_bits)
+{
+	struct klc_lite *lite;
+
+	lite = kzalloc(sizeof(*lite), GFP_KERNEL);
+	if (lite == NULL)
+		return NULL;
+
+	lite->object_bits = object_bits;
+	lite->objects = vmalloc(klc_lite_nr_objects(lite) *
+		sizeof(struct klc_lite_object));
+	lite->sites = vmalloc(KLC_LITE_SITES * sizeof(struct klc_lite_site));
+	lite->cpu = alloc_percpu(struct klc_lite_cpu);
+	if (lite->objects == NULL || lite->sites == NULL ||
+	    lite->cpu == NULL) {
+		klc_lite_destroy(lite);
+		return NULL;
+	}
+
+	klc_lite_clear(lite);
+	return lite;
+}
+
+void
+klc_lite_destroy(struct klc_lite *lite)
+{
+	if (lite == NULL)
+		return;
+
+	if (lite->cpu != NULL)
+		free_percpu(lite->cpu);
+	vfree(lite->sites);
+	vfree(lite->objects);
+	kfree(lite);
+}
+
+void
+klc_lite_clear(struct klc_lite *lite)
+{
+	memset(lite->objects, 0,
+		klc_lite_nr_objects(lite) * sizeof(struct klc_lite_object));
+	memset(lite->sites, 0, KLC_LITE_SITES * sizeof(struct klc_lite_site));
+	klc_lite_clear_cpu_data(lite);
+}
+
+void
+klc_lite_get_totals(struct klc_lite *lite, u64 *total_allocs,
+	u64 *total_leaks, u64 *total_bad_frees)
+{
+	u64 allocs = 0;
+	u64 tracked = 0;
+	u64 bad_frees = 0;
+	int cpu;
+
+	for_each_possible_cpu(cpu) {
+		struct klc_lite_cpu *data = per_cpu_ptr(lite->cpu, cpu);
+
+		allocs += data->allocs;
+		tracked += data->allocs - data->dropped;
+		tracked -= data->frees;
+		bad_frees += data->untracked_frees;
+	}
+
+	*total_allocs = allocs;
+	*total_leaks = tracked;
+	*total_bad_frees = bad_frees;
+}
+/* ====================================================================== */
+
+/* Insert 'stats' into 'top' which contains 'n' elements sorted by the
+ * size of the objects not freed yet, in descending order. Returns the new
+ * number of the elements. */
+static unsigned int
+klc_lite_top_insert(struct klc_lite_stats *top, unsigned int n,
+	const struct klc_lite_stats *stats)
+{
+	unsigned int i = n;
+
+	while (i > 0 && (top[i - 1].bytes < stats->bytes ||
+		(top[i - 1].bytes == stats->bytes &&
+		 top[i - 1].count < stats->count))) {
+		if (i < KLC_LITE_TOP)
+			top[i] = top[i - 1];
+		--i;
+	}
+
+	if (i < KLC_LITE_TOP)
+		top[i] = *stats;
+
+	return (n < KLC_LITE_TOP) ? n + 1 : n;
+}
+
+int
+klc_lite_show(struct seq_file *m, struct klc_lite *lite)
+{
+	struct klc_lite_stats *top;
+	struct klc_lite_stats stats;
+	unsigned long dropped = 0;
+	u64 total_allocs;
+	u64 total_leaks;
+	u64 total_bad_frees;
+	unsigned int n = 0;
+	unsigned int i;
+	int cpu;
+
+	top = kcalloc(KLC_LITE_TOP, sizeof(*top), GFP_KERNEL);
+	if (top == NULL)
+		return -ENOMEM;
+
+	/* The counters are being changed while they are read, so the
+	 * results are approximate if the target is working. */
+	for (i = 0; i < KLC_LITE_SITES; ++i) {
+		stats.call_site = READ_ONCE(lite->sites[i].call_site);
+		if (stats.call_site == 0)
+			continue;
+
+		stats.count = atomic_long_read(&lite->sites[i].count);
+		stats.bytes = atomic_long_read(&lite->sites[i].bytes);
+		for_each_possible_cpu(cpu) {
+			struct klc_lite_cpu *data = per_cpu_ptr(lite->cpu, cpu);
+
+			stats.count += READ_ONCE(data->count[i]);
+			stats.bytes += READ_ONCE(data->bytes[i]);
+		}
+
+		if (stats.count > 0)
+			n = klc_lite_top_insert(top, n, &stats);
+	}
+
+	for_each_possible_cpu(cpu)
+		dropped += per_cpu_ptr(lite->cpu, cpu)->dropped;
+	klc_lite_get_totals(lite, &total_allocs, &total_leaks,
+		&total_bad_frees);
+
+	seq_printf(m,
+	"Allocations: %llu, not freed: %llu, untracked frees: %llu, "
+	"not tracked: %lu\n",
+		(unsigned long long)total_allocs,
+		(unsigned long long)total_leaks,
+		(unsigned long long)total_bad_frees,
+		dropped);
+	for (i = 0; i < n; ++i) {
+		seq_printf(m, "[<%lx>] %pS: objects: %ld, bytes: %ld\n",
+			top[i].call_site, (void *)top[i].call_site,
+			top[i].count, top[i].bytes);
+	}
+
+	kfree(top);
+	return 0;
+}
+/* ====================================================================== */
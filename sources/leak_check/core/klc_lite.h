@@ -0,0 +1,62 @@
+/* klc_lite.h - "lite" mode of LeakCheck: the memory not freed yet is
+ * accounted per call site of the allocation functions, without the call
+ * stacks and other details about each allocation.
+ *
+ * Each live object is kept in a compact open-addressing table as (address,
+ * call site id, size), 16 bytes per object on 64-bit systems. For each
+ * call site, the number of the objects allocated there and not freed yet
+ * and their total size are counted. The counters are updated in the
+ * per-CPU batches and are folded into the shared counters of the call site
+ * only when the batch becomes large enough.
+ *
+ * The events are processed right in the replacement functions: there is
+ * no stack unwinding, no symbol resolution and no work items. The call
+ * sites are resolved only when the report is read. If there is no room
+ * for an object in the table, the object is not tracked and its
+ * deallocation is counted as an untracked free. */
+
+#ifndef KLC_LITE_H_1045_INCLUDED
+#define KLC_LITE_H_1045_INCLUDED
+
+struct seq_file;
+struct klc_lite;
+
+/* The allowed range of 'object_bits' for klc_lite_create(). */
+#define KLC_LITE_OBJECT_BITS_MIN	8
+#define KLC_LITE_OBJECT_BITS_MAX	24
+
+/* Creates the storage for the "lite" mode, 2^object_bits objects can be
+ * tracked at most. Returns NULL if there is not enough memory. */
+struct klc_lite *
+klc_lite_create(unsigned int object_bits);
+
+void
+klc_lite_destroy(struct klc_lite *lite);
+
+/* Forget all the objects and the call sites. If the target is working
+ * while this function is running, the counters may become inaccurate. */
+void
+klc_lite_clear(struct klc_lite *lite);
+
+/* Account for the allocation and deallocation events.
+ *
+ * These functions may be used in atomic context. */
+void
+klc_lite_alloc(struct klc_lite *lite, const void *addr, size_t size,
+	const void *caller_address);
+
+void
+klc_lite_free(struct klc_lite *lite, const void *addr);
+
+/* Get the totals: the number of the allocations, of the objects not freed
+ * yet and of the deallocations for which no allocation has been tracked. */
+void
+klc_lite_get_totals(struct klc_lite *lite, u64 *total_allocs,
+	u64 *total_leaks, u64 *total_bad_frees);
+
+/* Output the call sites with the largest total size of the objects
+ * allocated there and not freed yet. */
+int
+klc_lite_show(struct seq_file *m, struct klc_lite *lite);
+
+#endif /* KLC_LITE_H_1045_INCLUDED */
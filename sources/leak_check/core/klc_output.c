@@ -26,9 +26,14 @@
 #include <linux/fs.h>
 #include <linux/vmalloc.h>
 #include <linux/uaccess.h>
+#include <linux/seq_file.h>
 
 #include "leak_check_impl.h"
 #include "klc_output.h"
+#include "klc_aging.h"
+#include "klc_lite.h"
+
+#include "config.h"
 /* ====================================================================== */
 
 /* Main directory for LeakCheck in debugfs. */
@@ -37,6 +42,29 @@ static struct dentry *dir_klc_main = NULL;
 
 /* A separator for the records in the report files. */
 static const char *sep = "----------------------------------------";
+
+/* Formats of the records in the report files. The same formats are used
+ * for the reports prepared when flushing the results and for the reports
+ * generated on read in the streaming mode. */
+static const char *fmt_stack_entry = "[<%lx>] %s";
+static const char *fmt_process_info = "Process: %s (PID: %d)";
+static const char *fmt_alloc = 
+	"Address: 0x%lx, size: %zu; stack trace of the allocation:";
+static const char *fmt_alloc_unknown = 
+	"Address: 0x%lx, size: unknown; stack trace of the allocation:";
+static const char *fmt_similar_allocs = 
+	"+%llu more allocation(s) with the same call stack.";
+static const char *fmt_dealloc = 
+	"Address: 0x%lx; stack trace of the deallocation:";
+static const char *fmt_similar_deallocs = 
+	"+%llu more deallocation(s) with the same call stack.";
+static const char *fmt_dealloc_note = 
+"The information about only %llu of the \"unallocated free\" events is " 
+"shown above. The data for other such events have been discarded to "
+"save memory.";
+static const char *fmt_allocs_total = "Allocations: %llu";
+static const char *fmt_leaks_total = "Possible leaks: %llu";
+static const char *fmt_bad_frees_total = "Unallocated frees: %llu";
 /* ====================================================================== */
 
 /* Types of information that can be output.
@@ -120,6 +148,13 @@ struct kedr_lc_output
 	 * allocations and deallocations collected so far. */
 	struct dentry *file_clear;
 	
+	/* The file with the call sites holding the old allocations. */
+	struct dentry *file_aging;
+	
+	/* The file with the call sites holding the most memory, only in
+	 * the "lite" mode. */
+	struct dentry *file_lite;
+	
 	/* Output buffers for each type of output resource. */
 	struct klc_output_buffer ob_leaks;
 	struct klc_output_buffer ob_bad_frees;
@@ -301,6 +336,355 @@ static const struct file_operations klc_fops = {
 	.read       = klc_read_common,
 };
 
+/* ====================================================================== */
+
+/* The files in debugfs for the streaming mode. The reports are generated
+ * from the storage of the LeakCheck object when the files are read, with 
+ * 'report_lock' of the object locked. The address of the LeakCheck object
+ * should be passed as 'data' to debugfs_create_file(). */
+
+/* The position in "possible_leaks" file. The upper bits contain the index 
+ * of the bucket in the storage, the lower KLC_POS_SEQ_BITS bits contain 
+ * (KLC_POS_SEQ_MASK - alloc_seq) for the element to be shown next. 
+ * Because the elements in a bucket are ordered by 'alloc_seq' in 
+ * descending order, the positions increase while reading. The position
+ * also remains valid if the elements are added to the storage or removed
+ * from it between the reads. */
+#define KLC_POS_SEQ_BITS 52
+#define KLC_POS_SEQ_MASK ((1ULL << KLC_POS_SEQ_BITS) - 1)
+
+static loff_t
+klc_leaks_pos(unsigned int bucket, u64 alloc_seq)
+{
+	return ((loff_t)bucket << KLC_POS_SEQ_BITS) | 
+		(loff_t)(KLC_POS_SEQ_MASK - (alloc_seq & KLC_POS_SEQ_MASK));
+}
+
+/* Finds the first element to be reported at position '*pos' or after it
+ * and sets '*pos' to the position of that element. Returns NULL and sets
+ * '*pos' past the end of the storage if there are no such elements. */
+static struct kedr_lc_resource_info *
+klc_leaks_find(struct kedr_leak_check *lc, loff_t *pos)
+{
+	struct kedr_lc_resource_info *ri;
+	unsigned int bucket = (unsigned int)(*pos >> KLC_POS_SEQ_BITS);
+	u64 max_seq = KLC_POS_SEQ_MASK - (*pos & KLC_POS_SEQ_MASK);
+
+	for (; bucket < KEDR_RI_TABLE_SIZE; ++bucket) {
+		kedr_hlist_for_each_entry(ri, &lc->allocs[bucket], hlist) {
+			if (ri->alloc_seq > max_seq || 
+			    ri->num_similar == (unsigned int)(-1))
+				continue;
+			
+			*pos = klc_leaks_pos(bucket, ri->alloc_seq);
+			return ri;
+		}
+		max_seq = KLC_POS_SEQ_MASK;
+	}
+	
+	*pos = (loff_t)KEDR_RI_TABLE_SIZE << KLC_POS_SEQ_BITS;
+	return NULL;
+}
+
+static void *
+klc_leaks_start(struct seq_file *m, loff_t *pos)
+{
+	struct kedr_leak_check *lc = m->private;
+	
+	BUILD_BUG_ON(KEDR_RI_HASH_BITS + KLC_POS_SEQ_BITS > 62);
+	
+	if (mutex_lock_killable(&lc->report_lock) != 0)
+		return ERR_PTR(-EINTR);
+	
+	/* The groups of similar allocations are found anew each time the 
+	 * file is read from the beginning. */
+	if (*pos == 0)
+		kedr_lc_group_allocs(lc);
+	
+	return klc_leaks_find(lc, pos);
+}
+
+static void *
+klc_leaks_next(struct seq_file *m, void *v, loff_t *pos)
+{
+	/* Only the elements with smaller 'alloc_seq' in this bucket and the 
+	 * elements of the following buckets remain. */
+	++*pos;
+	return klc_leaks_find(m->private, pos);
+}
+
+static void
+klc_report_stop(struct seq_file *m, void *v)
+{
+	struct kedr_leak_check *lc = m->private;
+	
+	if (!IS_ERR(v))
+		mutex_unlock(&lc->report_lock);
+}
+
+static void
+klc_seq_print_stack_trace(struct seq_file *m, 
+	struct stack_entry **stack_entries, unsigned int num_entries)
+{
+	unsigned int i;
+	
+	kedr_lc_resolve_stack_entries(stack_entries, num_entries);
+
+	for (i = 0; i < num_entries; ++i) {
+		seq_printf(m, fmt_stack_entry, 
+			(unsigned long)stack_entries[i]->addr, 
+			stack_entries[i]->symbolic);
+		seq_putc(m, '\n');
+	}
+}
+
+static void
+klc_seq_print_process_info(struct seq_file *m,
+	struct kedr_lc_resource_info *info)
+{
+	if (info->task_pid == -1)
+		seq_puts(m, "<IRQ>");
+	else
+		seq_printf(m, fmt_process_info, info->task_comm,
+			(int)info->task_pid);
+	seq_putc(m, '\n');
+}
+
+static int
+klc_leaks_show(struct seq_file *m, void *v)
+{
+	struct kedr_lc_resource_info *ri = v;
+	
+	klc_seq_print_process_info(m, ri);
+	
+	if (ri->size != 0)
+		seq_printf(m, fmt_alloc, (unsigned long)ri->addr, ri->size);
+	else
+		seq_printf(m, fmt_alloc_unknown, (unsigned long)ri->addr);
+	seq_putc(m, '\n');
+	
+	klc_seq_print_stack_trace(m, ri->stack_entries, ri->num_entries);
+	
+	if (ri->num_similar != 0) {
+		seq_printf(m, fmt_similar_allocs, 
+			(unsigned long long)ri->num_similar);
+		seq_putc(m, '\n');
+	}
+	
+	seq_printf(m, "%s\n", sep);
+	return 0;
+}
+
+static const struct seq_operations klc_leaks_seq_ops = {
+	.start = klc_leaks_start,
+	.next  = klc_leaks_next,
+	.stop  = klc_report_stop,
+	.show  = klc_leaks_show,
+};
+
+/* The position in "unallocated_frees" file is the index of the group of
+ * bad frees. The groups are never removed from the LeakCheck object, 
+ * except when the object is reset. The note about the discarded events, 
+ * if needed, follows the last group. */
+static char klc_dealloc_note_token;
+
+static void *
+klc_bad_frees_find(struct kedr_leak_check *lc, loff_t pos)
+{
+	if (pos < lc->nr_bad_free_groups)
+		return &lc->bad_free_groups[pos];
+	
+	if (pos == lc->nr_bad_free_groups && lc->total_bad_frees != 0)
+		return &klc_dealloc_note_token;
+	
+	return NULL;
+}
+
+static void *
+klc_bad_frees_start(struct seq_file *m, loff_t *pos)
+{
+	struct kedr_leak_check *lc = m->private;
+	
+	if (mutex_lock_killable(&lc->report_lock) != 0)
+		return ERR_PTR(-EINTR);
+	
+	return klc_bad_frees_find(lc, *pos);
+}
+
+static void *
+klc_bad_frees_next(struct seq_file *m, void *v, loff_t *pos)
+{
+	++*pos;
+	return klc_bad_frees_find(m->private, *pos);
+}
+
+static int
+klc_bad_frees_show(struct seq_file *m, void *v)
+{
+	struct kedr_leak_check *lc = m->private;
+	struct kedr_lc_bad_free_group *group = v;
+	u64 stored = 0;
+	unsigned int i;
+	
+	if (v == &klc_dealloc_note_token) {
+		for (i = 0; i < lc->nr_bad_free_groups; ++i)
+			stored += lc->bad_free_groups[i].nr_items;
+		
+		if (stored != lc->total_bad_frees) {
+			seq_printf(m, fmt_dealloc_note, 
+				(unsigned long long)stored);
+			seq_putc(m, '\n');
+		}
+		return 0;
+	}
+	
+	klc_seq_print_process_info(m, group->ri);
+	seq_printf(m, fmt_dealloc, (unsigned long)group->ri->addr);
+	seq_putc(m, '\n');
+	
+	klc_seq_print_stack_trace(m, group->ri->stack_entries, 
+		group->ri->num_entries);
+	
+	if (group->nr_items > 1) {
+		seq_printf(m, fmt_similar_deallocs, 
+			(unsigned long long)(group->nr_items - 1));
+		seq_putc(m, '\n');
+	}
+	
+	seq_printf(m, "%s\n", sep);
+	return 0;
+}
+
+static const struct seq_operations klc_bad_frees_seq_ops = {
+	.start = klc_bad_frees_start,
+	.next  = klc_bad_frees_next,
+	.stop  = klc_report_stop,
+	.show  = klc_bad_frees_show,
+};
+
+static int 
+klc_leaks_open(struct inode *inode, struct file *filp)
+{
+	int ret = seq_open(filp, &klc_leaks_seq_ops);
+	if (ret == 0)
+		((struct seq_file *)filp->private_data)->private = 
+			inode->i_private;
+	return ret;
+}
+
+static int 
+klc_bad_frees_open(struct inode *inode, struct file *filp)
+{
+	int ret = seq_open(filp, &klc_bad_frees_seq_ops);
+	if (ret == 0)
+		((struct seq_file *)filp->private_data)->private = 
+			inode->i_private;
+	return ret;
+}
+
+static const struct file_operations klc_leaks_stream_fops = {
+	.owner      = THIS_MODULE,
+	.open       = klc_leaks_open,
+	.read       = seq_read,
+	.llseek     = seq_lseek,
+	.release    = seq_release,
+};
+
+static const struct file_operations klc_bad_frees_stream_fops = {
+	.owner      = THIS_MODULE,
+	.open       = klc_bad_frees_open,
+	.read       = seq_read,
+	.llseek     = seq_lseek,
+	.release    = seq_release,
+};
+
+/* "info" file is small: the information about the targets is taken from
+ * the output buffer as usual, the totals are taken from the LeakCheck
+ * object. */
+static int
+klc_info_show(struct seq_file *m, void *v)
+{
+	struct kedr_leak_check *lc = m->private;
+	struct klc_output_buffer *ob = &lc->output->ob_other;
+	
+	if (mutex_lock_killable(&ob->lock) != 0)
+		return -EINTR;
+	seq_puts(m, ob->buf);
+	mutex_unlock(&ob->lock);
+	
+	if (mutex_lock_killable(&lc->report_lock) != 0)
+		return -EINTR;
+	seq_printf(m, fmt_allocs_total, 
+		(unsigned long long)lc->total_allocs);
+	seq_putc(m, '\n');
+	seq_printf(m, fmt_leaks_total, 
+		(unsigned long long)lc->total_leaks);
+	seq_putc(m, '\n');
+	seq_printf(m, fmt_bad_frees_total, 
+		(unsigned long long)lc->total_bad_frees);
+	seq_putc(m, '\n');
+	mutex_unlock(&lc->report_lock);
+	return 0;
+}
+
+static int 
+klc_info_open(struct inode *inode, struct file *filp)
+{
+	return single_open(filp, klc_info_show, inode->i_private);
+}
+
+static const struct file_operations klc_info_stream_fops = {
+	.owner      = THIS_MODULE,
+	.open       = klc_info_open,
+	.read       = seq_read,
+	.llseek     = seq_lseek,
+	.release    = single_release,
+};
+/* ====================================================================== */
+
+static int
+klc_aging_file_show(struct seq_file *m, void *v)
+{
+	return klc_aging_show(m, m->private);
+}
+
+static int 
+klc_aging_open(struct inode *inode, struct file *filp)
+{
+	return single_open(filp, klc_aging_file_show, inode->i_private);
+}
+
+static const struct file_operations klc_aging_fops = {
+	.owner      = THIS_MODULE,
+	.open       = klc_aging_open,
+	.read       = seq_read,
+	.llseek     = seq_lseek,
+	.release    = single_release,
+};
+/* ====================================================================== */
+
+static int
+klc_lite_file_show(struct seq_file *m, void *v)
+{
+	struct kedr_leak_check *lc = m->private;
+	return klc_lite_show(m, lc->lite);
+}
+
+static int 
+klc_lite_open(struct inode *inode, struct file *filp)
+{
+	return single_open(filp, klc_lite_file_show, inode->i_private);
+}
+
+static const struct file_operations klc_lite_fops = {
+	.owner      = THIS_MODULE,
+	.open       = klc_lite_open,
+	.read       = seq_read,
+	.llseek     = seq_lseek,
+	.release    = single_release,
+};
+/* ====================================================================== */
+
 static int
 klc_flush_open(struct inode *inode, struct file *filp)
 {
@@ -386,6 +770,14 @@ klc_remove_debugfs_files(struct kedr_lc_output *output)
 		debugfs_remove(output->file_clear);
 		output->file_clear = NULL;
 	}
+	if (output->file_aging != NULL) {
+		debugfs_remove(output->file_aging);
+		output->file_aging = NULL;
+	}
+	if (output->file_lite != NULL) {
+		debugfs_remove(output->file_lite);
+		output->file_lite = NULL;
+	}
 }
 
 /* [NB] We do not check here if debugfs is supported because this is done 
@@ -397,19 +789,26 @@ klc_create_debugfs_files(struct kedr_lc_output *output,
 	BUG_ON(output == NULL);
 	BUG_ON(dir_klc_main == NULL);
 	
-	output->file_leaks = debugfs_create_file("possible_leaks", 
-		S_IRUGO, dir_klc_main, &output->ob_leaks, &klc_fops);
-	if (output->file_leaks == NULL) 
-		goto fail;
-	
-	output->file_bad_frees = debugfs_create_file("unallocated_frees", 
-		S_IRUGO, dir_klc_main, &output->ob_bad_frees, &klc_fops);
-	if (output->file_bad_frees == NULL) 
-		goto fail;
-	
-	output->file_stats = debugfs_create_file("info", 
-		S_IRUGO, dir_klc_main, &output->ob_other, &klc_fops);
-	if (output->file_stats == NULL) 
+	if (stream_report != 0) {
+		output->file_leaks = debugfs_create_file("possible_leaks", 
+			S_IRUGO, dir_klc_main, lc, &klc_leaks_stream_fops);
+		output->file_bad_frees = debugfs_create_file(
+			"unallocated_frees", S_IRUGO, dir_klc_main, lc, 
+			&klc_bad_frees_stream_fops);
+		output->file_stats = debugfs_create_file("info", 
+			S_IRUGO, dir_klc_main, lc, &klc_info_stream_fops);
+	}
+	else {
+		output->file_leaks = debugfs_create_file("possible_leaks", 
+			S_IRUGO, dir_klc_main, &output->ob_leaks, &klc_fops);
+		output->file_bad_frees = debugfs_create_file(
+			"unallocated_frees", S_IRUGO, dir_klc_main, 
+			&output->ob_bad_frees, &klc_fops);
+		output->file_stats = debugfs_create_file("info", 
+			S_IRUGO, dir_klc_main, &output->ob_other, &klc_fops);
+	}
+	if (output->file_leaks == NULL || output->file_bad_frees == NULL ||
+	    output->file_stats == NULL) 
 		goto fail;
 
 	output->file_flush = debugfs_create_file("flush",
@@ -422,6 +821,18 @@ klc_create_debugfs_files(struct kedr_lc_output *output,
 	if (output->file_clear == NULL)
 		goto fail;
 
+	output->file_aging = debugfs_create_file("aging",
+		S_IRUGO, dir_klc_main, lc, &klc_aging_fops);
+	if (output->file_aging == NULL)
+		goto fail;
+
+	if (lc->lite != NULL) {
+		output->file_lite = debugfs_create_file("lite_sites",
+			S_IRUGO, dir_klc_main, lc, &klc_lite_fops);
+		if (output->file_lite == NULL)
+			goto fail;
+	}
+
 	return 0;
 
 fail:
@@ -552,6 +963,14 @@ klc_print_string(struct kedr_lc_output *output,
 	}
 	BUG_ON(ob->buf == NULL); 
 	
+	/* In the streaming mode, only the information about the targets is 
+	 * stored, the reports are generated when the files are read. */
+	if (stream_report != 0 && output_type != KLC_OTHER) {
+		if (syslog_output)
+			pr_warning(KEDR_LC_MSG_PREFIX "%s\n", s);
+		return;
+	}
+	
 	if (mutex_lock_killable(&ob->lock) != 0)
 	{
 		pr_warning(KEDR_LC_MSG_PREFIX "klc_print_string(): "
@@ -573,7 +992,7 @@ klc_print_stack_trace(struct kedr_lc_output *output,
 	enum klc_output_type output_type, 
 	struct stack_entry **stack_entries, unsigned int num_entries)
 {
-	static const char* fmt = "[<%lx>] %s";
+	const char *fmt = fmt_stack_entry;
 	char *buf = NULL;
 	int len;
 	unsigned int i;
@@ -657,9 +1076,6 @@ klc_print_process_info(struct kedr_lc_output *output,
 	struct kedr_lc_resource_info *info,
 	enum klc_output_type output_type)
 {
-	static const char* fmt_process_info =
-		"Process: %s (PID: %d)";
-
 	char *buf = NULL;
 	int len;
 
@@ -691,12 +1107,6 @@ void
 kedr_lc_print_alloc_info(struct kedr_lc_output *output, 
 	struct kedr_lc_resource_info *info, u64 similar_allocs)
 {
-	static const char* fmt_common = 
-	"Address: 0x%lx, size: %zu; stack trace of the allocation:";
-	
-	static const char* fmt_unknown = 
-	"Address: 0x%lx, size: unknown; stack trace of the allocation:";
-	
 	char *buf = NULL;
 	int len;
 	
@@ -705,11 +1115,11 @@ kedr_lc_print_alloc_info(struct kedr_lc_output *output,
 	klc_print_process_info(output, info, KLC_UNFREED_ALLOC);
 	
 	if (info->size != 0) {
-		len = snprintf(NULL, 0, fmt_common, (unsigned long)info->addr,
+		len = snprintf(NULL, 0, fmt_alloc, (unsigned long)info->addr,
 			info->size);
 	}
 	else {
-		len = snprintf(NULL, 0, fmt_unknown, (unsigned long)info->addr);
+		len = snprintf(NULL, 0, fmt_alloc_unknown, (unsigned long)info->addr);
 	}
 	buf = kmalloc(len + 1, GFP_KERNEL);
 	if (buf == NULL) {
@@ -720,10 +1130,10 @@ kedr_lc_print_alloc_info(struct kedr_lc_output *output,
 	}
 	
 	if (info->size != 0) {
-		snprintf(buf, len + 1, fmt_common, (unsigned long)info->addr, info->size);
+		snprintf(buf, len + 1, fmt_alloc, (unsigned long)info->addr, info->size);
 	}
 	else {
-		snprintf(buf, len + 1, fmt_unknown, (unsigned long)info->addr);
+		snprintf(buf, len + 1, fmt_alloc_unknown, (unsigned long)info->addr);
 	}
 	klc_print_string(output, KLC_UNFREED_ALLOC, buf);
 	kfree(buf);
@@ -733,7 +1143,7 @@ kedr_lc_print_alloc_info(struct kedr_lc_output *output,
 	
 	if (similar_allocs != 0) {
 		klc_print_u64(output, KLC_UNFREED_ALLOC, similar_allocs, 
-		"+%llu more allocation(s) with the same call stack.");
+			fmt_similar_allocs);
 	}
 	
 	klc_print_string(output, KLC_UNFREED_ALLOC, sep); /* separator */
@@ -743,8 +1153,7 @@ void
 kedr_lc_print_dealloc_info(struct kedr_lc_output *output, 
 	struct kedr_lc_resource_info *info, u64 similar_deallocs)
 {
-	static const char* fmt = 
-		"Address: 0x%lx; stack trace of the deallocation:";
+	const char *fmt = fmt_dealloc;
 	char *buf = NULL;
 	int len;
  
@@ -770,7 +1179,7 @@ kedr_lc_print_dealloc_info(struct kedr_lc_output *output,
 	
 	if (similar_deallocs != 0) {
 		klc_print_u64(output, KLC_BAD_FREE, similar_deallocs, 
-		"+%llu more deallocation(s) with the same call stack.");
+			fmt_similar_deallocs);
 	}
 	
 	klc_print_string(output, KLC_BAD_FREE, sep); /* separator */
@@ -783,12 +1192,24 @@ kedr_lc_print_totals(struct kedr_lc_output *output,
 	if (syslog_output != 0)
 		pr_warning(KEDR_LC_MSG_PREFIX "Totals:\n");
 	
-	klc_print_u64(output, KLC_OTHER, total_allocs, 
-		"Allocations: %llu");
-	klc_print_u64(output, KLC_OTHER, total_leaks,
-		"Possible leaks: %llu");
-	klc_print_u64(output, KLC_OTHER, total_bad_frees,
-		"Unallocated frees: %llu");
+	if (stream_report != 0) {
+		/* "info" file shows the current totals anyway. */
+		if (syslog_output != 0) {
+			pr_warning(KEDR_LC_MSG_PREFIX "Allocations: %llu\n",
+				(unsigned long long)total_allocs);
+			pr_warning(KEDR_LC_MSG_PREFIX "Possible leaks: %llu\n",
+				(unsigned long long)total_leaks);
+			pr_warning(KEDR_LC_MSG_PREFIX 
+				"Unallocated frees: %llu\n",
+				(unsigned long long)total_bad_frees);
+		}
+		return;
+	}
+	
+	klc_print_u64(output, KLC_OTHER, total_allocs, fmt_allocs_total);
+	klc_print_u64(output, KLC_OTHER, total_leaks, fmt_leaks_total);
+	klc_print_u64(output, KLC_OTHER, total_bad_frees, 
+		fmt_bad_frees_total);
 }
 
 void 
@@ -798,10 +1219,7 @@ kedr_lc_print_dealloc_note(struct kedr_lc_output *output,
 	if (reported == total)
 		return;
 	
-	klc_print_u64(output, KLC_BAD_FREE, reported,
-"The information about only %llu of the \"unallocated free\" events is " 
-"shown above. The data for other such events have been discarded to "
-"save memory.");
+	klc_print_u64(output, KLC_BAD_FREE, reported, fmt_dealloc_note);
 }
 /* ====================================================================== */
 
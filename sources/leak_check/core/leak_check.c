@@ -26,14 +26,18 @@
 #include <linux/string.h>
 #include <linux/slab.h>
 #include <linux/sched.h>
+#include <linux/jiffies.h>
 #include <linux/hardirq.h>
 
 #include <kedr/core/kedr.h>
+#include <kedr/core/kedr_overhead.h>
 #include <kedr/leak_check/leak_check.h>
 #include <kedr/util/stack_trace.h>
 
 #include "leak_check_impl.h"
 #include "klc_output.h"
+#include "klc_aging.h"
+#include "klc_lite.h"
 
 #include "config.h"
 /* ====================================================================== */
@@ -64,6 +68,37 @@ module_param(syslog_output, uint, S_IRUGO);
  * nevertheless. */
 unsigned int bad_free_groups_stored = 8;
 module_param(bad_free_groups_stored, uint, S_IRUGO);
+
+/* If non-zero, the reports about possible leaks and unallocated frees as
+ * well as the totals are not prepared when the results are flushed. 
+ * Instead, they are generated from the current contents of the storage
+ * each time the files in debugfs are read. This way, no memory is needed
+ * for the text of the reports, which may be large for large targets. */
+unsigned int stream_report = 0;
+module_param(stream_report, uint, S_IRUGO);
+
+/* The allocations not freed yet are grouped by their age for each call
+ * site: the groups correspond to the periods of 'age_epoch' seconds. 
+ * "aging" file shows the call sites where the most of the allocations
+ * have become older than 'age_threshold' seconds recently. */
+unsigned int age_epoch = 10;
+module_param(age_epoch, uint, S_IRUGO);
+
+unsigned int age_threshold = 60;
+module_param(age_threshold, uint, S_IRUGO);
+
+/* If non-zero, LeakCheck works in the "lite" mode: the call stacks are not
+ * collected and only the number and the total size of the objects not
+ * freed yet are reported for each call site of the allocation functions
+ * (see klc_lite.h). The overhead is much lower than in the full mode,
+ * which is useful for the large targets under load. The results are in
+ * "lite_sites" file. At most 2^lite_object_bits objects can be tracked
+ * at the same time. */
+unsigned int lite_mode = 0;
+module_param(lite_mode, uint, S_IRUGO);
+
+unsigned int lite_object_bits = 16;
+module_param(lite_object_bits, uint, S_IRUGO);
 /* ====================================================================== */
 /* Global leak check object. */
 static struct kedr_leak_check* lc_object;
@@ -313,11 +348,13 @@ resource_info_create(const void *addr, size_t size,
 {
 	struct kedr_lc_resource_info *info;
 	unsigned long flags;
+	u64 overhead_start = kedr_overhead_begin();
 
 	info = kzalloc(sizeof(*info), GFP_ATOMIC);
 	if (info != NULL) {
 		int i;
 		unsigned long stack_addrs[ARRAY_SIZE(info->stack_entries)];
+		u64 stack_start;
 		// TODO: It seems that 'current' is valid even in interrupts.
 		if (!kedr_in_interrupt()) {
 			struct task_struct *task = current;
@@ -343,6 +380,8 @@ resource_info_create(const void *addr, size_t size,
 
 		info->addr = addr;
 		info->size  = size;
+		info->call_site = (unsigned long)caller_address;
+		info->alloc_time = get_jiffies_64();
 
 /* [NB] It appears that the implementation of save_stack_trace() is not 
  * guaranteed to be thread-safe as of this writing if the kernel uses DWARF2
@@ -351,10 +390,12 @@ resource_info_create(const void *addr, size_t size,
 
 		spin_lock_irqsave(&stack_entry_lock, flags);
 
+		stack_start = kedr_overhead_begin();
 		kedr_save_stack_trace(stack_addrs,
 			stack_depth,
 			&info->num_entries,
 			(unsigned long)caller_address);
+		kedr_overhead_end(KEDR_OVERHEAD_STACK_TRACE, NULL, stack_start);
 
 		for(i = 0; i < info->num_entries; i++)
 		{
@@ -364,6 +405,8 @@ resource_info_create(const void *addr, size_t size,
 
 		INIT_HLIST_NODE(&info->hlist);
 	}
+
+	kedr_overhead_end(KEDR_OVERHEAD_RESOURCE_INFO, NULL, overhead_start);
 	return info;
 }
 
@@ -449,6 +492,17 @@ lc_object_create(void)
 		return NULL;
 	}
 	
+	/* The output object needs to know if the "lite" mode is used, so
+	 * this is done first. */
+	if (lite_mode != 0) {
+		lc->lite = klc_lite_create(lite_object_bits);
+		if (lc->lite == NULL) {
+			pr_warning(KEDR_LC_MSG_PREFIX
+		"Failed to create the storage for the \"lite\" mode\n");
+			goto fail_lite;
+		}
+	}
+	
 	lc->output = kedr_lc_output_create(lc);
 	BUG_ON(lc->output == NULL);
 	if (IS_ERR(lc->output)) {
@@ -460,6 +514,9 @@ lc_object_create(void)
 	
 	for (i = 0; i < KEDR_RI_TABLE_SIZE; ++i)
 		INIT_HLIST_HEAD(&lc->allocs[i]);
+	
+	for (i = 0; i < KLC_SITE_TABLE_SIZE; ++i)
+		INIT_HLIST_HEAD(&lc->sites[i]);
 
 	lc->bad_free_groups = kzalloc(bad_free_groups_stored * 
 		sizeof(struct kedr_lc_bad_free_group), GFP_KERNEL);
@@ -469,6 +526,8 @@ lc_object_create(void)
 		goto fail_bad_free_groups;
 	}
 	/* nr_bad_free_groups is now 0. */
+	mutex_init(&lc->report_lock);
+	
 	lc->wq = create_singlethread_workqueue(wq_name);
 	if (lc->wq == NULL) {
 		pr_warning(KEDR_LC_MSG_PREFIX
@@ -481,10 +540,13 @@ lc_object_create(void)
 	return lc;
 
 fail_wq:
+	mutex_destroy(&lc->report_lock);
 	kfree(lc->bad_free_groups);
 fail_bad_free_groups:
 	kedr_lc_output_destroy(lc->output);
 fail_output:
+	klc_lite_destroy(lc->lite);
+fail_lite:
 	kfree(lc);
 	return NULL;
 }
@@ -505,14 +567,17 @@ lc_object_destroy(struct kedr_leak_check *lc)
 
 	klc_clear_allocs(lc);
 	klc_clear_deallocs(lc);
+	klc_aging_clear(lc);
 	
 	/* The table of resource leaks should be already empty.
 	 * Warn if it is not. */
 	for (i = 0; i < KEDR_RI_TABLE_SIZE; ++i)
 		WARN_ON_ONCE(!hlist_empty(&lc->allocs[i]));
 	
+	mutex_destroy(&lc->report_lock);
 	kfree(lc->bad_free_groups);
 	kedr_lc_output_destroy(lc->output);
+	klc_lite_destroy(lc->lite);
 	kfree(lc);
 }
 
@@ -524,13 +589,18 @@ lc_object_reset(struct kedr_leak_check *lc)
 {
 	kedr_lc_output_clear(lc->output);
 
+	mutex_lock(&lc->report_lock);
 	klc_clear_allocs(lc);
 	klc_clear_deallocs(lc);
+	klc_aging_clear(lc);
+	if (lc->lite != NULL)
+		klc_lite_clear(lc->lite);
 	
 	lc->nr_bad_free_groups = 0;
 	lc->total_allocs = 0;
 	lc->total_leaks = 0;
 	lc->total_bad_frees = 0;
+	mutex_unlock(&lc->report_lock);
 }
 
 /* ====================================================================== */
@@ -670,6 +740,7 @@ find_and_remove_alloc(const void *addr, struct kedr_leak_check *lc)
 	ri = ri_find_and_remove(addr, &lc->allocs[0]);
 	if (ri) {
 		ret = 1;
+		klc_aging_remove(lc, ri);
 		resource_info_destroy(ri);
 		--lc->total_leaks;
 	}
@@ -683,17 +754,13 @@ find_and_remove_alloc(const void *addr, struct kedr_leak_check *lc)
  * This is because the wq is ordered and it is flushed in the "target
  * unload" handler before the functions are called. */
 
-static void
-klc_flush_allocs(struct kedr_leak_check *lc)
+void
+kedr_lc_group_allocs(struct kedr_leak_check *lc)
 {
 	struct kedr_lc_resource_info *ri = NULL;
 	struct hlist_node *tmp = NULL;
 	struct hlist_head *head = NULL;
 	unsigned int i;
-	
-	if (syslog_output != 0 && lc->total_leaks != 0)
-		pr_warning(KEDR_LC_MSG_PREFIX 
-			"LeakCheck has detected possible memory leaks: \n");
 
 	for (i = 0; i < KEDR_RI_TABLE_SIZE; ++i) {
 		head = &lc->allocs[i];
@@ -714,6 +781,30 @@ klc_flush_allocs(struct kedr_leak_check *lc)
 	 * to reduce the needed size of the output buffer and to make the
 	 * report more readable. */
 			ri_count_similar(ri, &lc->allocs[0], i);
+		}
+	} 
+}
+
+static void
+klc_flush_allocs(struct kedr_leak_check *lc)
+{
+	struct kedr_lc_resource_info *ri = NULL;
+	struct hlist_node *tmp = NULL;
+	struct hlist_head *head = NULL;
+	unsigned int i;
+	
+	if (syslog_output != 0 && lc->total_leaks != 0)
+		pr_warning(KEDR_LC_MSG_PREFIX 
+			"LeakCheck has detected possible memory leaks: \n");
+
+	kedr_lc_group_allocs(lc);
+	
+	for (i = 0; i < KEDR_RI_TABLE_SIZE; ++i) {
+		head = &lc->allocs[i];
+		kedr_hlist_for_each_entry_safe(ri, tmp, head, hlist) {
+			if (ri->num_similar == (unsigned int)(-1))
+				continue;
+			
 			kedr_lc_print_alloc_info(lc->output, ri,
 						 (u64)ri->num_similar);
 		}
@@ -750,6 +841,11 @@ klc_flush_deallocs(struct kedr_leak_check *lc)
 static void
 klc_flush_stats(struct kedr_leak_check *lc)
 {
+	/* In the "lite" mode, the totals are maintained by klc_lite_*(). */
+	if (lc->lite != NULL)
+		klc_lite_get_totals(lc->lite, &lc->total_allocs,
+			&lc->total_leaks, &lc->total_bad_frees);
+
 	kedr_lc_print_totals(lc->output, lc->total_allocs, lc->total_leaks,
 		lc->total_bad_frees);
 	/* If needed, the counters will be reset by lc_object_reset(). */
@@ -768,9 +864,15 @@ work_func_flush(struct work_struct *work)
 
 	kedr_lc_output_clear(lc->output);
 
-	klc_flush_allocs(lc);
-	klc_flush_deallocs(lc);
+	mutex_lock(&lc->report_lock);
+	/* In the streaming mode, the reports are generated when the files 
+	 * are read, so they are only needed here for the system log. */
+	if (stream_report == 0 || syslog_output != 0) {
+		klc_flush_allocs(lc);
+		klc_flush_deallocs(lc);
+	}
 	klc_flush_stats(lc);
+	mutex_unlock(&lc->report_lock);
 
 	kfree(klc_work);
 }
@@ -931,8 +1033,10 @@ static struct kedr_payload payload = {
 /* ====================================================================== */
 
 /* In work_func_*() functions, we do not need to use locks to protect the
- * storage of 'kedr_lc_resource_info' structures and the counters because
- * the work queue is ordered and does all this serialization already. */
+ * storage of 'kedr_lc_resource_info' structures and the counters from each
+ * other because the work queue is ordered and does all this serialization
+ * already. 'report_lock' is only taken to exclude the readers of the 
+ * report files in the streaming mode. */
 static void 
 work_func_alloc(struct work_struct *work)
 {
@@ -943,9 +1047,13 @@ work_func_alloc(struct work_struct *work)
 	
 	BUG_ON(info == NULL);
 
-	ri_add(info, &lc->allocs[0]);
+	mutex_lock(&lc->report_lock);
 	++lc->total_allocs;
 	++lc->total_leaks;
+	info->alloc_seq = lc->total_allocs;
+	ri_add(info, &lc->allocs[0]);
+	klc_aging_add(lc, info);
+	mutex_unlock(&lc->report_lock);
 
 	kfree(klc_work);
 }
@@ -960,14 +1068,17 @@ work_func_free(struct work_struct *work)
 	
 	BUG_ON(info == NULL);
 	
+	mutex_lock(&lc->report_lock);
 	if (!find_and_remove_alloc(info->addr, lc)) {
 		ri_add_bad_free(info, lc);
 		++lc->total_bad_frees;
+		info = NULL;
 	}
-	else {
-		resource_info_destroy(info);
-	}
-		
+	mutex_unlock(&lc->report_lock);
+	
+	/* The structure is not needed if the matching allocation has been
+	 * found. */
+	resource_info_destroy(info);
 	kfree(klc_work);
 }
 
@@ -1006,6 +1117,10 @@ void
 kedr_lc_handle_alloc(const void *addr, size_t size, 
 	const void *caller_address)
 {
+	if (lc_object->lite != NULL) {
+		klc_lite_alloc(lc_object->lite, addr, size, caller_address);
+		return;
+	}
 	klc_handle_event(lc_object, addr, size, caller_address, work_func_alloc);
 }
 EXPORT_SYMBOL(kedr_lc_handle_alloc);
@@ -1014,6 +1129,10 @@ void
 kedr_lc_handle_free(const void *addr,
 	const void *caller_address)
 {
+	if (lc_object->lite != NULL) {
+		klc_lite_free(lc_object->lite, addr);
+		return;
+	}
 	klc_handle_event(lc_object, addr, (size_t)(-1), caller_address,
 		work_func_free);
 }
@@ -1114,6 +1233,18 @@ leak_check_init_module(void)
 		return -EINVAL;
 	}
 	
+	if (lite_mode != 0 && (lite_object_bits < KLC_LITE_OBJECT_BITS_MIN ||
+	    lite_object_bits > KLC_LITE_OBJECT_BITS_MAX)) {
+		pr_err(KEDR_LC_MSG_PREFIX
+		"Invalid value of 'lite_object_bits': %u (should be in "
+		"[%u, %u])\n",
+			lite_object_bits,
+			KLC_LITE_OBJECT_BITS_MIN,
+			KLC_LITE_OBJECT_BITS_MAX
+		);
+		return -EINVAL;
+	}
+	
 	ret = kedr_lc_output_init();
 	if (ret != 0)
 		return ret;
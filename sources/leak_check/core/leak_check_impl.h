@@ -6,6 +6,7 @@
 
 #include <linux/list.h>
 #include <linux/spinlock.h>
+#include <linux/mutex.h>
 #include <linux/sched.h>
 #include <linux/rbtree.h>
 #include <kedr/util/stack_trace.h>
@@ -13,6 +14,7 @@
 struct module;
 struct kedr_lc_resource_info;
 struct kedr_lc_output;
+struct klc_lite;
 
 /* An instance of struct kedr_leak_check ("LeakCheck object") is created for
  * and contains the data concerning the analysis of the module.
@@ -33,6 +35,18 @@ struct kedr_lc_output;
 #define KEDR_RI_HASH_BITS   10
 #define KEDR_RI_TABLE_SIZE  (1 << KEDR_RI_HASH_BITS)
 
+/* The statistics about the age of the allocations for the call sites 
+ * (see klc_aging.h) is stored in a hash table with KLC_SITE_TABLE_SIZE 
+ * buckets. */
+#define KLC_SITE_HASH_BITS  8
+#define KLC_SITE_TABLE_SIZE (1 << KLC_SITE_HASH_BITS)
+
+/* The number of the last epochs for which the allocations are counted
+ * separately in that statistics. Must be a power of 2. */
+#define KLC_AGE_EPOCHS      16
+
+struct klc_site;
+
 /* One stack entry, possibly resolved. */
 struct stack_entry
 {
@@ -70,6 +84,17 @@ struct kedr_leak_check
 	struct kedr_lc_bad_free_group *bad_free_groups;
 	unsigned int nr_bad_free_groups;
 	
+	/* The statistics about the age of the allocations not freed yet,
+	 * for each call site (struct klc_site). */
+	struct hlist_head sites[KLC_SITE_TABLE_SIZE];
+	
+	/* The per-call-site accounting used in the "lite" mode (see
+	 * 'lite_mode' parameter and klc_lite.h), NULL in the full mode.
+	 * In the "lite" mode, the allocation and deallocation events are
+	 * handled right away rather than in 'wq' and the storage above
+	 * stays empty. */
+	struct klc_lite *lite;
+	
 	/* A single-threaded (ordered) workqueue where the requests to 
 	 * handle allocations and deallocations are placed. It takes care of
 	 * serialization of access to the storage of kedr_lc_resource_info 
@@ -90,6 +115,13 @@ struct kedr_leak_check
 	 * workqueue. */
 	struct workqueue_struct *wq;
 	
+	/* Protects the storage and the totals from the concurrent access by
+	 * the work items in 'wq' and by the readers of the report files in
+	 * the streaming mode (see 'stream_report' parameter). The work items
+	 * are serialized by 'wq' itself, so the mutex is only needed to 
+	 * exclude the readers. */
+	struct mutex report_lock;
+	
 	/* Statistics: total number of the detected resource allocations,
 	 * possible leaks and unallocated frees. */
 	u64 total_allocs;
@@ -117,6 +149,21 @@ struct kedr_lc_resource_info
 	/* Number of events with the similar call stack. */
 	unsigned int num_similar;
 	
+	/* Sequence number of the allocation event in the current analysis
+	 * session, starting from 1. As the new elements are added to the 
+	 * head of a bucket, the elements of each bucket are ordered by
+	 * this number, in descending order. */
+	u64 alloc_seq;
+	
+	/* The return address of the call to the allocation or deallocation
+	 * function and the time of the event (in jiffies). */
+	unsigned long call_site;
+	u64 alloc_time;
+	
+	/* The statistics for the call site this allocation is accounted in,
+	 * NULL if it is not accounted anywhere. */
+	struct klc_site *site;
+	
 	/* Call stack */
 	unsigned int num_entries;
 	struct stack_entry* stack_entries[KEDR_MAX_FRAMES];
@@ -143,6 +190,10 @@ struct kedr_lc_bad_free_group
 
 #define KEDR_LC_MSG_PREFIX "[leak_check] "
 extern unsigned int syslog_output;
+extern unsigned int stream_report;
+extern unsigned int age_epoch;
+extern unsigned int age_threshold;
+extern unsigned int lite_mode;
 
 /* "Flush" the current results of memory leak detection to make them
  * available in the files in debugfs. Note that the memory that was
@@ -161,6 +212,16 @@ kedr_lc_flush_results(struct kedr_leak_check *lc);
 void
 kedr_lc_clear(struct kedr_leak_check *lc);
 
+/* Find the allocation events with the same call stacks in the storage, 
+ * so that only one event of each such group is reported. For this event,
+ * 'num_similar' is set to the number of the other events in the group, 
+ * for the other events it is set to (unsigned int)(-1).
+ * 
+ * Should be called with 'lc->report_lock' locked or from a work item 
+ * in 'lc->wq'. */
+void
+kedr_lc_group_allocs(struct kedr_leak_check *lc);
+
 /* Resolve stack entries, if them hasn't been resolved before. */
 void
 kedr_lc_resolve_stack_entries(struct stack_entry** entries,
@@ -0,0 +1,544 @@
+/* lockstat_module.c - profiling of the locks used by the target modules.
+ *
+ * The payload modules report when the target is about to acquire a lock,
+ * when it has acquired it and when it is about to release it. The time
+ * between the first two events is the wait time, the time between the
+ * last two is the hold time.
+ *
+ * The acquisitions in progress and the locks currently held are kept in
+ * two global open-addressing tables of pending records. A record is
+ * claimed with cmpxchg() and is then accessed only by its owner: the task
+ * waiting for the lock or the holder of the lock, so no locks are needed
+ * there.
+ *
+ * The times are accumulated per (lock, call site of the acquisition) in
+ * a keyed per-CPU table, see <kedr/util/percpu_stats.h>. */
+
+/* ========================================================================
+ * Copyright (C) 2012, KEDR development team
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation.
+ ======================================================================== */
+
+#include <linux/version.h>
+#include <linux/module.h>
+#include <linux/moduleparam.h>
+#include <linux/init.h>
+#include <linux/kernel.h>
+#include <linux/errno.h>
+#include <linux/mutex.h>
+#include <linux/hash.h>
+#include <linux/percpu.h>
+#include <linux/smp.h>
+#include <linux/sched.h>
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(4, 11, 0)
+#include <linux/sched/clock.h>
+#endif
+#include <linux/vmalloc.h>
+#include <linux/slab.h>
+#include <linux/sort.h>
+#include <linux/math64.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include <linux/fs.h>
+
+#include <kedr/lockstat/lockstat.h>
+#include <kedr/util/percpu_stats.h>
+#include <kedr/util/read_once.h>
+
+MODULE_AUTHOR("KEDR development team");
+MODULE_DESCRIPTION("KEDR lock profiling");
+MODULE_LICENSE("GPL");
+/* ====================================================================== */
+
+/* Number of bits in the index of the per-CPU table of statistics. */
+static unsigned int table_bits = 9;
+module_param(table_bits, uint, S_IRUGO);
+
+/* Number of bits in the index of the tables of pending records (the
+ * acquisitions in progress and the locks currently held). */
+static unsigned int pending_bits = 10;
+module_param(pending_bits, uint, S_IRUGO);
+
+/* How many locks are shown in the reports. */
+static unsigned int top_n = 20;
+module_param(top_n, uint, S_IRUGO | S_IWUSR);
+
+/* How many entries are checked when looking for a key in a table before
+ * giving up. */
+#define LOCKSTAT_MAX_PROBES 32
+
+struct lockstat_entry
+{
+	/* (lock, call_site) */
+	struct kedr_stat_key key;
+
+	unsigned long acquired;
+	/* Number of failed attempts (e.g. mutex_trylock() returned 0). */
+	unsigned long failed;
+
+	u64 wait_total;
+	u64 wait_max;
+	u64 hold_total;
+	u64 hold_max;
+};
+
+/* The events which were not accounted for because some of the tables was
+ * full are counted as dropped in this table. */
+static struct kedr_stat_table *table;
+
+struct lockstat_pending
+{
+	/* Address of the lock, 0 if the record is free. */
+	unsigned long lock;
+
+	/* The task waiting for the lock (for the acquisitions only). */
+	struct task_struct *task;
+
+	/* When the acquisition has started or the lock was acquired. */
+	u64 ts;
+
+	/* Where the lock was acquired (for the locks held only). */
+	void *call_site;
+};
+
+static struct lockstat_pending *waiting;
+static struct lockstat_pending *held;
+
+/* Serializes readers of the statistics with reset. */
+static DEFINE_MUTEX(lockstat_mutex);
+
+static struct dentry *dir_lockstat;
+static struct dentry *file_top_wait;
+static struct dentry *file_top_hold;
+static struct dentry *file_reset;
+/* ====================================================================== */
+
+static inline unsigned long
+pending_size(void)
+{
+	return 1UL << pending_bits;
+}
+
+static inline u64
+lockstat_now(void)
+{
+	return local_clock();
+}
+
+/* The clocks of different CPUs may be slightly out of sync. */
+static inline u64
+lockstat_duration(u64 start, u64 end)
+{
+	return (end > start) ? (end - start) : 0;
+}
+
+static void
+account_dropped(void)
+{
+	kedr_stat_table_drop(table);
+}
+/* ====================================================================== */
+
+/* Claim a free pending record for 'lock'. If 'task' is NULL, a record
+ * for the same lock is reused if there is one: it is left from the
+ * acquisition which release has not been seen. */
+static struct lockstat_pending *
+pending_claim(struct lockstat_pending *records, void *lock,
+	struct task_struct *task)
+{
+	unsigned long mask = pending_size() - 1;
+	unsigned long i = hash_ptr(lock, pending_bits);
+	unsigned int n;
+
+	if (task == NULL) {
+		unsigned long k = i;
+
+		for (n = 0; n < LOCKSTAT_MAX_PROBES; ++n, k = (k + 1) & mask) {
+			if (READ_ONCE(records[k].lock) == (unsigned long)lock)
+				return &records[k];
+		}
+	}
+
+	for (n = 0; n < LOCKSTAT_MAX_PROBES; ++n, i = (i + 1) & mask) {
+		struct lockstat_pending *record = &records[i];
+
+		if (READ_ONCE(record->lock) != 0)
+			continue;
+		if (cmpxchg(&record->lock, 0, (unsigned long)lock) == 0) {
+			record->task = task;
+			return record;
+		}
+	}
+	return NULL;
+}
+
+/* The deleted records are not marked specially, so the whole probe
+ * window is checked. */
+static struct lockstat_pending *
+pending_find(struct lockstat_pending *records, void *lock,
+	struct task_struct *task)
+{
+	unsigned long mask = pending_size() - 1;
+	unsigned long i = hash_ptr(lock, pending_bits);
+	unsigned int n;
+
+	for (n = 0; n < LOCKSTAT_MAX_PROBES; ++n, i = (i + 1) & mask) {
+		struct lockstat_pending *record = &records[i];
+
+		if (READ_ONCE(record->lock) == (unsigned long)lock &&
+		    record->task == task)
+			return record;
+	}
+	return NULL;
+}
+
+static void
+pending_free(struct lockstat_pending *record)
+{
+	/* Otherwise, the task could find the record just claimed by another
+	 * task for the same lock. */
+	record->task = NULL;
+
+	/* The fields are read before the record may be claimed again. */
+	smp_mb();
+	WRITE_ONCE(record->lock, 0);
+}
+/* ====================================================================== */
+
+static void
+account_acquire(void *lock, void *call_site, int acquired, u64 wait,
+	int has_wait)
+{
+	unsigned long irq_flags;
+	struct lockstat_entry *entry;
+
+	local_irq_save(irq_flags);
+	entry = kedr_stat_table_get(table, (unsigned long)lock,
+		(unsigned long)call_site);
+	if (entry != NULL) {
+		if (acquired)
+			++entry->acquired;
+		else
+			++entry->failed;
+
+		if (has_wait) {
+			entry->wait_total += wait;
+			if (wait > entry->wait_max)
+				entry->wait_max = wait;
+		}
+	}
+	local_irq_restore(irq_flags);
+}
+
+static void
+account_hold(void *lock, void *call_site, u64 hold)
+{
+	unsigned long irq_flags;
+	struct lockstat_entry *entry;
+
+	local_irq_save(irq_flags);
+	entry = kedr_stat_table_get(table, (unsigned long)lock,
+		(unsigned long)call_site);
+	if (entry != NULL) {
+		entry->hold_total += hold;
+		if (hold > entry->hold_max)
+			entry->hold_max = hold;
+	}
+	local_irq_restore(irq_flags);
+}
+/* ====================================================================== */
+
+void
+kedr_lockstat_acquire_begin(void *lock)
+{
+	struct lockstat_pending *record;
+
+	record = pending_claim(waiting, lock, current);
+	if (record == NULL) {
+		account_dropped();
+		return;
+	}
+	record->ts = lockstat_now();
+}
+EXPORT_SYMBOL(kedr_lockstat_acquire_begin);
+
+void
+kedr_lockstat_acquire_end(void *lock, void *call_site, int acquired)
+{
+	u64 now = lockstat_now();
+	struct lockstat_pending *record;
+	u64 wait = 0;
+	int has_wait = 0;
+
+	record = pending_find(waiting, lock, current);
+	if (record != NULL) {
+		wait = lockstat_duration(record->ts, now);
+		has_wait = 1;
+		pending_free(record);
+	}
+
+	account_acquire(lock, call_site, acquired, wait, has_wait);
+	if (!acquired)
+		return;
+
+	record = pending_claim(held, lock, NULL);
+	if (record == NULL) {
+		account_dropped();
+		return;
+	}
+	record->call_site = call_site;
+	record->ts = now;
+}
+EXPORT_SYMBOL(kedr_lockstat_acquire_end);
+
+void
+kedr_lockstat_release(void *lock)
+{
+	u64 now = lockstat_now();
+	struct lockstat_pending *record;
+	void *call_site;
+	u64 hold;
+
+	record = pending_find(held, lock, NULL);
+	if (record == NULL)
+		return; /* Acquired before the target was loaded, etc. */
+
+	call_site = record->call_site;
+	hold = lockstat_duration(record->ts, now);
+	pending_free(record);
+
+	account_hold(lock, call_site, hold);
+}
+EXPORT_SYMBOL(kedr_lockstat_release);
+/* ====================================================================== */
+
+/* The largest totals go first. */
+static int
+entry_compare_wait(const void *lhs, const void *rhs)
+{
+	const struct lockstat_entry *a = lhs;
+	const struct lockstat_entry *b = rhs;
+
+	if (a->wait_total != b->wait_total)
+		return (a->wait_total > b->wait_total) ? -1 : 1;
+	return 0;
+}
+
+static int
+entry_compare_hold(const void *lhs, const void *rhs)
+{
+	const struct lockstat_entry *a = lhs;
+	const struct lockstat_entry *b = rhs;
+
+	if (a->hold_total != b->hold_total)
+		return (a->hold_total > b->hold_total) ? -1 : 1;
+	return 0;
+}
+
+static void
+entry_merge(void *merged, const void *entry_data)
+{
+	struct lockstat_entry *total = merged;
+	const struct lockstat_entry *entry = entry_data;
+
+	total->acquired += entry->acquired;
+	total->failed += entry->failed;
+	total->wait_total += entry->wait_total;
+	total->hold_total += entry->hold_total;
+	if (entry->wait_max > total->wait_max)
+		total->wait_max = entry->wait_max;
+	if (entry->hold_max > total->hold_max)
+		total->hold_max = entry->hold_max;
+}
+
+static void
+report_show_entry(struct seq_file *m, const struct lockstat_entry *entry)
+{
+	unsigned long n = entry->acquired + entry->failed;
+
+	seq_printf(m, "%p\t[<%p>] %pS\tacquired: %lu\tfailed: %lu\t"
+		"wait total: %llu\tmax: %llu\tavg: %llu\t"
+		"hold total: %llu\tmax: %llu\tavg: %llu\n",
+		(void *)entry->key.k1, (void *)entry->key.k2,
+		(void *)entry->key.k2,
+		entry->acquired, entry->failed,
+		(unsigned long long)entry->wait_total,
+		(unsigned long long)entry->wait_max,
+		(unsigned long long)(n ? div64_u64(entry->wait_total, n) : 0),
+		(unsigned long long)entry->hold_total,
+		(unsigned long long)entry->hold_max,
+		(unsigned long long)(entry->acquired ?
+			div64_u64(entry->hold_total, entry->acquired) : 0));
+}
+
+static int
+report_show(struct seq_file *m, void *v)
+{
+	int (*cmp)(const void *, const void *) = m->private;
+	void *data;
+	struct lockstat_entry *merged;
+	unsigned long dropped;
+	unsigned long limit = READ_ONCE(top_n);
+	long nr_merged;
+	long i;
+
+	mutex_lock(&lockstat_mutex);
+	nr_merged = kedr_stat_table_merge(table, entry_merge, &data,
+		&dropped);
+	mutex_unlock(&lockstat_mutex);
+
+	if (nr_merged < 0)
+		return (int)nr_merged;
+
+	merged = data;
+	sort(merged, nr_merged, sizeof(*merged), cmp, NULL);
+
+	seq_printf(m, "# Times are in nanoseconds.\n");
+	for (i = 0; i < nr_merged && (unsigned long)i < limit; ++i)
+		report_show_entry(m, &merged[i]);
+	seq_printf(m, "# Events not accounted for (tables are full): %lu\n",
+		dropped);
+
+	vfree(merged);
+	return 0;
+}
+
+static int
+top_wait_open(struct inode *inode, struct file *filp)
+{
+	return single_open(filp, report_show, entry_compare_wait);
+}
+
+static int
+top_hold_open(struct inode *inode, struct file *filp)
+{
+	return single_open(filp, report_show, entry_compare_hold);
+}
+
+static const struct file_operations top_wait_ops = {
+	.owner = THIS_MODULE,
+	.open = top_wait_open,
+	.read = seq_read,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
+static const struct file_operations top_hold_ops = {
+	.owner = THIS_MODULE,
+	.open = top_hold_open,
+	.read = seq_read,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
+/* The pending records are kept: the locks may be still held. */
+static ssize_t
+reset_write(struct file *filp, const char __user *buf, size_t count,
+	loff_t *f_pos)
+{
+	mutex_lock(&lockstat_mutex);
+	kedr_stat_table_reset(table);
+	mutex_unlock(&lockstat_mutex);
+	return count;
+}
+
+static const struct file_operations reset_ops = {
+	.owner = THIS_MODULE,
+	.write = reset_write,
+};
+/* ====================================================================== */
+
+static void
+tables_destroy(void)
+{
+	kedr_stat_table_destroy(table);
+	vfree(held);
+	vfree(waiting);
+}
+
+static int
+tables_create(void)
+{
+	waiting = vmalloc(pending_size() * sizeof(*waiting));
+	held = vmalloc(pending_size() * sizeof(*held));
+	table = kedr_stat_table_create(table_bits, LOCKSTAT_MAX_PROBES,
+		sizeof(struct lockstat_entry));
+	if (waiting == NULL || held == NULL || table == NULL) {
+		/* All of these accept NULL. */
+		tables_destroy();
+		return -ENOMEM;
+	}
+
+	memset(waiting, 0, pending_size() * sizeof(*waiting));
+	memset(held, 0, pending_size() * sizeof(*held));
+	return 0;
+}
+
+static int __init
+lockstat_init(void)
+{
+	int ret;
+
+	if (table_bits == 0 || table_bits > 20) {
+		pr_err("[kedr_lockstat] Invalid value of 'table_bits': %u\n",
+			table_bits);
+		return -EINVAL;
+	}
+	if (pending_bits == 0 || pending_bits > 20) {
+		pr_err("[kedr_lockstat] Invalid value of 'pending_bits': %u\n",
+			pending_bits);
+		return -EINVAL;
+	}
+
+	ret = tables_create();
+	if (ret != 0)
+		return ret;
+
+	ret = -ENOMEM;
+	dir_lockstat = debugfs_create_dir("kedr_lockstat", NULL);
+	if (dir_lockstat == NULL)
+		goto fail_dir;
+
+	file_top_wait = debugfs_create_file("top_wait", S_IRUSR, dir_lockstat,
+		NULL, &top_wait_ops);
+	if (file_top_wait == NULL)
+		goto fail_top_wait;
+
+	file_top_hold = debugfs_create_file("top_hold", S_IRUSR, dir_lockstat,
+		NULL, &top_hold_ops);
+	if (file_top_hold == NULL)
+		goto fail_top_hold;
+
+	file_reset = debugfs_create_file("reset", S_IWUSR, dir_lockstat,
+		NULL, &reset_ops);
+	if (file_reset == NULL)
+		goto fail_reset;
+
+	return 0;
+
+fail_reset:
+	debugfs_remove(file_top_hold);
+fail_top_hold:
+	debugfs_remove(file_top_wait);
+fail_top_wait:
+	debugfs_remove(dir_lockstat);
+fail_dir:
+	tables_destroy();
+	return ret;
+}
+
+static void __exit
+lockstat_exit(void)
+{
+	debugfs_remove(file_reset);
+	debugfs_remove(file_top_hold);
+	debugfs_remove(file_top_wait);
+	debugfs_remove(dir_lockstat);
+	tables_destroy();
+}
+
+module_init(lockstat_init);
+module_exit(lockstat_exit);
@@ -20,51 +20,70 @@ kedr_orig_<$function.name$>(<$argumentSpec_effective$>)
 static <$if returnType$><$returnType$><$else$>void<$endif$> kedr_intermediate_func_<$function.name$>(<$argumentSpec$>)
 {
     struct kedr_function_call_info call_info;
+    const struct kedr_intermediate_info* intermediate_info;
     <$if returnType$><$returnType$> ret_val;
-    <$endif$>call_info.return_address = __builtin_return_address(0);
+    <$endif$><$if timing$>u64 timing_start;
+    <$endif$>u64 overhead_start = kedr_overhead_begin();
+    u64 overhead_cycles;
+    call_info.return_address = __builtin_return_address(0);
+    intermediate_info = kedr_intermediate_info_get(
+        &kedr_intermediate_info_<$function.name$>, call_info.return_address);
     
     // Call all pre-functions.
-    if(kedr_intermediate_info_<$function.name$>.pre != NULL)
+    if(intermediate_info->pre != NULL)
     {
         void (**pre_function)(<$argumentSpec_comma$>struct kedr_function_call_info* call_info);
-        for(pre_function = (typeof(pre_function))kedr_intermediate_info_<$function.name$>.pre;
+        for(pre_function = (typeof(pre_function))intermediate_info->pre;
             *pre_function != NULL;
             ++pre_function)
         {
+            u64 handler_start = kedr_overhead_begin();
 <$argsCopy_declare$>
             (*pre_function)(<$argumentList_comma$>&call_info);
 <$argsCopy_finalize$>
+            kedr_overhead_end(KEDR_OVERHEAD_PRE, (void*)*pre_function, handler_start);
         }
     }
+    overhead_cycles = kedr_overhead_begin() - overhead_start;
     // Call replacement function
-    if(kedr_intermediate_info_<$function.name$>.replace != NULL)
+    if(intermediate_info->replace != NULL)
     {
         <$if returnType$><$returnType$><$else$>void<$endif$> (*replace_function)(<$argumentSpec_comma$> struct kedr_function_call_info* call_info) =
-            (typeof(replace_function))kedr_intermediate_info_<$function.name$>.replace;
+            (typeof(replace_function))intermediate_info->replace;
+        u64 handler_start = kedr_overhead_begin();
         
 <$argsCopy_declare$>
         <$if returnType$>ret_val = <$endif$>replace_function(<$argumentList_comma$>&call_info);
 <$argsCopy_finalize$>
+        kedr_overhead_end(KEDR_OVERHEAD_REPLACE, (void*)replace_function, handler_start);
     }
     // .. or original one.
     else
     {
 <$argsCopy_declare$>
-        <$if returnType$>ret_val = <$endif$><$if ellipsis$>kedr_orig_<$endif$><$function.name$>(<$argumentList$>);
-<$argsCopy_finalize$>
+<$if timing$>        timing_start = kedr_timing_begin();
+<$endif$>        <$if returnType$>ret_val = <$endif$><$if ellipsis$>kedr_orig_<$endif$><$function.name$>(<$argumentList$>);
+<$if timing$>        kedr_timing_end((void*)<$function.name$>, call_info.return_address, timing_start);
+<$endif$><$argsCopy_finalize$>
     }
+    overhead_start = kedr_overhead_begin();
     // Call all post-functions.
-    if(kedr_intermediate_info_<$function.name$>.post != NULL)
+    if(intermediate_info->post != NULL)
     {
         void (**post_function)(<$argumentSpec_comma$><$if returnType$><$returnType$>, <$endif$>struct kedr_function_call_info* call_info);
-        for(post_function = (typeof(post_function))kedr_intermediate_info_<$function.name$>.post;
+        for(post_function = (typeof(post_function))intermediate_info->post;
             *post_function != NULL;
             ++post_function)
         {
+            u64 handler_start = kedr_overhead_begin();
 <$argsCopy_declare$>
             (*post_function)(<$argumentList_comma$><$if returnType$>ret_val, <$endif$>&call_info);
 <$argsCopy_finalize$>
+            kedr_overhead_end(KEDR_OVERHEAD_POST, (void*)*post_function, handler_start);
         }
     }
+    // The intermediate function itself, except the original function.
+    kedr_overhead_account(KEDR_OVERHEAD_INTERMEDIATE, (void*)<$function.name$>,
+        overhead_cycles + (kedr_overhead_begin() - overhead_start));
     <$if returnType$>return ret_val;
 <$endif$>}
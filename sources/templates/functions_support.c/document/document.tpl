@@ -3,6 +3,7 @@
  */
 
 #include <kedr/core/kedr_functions_support.h>
+#include <kedr/core/kedr_overhead.h>
 #include <kedr/core/kedr.h> /* only for types definition */
 
 <$if concat(header)$><$header: join(\n)$>
@@ -22,7 +23,8 @@ static struct kedr_intermediate_impl intermediate_impl[] =
 static struct kedr_functions_support functions_support =
 {
 	<$if compile_as_module$>.mod = THIS_MODULE,
-	<$endif$>.intermediate_impl = intermediate_impl
+	<$endif$>.intermediate_impl = intermediate_impl,
+	.timing = <$if concat(timing)$>1<$else$>0<$endif$>
 };
 
 <$if compile_as_module$>
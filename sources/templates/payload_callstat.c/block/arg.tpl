@@ -0,0 +1 @@
+<$arg.type$> <$arg.name$>
@@ -0,0 +1 @@
+<$if concat(arg.name)$><$arg : join(, )$>, <$if ellipsis$>va_list args, <$endif$><$endif$>
@@ -0,0 +1,26 @@
+//***** Count calls of <$function.name$> *****//
+static struct kedr_callstat_func kedr_callstat_func_<$function.name$> =
+{
+	.name = "<$function.name$>",
+	.owner = THIS_MODULE
+};
+
+#define KEDR_<$if trace.happensBefore$>PRE<$else$>POST<$endif$>_<$function.name$>
+static void
+kedr_<$if trace.happensBefore$>pre<$else$>post<$endif$>_<$function.name$>(<$argumentSpec_comma$>
+	<$if trace.happensBefore$><$else$><$if returnType$><$returnType$> ret_val,
+	<$endif$><$endif$>struct kedr_function_call_info* call_info)
+{
+<$if callstat.retval$>	kedr_callstat_record_retval(&kedr_callstat_func_<$function.name$>,
+		call_info->return_address,
+		<$if callstat.isError$><$callstat.isError$><$else$>0<$endif$>,
+		<$if callstat.size$>(unsigned long)(<$callstat.size$>), 1<$else$>0, 0<$endif$>,
+		(long)(<$callstat.retval$>));
+<$else$><$if callstat.size$>	kedr_callstat_record_size(&kedr_callstat_func_<$function.name$>,
+		call_info->return_address,
+		<$if callstat.isError$><$callstat.isError$><$else$>0<$endif$>,
+		(unsigned long)(<$callstat.size$>));
+<$else$>	kedr_callstat_record(&kedr_callstat_func_<$function.name$>,
+		call_info->return_address,
+		<$if callstat.isError$><$callstat.isError$><$else$>0<$endif$>);
+<$endif$><$endif$>}
@@ -0,0 +1,26 @@
+<$if lockstat.acquire$>//***** Profile acquisitions of the locks by <$function.name$> *****//
+#define KEDR_PRE_<$function.name$>
+static void
+kedr_pre_<$function.name$>(<$argumentSpec_comma$>
+	struct kedr_function_call_info* call_info)
+{
+	kedr_lockstat_acquire_begin((void *)(<$lockstat.acquire$>));
+}
+
+#define KEDR_POST_<$function.name$>
+static void
+kedr_post_<$function.name$>(<$argumentSpec_comma$>
+	<$if returnType$><$returnType$> ret_val,
+	<$endif$>struct kedr_function_call_info* call_info)
+{
+	kedr_lockstat_acquire_end((void *)(<$lockstat.acquire$>),
+		call_info->return_address,
+		<$if lockstat.acquired$><$lockstat.acquired$><$else$>1<$endif$>);
+}<$else$><$if lockstat.release$>//***** Profile releases of the locks by <$function.name$> *****//
+#define KEDR_PRE_<$function.name$>
+static void
+kedr_pre_<$function.name$>(<$argumentSpec_comma$>
+	struct kedr_function_call_info* call_info)
+{
+	kedr_lockstat_release((void *)(<$lockstat.release$>));
+}<$else$>//***** <$function.name$> is not processed *****//<$endif$><$endif$>
@@ -0,0 +1,6 @@
+#ifdef KEDR_POST_<$function.name$>
+	{
+		.orig = (void*)&<$function.name$>,
+		.post = (void*)&kedr_post_<$function.name$>
+	},
+#endif
@@ -0,0 +1,570 @@
+/*********************************************************************
+ * The target module for the microbenchmarks: it measures how much the
+ * calls to some kernel functions made from this module cost, so that
+ * the overhead KEDR adds to these calls with different payloads could
+ * be estimated.
+ *
+ * Writing a list of operations (e.g. "kmalloc,mutex") to
+ * "kedr_bench/run" file in debugfs runs the benchmark for each of these
+ * operations in turn. The write returns when all of them are done. For
+ * each operation, 'nr_threads' kernel threads bound to different CPUs
+ * perform it 'iterations' times each at the same time. "all" or an
+ * empty string means all the operations.
+ *
+ * The operations:
+ *   kmalloc    - kmalloc() + kfree();
+ *   spinlock   - spin_lock() + spin_unlock();
+ *   mutex      - mutex_lock() + mutex_unlock();
+ *   uaccess    - copy_to_user() of a small buffer to the address space
+ *                of the process that has started the run;
+ *   kmem_cache - kmem_cache_alloc() + kmem_cache_free().
+ *
+ * The locks are per-thread, so only the cost of the calls is measured,
+ * not the contention.
+ *
+ * The results of the last run of each operation are available in
+ * "kedr_bench/results" file, one line per operation:
+ * <op> <threads> <iterations> <ns_per_op> <ops_per_sec>
+ * where <ns_per_op> is the average time of an operation in a thread and
+ * <ops_per_sec> is the total throughput of all the threads.
+ *********************************************************************/
+
+#include <linux/module.h>
+#include <linux/moduleparam.h>
+#include <linux/init.h>
+#include <linux/kernel.h>
+#include <linux/version.h>
+#include <linux/slab.h>
+#include <linux/spinlock.h>
+#include <linux/mutex.h>
+#include <linux/completion.h>
+#include <linux/kthread.h>
+#include <linux/sched.h>
+#include <linux/cpumask.h>
+#include <linux/ktime.h>
+#include <linux/math64.h>
+#include <linux/mm.h>
+#include <linux/mman.h>
+#include <linux/uaccess.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include <linux/string.h>
+#include <linux/err.h>
+
+#if LINUX_VERSION_CODE < KERNEL_VERSION(5,8,0)
+#include <linux/mmu_context.h>
+#define kthread_use_mm(mm) use_mm(mm)
+#define kthread_unuse_mm(mm) unuse_mm(mm)
+#endif
+
+/*********************************************************************/
+MODULE_AUTHOR("KEDR development team");
+MODULE_LICENSE("GPL");
+/*********************************************************************/
+
+#define BENCH_PREFIX "[kedr_bench] "
+
+/* Number of the threads, 0 means one thread per online CPU. */
+unsigned int nr_threads = 0;
+module_param(nr_threads, uint, S_IRUGO | S_IWUSR);
+
+/* Number of the operations each thread performs. */
+unsigned long iterations = 100000;
+module_param(iterations, ulong, S_IRUGO | S_IWUSR);
+/*********************************************************************/
+
+
+/* Size of the data to allocate or to copy in a single operation. */
+#define BENCH_DATA_SIZE 64
+
+/* The operations are performed in chunks of this size, the thread lets
+ * the scheduler run between the chunks. */
+#define BENCH_CHUNK 1024
+
+/* The maximum length of the string written to "run" file. */
+#define BENCH_RUN_MAX_LEN 256
+
+struct bench_thread;
+
+struct bench_op
+{
+	const char *name;
+
+	/* Performs the operation 'count' times. Returns 0 on success,
+	 * -errno on failure. */
+	int (*run)(struct bench_thread *t, unsigned long count);
+
+	/* The results of the last run, 'threads' is 0 if the operation has
+	 * not been run yet. */
+	unsigned int threads;
+	unsigned long iterations;
+	u64 ns_per_op;
+	u64 ops_per_sec;
+};
+
+struct bench_thread
+{
+	struct task_struct *task;
+	struct bench_op *op;
+
+	/* Per-thread locks, so that only the cost of the calls is measured
+	 * rather than the contention. */
+	spinlock_t spinlock;
+	struct mutex mutex;
+
+	/* Where to copy the data to for "uaccess". */
+	char __user *ubuf;
+
+	/* The time the thread has spent performing the operations, ns. */
+	u64 ns;
+
+	/* 0 on success, -errno if the operation has failed. */
+	int ret;
+};
+
+static struct kmem_cache *bench_cache;
+
+/* The threads wait for 'bench_start' to start the operations at the same
+ * time. The last thread to finish completes 'bench_done'. */
+static struct completion bench_start;
+static struct completion bench_done;
+static atomic_t bench_remaining;
+
+/* The value of 'iterations' for the current run: the parameter may be
+ * changed while the threads are running. */
+static unsigned long bench_iterations;
+
+/* The address space the threads copy the data to for "uaccess". */
+static struct mm_struct *bench_mm;
+
+/* Serializes the runs and protects the results. */
+static DEFINE_MUTEX(bench_mutex);
+
+static struct dentry *dir_bench;
+static struct dentry *file_run;
+static struct dentry *file_results;
+/*********************************************************************/
+
+static int
+run_kmalloc(struct bench_thread *t, unsigned long count)
+{
+	unsigned long i;
+	void *p;
+
+	for (i = 0; i < count; ++i) {
+		p = kmalloc(BENCH_DATA_SIZE, GFP_KERNEL);
+		if (p == NULL)
+			return -ENOMEM;
+		kfree(p);
+	}
+	return 0;
+}
+
+static int
+run_spinlock(struct bench_thread *t, unsigned long count)
+{
+	unsigned long i;
+
+	for (i = 0; i < count; ++i) {
+		spin_lock(&t->spinlock);
+		spin_unlock(&t->spinlock);
+	}
+	return 0;
+}
+
+static int
+run_mutex(struct bench_thread *t, unsigned long count)
+{
+	unsigned long i;
+
+	for (i = 0; i < count; ++i) {
+		mutex_lock(&t->mutex);
+		mutex_unlock(&t->mutex);
+	}
+	return 0;
+}
+
+/* Called with 'bench_mm' used by the current thread. */
+static int
+run_uaccess(struct bench_thread *t, unsigned long count)
+{
+	char data[BENCH_DATA_SIZE];
+	unsigned long i;
+
+	memset(data, 0xAB, sizeof(data));
+	for (i = 0; i < count; ++i) {
+		if (copy_to_user(t->ubuf, data, sizeof(data)) != 0)
+			return -EFAULT;
+	}
+	return 0;
+}
+
+static int
+run_kmem_cache(struct bench_thread *t, unsigned long count)
+{
+	unsigned long i;
+	void *p;
+
+	for (i = 0; i < count; ++i) {
+		p = kmem_cache_alloc(bench_cache, GFP_KERNEL);
+		if (p == NULL)
+			return -ENOMEM;
+		kmem_cache_free(bench_cache, p);
+	}
+	return 0;
+}
+
+static struct bench_op bench_ops[] = {
+	{ .name = "kmalloc",	.run = run_kmalloc },
+	{ .name = "spinlock",	.run = run_spinlock },
+	{ .name = "mutex",	.run = run_mutex },
+	{ .name = "uaccess",	.run = run_uaccess },
+	{ .name = "kmem_cache",	.run = run_kmem_cache },
+};
+
+static int
+bench_op_is_uaccess(const struct bench_op *op)
+{
+	return (op->run == run_uaccess);
+}
+/*********************************************************************/
+
+static int
+bench_thread_func(void *data)
+{
+	struct bench_thread *t = data;
+	unsigned long remaining = bench_iterations;
+	unsigned long count;
+	ktime_t start;
+
+	wait_for_completion(&bench_start);
+
+	if (bench_op_is_uaccess(t->op))
+		kthread_use_mm(bench_mm);
+
+	start = ktime_get();
+	while (remaining != 0) {
+		count = min_t(unsigned long, remaining, BENCH_CHUNK);
+		t->ret = t->op->run(t, count);
+		if (t->ret != 0)
+			break;
+		remaining -= count;
+		cond_resched();
+	}
+	t->ns = (u64)ktime_to_ns(ktime_sub(ktime_get(), start));
+
+	if (bench_op_is_uaccess(t->op))
+		kthread_unuse_mm(bench_mm);
+
+	if (atomic_dec_and_test(&bench_remaining))
+		complete(&bench_done);
+
+	/* Wait for kthread_stop() so that the task struct is still there
+	 * when it is called. */
+	set_current_state(TASK_INTERRUPTIBLE);
+	while (!kthread_should_stop()) {
+		schedule();
+		set_current_state(TASK_INTERRUPTIBLE);
+	}
+	__set_current_state(TASK_RUNNING);
+	return 0;
+}
+
+/* Runs the operation on 'nthreads' threads. Should be called with
+ * 'bench_mutex' locked. */
+static int
+bench_run_op(struct bench_op *op, struct bench_thread *threads,
+	unsigned int nthreads)
+{
+	unsigned long ubuf = 0;
+	unsigned long ubuf_size = (unsigned long)nthreads * PAGE_SIZE;
+	unsigned int created = 0;
+	unsigned int i;
+	int cpu = -1;
+	ktime_t start;
+	u64 wall_ns;
+	u64 total_ns = 0;
+	u64 total_ops;
+	int ret = 0;
+
+	bench_iterations = iterations;
+	if (bench_iterations == 0) {
+		pr_warning(BENCH_PREFIX "'iterations' must be positive.\n");
+		return -EINVAL;
+	}
+
+	if (bench_op_is_uaccess(op)) {
+		/* The threads copy the data to the address space of the
+		 * process that has requested the run. Each thread uses its
+		 * own page. */
+		if (current->mm == NULL)
+			return -EINVAL;
+
+		ubuf = vm_mmap(NULL, 0, ubuf_size, PROT_READ | PROT_WRITE,
+			MAP_ANONYMOUS | MAP_PRIVATE, 0);
+		if (IS_ERR_VALUE(ubuf))
+			return (int)ubuf;
+		bench_mm = current->mm;
+	}
+
+	init_completion(&bench_start);
+	init_completion(&bench_done);
+	atomic_set(&bench_remaining, nthreads);
+
+	for (i = 0; i < nthreads; ++i) {
+		struct bench_thread *t = &threads[i];
+
+		memset(t, 0, sizeof(*t));
+		spin_lock_init(&t->spinlock);
+		mutex_init(&t->mutex);
+		t->op = op;
+		t->ubuf = (char __user *)(ubuf + (unsigned long)i * PAGE_SIZE);
+
+		t->task = kthread_create(bench_thread_func, t,
+			"kedr_bench/%u", i);
+		if (IS_ERR(t->task)) {
+			ret = PTR_ERR(t->task);
+			t->task = NULL;
+			break;
+		}
+
+		/* Distribute the threads among the online CPUs. */
+		cpu = cpumask_next(cpu, cpu_online_mask);
+		if (cpu >= nr_cpu_ids)
+			cpu = cpumask_first(cpu_online_mask);
+		kthread_bind(t->task, cpu);
+
+		wake_up_process(t->task);
+		++created;
+	}
+
+	if (ret != 0) {
+		/* Let the threads already created finish. */
+		atomic_sub(nthreads - created, &bench_remaining);
+		if (created == 0)
+			complete(&bench_done);
+	}
+
+	start = ktime_get();
+	complete_all(&bench_start);
+	wait_for_completion(&bench_done);
+	wall_ns = (u64)ktime_to_ns(ktime_sub(ktime_get(), start));
+
+	for (i = 0; i < created; ++i) {
+		kthread_stop(threads[i].task);
+		if (threads[i].ret != 0 && ret == 0)
+			ret = threads[i].ret;
+		total_ns += threads[i].ns;
+	}
+
+	if (ubuf != 0) {
+		vm_munmap(ubuf, ubuf_size);
+		bench_mm = NULL;
+	}
+
+	if (ret != 0) {
+		pr_warning(BENCH_PREFIX "\"%s\" failed, error %d.\n",
+			op->name, ret);
+		return ret;
+	}
+
+	total_ops = (u64)nthreads * bench_iterations;
+	op->threads = nthreads;
+	op->iterations = bench_iterations;
+	op->ns_per_op = div64_u64(total_ns, total_ops);
+	op->ops_per_sec = (wall_ns != 0) ?
+		div64_u64(total_ops * NSEC_PER_SEC, wall_ns) : 0;
+	return 0;
+}
+
+/* Runs the operations listed in 'str' (comma-separated) one after
+ * another. Should be called with 'bench_mutex' locked. */
+static int
+bench_run(char *str)
+{
+	struct bench_thread *threads;
+	unsigned int nthreads;
+	char *name;
+	unsigned int i;
+	int all;
+	int ret = 0;
+
+	str = strim(str);
+	all = (str[0] == 0 || strcmp(str, "all") == 0);
+
+	/* Check the list first. */
+	if (!all) {
+		char *s = str;
+		char tmp[BENCH_RUN_MAX_LEN + 1];
+
+		strcpy(tmp, s);
+		s = tmp;
+		while ((name = strsep(&s, ",")) != NULL) {
+			name = strim(name);
+			for (i = 0; i < ARRAY_SIZE(bench_ops); ++i) {
+				if (strcmp(name, bench_ops[i].name) == 0)
+					break;
+			}
+			if (i == ARRAY_SIZE(bench_ops)) {
+				pr_warning(BENCH_PREFIX
+					"Unknown operation: \"%s\".\n", name);
+				return -EINVAL;
+			}
+		}
+	}
+
+	nthreads = (nr_threads != 0) ? nr_threads : num_online_cpus();
+	threads = kcalloc(nthreads, sizeof(*threads), GFP_KERNEL);
+	if (threads == NULL)
+		return -ENOMEM;
+
+	if (all) {
+		for (i = 0; i < ARRAY_SIZE(bench_ops) && ret == 0; ++i)
+			ret = bench_run_op(&bench_ops[i], threads, nthreads);
+		goto out;
+	}
+
+	while (ret == 0 && (name = strsep(&str, ",")) != NULL) {
+		name = strim(name);
+		for (i = 0; i < ARRAY_SIZE(bench_ops); ++i) {
+			if (strcmp(name, bench_ops[i].name) == 0) {
+				ret = bench_run_op(&bench_ops[i], threads,
+					nthreads);
+				break;
+			}
+		}
+	}
+out:
+	kfree(threads);
+	return ret;
+}
+/*********************************************************************/
+
+static ssize_t
+run_file_write(struct file *filp, const char __user *buf, size_t count,
+	loff_t *f_pos)
+{
+	char *str;
+	int ret;
+
+	if (count > BENCH_RUN_MAX_LEN)
+		return -EINVAL;
+
+	str = kzalloc(count + 1, GFP_KERNEL);
+	if (str == NULL)
+		return -ENOMEM;
+
+	if (copy_from_user(str, buf, count) != 0) {
+		kfree(str);
+		return -EFAULT;
+	}
+
+	ret = mutex_lock_killable(&bench_mutex);
+	if (ret != 0) {
+		kfree(str);
+		return ret;
+	}
+
+	ret = bench_run(str);
+	mutex_unlock(&bench_mutex);
+	kfree(str);
+
+	return (ret != 0) ? ret : (ssize_t)count;
+}
+
+static const struct file_operations run_file_ops = {
+	.owner = THIS_MODULE,
+	.write = run_file_write,
+};
+
+static int
+results_show(struct seq_file *m, void *v)
+{
+	unsigned int i;
+
+	if (mutex_lock_killable(&bench_mutex) != 0)
+		return -EINTR;
+
+	for (i = 0; i < ARRAY_SIZE(bench_ops); ++i) {
+		const struct bench_op *op = &bench_ops[i];
+
+		if (op->threads == 0)
+			continue;
+
+		seq_printf(m, "%s %u %lu %llu %llu\n", op->name,
+			op->threads, op->iterations,
+			(unsigned long long)op->ns_per_op,
+			(unsigned long long)op->ops_per_sec);
+	}
+
+	mutex_unlock(&bench_mutex);
+	return 0;
+}
+
+static int
+results_file_open(struct inode *inode, struct file *filp)
+{
+	return single_open(filp, results_show, NULL);
+}
+
+static const struct file_operations results_file_ops = {
+	.owner = THIS_MODULE,
+	.open = results_file_open,
+	.read = seq_read,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+/*********************************************************************/
+
+static int __init
+bench_init_module(void)
+{
+	int ret;
+
+	bench_cache = kmem_cache_create("kedr_bench_cache", BENCH_DATA_SIZE,
+		0, 0, NULL);
+	if (bench_cache == NULL)
+		return -ENOMEM;
+
+	dir_bench = debugfs_create_dir("kedr_bench", NULL);
+	if (IS_ERR_OR_NULL(dir_bench)) {
+		ret = -ENOMEM;
+		goto fail_dir;
+	}
+
+	file_run = debugfs_create_file("run", S_IWUSR, dir_bench, NULL,
+		&run_file_ops);
+	if (IS_ERR_OR_NULL(file_run)) {
+		ret = -ENOMEM;
+		goto fail_files;
+	}
+
+	file_results = debugfs_create_file("results", S_IRUGO, dir_bench,
+		NULL, &results_file_ops);
+	if (IS_ERR_OR_NULL(file_results)) {
+		ret = -ENOMEM;
+		goto fail_files;
+	}
+	return 0;
+
+fail_files:
+	/* debugfs_remove() accepts NULL. */
+	debugfs_remove(file_run);
+	debugfs_remove(dir_bench);
+fail_dir:
+	kmem_cache_destroy(bench_cache);
+	return ret;
+}
+
+static void __exit
+bench_cleanup_module(void)
+{
+	debugfs_remove(file_results);
+	debugfs_remove(file_run);
+	debugfs_remove(dir_bench);
+	kmem_cache_destroy(bench_cache);
+}
+
+module_init(bench_init_module);
+module_exit(bench_cleanup_module);
+/*********************************************************************/
@@ -84,7 +84,7 @@ kedr_module_init(void)
     result = kedr_payload_register(&payload);
     if(result) goto err_payload;
     
-    info = kedr_base_session_start();
+    info = kedr_base_session_start(NULL, 0);
     if((info == NULL) || IS_ERR(info))
     {
         result = -EINVAL;
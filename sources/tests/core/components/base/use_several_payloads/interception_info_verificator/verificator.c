@@ -366,7 +366,7 @@ verificator_init(void)
 {
     int result;
     const struct kedr_base_interception_info* info =
-        kedr_base_session_start();
+        kedr_base_session_start(NULL, 0);
     if(IS_ERR(info))
     {
         pr_err("kedr_base_session_start() failed.");
@@ -36,13 +36,17 @@ module_param(target_name, charp, S_IRUGO);
 static int target_is_loaded = 0;
 module_param(target_is_loaded, int, S_IRUGO);
 
-int on_target_load(struct module* m)
+int on_target_load(struct module* m, int target_index)
 {
     target_is_loaded = 1;
     return 0;
 }
 
-void on_target_unload(struct module* m)
+void on_target_init_done(struct module* m, int target_index)
+{
+}
+
+void on_target_unload(struct module* m, int target_index)
 {
     target_is_loaded = 0;
 }
@@ -14,6 +14,8 @@
 #include <linux/module.h>
 
 #include <linux/kernel.h>	/* printk() */
+#include <linux/string.h>	/* strcmp() */
+#include <linux/errno.h>
 
 #include <kedr/fault_simulation/fault_simulation.h>
 
@@ -73,6 +75,9 @@ static int read_indicator_instance_init(void** indicator_state,
     *indicator_state = NULL;
     (void)control_directory;
     
+    /* Parameters which cannot be accepted, for testing errors. */
+    if(params && (strcmp(params, "fail") == 0)) return -EINVAL;
+    
     read_indicator_instances++;
     
     return 0;
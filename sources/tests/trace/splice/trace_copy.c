@@ -0,0 +1,163 @@
+/*
+ * Copy the trace from the file of kedr_trace module into the output file
+ * until the trace is empty, using either read()/write() or splice().
+ * 
+ * Usage: trace_copy <read|splice> <trace_file> <output_file>
+ * 
+ * Outputs number of bytes copied and the throughput, for comparision of
+ * the two methods.
+ */
+
+#define _GNU_SOURCE /* splice() */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#define CHUNK_SIZE 65536
+
+/* Return number of bytes copied or -1 on error. */
+static long long copy_read(int fd_in, int fd_out)
+{
+    static char buffer[CHUNK_SIZE];
+    long long total = 0;
+    
+    while(1)
+    {
+        ssize_t n = read(fd_in, buffer, sizeof(buffer));
+        ssize_t written = 0;
+        if(n < 0)
+        {
+            if(errno == EAGAIN) break; // Trace is empty.
+            perror("read");
+            return -1;
+        }
+        if(n == 0) break;
+        
+        while(written < n)
+        {
+            ssize_t w = write(fd_out, buffer + written, n - written);
+            if(w < 0)
+            {
+                perror("write");
+                return -1;
+            }
+            written += w;
+        }
+        total += n;
+    }
+    
+    return total;
+}
+
+static long long copy_splice(int fd_in, int fd_out)
+{
+    long long total = 0;
+    int pipe_fds[2];
+    
+    if(pipe(pipe_fds))
+    {
+        perror("pipe");
+        return -1;
+    }
+    
+    while(1)
+    {
+        ssize_t n = splice(fd_in, NULL, pipe_fds[1], NULL, CHUNK_SIZE,
+            SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+        if(n < 0)
+        {
+            if(errno == EAGAIN) break; // Trace is empty.
+            perror("splice from the trace");
+            total = -1;
+            break;
+        }
+        if(n == 0) break;
+        
+        total += n;
+        while(n > 0)
+        {
+            ssize_t m = splice(pipe_fds[0], NULL, fd_out, NULL, n,
+                SPLICE_F_MOVE);
+            if(m <= 0)
+            {
+                perror("splice to the output file");
+                total = -1;
+                goto out;
+            }
+            n -= m;
+        }
+    }
+out:
+    close(pipe_fds[0]);
+    close(pipe_fds[1]);
+    
+    return total;
+}
+
+int main(int argc, char** argv)
+{
+    int fd_in, fd_out;
+    long long total;
+    struct timeval start, end;
+    double seconds;
+    
+    if(argc != 4)
+    {
+        printf("Usage: %s <read|splice> <trace_file> <output_file>\n",
+            argv[0]);
+        return 1;
+    }
+    
+    fd_in = open(argv[2], O_RDONLY | O_NONBLOCK);
+    if(fd_in < 0)
+    {
+        printf("Failed to open trace file %s: %s\n", argv[2],
+            strerror(errno));
+        return 1;
+    }
+    
+    fd_out = open(argv[3], O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if(fd_out < 0)
+    {
+        printf("Failed to open output file %s: %s\n", argv[3],
+            strerror(errno));
+        close(fd_in);
+        return 1;
+    }
+    
+    gettimeofday(&start, NULL);
+    if(!strcmp(argv[1], "read"))
+    {
+        total = copy_read(fd_in, fd_out);
+    }
+    else if(!strcmp(argv[1], "splice"))
+    {
+        total = copy_splice(fd_in, fd_out);
+    }
+    else
+    {
+        printf("Unknown method: %s\n", argv[1]);
+        total = -1;
+    }
+    gettimeofday(&end, NULL);
+    
+    close(fd_out);
+    close(fd_in);
+    
+    if(total < 0) return 1;
+    
+    seconds = (end.tv_sec - start.tv_sec)
+        + (end.tv_usec - start.tv_usec) / 1000000.0;
+    printf("%s: %lld bytes in %.3f s (%.1f MB/s)\n", argv[1], total, seconds,
+        seconds > 0 ? total / seconds / (1024 * 1024) : 0.0);
+    
+    return 0;
+}
@@ -0,0 +1,333 @@
+/*********************************************************************
+ * The module checks the per-CPU statistics helpers from 
+ * <kedr/util/percpu_stats.h> and compares the cost of updating a 
+ * per-CPU counter with the cost of updating a counter protected by a
+ * spinlock, which is what the payloads used before.
+ *
+ * When loaded, the module updates both kinds of counters 'iterations'
+ * times on each online CPU at the same time. The totals are checked, 
+ * the average cost of an update (in ns) is shown in the system log and 
+ * in "kedr_test_percpu_stats/stats" file in debugfs. 
+ *
+ * The keyed tables are checked the same way: the records for several keys
+ * are updated on each CPU, then the merged totals are checked, as well as
+ * removing the records with kedr_stat_table_forget(), reusing the removed
+ * entries and resetting the table.
+ *********************************************************************/
+ 
+#include <linux/module.h>
+#include <linux/moduleparam.h>
+#include <linux/init.h>
+#include <linux/kernel.h>
+#include <linux/spinlock.h>
+#include <linux/smp.h>
+#include <linux/sched.h>
+#include <linux/math64.h>
+#include <linux/vmalloc.h>
+#include <linux/debugfs.h>
+
+#include <kedr/util/percpu_stats.h>
+
+/*********************************************************************/
+MODULE_AUTHOR("KEDR development team");
+MODULE_LICENSE("GPL");
+/*********************************************************************/
+
+/* Number of updates to perform on each CPU. */
+unsigned long iterations = 10000;
+module_param(iterations, ulong, S_IRUGO);
+/*********************************************************************/
+
+static DEFINE_SPINLOCK(locked_lock);
+static u64 locked_counter;
+
+static struct kedr_stat_counter cnt_updates;
+static struct kedr_stat_max max_update_ns;
+static struct kedr_stat_min min_update_ns;
+static struct kedr_stat_hist hist_update_ns;
+
+/* Average cost of an update, ns. */
+static struct kedr_stat_max ns_locked;
+static struct kedr_stat_max ns_percpu;
+
+static const struct kedr_stat_desc stats_desc[] = {
+	KEDR_STAT_DESC_COUNTER("updates", &cnt_updates),
+	KEDR_STAT_DESC_MAX("max_update_ns", &max_update_ns),
+	KEDR_STAT_DESC_MIN("min_update_ns", &min_update_ns),
+	KEDR_STAT_DESC_HIST("update_ns", &hist_update_ns),
+	KEDR_STAT_DESC_MAX("locked_counter_ns", &ns_locked),
+	KEDR_STAT_DESC_MAX("percpu_counter_ns", &ns_percpu),
+	KEDR_STAT_DESC_END
+};
+
+/* Number of the keys in the test table, the same as the number of the
+ * entries in it. */
+#define TEST_TABLE_BITS 4
+#define TEST_TABLE_KEYS (1 << TEST_TABLE_BITS)
+
+struct test_table_entry
+{
+	/* (k, 2 * k), k is from 1 to TEST_TABLE_KEYS. */
+	struct kedr_stat_key key;
+	unsigned long count;
+};
+
+static struct kedr_stat_table *test_table;
+
+static struct dentry *dir_test;
+static struct dentry *file_stats;
+/*********************************************************************/
+
+/* Called on each CPU with interrupts disabled. */
+static void
+run_locked(void *unused)
+{
+	unsigned long i;
+	u64 start = local_clock();
+	u64 ns;
+
+	for (i = 0; i < iterations; ++i) {
+		spin_lock(&locked_lock);
+		++locked_counter;
+		spin_unlock(&locked_lock);
+	}
+
+	ns = local_clock() - start;
+	kedr_stat_max_update(&ns_locked, div64_u64(ns, iterations));
+}
+
+static void
+run_percpu(void *unused)
+{
+	unsigned long i;
+	u64 start = local_clock();
+	u64 ns;
+
+	for (i = 0; i < iterations; ++i)
+		kedr_stat_counter_inc(&cnt_updates);
+
+	ns = local_clock() - start;
+	kedr_stat_max_update(&ns_percpu, div64_u64(ns, iterations));
+	kedr_stat_max_update(&max_update_ns, ns);
+	kedr_stat_min_update(&min_update_ns, ns);
+	kedr_stat_hist_add(&hist_update_ns, div64_u64(ns, iterations));
+}
+
+static void
+run_table(void *unused)
+{
+	unsigned long i;
+	unsigned long k;
+
+	for (i = 0; i < iterations; ++i) {
+		for (k = 1; k <= TEST_TABLE_KEYS; ++k) {
+			struct test_table_entry *entry =
+				kedr_stat_table_get(test_table, k, 2 * k);
+			if (entry != NULL)
+				++entry->count;
+		}
+	}
+}
+
+static void
+test_entry_merge(void *total, const void *entry)
+{
+	((struct test_table_entry *)total)->count +=
+		((const struct test_table_entry *)entry)->count;
+}
+
+static int
+test_entry_is_odd(const void *entry, void *unused)
+{
+	return ((const struct test_table_entry *)entry)->key.k1 & 1;
+}
+
+static int
+test_entry_any(const void *entry, void *unused)
+{
+	return 1;
+}
+
+/* Check that the table contains the keys from 'first' to
+ * TEST_TABLE_KEYS with the step 'step' and the expected totals. */
+static int
+check_table(unsigned long first, unsigned long step, unsigned long expected)
+{
+	void *data;
+	struct test_table_entry *merged;
+	unsigned long dropped;
+	unsigned long k;
+	long nr_merged;
+	long i = 0;
+	int ret = 0;
+
+	nr_merged = kedr_stat_table_merge(test_table, test_entry_merge, &data,
+		&dropped);
+	if (nr_merged < 0)
+		return (int)nr_merged;
+	merged = data;
+
+	for (k = first; k <= TEST_TABLE_KEYS; k += step, ++i) {
+		if (i >= nr_merged || merged[i].key.k1 != k ||
+		    merged[i].key.k2 != 2 * k ||
+		    merged[i].count != expected) {
+			ret = -EINVAL;
+			break;
+		}
+	}
+	if (i != nr_merged || dropped != 0)
+		ret = -EINVAL;
+
+	if (ret != 0) {
+		pr_warning("[test_percpu_stats] Unexpected contents of "
+			"the table: %ld entries, %lu dropped, "
+			"expected %lu per key\n",
+			nr_merged, dropped, expected);
+	}
+	vfree(data);
+	return ret;
+}
+/*********************************************************************/
+
+static void
+destroy_stats(void)
+{
+	kedr_stat_table_destroy(test_table);
+	test_table = NULL;
+
+	kedr_stat_max_destroy(&ns_percpu);
+	kedr_stat_max_destroy(&ns_locked);
+	kedr_stat_hist_destroy(&hist_update_ns);
+	kedr_stat_min_destroy(&min_update_ns);
+	kedr_stat_max_destroy(&max_update_ns);
+	kedr_stat_counter_destroy(&cnt_updates);
+}
+
+static int
+init_stats(void)
+{
+	if (kedr_stat_counter_init(&cnt_updates) != 0 ||
+	    kedr_stat_max_init(&max_update_ns) != 0 ||
+	    kedr_stat_min_init(&min_update_ns) != 0 ||
+	    kedr_stat_hist_init(&hist_update_ns) != 0 ||
+	    kedr_stat_max_init(&ns_locked) != 0 ||
+	    kedr_stat_max_init(&ns_percpu) != 0) {
+		/* free_percpu(NULL) is a no-op. */
+		destroy_stats();
+		return -ENOMEM;
+	}
+
+	/* All keys fit into the table, and they are never dropped. The table
+	 * has no free entries then, so after kedr_stat_table_forget(), the
+	 * keys fit into it only if the removed entries are reused. */
+	test_table = kedr_stat_table_create(TEST_TABLE_BITS, TEST_TABLE_KEYS,
+		sizeof(struct test_table_entry));
+	if (test_table == NULL) {
+		destroy_stats();
+		return -ENOMEM;
+	}
+	return 0;
+}
+
+static int __init
+test_init_module(void)
+{
+	unsigned int ncpus;
+	u64 expected;
+	int ret;
+
+	if (iterations == 0) {
+		pr_warning("[test_percpu_stats] "
+			"'iterations' must be positive.\n");
+		return -EINVAL;
+	}
+
+	ret = init_stats();
+	if (ret != 0)
+		return ret;
+
+	get_online_cpus();
+	ncpus = num_online_cpus();
+	on_each_cpu(run_locked, NULL, 1);
+	on_each_cpu(run_percpu, NULL, 1);
+	on_each_cpu(run_table, NULL, 1);
+	put_online_cpus();
+
+	ret = check_table(1, 1, (unsigned long)ncpus * iterations);
+	if (ret == 0) {
+		kedr_stat_table_forget(test_table, test_entry_is_odd, NULL);
+		ret = check_table(2, 2, (unsigned long)ncpus * iterations);
+	}
+	if (ret == 0) {
+		kedr_stat_table_forget(test_table, test_entry_any, NULL);
+		ret = check_table(TEST_TABLE_KEYS + 1, 1, 0);
+	}
+	if (ret == 0) {
+		get_online_cpus();
+		on_each_cpu(run_table, NULL, 1);
+		put_online_cpus();
+		ret = check_table(1, 1, (unsigned long)ncpus * iterations);
+	}
+	if (ret == 0) {
+		kedr_stat_table_reset(test_table);
+		ret = check_table(TEST_TABLE_KEYS + 1, 1, 0);
+	}
+	if (ret != 0)
+		goto fail;
+
+	expected = (u64)ncpus * iterations;
+	if (locked_counter != expected ||
+	    kedr_stat_counter_read(&cnt_updates) != (s64)expected) {
+		pr_warning("[test_percpu_stats] Unexpected totals: "
+			"locked: %llu, per-cpu: %lld, expected: %llu\n",
+			(unsigned long long)locked_counter,
+			(long long)kedr_stat_counter_read(&cnt_updates),
+			(unsigned long long)expected);
+		ret = -EINVAL;
+		goto fail;
+	}
+
+	if (kedr_stat_min_read(&min_update_ns) >
+	    kedr_stat_max_read(&max_update_ns)) {
+		pr_warning("[test_percpu_stats] "
+			"Minimum is greater than maximum.\n");
+		ret = -EINVAL;
+		goto fail;
+	}
+
+	pr_info("[test_percpu_stats] %u CPU(s), %lu updates per CPU: "
+		"spinlock: %llu ns/update, per-cpu: %llu ns/update\n",
+		ncpus, iterations,
+		(unsigned long long)kedr_stat_max_read(&ns_locked),
+		(unsigned long long)kedr_stat_max_read(&ns_percpu));
+
+	dir_test = debugfs_create_dir("kedr_test_percpu_stats", NULL);
+	if (dir_test == NULL) {
+		ret = -ENOMEM;
+		goto fail;
+	}
+
+	file_stats = kedr_stat_debugfs_create("stats", dir_test, stats_desc);
+	if (file_stats == NULL) {
+		ret = -ENOMEM;
+		goto fail_file;
+	}
+	return 0;
+
+fail_file:
+	debugfs_remove(dir_test);
+fail:
+	destroy_stats();
+	return ret;
+}
+
+static void __exit
+test_cleanup_module(void)
+{
+	debugfs_remove(file_stats);
+	debugfs_remove(dir_test);
+	destroy_stats();
+}
+
+module_init(test_init_module);
+module_exit(test_cleanup_module);
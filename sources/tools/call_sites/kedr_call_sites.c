@@ -0,0 +1,183 @@
+/*
+ * Prepare the list of the call sites in a kernel module for KEDR from
+ * the relocations in the module file.
+ *
+ * Usage:
+ *   kedr_call_sites [-n <module_name>] <module_file.ko>
+ *
+ * Each call of a kernel function from a module is a 'call' or 'jmp'
+ * instruction with a 32-bit relative operand and there is a relocation
+ * against the symbol of that function for the operand in the module file.
+ * The tool finds such relocations and outputs the offsets of the operands
+ * from the beginning of the "core" and "init" code areas of the module
+ * when it is loaded. The output should be written to
+ * "kedr_call_sites/sites" file in debugfs before the module is loaded.
+ * KEDR then only checks these places in the code of the module instead of
+ * decoding all its instructions.
+ *
+ * The layout of the code areas is computed the same way as the kernel
+ * does it when loading a module: the code sections with names starting
+ * with ".init" go to the "init" area, the remaining ones go to the "core"
+ * area, in the order of their section headers, each one aligned according
+ * to its 'sh_addralign'. The sizes of the areas are output too, so KEDR
+ * can detect if the layout differs and decode the code in that case.
+ *
+ * The output format is:
+ *   target <module_name> <core_text_size> <init_text_size>
+ *   c <offset>
+ *   ...
+ *   i <offset>
+ *   ...
+ *   end
+ * The sizes and the offsets are hexadecimal.
+ */
+
+/* ========================================================================
+ * Copyright (C) 2012, KEDR development team
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation.
+ ======================================================================== */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <unistd.h>
+
+#include "module_file.h"
+
+static const char* prog_name = "kedr_call_sites";
+
+static void
+usage(void)
+{
+    fprintf(stderr, "Usage: %s [-n <module_name>] <module_file.ko>\n",
+        prog_name);
+}
+
+static int
+output_call_site(unsigned long offset, void* data)
+{
+    printf("%c %lx\n", *(const char*)data, offset);
+    return 0;
+}
+
+static int
+output_call_sites(const struct module_file* mf, const char* module_name)
+{
+    struct placement* placements;
+    unsigned long core_size;
+    unsigned long init_size;
+    const char areas[] = {'c', 'i'};
+    unsigned int a;
+    int result = -1;
+
+    placements = calloc(mf->shnum ? mf->shnum : 1, sizeof(*placements));
+    if(placements == NULL)
+    {
+        fprintf(stderr, "%s: not enough memory\n", prog_name);
+        return -1;
+    }
+
+    if(module_file_layout(mf, placements, &core_size, &init_size))
+        goto out;
+
+    printf("target %s %lx %lx\n", module_name, core_size, init_size);
+
+    for(a = 0; a < sizeof(areas); ++a)
+    {
+        if(module_file_for_each_call_site(mf, placements, areas[a],
+            output_call_site, (void*)&areas[a]))
+            goto out;
+    }
+
+    printf("end\n");
+    result = 0;
+out:
+    free(placements);
+    return result;
+}
+
+/*
+ * The name of the module is the name of the file without ".ko", '-' is
+ * replaced with '_' like the kernel build system does.
+ */
+static char*
+module_name_from_file(const char* path)
+{
+    const char* base = strrchr(path, '/');
+    char* name;
+    char* p;
+
+    base = (base != NULL) ? base + 1 : path;
+    name = strdup(base);
+    if(name == NULL) return NULL;
+
+    p = strstr(name, ".ko");
+    if(p != NULL && p[3] == '\0') *p = '\0';
+
+    for(p = name; *p != '\0'; ++p)
+    {
+        if(*p == '-') *p = '_';
+    }
+    return name;
+}
+
+int
+main(int argc, char* argv[])
+{
+    int opt;
+    char* module_name = NULL;
+    const char* file_name;
+    struct module_file mf;
+    int result;
+
+    while((opt = getopt(argc, argv, "n:h")) != -1)
+    {
+        switch(opt)
+        {
+        case 'n':
+            free(module_name);
+            module_name = strdup(optarg);
+            break;
+        case 'h':
+            usage();
+            return EXIT_SUCCESS;
+        default:
+            usage();
+            return EXIT_FAILURE;
+        }
+    }
+
+    if(optind + 1 != argc)
+    {
+        usage();
+        return EXIT_FAILURE;
+    }
+    file_name = argv[optind];
+
+    if(module_name == NULL)
+        module_name = module_name_from_file(file_name);
+    if(module_name == NULL)
+    {
+        fprintf(stderr, "%s: not enough memory\n", prog_name);
+        return EXIT_FAILURE;
+    }
+
+    result = module_file_open(&mf, file_name);
+    if(result == 0)
+    {
+        result = output_call_sites(&mf, module_name);
+        module_file_close(&mf);
+    }
+    free(module_name);
+
+    if(result == 0 && fflush(stdout) != 0)
+    {
+        fprintf(stderr, "%s: failed to write the output\n", prog_name);
+        result = -1;
+    }
+    return (result == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
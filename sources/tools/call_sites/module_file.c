@@ -0,0 +1,448 @@
+/*
+ * Reading the code sections of a kernel module file (.ko) and the call
+ * sites in them, see module_file.h.
+ */
+
+/* ========================================================================
+ * Copyright (C) 2012, KEDR development team
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation.
+ ======================================================================== */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <elf.h>
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "module_file.h"
+
+/* Opcodes of 'call rel32' and 'jmp rel32'. */
+#define OP_CALL 0xe8
+#define OP_JMP  0xe9
+
+/*
+ * The calls to these functions are changed by the kernel itself when
+ * a module is loaded (by ftrace or when patching the retpoline and
+ * return thunks), so these calls are not listed. KEDR never intercepts
+ * them anyway.
+ */
+static const char* skipped_prefixes[] = {
+    "__fentry__",
+    "mcount",
+    "__x86_indirect_thunk_",
+    "__x86_indirect_call_thunk_",
+    "__x86_indirect_jump_thunk_",
+    "__x86_return_thunk",
+    NULL
+};
+
+static int
+check_range(const struct module_file* mf, unsigned long offset,
+    unsigned long size)
+{
+    if(offset > mf->size || size > mf->size - offset)
+    {
+        fprintf(stderr, "%s: invalid ELF file: data is out of bounds\n",
+            mf->file_name);
+        return -1;
+    }
+    return 0;
+}
+
+int
+module_file_get_section(const struct module_file* mf, unsigned int index,
+    struct section* sec)
+{
+    unsigned long name;
+
+    if(mf->is_64)
+    {
+        const Elf64_Ehdr* ehdr = (const Elf64_Ehdr*)mf->data;
+        const Elf64_Shdr* shdr = (const Elf64_Shdr*)
+            (mf->data + ehdr->e_shoff) + index;
+
+        name = shdr->sh_name;
+        sec->type = shdr->sh_type;
+        sec->flags = shdr->sh_flags;
+        sec->offset = shdr->sh_offset;
+        sec->size = shdr->sh_size;
+        sec->link = shdr->sh_link;
+        sec->info = shdr->sh_info;
+        sec->addralign = shdr->sh_addralign;
+        sec->entsize = shdr->sh_entsize;
+    }
+    else
+    {
+        const Elf32_Ehdr* ehdr = (const Elf32_Ehdr*)mf->data;
+        const Elf32_Shdr* shdr = (const Elf32_Shdr*)
+            (mf->data + ehdr->e_shoff) + index;
+
+        name = shdr->sh_name;
+        sec->type = shdr->sh_type;
+        sec->flags = shdr->sh_flags;
+        sec->offset = shdr->sh_offset;
+        sec->size = shdr->sh_size;
+        sec->link = shdr->sh_link;
+        sec->info = shdr->sh_info;
+        sec->addralign = shdr->sh_addralign;
+        sec->entsize = shdr->sh_entsize;
+    }
+
+    if(mf->shstrtab == NULL)
+    {
+        sec->name = "";
+    }
+    else
+    {
+        if(name >= mf->shstrtab_size) return -1;
+        sec->name = mf->shstrtab + name;
+    }
+
+    if(sec->type != SHT_NOBITS)
+        return check_range(mf, sec->offset, sec->size);
+    return 0;
+}
+
+static int
+module_file_parse(struct module_file* mf)
+{
+    const unsigned char* ident = mf->data;
+    unsigned long shoff;
+    unsigned long shentsize;
+    unsigned int shstrndx;
+    struct section sec;
+
+    if(mf->size < EI_NIDENT || memcmp(ident, ELFMAG, SELFMAG) != 0)
+    {
+        fprintf(stderr, "%s: not an ELF file\n", mf->file_name);
+        return -1;
+    }
+
+    if(ident[EI_CLASS] == ELFCLASS64)
+    {
+        const Elf64_Ehdr* ehdr = (const Elf64_Ehdr*)mf->data;
+        if(check_range(mf, 0, sizeof(*ehdr))) return -1;
+        if(ehdr->e_machine != EM_X86_64) goto unsupported;
+
+        mf->is_64 = 1;
+        shoff = ehdr->e_shoff;
+        shentsize = ehdr->e_shentsize;
+        mf->shnum = ehdr->e_shnum;
+        shstrndx = ehdr->e_shstrndx;
+        if(ehdr->e_type != ET_REL) goto unsupported;
+        if(shentsize != sizeof(Elf64_Shdr)) goto unsupported;
+    }
+    else if(ident[EI_CLASS] == ELFCLASS32)
+    {
+        const Elf32_Ehdr* ehdr = (const Elf32_Ehdr*)mf->data;
+        if(check_range(mf, 0, sizeof(*ehdr))) return -1;
+        if(ehdr->e_machine != EM_386) goto unsupported;
+
+        mf->is_64 = 0;
+        shoff = ehdr->e_shoff;
+        shentsize = ehdr->e_shentsize;
+        mf->shnum = ehdr->e_shnum;
+        shstrndx = ehdr->e_shstrndx;
+        if(ehdr->e_type != ET_REL) goto unsupported;
+        if(shentsize != sizeof(Elf32_Shdr)) goto unsupported;
+    }
+    else
+    {
+        goto unsupported;
+    }
+
+    if(ident[EI_DATA] != ELFDATA2LSB) goto unsupported;
+
+    if(check_range(mf, shoff, (unsigned long)mf->shnum * shentsize))
+        return -1;
+
+    if(shstrndx >= mf->shnum)
+    {
+        fprintf(stderr, "%s: invalid ELF file: no section names\n",
+            mf->file_name);
+        return -1;
+    }
+    if(module_file_get_section(mf, shstrndx, &sec)) return -1;
+    mf->shstrtab = (const char*)mf->data + sec.offset;
+    mf->shstrtab_size = sec.size;
+    if(sec.size == 0 || mf->shstrtab[sec.size - 1] != '\0')
+    {
+        fprintf(stderr, "%s: invalid ELF file: bad section name table\n",
+            mf->file_name);
+        return -1;
+    }
+
+    return 0;
+
+unsupported:
+    fprintf(stderr,
+        "%s: not an x86 or x86-64 relocatable file (kernel module)\n",
+        mf->file_name);
+    return -1;
+}
+
+int
+module_file_open(struct module_file* mf, const char* file_name)
+{
+    int fd;
+    struct stat st;
+    void* data;
+
+    memset(mf, 0, sizeof(*mf));
+    mf->file_name = file_name;
+
+    fd = open(file_name, O_RDONLY);
+    if(fd == -1)
+    {
+        fprintf(stderr, "%s: cannot open the file: %s\n", file_name,
+            strerror(errno));
+        return -1;
+    }
+
+    if(fstat(fd, &st) == -1 || st.st_size == 0)
+    {
+        fprintf(stderr, "%s: cannot read the file\n", file_name);
+        close(fd);
+        return -1;
+    }
+
+    data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if(data == MAP_FAILED)
+    {
+        fprintf(stderr, "%s: cannot map the file: %s\n", file_name,
+            strerror(errno));
+        return -1;
+    }
+    mf->data = data;
+    mf->size = st.st_size;
+
+    if(module_file_parse(mf))
+    {
+        module_file_close(mf);
+        return -1;
+    }
+    return 0;
+}
+
+void
+module_file_close(struct module_file* mf)
+{
+    if(mf->data != NULL)
+        munmap((void*)mf->data, mf->size);
+    mf->data = NULL;
+    mf->size = 0;
+}
+
+static unsigned long
+align_up(unsigned long value, unsigned long align)
+{
+    if(align <= 1) return value;
+    return (value + align - 1) / align * align;
+}
+
+/*
+ * This is what layout_sections() in kernel/module.c does for the code
+ * sections.
+ */
+int
+module_file_layout(const struct module_file* mf,
+    struct placement* placements, unsigned long* core_size,
+    unsigned long* init_size)
+{
+    unsigned int i;
+    struct section sec;
+
+    *core_size = 0;
+    *init_size = 0;
+
+    for(i = 0; i < mf->shnum; ++i)
+    {
+        int is_init;
+
+        placements[i].area = 0;
+        if(module_file_get_section(mf, i, &sec)) return -1;
+
+        if((sec.flags & (SHF_ALLOC | SHF_EXECINSTR)) !=
+            (SHF_ALLOC | SHF_EXECINSTR))
+            continue;
+
+        is_init = (strncmp(sec.name, ".init", 5) == 0);
+        if(is_init)
+        {
+            placements[i].area = 'i';
+            placements[i].offset = align_up(*init_size, sec.addralign);
+            *init_size = placements[i].offset + sec.size;
+        }
+        else
+        {
+            placements[i].area = 'c';
+            placements[i].offset = align_up(*core_size, sec.addralign);
+            *core_size = placements[i].offset + sec.size;
+        }
+    }
+    return 0;
+}
+
+static int
+is_skipped_symbol(const char* name)
+{
+    const char** prefix;
+
+    for(prefix = skipped_prefixes; *prefix != NULL; ++prefix)
+    {
+        if(strncmp(name, *prefix, strlen(*prefix)) == 0)
+            return 1;
+    }
+    return 0;
+}
+
+/*
+ * Get the symbol 'index' from the symbol table 'symtab'. Return nonzero
+ * if the symbol is undefined (i.e. imported by the module) and is not one
+ * of the skipped symbols.
+ */
+static int
+is_imported_symbol(const struct module_file* mf, const struct section* symtab,
+    unsigned long index)
+{
+    struct section strtab;
+    unsigned long name;
+    unsigned int shndx;
+
+    if(symtab->entsize == 0 || index >= symtab->size / symtab->entsize)
+        return 0;
+    if(symtab->link >= mf->shnum || module_file_get_section(mf, symtab->link, &strtab))
+        return 0;
+
+    if(mf->is_64)
+    {
+        const Elf64_Sym* sym = (const Elf64_Sym*)
+            (mf->data + symtab->offset) + index;
+        name = sym->st_name;
+        shndx = sym->st_shndx;
+    }
+    else
+    {
+        const Elf32_Sym* sym = (const Elf32_Sym*)
+            (mf->data + symtab->offset) + index;
+        name = sym->st_name;
+        shndx = sym->st_shndx;
+    }
+
+    if(shndx != SHN_UNDEF || name == 0 || name >= strtab.size)
+        return 0;
+
+    return !is_skipped_symbol((const char*)mf->data + strtab.offset + name);
+}
+
+/*
+ * Process the call sites from the relocation section 'rel' if it applies
+ * to a code section in the given area.
+ */
+static int
+process_relocations(const struct module_file* mf, const struct section* rel,
+    const struct placement* placements, char area,
+    module_file_site_func func, void* data)
+{
+    struct section target;
+    struct section symtab;
+    unsigned long n;
+    unsigned long i;
+    int result;
+
+    if(rel->info >= mf->shnum || placements[rel->info].area != area)
+        return 0;
+    if(module_file_get_section(mf, rel->info, &target)) return -1;
+    if(rel->link >= mf->shnum || module_file_get_section(mf, rel->link, &symtab))
+        return -1;
+
+    if(rel->entsize == 0) return 0;
+    n = rel->size / rel->entsize;
+
+    for(i = 0; i < n; ++i)
+    {
+        unsigned long r_offset;
+        unsigned long type;
+        unsigned long sym;
+        long addend;
+        const unsigned char* insn;
+
+        if(mf->is_64)
+        {
+            const Elf64_Rela* r = (const Elf64_Rela*)
+                (mf->data + rel->offset) + i;
+            r_offset = r->r_offset;
+            type = ELF64_R_TYPE(r->r_info);
+            sym = ELF64_R_SYM(r->r_info);
+            addend = (long)r->r_addend;
+            if(type != R_X86_64_PC32 && type != R_X86_64_PLT32)
+                continue;
+        }
+        else
+        {
+            const Elf32_Rel* r = (const Elf32_Rel*)
+                (mf->data + rel->offset) + i;
+            r_offset = r->r_offset;
+            type = ELF32_R_TYPE(r->r_info);
+            sym = ELF32_R_SYM(r->r_info);
+            if(type != R_386_PC32 && type != R_386_PLT32)
+                continue;
+            if(r_offset + 4 > target.size) continue;
+            /* The addend is stored in the place to be relocated. */
+            addend = (long)(int)(
+                (unsigned int)mf->data[target.offset + r_offset] |
+                ((unsigned int)mf->data[target.offset + r_offset + 1] << 8) |
+                ((unsigned int)mf->data[target.offset + r_offset + 2] << 16) |
+                ((unsigned int)mf->data[target.offset + r_offset + 3] << 24));
+        }
+
+        /*
+         * The operand of 'call' and 'jmp' is the last 4 bytes of the
+         * instruction and is relative to the next instruction, hence
+         * the addend.
+         */
+        if(addend != -4 || r_offset == 0 || r_offset + 4 > target.size)
+            continue;
+
+        insn = mf->data + target.offset + r_offset - 1;
+        if(*insn != OP_CALL && *insn != OP_JMP)
+            continue;
+
+        if(!is_imported_symbol(mf, &symtab, sym))
+            continue;
+
+        result = func(placements[rel->info].offset + r_offset, data);
+        if(result != 0) return result;
+    }
+    return 0;
+}
+
+int
+module_file_for_each_call_site(const struct module_file* mf,
+    const struct placement* placements, char area,
+    module_file_site_func func, void* data)
+{
+    unsigned int i;
+    struct section sec;
+    int result;
+
+    for(i = 0; i < mf->shnum; ++i)
+    {
+        if(module_file_get_section(mf, i, &sec)) return -1;
+        if(sec.type != (mf->is_64 ? SHT_RELA : SHT_REL)) continue;
+
+        result = process_relocations(mf, &sec, placements, area, func, data);
+        if(result != 0) return result;
+    }
+    return 0;
+}
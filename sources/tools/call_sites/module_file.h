@@ -0,0 +1,112 @@
+/*
+ * Reading the code sections of a kernel module file (.ko) and the call
+ * sites in them for the user-space tools.
+ *
+ * Only x86 and x86-64 modules are supported.
+ */
+
+/* ========================================================================
+ * Copyright (C) 2012, KEDR development team
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation.
+ ======================================================================== */
+
+#ifndef KEDR_MODULE_FILE_H
+#define KEDR_MODULE_FILE_H
+
+#include <stddef.h>
+
+/* The module file mapped into memory. */
+struct module_file
+{
+    /* The name of the file, used in the error messages. */
+    const char* file_name;
+
+    const unsigned char* data;
+    size_t size;
+    int is_64;
+
+    unsigned int shnum;
+    /* Section name string table */
+    const char* shstrtab;
+    size_t shstrtab_size;
+};
+
+/* The fields of a section header the tools need. */
+struct section
+{
+    const char* name;
+    unsigned long type;
+    unsigned long flags;
+    unsigned long offset;
+    unsigned long size;
+    unsigned long link;
+    unsigned long info;
+    unsigned long addralign;
+    unsigned long entsize;
+};
+
+/* Where a code section is placed when the module is loaded. */
+struct placement
+{
+    /* 'c' - core area, 'i' - init area, 0 - not a code section. */
+    char area;
+    unsigned long offset;
+};
+
+/*
+ * Map the file into memory and check that it is a relocatable ELF file
+ * for x86 or x86-64.
+ *
+ * Returns 0 on success, -1 on failure. The errors are reported to stderr.
+ */
+int
+module_file_open(struct module_file* mf, const char* file_name);
+
+void
+module_file_close(struct module_file* mf);
+
+/*
+ * Get the header of the section 'index'. Returns 0 on success, -1 if the
+ * section is invalid.
+ */
+int
+module_file_get_section(const struct module_file* mf, unsigned int index,
+    struct section* sec);
+
+/*
+ * Compute the placement of the code sections in the core and init areas
+ * the same way as the kernel does it when loading the module: the code
+ * sections with names starting with ".init" go to the "init" area, the
+ * remaining ones go to the "core" area, in the order of their section
+ * headers, each one aligned according to its 'sh_addralign'.
+ *
+ * 'placements' should have room for 'mf->shnum' elements.
+ */
+int
+module_file_layout(const struct module_file* mf,
+    struct placement* placements, unsigned long* core_size,
+    unsigned long* init_size);
+
+/*
+ * Call 'func' for each call site in the given area ('c' or 'i') found from
+ * the relocations: the operand of a 'call' or 'jmp' instruction relocated
+ * against a function the module imports. 'offset' is the offset of the
+ * operand from the beginning of the area.
+ *
+ * The calls the kernel changes itself when loading the module (ftrace,
+ * retpoline and return thunks) are skipped.
+ *
+ * If 'func' returns nonzero, the iteration stops and that value is
+ * returned. Returns -1 if the module file is invalid, 0 otherwise.
+ */
+typedef int (*module_file_site_func)(unsigned long offset, void* data);
+
+int
+module_file_for_each_call_site(const struct module_file* mf,
+    const struct placement* placements, char area,
+    module_file_site_func func, void* data);
+
+#endif /* KEDR_MODULE_FILE_H */
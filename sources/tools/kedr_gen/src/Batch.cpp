@@ -0,0 +1,340 @@
+/* ========================================================================
+ * Copyright (C) 2012, KEDR development team
+ * Copyright (C) 2010-2012, Institute for System Programming
+ *                          of the Russian Academy of Sciences (ISPRAS)
+ * Authors:
+ *      Eugene A. Shatokhin <spectre@ispras.ru>
+ *      Andrey V. Tsyvarev  <tsyvarev@ispras.ru>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation.
+ ======================================================================== */
+
+#include <cassert>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+#include "Batch.h"
+#include "Generator.h"
+#include "OutputFile.h"
+#include "ValueLoader.h"
+
+using namespace std;
+
+///////////////////////////////////////////////////////////////////////
+// Strings
+const char commentMarker = '#';
+
+// Errors
+const string errOpenFailed = "unable to open file ";
+const string errReadFailed = "unable to read file ";
+const string errBadJob =
+    "expected \"<template directory> <data file> <output file> "
+    "[<dependencies file>]\"";
+const string errDuplicateOutput =
+    "the output file is already listed in the manifest: ";
+const string errCircularDeps =
+    "circular dependency between the generated files: ";
+const string errDependencyFailed =
+    "the data file could not be generated";
+const string errThreadFailed = "failed to create a worker thread";
+
+///////////////////////////////////////////////////////////////////////
+CBatchGenerator::CBatchGenerator()
+    : currentWave(NULL), nextJob(0), nFailed(0)
+{
+    pthread_mutex_init(&lock, NULL);
+}
+
+CBatchGenerator::~CBatchGenerator()
+{
+    for (size_t i = 0; i < workers.size(); ++i) {
+        map<string, CGenerator*>::iterator it;
+        for (it = workers[i].generators.begin();
+            it != workers[i].generators.end(); ++it) {
+            delete it->second;
+        }
+    }
+    pthread_mutex_destroy(&lock);
+}
+
+void
+CBatchGenerator::loadManifest(const string& manifestFile)
+{
+    ifstream inputFile(manifestFile.c_str());
+    if (!inputFile) {
+        throw CBatchError(errOpenFailed + manifestFile);
+    }
+
+    // Output file => index of the job generating it
+    map<string, int> producers;
+
+    string line;
+    int lineNumber = 0;
+    while (getline(inputFile, line)) {
+        ++lineNumber;
+        trimString(line);
+        if (line.empty() || line[0] == commentMarker) {
+            continue;
+        }
+
+        istringstream fields(line);
+        CJob job;
+        string extra;
+        if (!(fields >> job.templatePath >> job.dataFile >> job.outputFile)
+            || ((fields >> job.depsFile) && (fields >> extra))) {
+            throw CBatchError(formatErrorMessage(lineNumber, errBadJob));
+        }
+        job.lineNumber = lineNumber;
+        job.dependsOn = -1;
+        job.failed = false;
+
+        if (!producers.insert(
+            make_pair(job.outputFile, (int)jobs.size())).second) {
+            throw CBatchError(formatErrorMessage(lineNumber,
+                errDuplicateOutput + job.outputFile));
+        }
+        jobs.push_back(job);
+    }
+
+    if (!inputFile.eof()) {
+        throw CBatchError(errReadFailed + manifestFile);
+    }
+
+    for (size_t i = 0; i < jobs.size(); ++i) {
+        map<string, int>::const_iterator it = producers.find(jobs[i].dataFile);
+        if (it != producers.end()) {
+            jobs[i].dependsOn = it->second;
+        }
+    }
+
+    arrangeWaves();
+    return;
+}
+
+void
+CBatchGenerator::arrangeWaves()
+{
+    // wave[i] - the wave job #i belongs to, -1 if not determined yet.
+    vector<int> wave(jobs.size(), -1);
+    waves.clear();
+
+    for (size_t i = 0; i < jobs.size(); ++i) {
+        // Walk up the chain of dependencies until a job with a known
+        // wave or a job without dependencies is found. Each job depends
+        // on at most one other job, so the chain is a simple path unless
+        // there is a cycle.
+        vector<int> chain;
+        int current = (int)i;
+        while (current != -1 && wave[current] == -1) {
+            if (chain.size() > jobs.size()) {
+                throw CBatchError(formatErrorMessage(jobs[i].lineNumber,
+                    errCircularDeps + jobs[i].outputFile));
+            }
+            chain.push_back(current);
+            current = jobs[current].dependsOn;
+        }
+
+        int next = (current == -1) ? 0 : wave[current] + 1;
+        for (size_t k = chain.size(); k > 0; --k) {
+            wave[chain[k - 1]] = next++;
+        }
+    }
+
+    for (size_t i = 0; i < jobs.size(); ++i) {
+        if ((size_t)wave[i] >= waves.size()) {
+            waves.resize(wave[i] + 1);
+        }
+        waves[wave[i]].push_back((int)i);
+    }
+    return;
+}
+
+void
+CBatchGenerator::loadTemplates()
+{
+    // CTemplateLoader changes the current directory while loading, so the
+    // templates are loaded here rather than in the worker threads.
+    for (size_t i = 0; i < jobs.size(); ++i) {
+        const string& path = jobs[i].templatePath;
+        if (templates.find(path) != templates.end()) {
+            continue;
+        }
+
+        try {
+            templates[path].loadValues(path);
+        }
+        catch (CTemplateLoader::CLoadingError& e) {
+            templates.erase(path);
+            throw CBatchError(string("failed to load templates from ") +
+                path + ": " + e.what());
+        }
+    }
+    return;
+}
+
+unsigned int
+CBatchGenerator::generate(unsigned int nThreads)
+{
+    if (nThreads == 0) {
+        nThreads = 1;
+    }
+
+    size_t maxWave = 0;
+    for (size_t i = 0; i < waves.size(); ++i) {
+        if (waves[i].size() > maxWave) {
+            maxWave = waves[i].size();
+        }
+    }
+    if (nThreads > maxWave) {
+        nThreads = (unsigned int)maxWave;
+    }
+
+    workers.resize(nThreads);
+    for (size_t i = 0; i < workers.size(); ++i) {
+        workers[i].owner = this;
+    }
+
+    nFailed = 0;
+    for (size_t w = 0; w < waves.size(); ++w) {
+        currentWave = &waves[w];
+        nextJob = 0;
+
+        // The main thread acts as worker #0.
+        size_t nStarted = 1;
+        for (; nStarted < workers.size(); ++nStarted) {
+            if (pthread_create(&workers[nStarted].thread, NULL,
+                workerThread, &workers[nStarted]) != 0) {
+                cerr << "Warning: " << errThreadFailed << endl;
+                break;
+            }
+        }
+
+        if (!workers.empty()) {
+            processJobs(workers[0]);
+        }
+
+        for (size_t i = 1; i < nStarted; ++i) {
+            pthread_join(workers[i].thread, NULL);
+        }
+    }
+    currentWave = NULL;
+    return nFailed;
+}
+
+void*
+CBatchGenerator::workerThread(void* arg)
+{
+    CWorker* worker = static_cast<CWorker*>(arg);
+    worker->owner->processJobs(*worker);
+    return NULL;
+}
+
+void
+CBatchGenerator::processJobs(CWorker& worker)
+{
+    for (;;) {
+        pthread_mutex_lock(&lock);
+        if (nextJob >= currentWave->size()) {
+            pthread_mutex_unlock(&lock);
+            break;
+        }
+        CJob& job = jobs[(*currentWave)[nextJob]];
+        ++nextJob;
+
+        // The job this one depends on belongs to one of the previous
+        // waves, so it is complete by now.
+        bool canStart = (job.dependsOn == -1 || !jobs[job.dependsOn].failed);
+        pthread_mutex_unlock(&lock);
+
+        string error;
+        if (!canStart) {
+            error = errDependencyFailed;
+        }
+        else {
+            try {
+                executeJob(worker, job);
+            }
+            catch (bad_alloc& e) {
+                error = "not enough memory";
+            }
+            catch (CValueLoader::CLoadingError& e) {
+                error = string("failed to load ") + job.dataFile + ": " +
+                    e.what();
+            }
+            catch (runtime_error& e) {
+                error = e.what();
+            }
+        }
+
+        if (!error.empty()) {
+            pthread_mutex_lock(&lock);
+            job.failed = true;
+            ++nFailed;
+            cerr << "Failed to generate " << job.outputFile << ": "
+                 << error << endl;
+            pthread_mutex_unlock(&lock);
+        }
+    }
+    return;
+}
+
+CGenerator*
+CBatchGenerator::getGenerator(CWorker& worker, const string& templatePath)
+{
+    map<string, CGenerator*>::iterator it =
+        worker.generators.find(templatePath);
+    if (it != worker.generators.end()) {
+        return it->second;
+    }
+
+    map<string, CTemplateLoader>::const_iterator loader =
+        templates.find(templatePath);
+    assert(loader != templates.end());
+
+    // The constructor of CGenerator initializes MiST Engine which is not
+    // thread-safe.
+    pthread_mutex_lock(&lock);
+    CGenerator* generator = NULL;
+    try {
+        generator = new CGenerator();
+    }
+    catch (...) {
+        pthread_mutex_unlock(&lock);
+        throw;
+    }
+    pthread_mutex_unlock(&lock);
+
+    try {
+        generator->setCacheDir(cacheDir);
+        generator->setTemplates(loader->second.getDocumentGroup(),
+            loader->second.getBlockGroup());
+        worker.generators[templatePath] = generator;
+    }
+    catch (...) {
+        delete generator;
+        throw;
+    }
+    return generator;
+}
+
+void
+CBatchGenerator::executeJob(CWorker& worker, const CJob& job)
+{
+    CValueLoader valueLoader;
+    valueLoader.loadValues(job.dataFile);
+
+    string document;
+    CGenerator* generator = getGenerator(worker, job.templatePath);
+    generator->generateDocument(valueLoader.getValueGroups(), document);
+
+    writeFileIfChanged(job.outputFile, document);
+
+    if (!job.depsFile.empty()) {
+        writeDepsFile(job.depsFile,
+            templates.find(job.templatePath)->second.getFiles());
+    }
+    return;
+}
@@ -0,0 +1,178 @@
+#ifndef BATCH_H_1512_INCLUDED
+#define BATCH_H_1512_INCLUDED
+
+#include <map>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <pthread.h>
+
+#include "Common.h"
+#include "TemplateLoader.h"
+
+class CGenerator;
+
+// Objects of this class generate a set of documents listed in a manifest
+// file from a single process.
+//
+// Each non-empty line of the manifest that does not start with '#'
+// describes a single document:
+//      <template directory> <data file> <output file> [<dependencies file>]
+// The fields are separated with whitespace, so the paths may not contain
+// whitespace characters. If the dependencies file is specified, the list
+// of the template files the document is generated from is written there
+// (see writeDepsFile() in OutputFile.h).
+//
+// The templates from each template directory are loaded only once and
+// parsed at most once per worker thread no matter how many documents are
+// generated from them. The documents are generated in several threads.
+//
+// If the data file for a document is the output file of another document
+// in the manifest, the former is generated after the latter is ready.
+//
+// Each document is first written to a temporary file, "<output file>.tmp",
+// which is then renamed to the output file. So if the generation of a
+// document fails, the existing output file (if any) is left intact.
+// If the output file already has the contents to be written, it is not
+// touched at all, so that the things built from it are not rebuilt.
+class CBatchGenerator
+{
+public:
+    // This class represents the exceptions thrown if the manifest is
+    // invalid or the templates cannot be loaded.
+    class CBatchError : public std::runtime_error
+    {
+    public:
+        CBatchError(const std::string& msg = "")
+            : std::runtime_error(msg) {};
+    };
+
+public:
+    CBatchGenerator();
+    ~CBatchGenerator();
+
+    // Load the list of the documents to be generated from 'manifestFile'
+    // and order them according to the dependencies between them.
+    // The function throws CBatchError if the manifest is invalid and may
+    // throw any other exception as well.
+    void
+    loadManifest(const std::string& manifestFile);
+
+    // Use the cache of precompiled template groups in 'dir' (see
+    // TemplateCache.h). Should be called before generate().
+    void
+    setCacheDir(const std::string& dir)
+    {
+        cacheDir = dir;
+    }
+
+    // Load the templates for all the documents listed in the manifest.
+    // The function throws CBatchError if loading fails and may throw
+    // any other exception as well.
+    void
+    loadTemplates();
+
+    // Generate the documents using at most 'nThreads' threads.
+    // The errors are reported to stderr for each document that failed.
+    // The function returns the number of documents that could not be
+    // generated. Note that the documents that depend on the failed ones
+    // are not generated and are counted as failed too.
+    unsigned int
+    generate(unsigned int nThreads);
+
+private:
+    // A document to be generated.
+    struct CJob
+    {
+        std::string templatePath;
+        std::string dataFile;
+        std::string outputFile;
+
+        // Empty if the dependencies should not be written.
+        std::string depsFile;
+
+        // The number of the line in the manifest the job is defined at.
+        int lineNumber;
+
+        // Index of the job producing the data file for this job or -1
+        // if the data file is not generated by the batch.
+        int dependsOn;
+
+        // Nonzero if the job has failed or could not be started because
+        // the job it depends on has failed.
+        bool failed;
+    };
+
+    // The state of a worker thread. The template groups parsed by the
+    // worker are cached here, one generator per template directory.
+    // The parsed template groups store the values of parameters during
+    // generation, so they cannot be shared among the threads.
+    struct CWorker
+    {
+        CBatchGenerator* owner;
+        pthread_t thread;
+        std::map<std::string, CGenerator*> generators;
+    };
+
+private:
+    // The jobs in the order they are listed in the manifest.
+    std::vector<CJob> jobs;
+
+    // The indexes of the jobs to be executed, grouped in waves. A job
+    // can only depend on the jobs from the previous waves.
+    std::vector<std::vector<int> > waves;
+
+    // The templates loaded from each template directory.
+    std::map<std::string, CTemplateLoader> templates;
+
+    // The directory with precompiled template groups, empty if not used.
+    std::string cacheDir;
+
+    // The workers.
+    std::vector<CWorker> workers;
+
+    // This mutex protects the fields below as well as the creation of
+    // generators (MiST engine is initialized then).
+    pthread_mutex_t lock;
+
+    // The wave being processed and the position of the next job to be
+    // taken in it.
+    const std::vector<int>* currentWave;
+    size_t nextJob;
+
+    // The number of the jobs that have failed.
+    unsigned int nFailed;
+
+private:
+    // implementation-related stuff
+
+    // Split the jobs into waves according to their dependencies.
+    // The function throws CBatchError if there are circular dependencies.
+    void
+    arrangeWaves();
+
+    // Take the jobs from the current wave and execute them until there
+    // are none left.
+    void
+    processJobs(CWorker& worker);
+
+    // Generate the document for the job and write it to the output file.
+    // The function may throw exceptions in case of failure.
+    void
+    executeJob(CWorker& worker, const CJob& job);
+
+    // Return the generator with the templates from 'templatePath' already
+    // parsed. The generator is created if the worker does not have one.
+    CGenerator*
+    getGenerator(CWorker& worker, const std::string& templatePath);
+
+    static void*
+    workerThread(void* arg);
+
+    // Prohibit copying
+    CBatchGenerator(const CBatchGenerator&);
+    CBatchGenerator& operator=(const CBatchGenerator&);
+};
+
+#endif // BATCH_H_1512_INCLUDED
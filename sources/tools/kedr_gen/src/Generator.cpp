@@ -16,6 +16,7 @@
 #include <sstream>
 
 #include "Generator.h"
+#include "TemplateCache.h"
 
 //<>
 #include <iostream>
@@ -79,9 +80,11 @@ findMainTemplateIndex(const ValueList & templates,
 
 // Create a template group - do not forget to destroy it (mist_tg_destroy)
 // when it is no longer needed. The function will throw in case of failure.
+// If 'cacheDir' is not empty, the group is loaded from the cache of 
+// precompiled groups if possible and is stored there otherwise.
 static CMistTGroup*
 createTemplateGroup(const ValueList & templates, 
-    const std::string & groupName);
+    const std::string & groupName, const std::string & cacheDir);
 
 // Add CMistNameValuePair structure filled with pointers from 'name' and
 // 'value' to 'where' array. Only the pointers are copied, the contents of 
@@ -129,8 +132,15 @@ CGenerator::generateDocument(const std::vector<ValueList> & groups,
     const ValueList & blockTemplates,
     std::string & document)
 {
-    assert(groups.size() >= 1);
-    
+    setTemplates(documentTemplates, blockTemplates);
+    generateDocument(groups, document);
+    return;
+}
+
+void
+CGenerator::setTemplates(const ValueList & documentTemplates,
+    const ValueList & blockTemplates)
+{
     if (tgDocument != NULL) {
         mist_tg_destroy(tgDocument);
         tgDocument = NULL;
@@ -141,8 +151,19 @@ CGenerator::generateDocument(const std::vector<ValueList> & groups,
         tgBlock = NULL;
     }
     
-    tgDocument = createTemplateGroup(documentTemplates, documentGroupName);
-    tgBlock = createTemplateGroup(blockTemplates, blockGroupName);
+    tgDocument = createTemplateGroup(documentTemplates, documentGroupName,
+        cacheDir);
+    tgBlock = createTemplateGroup(blockTemplates, blockGroupName, cacheDir);
+    assert(tgDocument != NULL);
+    assert(tgBlock != NULL);
+    return;
+}
+
+void 
+CGenerator::generateDocument(const std::vector<ValueList> & groups,
+    std::string & document)
+{
+    assert(groups.size() >= 1);
     assert(tgDocument != NULL);
     assert(tgBlock != NULL);
     
@@ -194,10 +215,20 @@ findMainTemplateIndex(const ValueList & templates,
 
 static CMistTGroup*
 createTemplateGroup(const ValueList & templates, 
-    const std::string & groupName)
+    const std::string & groupName, const std::string & cacheDir)
 {
     size_t mainIndex = findMainTemplateIndex(templates, groupName);
     
+    string cacheKey;
+    if (!cacheDir.empty()) {
+        cacheKey = templateCacheKey(templates, groupName, 
+            begMarker, endMarker);
+        CMistTGroup* cached = loadCachedTemplateGroup(cacheDir, cacheKey);
+        if (cached != NULL) {
+            return cached;
+        }
+    }
+    
     CMistNameValuePair* source = new CMistNameValuePair[templates.size()];
     for (size_t i = 0; i < templates.size(); ++i) {
         source[i].name = templates.at(i).name.c_str();
@@ -238,6 +269,10 @@ createTemplateGroup(const ValueList & templates,
         free(whatFailed);
         throw (CGenerator::CGeneratorError(err.str()));
     }
+    
+    if (!cacheDir.empty()) {
+        storeCachedTemplateGroup(cacheDir, cacheKey, tg);
+    }
     return tg;
 }
 
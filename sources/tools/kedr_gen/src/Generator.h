@@ -25,6 +25,15 @@ public:
     CGenerator();
     ~CGenerator();
 
+    // Use the cache of precompiled template groups in 'dir' (see 
+    // TemplateCache.h) when the templates are set next time. If 'dir' is 
+    // empty, the cache is not used, which is the default.
+    void
+    setCacheDir(const std::string & dir)
+    {
+        cacheDir = dir;
+    }
+
     // Generate the output document and store it in 'document'.
     // The function may throw exceptions (including but not limited to
     // CGeneratorError).
@@ -34,9 +43,29 @@ public:
         const ValueList & blockTemplates,
         std::string & document);
     
+    // Parse the templates of "document" and "block" groups. The parsed 
+    // templates are kept until the next call to setTemplates() or 
+    // generateDocument() with the templates specified, so several 
+    // documents can be generated without parsing the templates again.
+    // The function may throw exceptions (including but not limited to
+    // CGeneratorError).
+    void
+    setTemplates(const ValueList & documentTemplates,
+        const ValueList & blockTemplates);
+    
+    // Generate the output document using the templates set by 
+    // setTemplates() and store it in 'document'.
+    // The function may throw exceptions (including but not limited to
+    // CGeneratorError).
+    void 
+    generateDocument(const std::vector<ValueList> & groups,
+        std::string & document);
+    
 private:
     CMistTGroup* tgDocument;
     CMistTGroup* tgBlock;
+    
+    std::string cacheDir;
 };
 
 #endif // GENERATOR_H_1900_INCLUDED
@@ -0,0 +1,94 @@
+/* ========================================================================
+ * Copyright (C) 2012, KEDR development team
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation.
+ ======================================================================== */
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#include "OutputFile.h"
+
+using namespace std;
+
+///////////////////////////////////////////////////////////////////////
+// Strings
+const string tmpSuffix = ".tmp";
+
+// Errors
+const string errOpenFailed = "unable to open file ";
+const string errWriteFailed = "unable to write file ";
+const string errRenameFailed = "unable to rename file ";
+
+///////////////////////////////////////////////////////////////////////
+// Check if the file 'path' exists and has exactly the given contents.
+static bool
+hasContents(const string& path, const string& contents)
+{
+    // Most of the files that have changed differ in size, no need to 
+    // read them.
+    struct stat st;
+    if (stat(path.c_str(), &st) != 0 || !S_ISREG(st.st_mode) ||
+        (size_t)st.st_size != contents.size()) {
+        return false;
+    }
+    
+    ifstream in(path.c_str(), ios_base::binary);
+    if (!in) {
+        return false;
+    }
+    string fileData((istreambuf_iterator<char>(in)), 
+        istreambuf_iterator<char>());
+    return (fileData == contents);
+}
+
+bool
+writeFileIfChanged(const std::string& path, const std::string& contents)
+{
+    if (hasContents(path, contents)) {
+        return false;
+    }
+    
+    string tmpFile = path + tmpSuffix;
+    ofstream outputFile(tmpFile.c_str(), ios_base::binary);
+    if (!outputFile) {
+        throw runtime_error(errOpenFailed + tmpFile);
+    }
+
+    outputFile << contents;
+    outputFile.close();
+    if (!outputFile) {
+        remove(tmpFile.c_str());
+        throw runtime_error(errWriteFailed + tmpFile);
+    }
+
+    if (rename(tmpFile.c_str(), path.c_str()) != 0) {
+        string reason = strerror(errno);
+        remove(tmpFile.c_str());
+        throw runtime_error(errRenameFailed + tmpFile + ": " + reason);
+    }
+    return true;
+}
+
+void
+writeDepsFile(const std::string& depsPath, 
+    const std::vector<std::string>& files)
+{
+    string contents = "SET(deps_list\n";
+    for (size_t i = 0; i < files.size(); ++i) {
+        contents += "\"" + files[i] + "\"\n";
+    }
+    contents += ")\n";
+    
+    writeFileIfChanged(depsPath, contents);
+    return;
+}
@@ -0,0 +1,37 @@
+#ifndef OUTPUTFILE_H_1420_INCLUDED
+#define OUTPUTFILE_H_1420_INCLUDED
+
+#include <string>
+#include <vector>
+
+// Helpers to write the generated files without touching those that have
+// not changed. If the timestamp of a generated source file is left intact,
+// the build system does not rebuild anything that depends on it.
+
+///////////////////////////////////////////////////////////////////////
+// Write 'contents' to the file 'path' unless the file already has exactly
+// the same contents. The data are written to "<path>.tmp" first and this
+// file is then renamed, so a failure does not leave a partially written
+// file.
+// The function returns true if the file has been written, false if it
+// was already up to date. It throws std::runtime_error in case of failure
+// and may throw any other exception as well.
+bool
+writeFileIfChanged(const std::string& path, const std::string& contents);
+
+// Write the list of the template files a document has been generated from
+// (see CTemplateLoader::getFiles()) to the dependencies file 'depsPath', 
+// in the format of CMake scripts:
+//      SET(deps_list
+//      "<file>"
+//      ...
+//      )
+// This is the same format as update_deps.sh in the build system of KEDR
+// uses. Like writeFileIfChanged(), the function does not touch the file
+// if the list has not changed.
+void
+writeDepsFile(const std::string& depsPath, 
+    const std::vector<std::string>& files);
+
+///////////////////////////////////////////////////////////////////////
+#endif // OUTPUTFILE_H_1420_INCLUDED
@@ -0,0 +1,187 @@
+/* ========================================================================
+ * Copyright (C) 2012, KEDR development team
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation.
+ ======================================================================== */
+
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "TemplateCache.h"
+
+using namespace std;
+
+///////////////////////////////////////////////////////////////////////
+// Strings
+const string cacheFileSuffix = ".mtg";
+const string tmpFileSuffix = ".XXXXXX";
+
+///////////////////////////////////////////////////////////////////////
+// 64-bit FNV-1a hash. It is not cryptographic but the cache is private to 
+// the build, so only accidental collisions matter, and these are extremely
+// unlikely for 64-bit hashes.
+class CHash
+{
+public:
+    CHash()
+        : value(14695981039346656037ULL)
+    {}
+    
+    // Add the string including its terminating '\0', so that ("ab", "c")
+    // and ("a", "bc") give different hashes.
+    void
+    add(const string & s)
+    {
+        for (size_t i = 0; i < s.size(); ++i) {
+            addByte((unsigned char)s[i]);
+        }
+        addByte(0);
+    }
+    
+    void
+    add(unsigned long long n)
+    {
+        for (size_t i = 0; i < sizeof(n); ++i) {
+            addByte((unsigned char)(n >> (8 * i)));
+        }
+    }
+    
+    string
+    toString() const
+    {
+        char buf[2 * sizeof(value) + 1];
+        snprintf(buf, sizeof(buf), "%016llx", value);
+        return buf;
+    }
+    
+private:
+    void
+    addByte(unsigned char b)
+    {
+        value ^= b;
+        value *= 1099511628211ULL;
+    }
+    
+    unsigned long long value;
+};
+
+///////////////////////////////////////////////////////////////////////
+string
+templateCacheKey(const ValueList & templates, const std::string & groupName,
+    const std::string & begMarker, const std::string & endMarker)
+{
+    CHash hash;
+    
+    // The format of the precompiled groups may change in a new version of
+    // MiST Engine.
+    hash.add((unsigned long long)MIST_ENGINE_API_MAX_VERSION);
+    hash.add(begMarker);
+    hash.add(endMarker);
+    hash.add((unsigned long long)templates.size());
+    for (size_t i = 0; i < templates.size(); ++i) {
+        hash.add(templates[i].name);
+        hash.add(templates[i].value);
+    }
+    
+    // The name of the group is for the humans looking at the cache.
+    return groupName + "-" + hash.toString();
+}
+
+CMistTGroup*
+loadCachedTemplateGroup(const std::string & cacheDir, 
+    const std::string & key)
+{
+    string path = cacheDir + "/" + key + cacheFileSuffix;
+    
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd == -1) {
+        return NULL;
+    }
+    
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size <= 0) {
+        close(fd);
+        return NULL;
+    }
+    
+    void* data = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE,
+        fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) {
+        return NULL;
+    }
+    
+    CMistTGroup* tg = NULL;
+    char* whatFailed = NULL;
+    if (mist_tg_load_precompiled(&tg, data, (size_t)st.st_size, 
+        &whatFailed) != MIST_OK) {
+        tg = NULL;
+    }
+    free(whatFailed);
+    
+    munmap(data, (size_t)st.st_size);
+    return tg;
+}
+
+void
+storeCachedTemplateGroup(const std::string & cacheDir, 
+    const std::string & key, CMistTGroup* tg)
+{
+    size_t size = 0;
+    if (mist_tg_save_precompiled(tg, NULL, 0, &size) != MIST_OK) {
+        return;
+    }
+    
+    vector<char> image(size);
+    size_t needed = 0;
+    if (mist_tg_save_precompiled(tg, &image[0], image.size(), 
+        &needed) != MIST_OK || needed != size) {
+        return;
+    }
+    
+    if (mkdir(cacheDir.c_str(), 0777) != 0 && errno != EEXIST) {
+        return;
+    }
+    
+    string path = cacheDir + "/" + key + cacheFileSuffix;
+    string tmpPath = path + tmpFileSuffix;
+    vector<char> tmpName(tmpPath.begin(), tmpPath.end());
+    tmpName.push_back(0);
+    
+    // A unique temporary file: other threads and processes may store the
+    // same group at the same time.
+    int fd = mkstemp(&tmpName[0]);
+    if (fd == -1) {
+        return;
+    }
+    
+    const char* pos = &image[0];
+    size_t left = image.size();
+    while (left != 0) {
+        ssize_t written = write(fd, pos, left);
+        if (written < 0 && errno == EINTR) {
+            continue;
+        }
+        if (written <= 0) {
+            break;
+        }
+        pos += written;
+        left -= (size_t)written;
+    }
+    
+    if (close(fd) != 0 || left != 0 || 
+        rename(&tmpName[0], path.c_str()) != 0) {
+        unlink(&tmpName[0]);
+    }
+    return;
+}
@@ -0,0 +1,50 @@
+#ifndef TEMPLATECACHE_H_1630_INCLUDED
+#define TEMPLATECACHE_H_1630_INCLUDED
+
+#include <string>
+
+#include <mist_engine.h>
+
+#include "Common.h"
+
+// The cache of precompiled template groups.
+//
+// Parsing the templates takes a noticeable part of the time kedr_gen runs,
+// while the templates rarely change. So the parsed template groups can be
+// saved in a cache directory (see mist_tg_save_precompiled()) and loaded
+// from there next time without parsing (see mist_tg_load_precompiled()).
+//
+// Each group is stored in a separate file, the name of which is derived 
+// from the hash of everything the group is created from: the templates, 
+// the markers and the version of MiST Engine. So a change in the templates
+// results in a different file rather than in a stale group being used.
+// The files are never removed from the cache, the whole cache directory 
+// can be removed at any time though.
+//
+// The cache is only an optimization, so failures to use it are not 
+// reported: the group is just created from the templates then.
+
+// Return the key (the name of the file in the cache) for the template 
+// group 'groupName' created from 'templates' with the given markers.
+std::string
+templateCacheKey(const ValueList & templates, const std::string & groupName,
+    const std::string & begMarker, const std::string & endMarker);
+
+// Load the template group with the given key from the cache directory 
+// 'cacheDir'. The function returns NULL if there is no such group in the
+// cache or if it cannot be loaded.
+CMistTGroup*
+loadCachedTemplateGroup(const std::string & cacheDir, 
+    const std::string & key);
+
+// Save the template group 'tg' in the cache directory 'cacheDir' under the
+// given key. The directory is created if it does not exist. The file is 
+// written to a temporary file first and then renamed, so the processes 
+// and threads using the same cache concurrently never see a partially 
+// written file.
+void
+storeCachedTemplateGroup(const std::string & cacheDir, 
+    const std::string & key, CMistTGroup* tg);
+
+///////////////////////////////////////////////////////////////////////
+#endif // TEMPLATECACHE_H_1630_INCLUDED
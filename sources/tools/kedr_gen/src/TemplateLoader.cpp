@@ -15,6 +15,7 @@
 #include <dirent.h>
 #include <limits.h>
 
+#include <algorithm>
 #include <iterator>
 #include <fstream>
 
@@ -47,6 +48,24 @@ const string errReadFailed = "unable to read file ";
 // Constants
 const size_t pathBufferSize = ((PATH_MAX < 2048) ? 2048 : PATH_MAX);
 
+///////////////////////////////////////////////////////////////////////
+// Append the paths to the files of the group 'groupName' loaded from
+// 'templatePath' to 'files', in the order of their names, followed by the
+// path to the directory of the group.
+static void
+addGroupFiles(const string& templatePath, const string& groupName,
+    vector<string>& fileNames, vector<string>& files)
+{
+    string groupPath = templatePath + "/" + groupName;
+    
+    sort(fileNames.begin(), fileNames.end());
+    for (size_t i = 0; i < fileNames.size(); ++i) {
+        files.push_back(groupPath + "/" + fileNames[i]);
+    }
+    files.push_back(groupPath);
+    return;
+}
+
 ///////////////////////////////////////////////////////////////////////
 CTemplateLoader::CTemplateLoader()
 {}
@@ -72,23 +91,31 @@ CTemplateLoader::loadValues(const std::string& templatePath)
     // ("Either succeed or have no effect" rule).
     RawTemplates tempDocumentGroup;
     RawTemplates tempBlockGroup;
+    vector<string> documentFiles;
+    vector<string> blockFiles;
     
-    loadTemplateGroup(documentGroupName, tempDocumentGroup);
-    loadTemplateGroup(blockGroupName, tempBlockGroup);
+    loadTemplateGroup(documentGroupName, tempDocumentGroup, documentFiles);
+    loadTemplateGroup(blockGroupName, tempBlockGroup, blockFiles);
     
     // Return to the previously saved directory. 
     if (chdir(cwd) != 0) { 
         throw CLoadingError(errNoDir + string(cwd));
     }
     
+    vector<string> tempFiles;
+    addGroupFiles(templatePath, documentGroupName, documentFiles, 
+        tempFiles);
+    addGroupFiles(templatePath, blockGroupName, blockFiles, tempFiles);
+    
     documentGroup.swap(tempDocumentGroup);
     blockGroup.swap(tempBlockGroup);
+    files.swap(tempFiles);
     return;
 }
 
 void 
 CTemplateLoader::loadTemplateGroup(const std::string& name, 
-    RawTemplates& templates)
+    RawTemplates& templates, std::vector<std::string>& fileNames)
 {
     assert(templates.empty());
     
@@ -110,6 +137,7 @@ CTemplateLoader::loadTemplateGroup(const std::string& name,
                 CValue v;
                 loadTemplateFile(name, fileName, v);
                 templates.push_back(v);
+                fileNames.push_back(fileName);
             }
             catch (...) {
                 closedir(d);
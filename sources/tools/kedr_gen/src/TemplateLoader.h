@@ -68,6 +68,15 @@ public:
     {
         return blockGroup;
     }
+    
+    // The paths to the template files loaded, each group followed by the
+    // path to its directory (adding or removing a template there may
+    // change the result too). The files of a group are sorted by name.
+    const std::vector<std::string> &
+    getFiles() const
+    {
+        return files;
+    }
 
 private:
     // Here group of templates "document" will be stored.
@@ -75,17 +84,22 @@ private:
     
     // Here group of templates "block" will be stored.
     RawTemplates blockGroup;
+    
+    // The files the templates have been loaded from, see getFiles().
+    std::vector<std::string> files;
 
 private:
     // implementation-related stuff
     
     // Load a group of templates from all the .tpl files contained in 'name'
     // subdirectory of the current working directory.
-    // The results are stored in 'templates'.
+    // The results are stored in 'templates', the names of the files are
+    // appended to 'fileNames'.
     // The function throws CLoadingError in case of failure and may throw
     // any other exception as well.
     static void 
-    loadTemplateGroup(const std::string& name, RawTemplates& templates);
+    loadTemplateGroup(const std::string& name, RawTemplates& templates,
+        std::vector<std::string>& fileNames);
     
     // Load the template from the file <groupName>/<fileName> into 
     // 'rawTemplate'.
@@ -0,0 +1,201 @@
+/*
+ * Benchmark for the cache of precompiled template groups (see 
+ * TemplateCache.h).
+ *
+ * Usage:
+ *   kedr_gen_bench [-n <iterations>] <template directory> <data file>
+ *
+ * The templates are loaded from the directory once. Then the time needed
+ * to prepare a generator for them (CGenerator::setTemplates(), i.e. what
+ * kedr_gen does at startup besides loading the files) is measured in the 
+ * following modes:
+ *   nocache - the templates are parsed each time;
+ *   cold    - the cache is empty each time, so the templates are parsed
+ *             and the groups are stored in the cache;
+ *   warm    - the groups are loaded from the cache.
+ * The results are output in CSV format:
+ *
+ *   mode,iterations,us_per_iteration
+ *
+ * The document is generated from the data file in each mode and the 
+ * results are checked to be the same.
+ *
+ * The benchmark is not built by default, use "make kedr_gen_bench".
+ */
+
+/* ========================================================================
+ * Copyright (C) 2012, KEDR development team
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation.
+ ======================================================================== */
+
+#include <iostream>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+#include <dirent.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "ValueLoader.h"
+#include "TemplateLoader.h"
+#include "Generator.h"
+
+using namespace std;
+
+///////////////////////////////////////////////////////////////////////
+// The modes of the benchmark, see above.
+enum EMode
+{
+    MODE_NOCACHE,
+    MODE_COLD,
+    MODE_WARM,
+    MODE_NUM
+};
+
+static const char* modeNames[MODE_NUM] = {"nocache", "cold", "warm"};
+
+///////////////////////////////////////////////////////////////////////
+static double
+nowUs()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec * 1e6 + (double)ts.tv_nsec / 1e3;
+}
+
+// Remove the files from the cache directory (but not the directory).
+static void
+clearCache(const string& cacheDir)
+{
+    DIR* d = opendir(cacheDir.c_str());
+    if (d == NULL) {
+        return;
+    }
+    
+    struct dirent* entry;
+    while ((entry = readdir(d)) != NULL) {
+        if (entry->d_name[0] == '.') {
+            continue;
+        }
+        unlink((cacheDir + "/" + entry->d_name).c_str());
+    }
+    closedir(d);
+    return;
+}
+
+// Run the benchmark in the given mode, return the average time of an 
+// iteration in microseconds. The document generated in the last iteration
+// is returned in 'document'.
+static double
+runMode(EMode mode, unsigned long iterations, 
+    const string& cacheDir,
+    const CTemplateLoader& templates, const CValueLoader& values,
+    string& document)
+{
+    clearCache(cacheDir);
+    if (mode == MODE_WARM) {
+        CGenerator generator;
+        generator.setCacheDir(cacheDir);
+        generator.setTemplates(templates.getDocumentGroup(), 
+            templates.getBlockGroup());
+    }
+    
+    double total = 0.0;
+    for (unsigned long i = 0; i < iterations; ++i) {
+        if (mode == MODE_COLD) {
+            clearCache(cacheDir);
+        }
+        
+        CGenerator generator;
+        if (mode != MODE_NOCACHE) {
+            generator.setCacheDir(cacheDir);
+        }
+        
+        double start = nowUs();
+        generator.setTemplates(templates.getDocumentGroup(), 
+            templates.getBlockGroup());
+        total += nowUs() - start;
+        
+        if (i + 1 == iterations) {
+            generator.generateDocument(values.getValueGroups(), document);
+        }
+    }
+    return total / (double)iterations;
+}
+
+///////////////////////////////////////////////////////////////////////
+int 
+main(int argc, char* argv[])
+{
+    unsigned long iterations = 1000;
+    
+    int opt;
+    while ((opt = getopt(argc, argv, "n:")) != -1) {
+        if (opt == 'n') {
+            iterations = strtoul(optarg, NULL, 10);
+        }
+        else {
+            optind = argc + 1;
+            break;
+        }
+    }
+    
+    if (optind + 2 != argc || iterations == 0) {
+        cerr << "Usage: kedr_gen_bench [-n <iterations>] "
+             << "<template directory> <data file>" << endl;
+        return EXIT_FAILURE;
+    }
+    string templatePath = argv[optind];
+    string dataFile = argv[optind + 1];
+    
+    char cacheTemplate[] = "/tmp/kedr_gen_bench.XXXXXX";
+    if (mkdtemp(cacheTemplate) == NULL) {
+        cerr << "Failed to create a temporary directory" << endl;
+        return EXIT_FAILURE;
+    }
+    string cacheDir = cacheTemplate;
+    
+    int ret = EXIT_SUCCESS;
+    try {
+        CValueLoader values;
+        values.loadValues(dataFile);
+        
+        CTemplateLoader templates;
+        templates.loadValues(templatePath);
+        
+        string documents[MODE_NUM];
+        cout << "mode,iterations,us_per_iteration" << endl;
+        for (int m = 0; m < MODE_NUM; ++m) {
+            double us = runMode((EMode)m, iterations, cacheDir, 
+                templates, values, documents[m]);
+            
+            char line[128];
+            snprintf(line, sizeof(line), "%s,%lu,%.2f", 
+                modeNames[m], iterations, us);
+            cout << line << endl;
+        }
+        
+        for (int m = MODE_NOCACHE + 1; m < MODE_NUM; ++m) {
+            if (documents[m] != documents[MODE_NOCACHE]) {
+                cerr << "The document generated in \"" << modeNames[m]
+                     << "\" mode differs from the one generated "
+                     << "without the cache" << endl;
+                ret = EXIT_FAILURE;
+            }
+        }
+    }
+    catch (exception& e) {
+        cerr << "Error: " << e.what() << endl;
+        ret = EXIT_FAILURE;
+    }
+    
+    clearCache(cacheDir);
+    rmdir(cacheDir.c_str());
+    return ret;
+}
@@ -16,25 +16,44 @@
 #include <cstddef>
 #include <cstdlib>
 
+#include <unistd.h>
+
 #include "ValueLoader.h"
 #include "TemplateLoader.h"
 #include "Generator.h"
+#include "Batch.h"
+#include "OutputFile.h"
 
 using namespace std;
 
 ///////////////////////////////////////////////////////////////////////
 // Common data
 const string appName = "kedr_gen";
+const string batchOption = "--batch";
+const string jobsOption = "--jobs";
+const string outputOption = "--output";
+const string depfileOption = "--depfile";
+const string cacheOption = "--template-cache";
 
 ///////////////////////////////////////////////////////////////////////
 // Output information about the usage of the tool
 static void
 usage();
 
+// Generate the documents listed in the manifest file (see Batch.h), 
+// "--batch <manifest> [--jobs <N>] [--template-cache <dir>]" should be
+// passed in the command line.
+static int
+runBatch(int argc, char* argv[]);
+
 ///////////////////////////////////////////////////////////////////////
 int 
 main(int argc, char* argv[])
 {
+    if (argc >= 2 && batchOption == argv[1]) {
+        return runBatch(argc, argv);
+    }
+    
     if (argc < 3) {
         usage();
         return EXIT_SUCCESS;
@@ -42,6 +61,36 @@ main(int argc, char* argv[])
     string dataFile = argv[2];
     string templatePath = argv[1];
     
+    // If the output file is not specified, the document is written to
+    // stdout. Otherwise, the file is only written if the document has
+    // changed.
+    string outputFile;
+    string depsFile;
+    string cacheDir;
+    for (int i = 3; i < argc; i += 2) {
+        if (i + 1 >= argc) {
+            usage();
+            return EXIT_FAILURE;
+        }
+        if (outputOption == argv[i]) {
+            outputFile = argv[i + 1];
+        }
+        else if (depfileOption == argv[i]) {
+            depsFile = argv[i + 1];
+        }
+        else if (cacheOption == argv[i]) {
+            cacheDir = argv[i + 1];
+        }
+        else {
+            usage();
+            return EXIT_FAILURE;
+        }
+    }
+    if (!depsFile.empty() && outputFile.empty()) {
+        usage();
+        return EXIT_FAILURE;
+    }
+    
     string document;
     
     try {
@@ -55,10 +104,18 @@ main(int argc, char* argv[])
         
         // Generate the resulting document
         CGenerator generator;
+        generator.setCacheDir(cacheDir);
         generator.generateDocument(valueLoader.getValueGroups(),
             templateLoader.getDocumentGroup(),
             templateLoader.getBlockGroup(),
             document);
+        
+        if (!outputFile.empty()) {
+            writeFileIfChanged(outputFile, document);
+            if (!depsFile.empty()) {
+                writeDepsFile(depsFile, templateLoader.getFiles());
+            }
+        }
     } 
     catch (bad_alloc& e) {
         cerr << "Error: not enough memory" << endl;
@@ -79,16 +136,83 @@ main(int argc, char* argv[])
     }
     
     // Output the result
-    cout << document.c_str();
+    if (outputFile.empty()) {
+        cout << document.c_str();
+    }
     return EXIT_SUCCESS;
 }
 
+///////////////////////////////////////////////////////////////////////
+static int
+runBatch(int argc, char* argv[])
+{
+    if (argc < 3 || argc % 2 == 0) {
+        usage();
+        return EXIT_FAILURE;
+    }
+    string manifestFile = argv[2];
+    string cacheDir;
+    
+    long nThreads = sysconf(_SC_NPROCESSORS_ONLN);
+    for (int i = 3; i < argc; i += 2) {
+        if (jobsOption == argv[i]) {
+            char* end = NULL;
+            nThreads = strtol(argv[i + 1], &end, 10);
+            if (*argv[i + 1] == 0 || *end != 0 || nThreads <= 0) {
+                cerr << "Invalid number of jobs: " << argv[i + 1] << endl;
+                return EXIT_FAILURE;
+            }
+        }
+        else if (cacheOption == argv[i]) {
+            cacheDir = argv[i + 1];
+        }
+        else {
+            usage();
+            return EXIT_FAILURE;
+        }
+    }
+    if (nThreads <= 0) {
+        nThreads = 1;
+    }
+    
+    unsigned int nFailed = 0;
+    try {
+        CBatchGenerator batch;
+        batch.setCacheDir(cacheDir);
+        batch.loadManifest(manifestFile);
+        batch.loadTemplates();
+        nFailed = batch.generate((unsigned int)nThreads);
+    }
+    catch (bad_alloc& e) {
+        cerr << "Error: not enough memory" << endl;
+        return EXIT_FAILURE;
+    }
+    catch (CBatchGenerator::CBatchError& e) {
+        cerr << "Failed to process " << manifestFile << ": " 
+             << e.what() << endl;
+        return EXIT_FAILURE;
+    }
+    catch (runtime_error& e) {
+        cerr << "Error: " << e.what() << endl;
+        return EXIT_FAILURE;
+    }
+    
+    return (nFailed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
 ///////////////////////////////////////////////////////////////////////
 static void 
 usage()
 {
     cout << "Usage: " << appName << " "
          << "<template directory> " 
-         << "<data file>" << endl;
+         << "<data file> "
+         << "[" << outputOption << " <output file> "
+         << "[" << depfileOption << " <dependencies file>]] "
+         << "[" << cacheOption << " <directory>]" << endl;
+    cout << "       " << appName << " "
+         << batchOption << " <manifest file> "
+         << "[" << jobsOption << " <number of threads>] "
+         << "[" << cacheOption << " <directory>]" << endl;
     return;
 }
@@ -22,6 +22,7 @@
 #include <string.h>
 #include <stdlib.h>
 #include <stdio.h>
+#include <stdint.h>
 #include <dirent.h>
 
 #include <assert.h>
@@ -227,6 +228,12 @@ static const char* errUnspecifiedError =
     "unspecified error";
 static const char* errEmptyParam = 
     "parameter \"%s\" has empty value in the .cfg file in \"%s\"";
+static const char* errNotPrecompiled = 
+    "the data do not contain a precompiled template group";
+static const char* errPrecompiledVersion = 
+    "the precompiled template group has unsupported format version or byte order";
+static const char* errBadPrecompiled = 
+    "the precompiled template group is corrupted";
 
 ///////////////////////////////////////////////////////////////////////////
 // Declarations: "private methods"
@@ -496,6 +503,95 @@ mist_token_create(EMistTokenType type, const char* beg, const char* end);
 static void
 mist_token_destroy(CMistToken* token);
 
+///////////////////////////////////////////////////////////////////////////
+// Precompiled template groups
+
+/// A precompiled template group is an image of an already parsed group with
+/// the placeholders already connected to the templates they refer to. 
+/// All numbers in the image are 32-bit unsigned integers in the native byte
+/// order. A string is stored as its length followed by its characters and
+/// the terminating '\0'. The layout of the image is as follows:
+///
+///   - magic, format version, byte order mark;
+///   - the number of templates in the group, the index of the main template;
+///   - the names of the templates, sorted the same way as in the group;
+///   - for each template: its contents (see below).
+///
+/// The contents of a template: the number of string chunks, the chunks, the
+/// number of placeholders, the placeholders. The attributes are stored as
+/// the templates without string chunks and placeholders.
+///
+/// A placeholder: its type and name, then
+///   - MPH_PLAIN: the index of the template it refers to;
+///   - MPH_JOIN:  the separator, the index of the template it refers to;
+///   - MPH_COND:  'is_concat', the index of the template for the conditional
+///                expression, the names and the contents of "then" and 
+///                "else" templates.
+/// 
+/// The format version must be changed whenever the layout changes. The 
+/// images are not portable between the machines with different byte order,
+/// it is checked when loading them.
+static const char mist_pc_magic[] = "MiSTpcg";
+#define MIST_PC_FORMAT_VERSION  1
+#define MIST_PC_BYTE_ORDER_MARK 0x01020304
+
+/// Output stream for the image. If the image does not fit into 'buf', the 
+/// data that do not fit are discarded but 'pos' is advanced anyway, so it 
+/// is the size of the whole image in the end.
+typedef struct CMistPcWriter_
+{
+    char* buf;
+    size_t size;
+    size_t pos;
+} CMistPcWriter;
+
+/// Input stream for the image. 'data' is not necessarily null-terminated.
+typedef struct CMistPcReader_
+{
+    const char* data;
+    size_t size;
+    size_t pos;
+} CMistPcReader;
+
+/// Write 'len' bytes from 'data', a number or a string to the image.
+static void
+mist_pc_write(CMistPcWriter* w, const void* data, size_t len);
+
+static void
+mist_pc_write_uint(CMistPcWriter* w, size_t val);
+
+static void
+mist_pc_write_string(CMistPcWriter* w, const char* str);
+
+/// Write the contents of the template 'mt' from the group 'mtg' (the name
+/// of the template is not written).
+static void
+mist_pc_write_template(CMistPcWriter* w, CMistTemplateGroup* mtg, 
+    CMistTemplate* mt);
+
+/// Read a number from the image. The function returns 0 if there is no 
+/// more data in the image, nonzero otherwise.
+static int
+mist_pc_read_uint(CMistPcReader* r, size_t* val);
+
+/// Read a string from the image and return a pointer to it (the string
+/// is located in the image itself). NULL is returned if the image does 
+/// not contain a valid string at the current position.
+static const char*
+mist_pc_read_string(CMistPcReader* r);
+
+/// Read the contents of the template 'mt' from the image. 'mt' is created
+/// by the caller and is empty. The templates of the group 'mtg' must have 
+/// been created already (they are referred to by index in the image).
+static EMistErrorCode
+mist_pc_read_template(CMistPcReader* r, CMistTemplateGroup* mtg, 
+    CMistTemplate* mt);
+
+/// Read a placeholder from the image and add it to the template 'mt'.
+static EMistErrorCode
+mist_pc_read_placeholder(CMistPcReader* r, CMistTemplateGroup* mtg, 
+    CMistTemplate* mt);
+
 ///////////////////////////////////////////////////////////////////////////
 // Other functions
 
@@ -2750,6 +2846,326 @@ mist_parse_cond_expr(const char* beg, const char* end, int* is_concat)
     return mist_get_substring(nbeg, nend);
 }
 
+///////////////////////////////////////////////////////////////////////////
+static void
+mist_pc_write(CMistPcWriter* w, const void* data, size_t len)
+{
+    assert(w != NULL);
+    assert(data != NULL);
+    
+    if (w->buf != NULL && w->pos <= w->size && len <= w->size - w->pos)
+    {
+        memcpy(w->buf + w->pos, data, len);
+    }
+    w->pos += len;
+    return;
+}
+
+static void
+mist_pc_write_uint(CMistPcWriter* w, size_t val)
+{
+    assert(val <= (uint32_t)(-1));
+    
+    uint32_t v = (uint32_t)val;
+    mist_pc_write(w, &v, sizeof(v));
+    return;
+}
+
+static void
+mist_pc_write_string(CMistPcWriter* w, const char* str)
+{
+    assert(str != NULL);
+    
+    size_t len = strlen(str);
+    mist_pc_write_uint(w, len);
+    mist_pc_write(w, str, len + 1);
+    return;
+}
+
+static void
+mist_pc_write_template(CMistPcWriter* w, CMistTemplateGroup* mtg, 
+    CMistTemplate* mt)
+{
+    assert(w != NULL);
+    assert(mtg != NULL);
+    assert(mt != NULL);
+    
+    size_t nsc = grar_get_size(&(mt->sch));
+    const char** schs = grar_get_c_array(&(mt->sch), const char*);
+    
+    mist_pc_write_uint(w, nsc);
+    for (size_t i = 0; i < nsc; ++i)
+    {
+        mist_pc_write_string(w, schs[i]);
+    }
+    
+    size_t nph = grar_get_size(&(mt->ph));
+    CMistPlaceholder** phs = grar_get_c_array(&(mt->ph), CMistPlaceholder*);
+    
+    mist_pc_write_uint(w, nph);
+    for (size_t p = 0; p < nph; ++p)
+    {
+        CMistPlaceholder* ph = phs[p];
+        assert(ph != NULL);
+        
+        mist_pc_write_uint(w, (size_t)ph->type);
+        mist_pc_write_string(w, ph->name);
+        
+        // The templates in the group are sorted by name, and the names 
+        // are unique, so the index of the template can be found this way.
+        CMistTemplate* target = (ph->type == MPH_COND) ? ph->tpl_cond : ph->tpl;
+        assert(target != NULL);
+        
+        int ind = grar_find(&(mtg->tpl), &target, mist_template_compare);
+        assert(ind != -1);
+        
+        switch (ph->type)
+        {
+        case MPH_PLAIN:
+            mist_pc_write_uint(w, (size_t)ind);
+            break;
+        case MPH_JOIN:
+            assert(ph->sep != NULL);
+            mist_pc_write_string(w, ph->sep);
+            mist_pc_write_uint(w, (size_t)ind);
+            break;
+        case MPH_COND:
+            assert(ph->tpl_then != NULL);
+            assert(ph->tpl_else != NULL);
+            
+            mist_pc_write_uint(w, (ph->is_concat ? 1 : 0));
+            mist_pc_write_uint(w, (size_t)ind);
+            
+            mist_pc_write_string(w, ph->tpl_then->name);
+            mist_pc_write_template(w, mtg, ph->tpl_then);
+            mist_pc_write_string(w, ph->tpl_else->name);
+            mist_pc_write_template(w, mtg, ph->tpl_else);
+            break;
+        default:
+            assert(0);
+            break;
+        }
+    } // end for p
+    
+    return;
+}
+
+static int
+mist_pc_read_uint(CMistPcReader* r, size_t* val)
+{
+    assert(r != NULL);
+    assert(val != NULL);
+    assert(r->pos <= r->size);
+    
+    uint32_t v;
+    if (r->size - r->pos < sizeof(v))
+    {
+        return 0;
+    }
+    
+    // The image is not necessarily aligned, hence memcpy().
+    memcpy(&v, r->data + r->pos, sizeof(v));
+    r->pos += sizeof(v);
+    
+    *val = (size_t)v;
+    return 1;
+}
+
+static const char*
+mist_pc_read_string(CMistPcReader* r)
+{
+    assert(r != NULL);
+    
+    size_t len;
+    if (!mist_pc_read_uint(r, &len) || r->size - r->pos <= len)
+    {
+        return NULL;
+    }
+    
+    const char* str = r->data + r->pos;
+    if (str[len] != '\0' || memchr(str, '\0', len) != NULL)
+    {
+        return NULL;
+    }
+    
+    r->pos += len + 1;
+    return str;
+}
+
+static EMistErrorCode
+mist_pc_read_template(CMistPcReader* r, CMistTemplateGroup* mtg, 
+    CMistTemplate* mt)
+{
+    assert(r != NULL);
+    assert(mtg != NULL);
+    assert(mt != NULL);
+    assert(grar_get_size(&(mt->sch)) == 0);
+    assert(grar_get_size(&(mt->ph)) == 0);
+    
+    size_t nsc;
+    if (!mist_pc_read_uint(r, &nsc))
+    {
+        return MIST_SYNTAX_ERROR;
+    }
+    
+    for (size_t i = 0; i < nsc; ++i)
+    {
+        const char* str = mist_pc_read_string(r);
+        if (str == NULL)
+        {
+            return MIST_SYNTAX_ERROR;
+        }
+        
+        char* sch = (char*)strdup(str);
+        if (sch == NULL)
+        {
+            return MIST_OUT_OF_MEMORY;
+        }
+        
+        if (grar_add_element(&(mt->sch), sch) == 0)
+        {
+            free(sch);
+            return MIST_OUT_OF_MEMORY;
+        }
+    }
+    
+    size_t nph;
+    if (!mist_pc_read_uint(r, &nph))
+    {
+        return MIST_SYNTAX_ERROR;
+    }
+    
+    // The same invariant as mist_template_evaluate() relies upon: either
+    // an attribute or a sequence of string chunks and placeholders that 
+    // begins and ends with a string chunk.
+    if (nsc == 0 ? nph != 0 : nsc != nph + 1)
+    {
+        return MIST_SYNTAX_ERROR;
+    }
+    
+    for (size_t p = 0; p < nph; ++p)
+    {
+        EMistErrorCode ec = mist_pc_read_placeholder(r, mtg, mt);
+        if (ec != MIST_OK)
+        {
+            return ec;
+        }
+    }
+    
+    return MIST_OK;
+}
+
+static EMistErrorCode
+mist_pc_read_placeholder(CMistPcReader* r, CMistTemplateGroup* mtg, 
+    CMistTemplate* mt)
+{
+    assert(r != NULL);
+    assert(mtg != NULL);
+    assert(mt != NULL);
+    
+    size_t type;
+    const char* name;
+    const char* sep = NULL;
+    size_t is_concat = 0;
+    
+    if (!mist_pc_read_uint(r, &type) || type >= MPH_NTYPES)
+    {
+        return MIST_SYNTAX_ERROR;
+    }
+    
+    name = mist_pc_read_string(r);
+    if (name == NULL || mist_name_is_bad(name))
+    {
+        return MIST_SYNTAX_ERROR;
+    }
+    
+    if (type == MPH_JOIN)
+    {
+        sep = mist_pc_read_string(r);
+        if (sep == NULL)
+        {
+            return MIST_SYNTAX_ERROR;
+        }
+    }
+    else if (type == MPH_COND)
+    {
+        if (!mist_pc_read_uint(r, &is_concat))
+        {
+            return MIST_SYNTAX_ERROR;
+        }
+    }
+    
+    size_t ind;
+    if (!mist_pc_read_uint(r, &ind) || ind >= grar_get_size(&(mtg->tpl)))
+    {
+        return MIST_SYNTAX_ERROR;
+    }
+    CMistTemplate* target = grar_get_element(&(mtg->tpl), CMistTemplate*, ind);
+    assert(target != NULL);
+    
+    CMistPlaceholder* ph = mist_placeholder_create(name, sep);
+    if (ph == NULL)
+    {
+        return MIST_OUT_OF_MEMORY;
+    }
+    
+    // From now on, 'ph' is owned by 'mt' and will be destroyed with it 
+    // in case of failure.
+    if (grar_add_element(&(mt->ph), ph) == 0)
+    {
+        mist_placeholder_destroy(ph);
+        return MIST_OUT_OF_MEMORY;
+    }
+    
+    if (type != MPH_COND)
+    {
+        ph->tpl = target;
+        return MIST_OK;
+    }
+    
+    // The conditional: see mist_match_if() and mist_parse_conditional().
+    ph->type = MPH_COND;
+    ph->is_concat = (is_concat != 0);
+    ph->tpl_cond = target;
+    
+    ph->tpl = mist_template_create(name);
+    if (ph->tpl == NULL)
+    {
+        return MIST_OUT_OF_MEMORY;
+    }
+    
+    CMistTemplate** branches[2] = {&(ph->tpl_then), &(ph->tpl_else)};
+    for (size_t i = 0; i < 2; ++i)
+    {
+        const char* branch_name = mist_pc_read_string(r);
+        if (branch_name == NULL || mist_name_is_bad(branch_name))
+        {
+            return MIST_SYNTAX_ERROR;
+        }
+        
+        *(branches[i]) = mist_template_create(branch_name);
+        if (*(branches[i]) == NULL)
+        {
+            return MIST_OUT_OF_MEMORY;
+        }
+        
+        EMistErrorCode ec = mist_pc_read_template(r, mtg, *(branches[i]));
+        if (ec != MIST_OK)
+        {
+            return ec;
+        }
+        
+        // The branches are evaluated as templates with string chunks, not
+        // as attributes.
+        if (grar_get_size(&((*(branches[i]))->sch)) == 0)
+        {
+            return MIST_SYNTAX_ERROR;
+        }
+    }
+    
+    return MIST_OK;
+}
+
 ///////////////////////////////////////////////////////////////////////////
 // Implementation: "public methods"
 ///////////////////////////////////////////////////////////////////////////
@@ -3335,4 +3751,156 @@ mist_tg_generate_path_string_impl(CMistTemplateGroup* path_tg, CStringMap* param
     
     return path;
 }
+
+size_t
+mist_tg_save_precompiled_impl(CMistTemplateGroup* mtg, void* buf, size_t size)
+{
+    assert(mtg != NULL);
+    assert(mtg->main != NULL);
+    assert(buf != NULL || size == 0);
+    
+    CMistPcWriter w;
+    w.buf = (char*)buf;
+    w.size = size;
+    w.pos = 0;
+    
+    size_t num = grar_get_size(&(mtg->tpl));
+    CMistTemplate** tpl = grar_get_c_array(&(mtg->tpl), CMistTemplate*);
+    
+    int main_ind = grar_find(&(mtg->tpl), &(mtg->main), mist_template_compare);
+    assert(main_ind != -1);
+    
+    mist_pc_write(&w, mist_pc_magic, sizeof(mist_pc_magic));
+    mist_pc_write_uint(&w, MIST_PC_FORMAT_VERSION);
+    mist_pc_write_uint(&w, MIST_PC_BYTE_ORDER_MARK);
+    mist_pc_write_uint(&w, num);
+    mist_pc_write_uint(&w, (size_t)main_ind);
+    
+    for (size_t i = 0; i < num; ++i)
+    {
+        mist_pc_write_string(&w, tpl[i]->name);
+    }
+    
+    for (size_t i = 0; i < num; ++i)
+    {
+        mist_pc_write_template(&w, mtg, tpl[i]);
+    }
+    
+    return w.pos;
+}
+
+CMistTemplateGroup*
+mist_tg_load_precompiled_impl(const void* data, size_t size, 
+    char** error_descr)
+{
+    assert(data != NULL);
+    assert(error_descr != NULL);
+    *error_descr = NULL;
+    
+    CMistPcReader r;
+    r.data = (const char*)data;
+    r.size = size;
+    r.pos = 0;
+    
+    size_t version = 0;
+    size_t bom = 0;
+    size_t num = 0;
+    size_t main_ind = 0;
+    
+    if (size < sizeof(mist_pc_magic) || 
+        memcmp(data, mist_pc_magic, sizeof(mist_pc_magic)) != 0)
+    {
+        *error_descr = (char*)strdup(errNotPrecompiled);
+        return NULL;
+    }
+    r.pos += sizeof(mist_pc_magic);
+    
+    if (!mist_pc_read_uint(&r, &version) || 
+        !mist_pc_read_uint(&r, &bom) ||
+        version != MIST_PC_FORMAT_VERSION || 
+        bom != MIST_PC_BYTE_ORDER_MARK)
+    {
+        *error_descr = (char*)strdup(errPrecompiledVersion);
+        return NULL;
+    }
+    
+    if (!mist_pc_read_uint(&r, &num) || 
+        !mist_pc_read_uint(&r, &main_ind) ||
+        num == 0 || main_ind >= num)
+    {
+        *error_descr = (char*)strdup(errBadPrecompiled);
+        return NULL;
+    }
+    
+    CMistTemplateGroup* tg = (CMistTemplateGroup*)malloc(sizeof(CMistTemplateGroup));
+    if (tg == NULL)
+    {
+        return NULL;
+    }
+    
+    if (grar_create(&(tg->tpl)) == 0)
+    {
+        free(tg);
+        return NULL;
+    }
+    tg->main = NULL;
+    // If something wrong happens below, we can call mist_tg_destroy_impl 
+    // to clean up because all the members of 'tg' are now initialized.
+    
+    EMistErrorCode ec = MIST_OK;
+    
+    // Create the templates first because the placeholders refer to them.
+    // The templates must be sorted by name (the lookup relies on that) and 
+    // the names must be unique.
+    for (size_t i = 0; i < num && ec == MIST_OK; ++i)
+    {
+        const char* name = mist_pc_read_string(&r);
+        if (name == NULL || mist_name_is_bad(name) || (i > 0 && 
+            strcmp(grar_get_element(&(tg->tpl), CMistTemplate*, i - 1)->name, name) >= 0))
+        {
+            ec = MIST_SYNTAX_ERROR;
+            break;
+        }
+        
+        CMistTemplate* tp = mist_template_create(name);
+        if (tp == NULL)
+        {
+            ec = MIST_OUT_OF_MEMORY;
+            break;
+        }
+        
+        if (grar_add_element(&(tg->tpl), tp) == 0)
+        {
+            mist_template_destroy(tp);
+            ec = MIST_OUT_OF_MEMORY;
+        }
+    }
+    
+    for (size_t i = 0; i < num && ec == MIST_OK; ++i)
+    {
+        ec = mist_pc_read_template(&r, tg, 
+            grar_get_element(&(tg->tpl), CMistTemplate*, i));
+    }
+    
+    if (ec == MIST_OK && r.pos != r.size)
+    {
+        // trailing garbage
+        ec = MIST_SYNTAX_ERROR;
+    }
+    
+    if (ec != MIST_OK)
+    {
+        if (ec == MIST_SYNTAX_ERROR)
+        {
+            *error_descr = (char*)strdup(errBadPrecompiled);
+        }
+        mist_tg_destroy_impl(tg);
+        return NULL;
+    }
+    
+    tg->main = grar_get_element(&(tg->tpl), CMistTemplate*, main_ind);
+    assert(tg->main != NULL);
+    
+    return tg;
+}
 ///////////////////////////////////////////////////////////////////////////
@@ -257,6 +257,26 @@ const char*
 mist_tg_generate_path_string_impl(CMistTemplateGroup* path_tg, CStringMap* params, 
     char** error_descr);
 
+/// Store the image of the template group (a "precompiled" group) in 'buf'
+/// of 'size' bytes. The image contains the parsed templates with the 
+/// placeholders already connected, so a group can be created from it without
+/// parsing (see mist_tg_load_precompiled_impl()). The values of the templates
+/// are not stored.
+/// The function returns the size of the whole image. If it is greater than 
+/// 'size', only a part of the image has been stored and the function should 
+/// be called again with a larger buffer. 'buf' may be NULL if 'size' is 0.
+size_t
+mist_tg_save_precompiled_impl(CMistTemplateGroup* mtg, void* buf, size_t size);
+
+/// Create a template group from the image made by 
+/// mist_tg_save_precompiled_impl(). 'data' and 'size' specify the image.
+/// The group does not depend on the image once created.
+/// NULL is returned in case of a failure, including the case when the image
+/// is corrupted or has been made by an incompatible version of MiST Engine.
+CMistTemplateGroup*
+mist_tg_load_precompiled_impl(const void* data, size_t size, 
+    char** error_descr);
+
 ///////////////////////////////////////////////////////////////////////////
 #ifdef __cplusplus
 }
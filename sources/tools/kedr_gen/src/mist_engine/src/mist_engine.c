@@ -168,6 +168,46 @@ mist_tg_create_single(CMistTGroup** ptg,
     return MIST_OK;
 }
 
+EMistErrorCode
+mist_tg_save_precompiled(CMistTGroup* mtg, 
+    void* buf, size_t size, size_t* needed)
+{
+    if (mist_api_version == 0)    
+    {
+        return MIST_LIBRARY_NOT_INITIALIZED;
+    }
+    
+    assert(mtg != NULL);
+    assert(buf != NULL || size == 0);
+    assert(needed != NULL);
+    
+    *needed = mist_tg_save_precompiled_impl(mtg, buf, size);
+    return MIST_OK;
+}
+
+EMistErrorCode
+mist_tg_load_precompiled(CMistTGroup** ptg, 
+    const void* data, size_t size, char** error_descr)
+{
+    if (mist_api_version == 0)    
+    {
+        return MIST_LIBRARY_NOT_INITIALIZED;
+    }
+    
+    assert(ptg != NULL);
+    assert(data != NULL);
+    assert(error_descr != NULL);
+    
+    *ptg = mist_tg_load_precompiled_impl(data, size, error_descr);
+    if (*ptg == NULL)
+    {
+        // The description of the error is provided if the image is
+        // invalid, there is not enough memory otherwise.
+        return (*error_descr != NULL) ? MIST_SYNTAX_ERROR : MIST_OUT_OF_MEMORY;
+    }
+    return MIST_OK;
+}
+
 EMistErrorCode
 mist_tg_destroy(CMistTGroup* mtg)
 {
@@ -0,0 +1,113 @@
+/*
+ * Trace events emitted by the ftrace backend of KEDR tracing system
+ * (see trace_ftrace.h).
+ *
+ * The events are placed into the ring buffer of ftrace, so they can be
+ * recorded with trace-cmd or perf along with the events of the kernel
+ * itself (see 'events/kedr/' directory in tracefs).
+ *
+ * The data of a message are pretty printed when the event is emitted,
+ * directly into the space reserved for the event.
+ */
+
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM kedr
+
+#if !defined(KEDR_TRACE_EVENTS_H) || defined(TRACE_HEADER_MULTI_READ)
+#define KEDR_TRACE_EVENTS_H
+
+#include <linux/tracepoint.h>
+#include <linux/version.h>
+
+#include <kedr/trace/trace.h>
+
+#ifndef KEDR_TRACE_EVENTS_HELPERS
+#define KEDR_TRACE_EVENTS_HELPERS
+
+/* Since 6.10, __assign_str() takes the destination field only. */
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(6, 10, 0)
+# define kedr_assign_str(dst, src) __assign_str(dst)
+#else
+# define kedr_assign_str(dst, src) __assign_str(dst, src)
+#endif
+
+/*
+ * Maximum size of the text of an event, including '\0'. The longer text
+ * is truncated, so that the event fits into a page of the ring buffer.
+ */
+#define KEDR_TRACE_EVENT_TEXT_MAX 1024
+
+/* Size of the text produced by 'pp' for 'data', including '\0'. */
+static inline size_t kedr_trace_pp_size(kedr_trace_pp_function pp,
+    const void* data)
+{
+    size_t size = pp ? pp(NULL, 0, data) + 1 : 1;
+
+    return min_t(size_t, size, KEDR_TRACE_EVENT_TEXT_MAX);
+}
+
+static inline void kedr_trace_pp_fill(char* dest, size_t size,
+    kedr_trace_pp_function pp, const void* data)
+{
+    if(pp)
+        pp(dest, size, data);
+    else
+        dest[0] = '\0';
+}
+#endif /* KEDR_TRACE_EVENTS_HELPERS */
+
+/* Message added with kedr_trace() or kedr_trace_lock(). */
+TRACE_EVENT(kedr_message,
+
+    TP_PROTO(kedr_trace_pp_function pp, const void* data),
+
+    TP_ARGS(pp, data),
+
+    TP_STRUCT__entry(
+        __dynamic_array(char, text, kedr_trace_pp_size(pp, data))
+    ),
+
+    TP_fast_assign(
+        kedr_trace_pp_fill(__get_dynamic_array(text),
+            __get_dynamic_array_len(text), pp, data);
+    ),
+
+    TP_printk("%s", __get_str(text))
+);
+
+/*
+ * Message added with kedr_trace_function_call() or
+ * kedr_trace_function_call_lock().
+ */
+TRACE_EVENT(kedr_function_call,
+
+    TP_PROTO(const char* function_name, void* return_address,
+        kedr_trace_pp_function params_pp, const void* params),
+
+    TP_ARGS(function_name, return_address, params_pp, params),
+
+    TP_STRUCT__entry(
+        __field(void*, return_address)
+        __string(function, function_name)
+        __dynamic_array(char, params, kedr_trace_pp_size(params_pp, params))
+    ),
+
+    TP_fast_assign(
+        __entry->return_address = return_address;
+        kedr_assign_str(function, function_name);
+        kedr_trace_pp_fill(__get_dynamic_array(params),
+            __get_dynamic_array_len(params), params_pp, params);
+    ),
+
+    TP_printk("called_%s: ([<%p>] %pS) %s", __get_str(function),
+        __entry->return_address, __entry->return_address,
+        __get_str(params))
+);
+
+#endif /* KEDR_TRACE_EVENTS_H */
+
+#undef TRACE_INCLUDE_PATH
+#define TRACE_INCLUDE_PATH .
+#undef TRACE_INCLUDE_FILE
+#define TRACE_INCLUDE_FILE kedr_trace_events
+#include <trace/define_trace.h>
@@ -1,5 +1,7 @@
 #include <kedr/core/kedr.h>
+#include <kedr/core/kedr_overhead.h>
 #include "trace_buffer.h"
+#include "trace_ftrace.h"
 #include "wait_nestable.h"
 
 #include <linux/module.h>
@@ -21,6 +23,29 @@
 
 #include <linux/version.h> /* KERNEL_VERSION macro */
 
+/*
+ * Since 4.9, the trace files implement read_iter(), so the trace may be
+ * spliced into a pipe page by page without copying it to user space.
+ */
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(4, 9, 0)
+# define KEDR_TRACE_SPLICE 1
+# include <linux/uio.h> /* iov_iter */
+# include <linux/splice.h>
+# if LINUX_VERSION_CODE >= KERNEL_VERSION(6, 5, 0)
+#  define trace_file_splice_read copy_splice_read
+# else
+#  define trace_file_splice_read generic_file_splice_read
+# endif
+/* 
+ * Full proxy for debugfs files does not forward splice_read(). Proxy is
+ * not needed for our files: they are removed only when module is unloaded,
+ * and open files keep the module loaded.
+ */
+# define trace_debugfs_create_file debugfs_create_file_unsafe
+#else
+# define trace_debugfs_create_file debugfs_create_file
+#endif
+
 #include "config.h"
 
 #define BUFFER_SIZE_DEFAULT 100000
@@ -259,13 +284,50 @@ static int tme_alloc(struct trace_message_extracted* tme, size_t size)
 unsigned long buffer_size = BUFFER_SIZE_DEFAULT;
 module_param(buffer_size, ulong, S_IRUGO);
 
+/* 
+ * Maximum buffer size for auto-grow policy.
+ * 
+ * If not 0, buffer is grown when messages are lost, up to that size.
+ */
+unsigned long buffer_size_max = 0;
+module_param(buffer_size_max, ulong, S_IRUGO);
+
+/*
+ * Readers of the trace are woken up when this number of bytes is written
+ * on some CPU...
+ */
+unsigned long wakeup_watermark = PAGE_SIZE;
+module_param(wakeup_watermark, ulong, S_IRUGO);
+
+/* ...or when this time(in milliseconds) expires after the first message. */
+unsigned long wakeup_timeout = 10;
+module_param(wakeup_timeout, ulong, S_IRUGO);
+
+/*
+ * Where the messages go:
+ * 
+ * "buffer" - the trace buffer of KEDR, read via 'trace' and
+ *   'trace_session' files;
+ * "ftrace" - trace events 'kedr:kedr_message' and 'kedr:kedr_function_call'
+ *   (see trace_ftrace.h), recorded with trace-cmd, perf, etc.
+ * 
+ * In the latter case, only 'lost_messages' file is created.
+ */
+char* backend = "buffer";
+module_param(backend, charp, S_IRUGO);
+
+static bool use_ftrace;
+
 // Names of files
 static struct dentry* trace_file;
 static struct dentry* trace_session_file;
 static struct dentry* trace_dir;
 static struct dentry* reset_file;
 static struct dentry* buffer_size_file;
+static struct dentry* buffer_size_max_file;
 static struct dentry* lost_messages_file;
+static struct dentry* wakeup_watermark_file;
+static struct dentry* wakeup_timeout_file;
 
 /*
  * Format of the message written into the trace buffer.
@@ -415,6 +477,9 @@ static void kedr_trace_marker_session(bool is_started)
  */
 void kedr_trace_pp_unregister(void)
 {
+    /* Trace events are pretty printed when they are emitted. */
+    if(use_ftrace) return;
+
     kedr_trace_reset();
 }
 EXPORT_SYMBOL(kedr_trace_pp_unregister);
@@ -427,11 +492,13 @@ EXPORT_SYMBOL(kedr_trace_pp_unregister);
  * Return not NULL on success. Returning value should be passed to
  * the kedr_trace_unlock_commit() for complete trace operation.
  */
-void* kedr_trace_lock(kedr_trace_pp_function pp,
+static void* trace_lock_buffer(kedr_trace_pp_function pp,
     size_t size, void** data)
 {
     struct kedr_trace_message* msg;
-    void* id = trace_buffer_write_lock(tb_global,
+    void* id;
+
+    id = trace_buffer_write_lock(tb_global,
         sizeof(struct kedr_trace_message) + size, (void**)&msg);
     if(id == NULL) return NULL;
     msg->pp = pp;
@@ -441,6 +508,21 @@ void* kedr_trace_lock(kedr_trace_pp_function pp,
     *data = msg->data;
     return id;
 }
+
+void* kedr_trace_lock(kedr_trace_pp_function pp,
+    size_t size, void** data)
+{
+    u64 overhead_start = kedr_overhead_begin();
+    void* id;
+
+    if(use_ftrace)
+        id = trace_ftrace_lock(pp, size, data);
+    else
+        id = trace_lock_buffer(pp, size, data);
+
+    kedr_overhead_end(KEDR_OVERHEAD_TRACE_RESERVE, NULL, overhead_start);
+    return id;
+}
 EXPORT_SYMBOL(kedr_trace_lock);
 
 /*
@@ -449,7 +531,14 @@ EXPORT_SYMBOL(kedr_trace_lock);
 
 void kedr_trace_unlock_commit(void* id)
 {
-    trace_buffer_write_unlock(tb_global, id);
+    u64 overhead_start = kedr_overhead_begin();
+
+    if(use_ftrace)
+        trace_ftrace_unlock_commit(id);
+    else
+        trace_buffer_write_unlock(tb_global, id);
+
+    kedr_overhead_end(KEDR_OVERHEAD_TRACE_COMMIT, NULL, overhead_start);
 }
 EXPORT_SYMBOL(kedr_trace_unlock_commit);
 
@@ -474,6 +563,18 @@ EXPORT_SYMBOL(kedr_trace);
 void kedr_trace_call_after_read(kedr_trace_callback_func func,
     struct kedr_trace_callback_head* callback_head)
 {
+    if(use_ftrace)
+    {
+        /* 
+         * Committed trace events do not refer to any data, so
+         * the callback may be called immediately.
+         */
+        preempt_disable();
+        func(callback_head);
+        preempt_enable();
+        return;
+    }
+
     trace_buffer_call_after_read(tb_global, func, callback_head);
 }
 EXPORT_SYMBOL(kedr_trace_call_after_read);
@@ -580,7 +681,22 @@ void* kedr_trace_function_call_lock(const char* function_name,
 {
     struct function_call_data* fcd;
     size_t size = offsetof(typeof(*fcd), params) + params_size;
-    void* id = kedr_trace_lock(&function_call_pp_function, size, (void**)&fcd);
+    void* id;
+    
+    /* %pS is used for the return address instead of 'target_info'. */
+    if(use_ftrace)
+    {
+        u64 overhead_start = kedr_overhead_begin();
+
+        id = trace_ftrace_function_call_lock(function_name,
+            return_address, params_pp, params_size, params);
+
+        kedr_overhead_end(KEDR_OVERHEAD_TRACE_RESERVE, NULL,
+            overhead_start);
+        return id;
+    }
+    
+    id = kedr_trace_lock(&function_call_pp_function, size, (void**)&fcd);
     
     if(id)
     {
@@ -680,6 +796,12 @@ static void on_session_start(void)
 static void on_session_end(void)
 {
     kedr_trace_marker_session(0);
+    /*
+     * Sessions are tracked only for the "trace_session" file, which
+     * does not exist for ftrace backend. Also, there is no trace buffer
+     * to take the timestamp from in that case.
+     */
+    if(use_ftrace) return;
     /* Ignore return value. That is, session ending may fail silently. */
     if(kedr_trace_end_session())
     {
@@ -845,7 +967,11 @@ out:
 /******************** Trace file operations ***************************/
 struct read_fn_normal_data
 {
+    /* Destination: user buffer 'buf' or 'iter', if it is not NULL. */
     char __user* buf;
+#ifdef KEDR_TRACE_SPLICE
+    struct iov_iter* iter;
+#endif
     size_t count;
     size_t bytes_read;
 };
@@ -858,6 +984,18 @@ static int read_fn_normal(const char* chunk,
     if(chunk_size > read_data->count - read_data->bytes_read)
         chunk_size = read_data->count - read_data->bytes_read;
     
+#ifdef KEDR_TRACE_SPLICE
+    if(read_data->iter)
+    {
+        /* Pipe may accept less than requested, the rest is read later. */
+        chunk_size = copy_to_iter(chunk, chunk_size, read_data->iter);
+        if(!chunk_size) return -EFAULT;
+        read_data->bytes_read += chunk_size;
+        
+        return chunk_size;
+    }
+#endif
+    
     err = copy_to_user(read_data->buf + read_data->bytes_read, chunk, chunk_size);
     if(err) return -EFAULT;
     read_data->bytes_read += chunk_size;
@@ -865,19 +1003,17 @@ static int read_fn_normal(const char* chunk,
     return chunk_size;
 }
 
-static ssize_t trace_file_op_read(struct file* filp, char __user* buf,
-    size_t count, loff_t* f_pos)
+/* 
+ * Read the trace into the destination described by 'read_data'.
+ * 
+ * Common part of read() and read_iter() for the trace file.
+ */
+static ssize_t trace_file_read_common(struct file* filp,
+    struct read_fn_normal_data* read_data)
 {
     int err;
-    struct read_fn_normal_data read_data;
-    
-    if(!count) return 0;
     
-    read_data.buf = buf;
-    read_data.count = count;
-    read_data.bytes_read = 0;
-    
-    err = trace_read(read_fn_normal, NULL, &read_data);
+    err = trace_read(read_fn_normal, NULL, read_data);
     if(err == -EAGAIN && !(filp->f_flags & O_NONBLOCK))
     {
         bool woken_flag = 0;
@@ -889,7 +1025,7 @@ static ssize_t trace_file_op_read(struct file* filp, char __user* buf,
         {
             add_wait_queue_nestable(wq_buffer, &w_buffer);
 
-            err = trace_read(read_fn_normal, NULL, &read_data);
+            err = trace_read(read_fn_normal, NULL, read_data);
             
             if(err != -EAGAIN) break;
             err = wait_flagged_interruptible(&woken_flag);
@@ -900,39 +1036,85 @@ static ssize_t trace_file_op_read(struct file* filp, char __user* buf,
     }
     if(err < 0) return err;
     
-    while(read_data.bytes_read < read_data.count)
+    while(read_data->bytes_read < read_data->count)
     {
-        err = trace_read(read_fn_normal, NULL, &read_data);
+        err = trace_read(read_fn_normal, NULL, read_data);
         if(err < 0) break;
     }
     
-    return read_data.bytes_read;
+    return read_data->bytes_read;
 }
 
-static int poll_fn(const char* chunk,
-    int chunk_size, struct trace_session* session, void* user_data)
+static ssize_t trace_file_op_read(struct file* filp, char __user* buf,
+    size_t count, loff_t* f_pos)
 {
-    return 0;
+    struct read_fn_normal_data read_data;
+    
+    if(!count) return 0;
+    
+    read_data.buf = buf;
+#ifdef KEDR_TRACE_SPLICE
+    read_data.iter = NULL;
+#endif
+    read_data.count = count;
+    read_data.bytes_read = 0;
+    
+    return trace_file_read_common(filp, &read_data);
 }
 
-static unsigned int trace_file_op_poll(struct file *filp, poll_table *wait)
+#ifdef KEDR_TRACE_SPLICE
+/* Used by splice(); read() uses trace_file_op_read(). */
+static ssize_t trace_file_op_read_iter(struct kiocb* iocb, struct iov_iter* to)
 {
-    int err;
+    struct read_fn_normal_data read_data;
     
-    wait_queue_head_t* wq_buffer = trace_buffer_get_wait_queue(tb_global);
-    poll_wait(filp, wq_buffer, wait);
+    if(!iov_iter_count(to)) return 0;
+    
+    read_data.buf = NULL;
+    read_data.iter = to;
+    read_data.count = iov_iter_count(to);
+    read_data.bytes_read = 0;
+    
+    return trace_file_read_common(iocb->ki_filp, &read_data);
+}
+#endif
+
+/* 
+ * Check whether the trace has something to read.
+ * 
+ * Unlike trace_read(), messages are neither extracted nor formatted,
+ * so this is cheap enough for poll.
+ * 
+ * If read_session_p and *read_session_p are not NULL, ended session
+ * is treated as readable(EOF can be read).
+ */
+static unsigned int trace_poll(struct trace_session** read_session_p)
+{
+    unsigned int mask = 0;
     
-    err = trace_read(&poll_fn, NULL, NULL);
+    if(mutex_lock_interruptible(&trace_m))
+        return POLLERR;
     
-    switch(err)
+    if(tme_last.text_size
+        || !trace_buffer_empty(tb_global)
+        || (read_session_p
+            && *read_session_p
+            && (*read_session_p)->is_ended))
     {
-    case 0:
-        return POLLIN | POLLRDNORM;
-    case -EAGAIN:
-        return 0;
-    default:
-        return (unsigned)err;
+        mask = POLLIN | POLLRDNORM;
     }
+    
+    mutex_unlock(&trace_m);
+    
+    return mask;
+}
+
+static unsigned int trace_file_op_poll(struct file *filp, poll_table *wait)
+{
+    wait_queue_head_t* wq_buffer = trace_buffer_get_wait_queue(tb_global);
+    poll_wait(filp, wq_buffer, wait);
+    
+    return trace_poll(NULL);
 }
 
 static int trace_file_op_open(struct inode* inode, struct file* filp)
@@ -945,6 +1127,10 @@ static struct file_operations trace_file_ops =
     .owner = THIS_MODULE,
     .open = &trace_file_op_open,
     .read = &trace_file_op_read,
+#ifdef KEDR_TRACE_SPLICE
+    .read_iter = &trace_file_op_read_iter,
+    .splice_read = &trace_file_splice_read,
+#endif
     .poll = &trace_file_op_poll
 };
 /******************** trace_session file operations *******************/
@@ -973,21 +1159,21 @@ static int read_fn_session(const char* chunk,
     return err;
 }
 
-static ssize_t trace_file_session_op_read(struct file* filp, char __user* buf,
-    size_t count, loff_t* f_pos)
+/* 
+ * Read the trace of the current session into the destination described by
+ * 'read_data'.
+ * 
+ * Common part of read() and read_iter() for the trace_session file.
+ */
+static ssize_t trace_file_session_read_common(struct file* filp,
+    struct read_fn_session_data* read_data)
 {
     int err;
-    struct read_fn_session_data read_data;
     struct trace_session** read_session_p = (struct trace_session**)&filp->private_data;
     
-    if(!count) return 0;
-    
-    read_data.normal_data.buf = buf;
-    read_data.normal_data.count = count;
-    read_data.normal_data.bytes_read = 0;
-    read_data.session_p = read_session_p;
+    read_data->session_p = read_session_p;
     
-    err = trace_read(read_fn_session, read_session_p, &read_data);
+    err = trace_read(read_fn_session, read_session_p, read_data);
     if(err == -EAGAIN && !(filp->f_flags & O_NONBLOCK))
     {
         bool woken_flag = 0;
@@ -1000,7 +1186,7 @@ static ssize_t trace_file_session_op_read(struct file* filp, char __user* buf,
         {
             add_wait_queue_nestable(wq_buffer, &w_buffer);
             add_wait_queue_nestable(&wq_session, &w_session);
-            err = trace_read(read_fn_session, read_session_p, &read_data);
+            err = trace_read(read_fn_session, read_session_p, read_data);
             
             if(err != -EAGAIN) break;
             err = wait_flagged_interruptible(&woken_flag);
@@ -1012,35 +1198,58 @@ static ssize_t trace_file_session_op_read(struct file* filp, char __user* buf,
     }
     if(err <= 0) return err;
     
-    while(read_data.normal_data.bytes_read < read_data.normal_data.count)
+    while(read_data->normal_data.bytes_read < read_data->normal_data.count)
     {
-        err = trace_read(read_fn_session, read_session_p, &read_data);
+        err = trace_read(read_fn_session, read_session_p, read_data);
         if(err <= 0) break;
     }
     
-    return read_data.normal_data.bytes_read;
+    return read_data->normal_data.bytes_read;
 }
 
-static unsigned int trace_file_session_op_poll(struct file *filp, poll_table *wait)
+static ssize_t trace_file_session_op_read(struct file* filp, char __user* buf,
+    size_t count, loff_t* f_pos)
 {
-    int err;
+    struct read_fn_session_data read_data;
+    
+    if(!count) return 0;
+    
+    read_data.normal_data.buf = buf;
+#ifdef KEDR_TRACE_SPLICE
+    read_data.normal_data.iter = NULL;
+#endif
+    read_data.normal_data.count = count;
+    read_data.normal_data.bytes_read = 0;
     
+    return trace_file_session_read_common(filp, &read_data);
+}
+
+#ifdef KEDR_TRACE_SPLICE
+/* Used by splice(); read() uses trace_file_session_op_read(). */
+static ssize_t trace_file_session_op_read_iter(struct kiocb* iocb,
+    struct iov_iter* to)
+{
+    struct read_fn_session_data read_data;
+    
+    if(!iov_iter_count(to)) return 0;
+    
+    read_data.normal_data.buf = NULL;
+    read_data.normal_data.iter = to;
+    read_data.normal_data.count = iov_iter_count(to);
+    read_data.normal_data.bytes_read = 0;
+    
+    return trace_file_session_read_common(iocb->ki_filp, &read_data);
+}
+#endif
+
+static unsigned int trace_file_session_op_poll(struct file *filp, poll_table *wait)
+{
     struct trace_session** read_session_p = (struct trace_session**)&filp->private_data;
     wait_queue_head_t* wq_buffer = trace_buffer_get_wait_queue(tb_global);
     poll_wait(filp, wq_buffer, wait);
     poll_wait(filp, &wq_session, wait);
     
-    err = trace_read(&poll_fn, read_session_p, NULL);
-    
-    switch(err)
-    {
-    case 0:
-        return POLLIN | POLLRDNORM;
-    case -EAGAIN:
-        return 0;
-    default:
-        return (unsigned)err;
-    }
+    return trace_poll(read_session_p);
 }
 
 static int trace_file_session_op_open(struct inode* inode, struct file* filp)
@@ -1064,6 +1273,10 @@ static struct file_operations trace_file_session_ops =
     .owner = THIS_MODULE,
     .open = &trace_file_session_op_open,
     .read = &trace_file_session_op_read,
+#ifdef KEDR_TRACE_SPLICE
+    .read_iter = &trace_file_session_op_read_iter,
+    .splice_read = &trace_file_splice_read,
+#endif
     .poll = &trace_file_session_op_poll,
     .release = &trace_file_session_op_release,
 };
@@ -1114,38 +1327,45 @@ buffer_size_file_open(struct inode *inode, struct file *filp)
     return single_open(filp, &buffer_size_seq_show, NULL);
 }
 
-static ssize_t
-buffer_size_file_write(struct file *filp,
-    const char __user *buf, size_t count, loff_t * f_pos)
+/* Parse unsigned long value written into the file. */
+static int
+ulong_from_user(const char __user *buf, size_t count, unsigned long* val)
 {
-    int err = 0;
-    unsigned long size;
+    int err;
+    char* str;
     
     if(count == 0) return -EINVAL;
+    
+    str = kmalloc(count + 1, GFP_KERNEL);
+    if(str == NULL) return -ENOMEM;
+
+    if(copy_from_user(str, buf, count))
     {
-        char* str = kmalloc(count + 1, GFP_KERNEL);
-        if(str == NULL) return -ENOMEM;
+        kfree(str);
+        return -EFAULT;
+    }
+    str[count] = '\0';
 
-        if(copy_from_user(str, buf, count))
-        {
-            kfree(str);
-            return -EFAULT;
-        }
-        str[count] = '\0';
+    err = kstrtoul(str, 0, val);
 
-        err = kstrtoul(str, 0, &size);
+    kfree(str);
+    return err;
+}
 
-        kfree(str);
-        if(err) return err;
-    }
+static ssize_t
+buffer_size_file_write(struct file *filp,
+    const char __user *buf, size_t count, loff_t * f_pos)
+{
+    int err = 0;
+    unsigned long size;
+    
+    err = ulong_from_user(buf, count, &size);
+    if(err) return err;
     
     err = mutex_lock_interruptible(&trace_m);
     if(err) return err;
+    /* Messages in the buffer are preserved, so 'tme_last' is kept. */
     err = trace_buffer_resize(tb_global, size);
-    if(err) goto out;
-    
-    tme_last_clear();
-out:
     mutex_unlock(&trace_m);
     
     return err ? err : count;
@@ -1161,10 +1381,132 @@ static struct file_operations buffer_size_file_ops =
 };
 
 
+// Maximum buffer size file operations implementation
+static int buffer_size_max_seq_show(struct seq_file* m, void* v)
+{
+    seq_printf(m, "%lu\n", trace_buffer_size_max(tb_global));
+    
+    return 0;
+}
+
+static int
+buffer_size_max_file_open(struct inode *inode, struct file *filp)
+{
+    return single_open(filp, &buffer_size_max_seq_show, NULL);
+}
+
+static ssize_t
+buffer_size_max_file_write(struct file *filp,
+    const char __user *buf, size_t count, loff_t * f_pos)
+{
+    int err;
+    unsigned long size_max;
+    
+    err = ulong_from_user(buf, count, &size_max);
+    if(err) return err;
+    
+    trace_buffer_set_size_max(tb_global, size_max);
+    
+    return count;
+}
+
+static struct file_operations buffer_size_max_file_ops = 
+{
+    .owner = THIS_MODULE,
+    .open = &buffer_size_max_file_open,
+    .read = &seq_read,
+    .write = &buffer_size_max_file_write,
+    .release = &single_release
+};
+
+// Wakeup watermark file operations implementation
+static int wakeup_watermark_seq_show(struct seq_file* m, void* v)
+{
+    seq_printf(m, "%lu\n", trace_buffer_wakeup_watermark(tb_global));
+    
+    return 0;
+}
+
+static int
+wakeup_watermark_file_open(struct inode *inode, struct file *filp)
+{
+    return single_open(filp, &wakeup_watermark_seq_show, NULL);
+}
+
+static ssize_t
+wakeup_watermark_file_write(struct file *filp,
+    const char __user *buf, size_t count, loff_t * f_pos)
+{
+    int err;
+    unsigned long watermark;
+    
+    err = ulong_from_user(buf, count, &watermark);
+    if(err) return err;
+    
+    trace_buffer_set_wakeup_watermark(tb_global, watermark);
+    
+    return count;
+}
+
+static struct file_operations wakeup_watermark_file_ops = 
+{
+    .owner = THIS_MODULE,
+    .open = &wakeup_watermark_file_open,
+    .read = &seq_read,
+    .write = &wakeup_watermark_file_write,
+    .release = &single_release
+};
+
+// Wakeup timeout file operations implementation
+static int wakeup_timeout_seq_show(struct seq_file* m, void* v)
+{
+    seq_printf(m, "%lu\n", trace_buffer_wakeup_timeout(tb_global));
+    
+    return 0;
+}
+
+static int
+wakeup_timeout_file_open(struct inode *inode, struct file *filp)
+{
+    return single_open(filp, &wakeup_timeout_seq_show, NULL);
+}
+
+static ssize_t
+wakeup_timeout_file_write(struct file *filp,
+    const char __user *buf, size_t count, loff_t * f_pos)
+{
+    int err;
+    unsigned long timeout;
+    
+    err = ulong_from_user(buf, count, &timeout);
+    if(err) return err;
+    
+    trace_buffer_set_wakeup_timeout(tb_global, timeout);
+    
+    return count;
+}
+
+static struct file_operations wakeup_timeout_file_ops = 
+{
+    .owner = THIS_MODULE,
+    .open = &wakeup_timeout_file_open,
+    .read = &seq_read,
+    .write = &wakeup_timeout_file_write,
+    .release = &single_release
+};
+
 // Lost messages file operations implementation
 static int lost_messages_seq_show(struct seq_file* m, void* v)
 {
-    int err = mutex_lock_interruptible(&trace_m);
+    int err;
+    
+    if(use_ftrace)
+    {
+        seq_printf(m, "%lu\n", trace_ftrace_lost_messages());
+        return 0;
+    }
+    
+    err = mutex_lock_interruptible(&trace_m);
     if(err) return err;
     
     seq_printf(m, "%lu\n", (unsigned long)trace_buffer_lost_messages(tb_global));
@@ -1216,30 +1558,82 @@ void str_into_buffer(struct print_buffer* pb, const char* str)
 }
 
 /************************ Module definition ***************************/
+/* Initialize the rest of the module for ftrace backend. */
+static int __init
+kedr_trace_ftrace_init(void)
+{
+    int err = trace_ftrace_init();
+    if(err) return err;
+    
+    err = -ENOMEM;
+    trace_dir = debugfs_create_dir("kedr_tracing", NULL);
+    if(!trace_dir) goto fail_trace_dir;
+    
+    lost_messages_file = debugfs_create_file("lost_messages",
+        S_IRUGO,
+        trace_dir,
+        NULL,
+        &lost_messages_file_ops);
+    
+    if(!lost_messages_file) goto fail_lost_messages_file;
+
+    err = kedr_payload_register(&payload);
+    if(err) goto fail_payload;
+
+    return 0;
+
+fail_payload:
+    debugfs_remove(lost_messages_file);
+fail_lost_messages_file:
+    debugfs_remove(trace_dir);
+fail_trace_dir:
+    trace_ftrace_destroy();
+    return err;
+}
+
 static int __init
 kedr_trace_module_init(void)
 {
     int err = -ENOMEM;
     struct trace_session* first_session;
 
+    if(strcmp(backend, "ftrace") == 0)
+        use_ftrace = 1;
+    else if(strcmp(backend, "buffer") != 0)
+    {
+        pr_err("Unknown trace backend '%s'.\n", backend);
+        return -EINVAL;
+    }
+
     tme_init(&tme_last);
     
     first_session = trace_session_create();
     if(!first_session) goto fail_trace_session;
     list_add(&first_session->list, &trace_session_list);
 
+    if(use_ftrace)
+    {
+        err = kedr_trace_ftrace_init();
+        if(err) goto fail_trace_buffer;
+        return 0;
+    }
+
     tb_global = trace_buffer_alloc(buffer_size, 1);
     if(!tb_global) goto fail_trace_buffer;
     
+    trace_buffer_set_size_max(tb_global, buffer_size_max);
+    trace_buffer_set_wakeup_watermark(tb_global, wakeup_watermark);
+    trace_buffer_set_wakeup_timeout(tb_global, wakeup_timeout);
+    
     trace_dir = debugfs_create_dir("kedr_tracing", NULL);
     if(!trace_dir) goto fail_trace_dir;
     
-    trace_file = debugfs_create_file("trace", S_IRUSR, trace_dir,
+    trace_file = trace_debugfs_create_file("trace", S_IRUSR, trace_dir,
         NULL, &trace_file_ops);
         
     if(!trace_file) goto fail_trace_file;
 
-    trace_session_file = debugfs_create_file("trace_session", S_IRUSR, trace_dir,
+    trace_session_file = trace_debugfs_create_file("trace_session", S_IRUSR, trace_dir,
         NULL, &trace_file_session_ops);
         
     if(!trace_session_file) goto fail_trace_session_file;
@@ -1260,6 +1654,14 @@ kedr_trace_module_init(void)
         
     if(!buffer_size_file) goto fail_buffer_size_file;
     
+    buffer_size_max_file = debugfs_create_file("buffer_size_max",
+        S_IRUGO | S_IWUSR,
+        trace_dir,
+        NULL,
+        &buffer_size_max_file_ops);
+        
+    if(!buffer_size_max_file) goto fail_buffer_size_max_file;
+    
     lost_messages_file = debugfs_create_file("lost_messages",
         S_IRUGO,
         trace_dir,
@@ -1268,14 +1670,36 @@ kedr_trace_module_init(void)
     
     if(!lost_messages_file) goto fail_lost_messages_file;
 
+    wakeup_watermark_file = debugfs_create_file("wakeup_watermark",
+        S_IRUGO | S_IWUSR,
+        trace_dir,
+        NULL,
+        &wakeup_watermark_file_ops);
+    
+    if(!wakeup_watermark_file) goto fail_wakeup_watermark_file;
+
+    wakeup_timeout_file = debugfs_create_file("wakeup_timeout",
+        S_IRUGO | S_IWUSR,
+        trace_dir,
+        NULL,
+        &wakeup_timeout_file_ops);
+    
+    if(!wakeup_timeout_file) goto fail_wakeup_timeout_file;
+
     err = kedr_payload_register(&payload);
     if(err) goto fail_payload;
 
     return 0;
 
 fail_payload:
+    debugfs_remove(wakeup_timeout_file);
+fail_wakeup_timeout_file:
+    debugfs_remove(wakeup_watermark_file);
+fail_wakeup_watermark_file:
     debugfs_remove(lost_messages_file);
 fail_lost_messages_file:
+    debugfs_remove(buffer_size_max_file);
+fail_buffer_size_max_file:
     debugfs_remove(buffer_size_file);
 fail_buffer_size_file:
     debugfs_remove(reset_file);
@@ -1302,13 +1726,20 @@ kedr_trace_module_exit(void)
     struct trace_session* first_session;
     
     kedr_payload_unregister(&payload);
+    debugfs_remove(wakeup_timeout_file);
+    debugfs_remove(wakeup_watermark_file);
     debugfs_remove(lost_messages_file);
+    debugfs_remove(buffer_size_max_file);
     debugfs_remove(buffer_size_file);
     debugfs_remove(reset_file);
     debugfs_remove(trace_session_file);
     debugfs_remove(trace_file);
     debugfs_remove(trace_dir);
-    trace_buffer_destroy(tb_global);
+    /* The files not created for ftrace backend are NULL here. */
+    if(use_ftrace)
+        trace_ftrace_destroy();
+    else
+        trace_buffer_destroy(tb_global);
 
     first_session = list_first_entry(&trace_session_list,
         typeof(*first_session), list);
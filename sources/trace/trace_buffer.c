@@ -12,6 +12,14 @@
 #include <linux/sched.h> /* TASK_NORMAL, TASK_INTERRUPTIBLE*/
 #include <linux/hardirq.h> /* in_nmi() */
 #include <linux/hrtimer.h> /* high resolution timer for clock*/
+#include <linux/rcupdate.h> /* rcu_dereference_sched() */
+#include <linux/jiffies.h> /* time_after_eq() */
+#include <linux/percpu.h> /* per-cpu wakeup accounting */
+#include <linux/irq_work.h> /* deferred wakeup of readers */
+#include <linux/timer.h> /* wakeup timeout */
+#include <linux/version.h>
+
+#include <kedr/util/read_once.h>
 
 #include "config.h"
 
@@ -83,6 +91,13 @@ kedr_clock(void)
 struct trace_data
 {
 	u64 ts;
+	/* 
+	 * Ring buffer the message is reserved in.
+	 * 
+	 * Ring buffer may be switched by trace_buffer_resize() between
+	 * reserving of the message and its commiting.
+	 */
+	struct ring_buffer* buffer;
 	char msg[0];
 };
 
@@ -94,12 +109,12 @@ struct trace_data
  */
 struct last_message
 {
-	/* List of per-cpu last messages ordered by timestamp. */
-	struct list_head list;
 	/* 
 	 * Event extracted or NULL if buffer found to be empty.
 	 * */
 	struct ring_buffer_event* event;
+	/* Ring buffer from which event is extracted. */
+	struct ring_buffer* buffer;
 	
 	/*
 	 * Timestamp of the message.
@@ -111,7 +126,7 @@ struct last_message
 };
 
 void last_message_set(struct last_message* lm,
-	struct ring_buffer_event* event)
+	struct ring_buffer_event* event, struct ring_buffer* buffer)
 {
 	struct trace_data* td;
 	
@@ -120,8 +135,33 @@ void last_message_set(struct last_message* lm,
 	td = ring_buffer_event_data(event);
 	lm->ts = td->ts;
 	lm->event = event;
+	lm->buffer = buffer;
 }
 
+/*
+ * Writers which are writing messages on the CPU, from reserving space
+ * for a message in trace_buffer_write_lock() till commiting it in
+ * trace_buffer_write_unlock().
+ * 
+ * 'active' is the number of such writers(writers may nest when
+ * interrupted). 'idle_seq' is incremented every time 'active' drops
+ * to 0, so the reader may wait for the writers which are active at
+ * some moment without waiting for the ones started later.
+ */
+struct writers_state
+{
+	unsigned long active;
+	unsigned long idle_seq;
+};
+
+/*
+ * Data written on the current CPU since the last wakeup of the readers.
+ */
+struct wakeup_pending
+{
+	unsigned long bytes;
+};
+
 /*
  * Struct, represented buffer which support two main operations:
  *
@@ -132,21 +172,79 @@ void last_message_set(struct last_message* lm,
 
 struct trace_buffer
 {
+	/* 
+	 * Ring buffer for write new messages.
+	 * 
+	 * Writers access it under RCU-sched read lock.
+	 */
 	struct ring_buffer* buffer;
+	/*
+	 * Ring buffer which was replaced by trace_buffer_resize() but
+	 * still contains unread messages. NULL if there is no such buffer.
+	 * 
+	 * Messages are never written into this buffer, they are only
+	 * read from it. When buffer become empty, it is freed.
+	 */
+	struct ring_buffer* buffer_old;
+	/* Flags which are used for allocate ring buffers. */
+	unsigned ring_buffer_flags;
+	/* Number of messages lost in the ring buffers already freed. */
+	unsigned long lost_messages_freed;
+	
+	/*
+	 * Maximum size of the buffer for auto-grow policy.
+	 * 
+	 * 0 means that buffer is not grown automatically.
+	 */
+	unsigned long size_max;
+	/* Number of lost messages in 'buffer' at the last auto-grow check. */
+	unsigned long autogrow_overruns;
+	/* Time(in jiffies) of the next auto-grow check. */
+	unsigned long autogrow_next_check;
 
 	//Array of 'last_message' content for corresponding CPUs.
 	struct last_message* last_messages;
-	//List organization of 'last_messages', ordered by .ts in ascended order.
-	struct list_head last_messages_ordered;
+	/*
+	 * Min-heap of 'last_messages' for possible CPUs, ordered by .ts.
+	 * 
+	 * Timestamp of a last message only grows, so it is sufficient
+	 * to sift the changed element down.
+	 */
+	struct last_message** heap;
+	int heap_size;
 	
 	/* 
 	 * Prevent concurrent access to 'last_message' array
-	 * and 'last_messages_ordered' list.
+	 * and 'heap'.
 	 */
 	struct mutex m;
 	
+	/* Per-cpu state of the writers, see trace_buffer_wait_writers(). */
+	struct writers_state __percpu* writers;
+	
 	// Wait queue for polling
 	wait_queue_head_t rq;
+	
+	/*
+	 * Wakeup policy.
+	 * 
+	 * Writers never wake up the readers by themselves: they may be
+	 * called with spinlocks held or in interrupt context. Instead,
+	 * 'wakeup_work' is queued when 'wakeup_watermark' bytes are written
+	 * on the current CPU while readers are waiting. If less data are
+	 * written, 'wakeup_timer' wakes up the readers after
+	 * 'wakeup_timeout' milliseconds.
+	 * 
+	 * 0 watermark means waking up the readers after each message,
+	 * 0 timeout disables the timer.
+	 */
+	unsigned long wakeup_watermark;
+	unsigned long wakeup_timeout;
+	struct wakeup_pending __percpu* wakeup_pending;
+	struct irq_work wakeup_work;
+	/* Arms 'wakeup_timer', which cannot be done in NMI context. */
+	struct irq_work wakeup_timer_work;
+	struct timer_list wakeup_timer;
 
 	u64 (*clock)(void);
 	
@@ -165,11 +263,121 @@ struct trace_buffer
 
 void trace_buffer_clear_last_message(struct trace_buffer* tb, int cpu)
 {
-	if(tb->last_messages[cpu].event)
+	struct last_message* lm = &tb->last_messages[cpu];
+	if(lm->event)
+	{
+		lm->event = NULL;
+		ring_buffer_consume_compat(lm->buffer, cpu, NULL);
+	}
+}
+
+/*
+ * Restore heap order after the timestamp of heap[0] has been increased.
+ */
+static void trace_buffer_heap_sift_down(struct trace_buffer* tb)
+{
+	struct last_message** heap = tb->heap;
+	struct last_message* lm = heap[0];
+	int i = 0;
+	
+	while(1)
+	{
+		int child = 2 * i + 1;
+		
+		if(child >= tb->heap_size) break;
+		if((child + 1 < tb->heap_size)
+			&& (heap[child + 1]->ts < heap[child]->ts))
+			child++;
+		if(lm->ts <= heap[child]->ts) break;
+		
+		heap[i] = heap[child];
+		i = child;
+	}
+	heap[i] = lm;
+}
+
+/*
+ * Wait until all writers, which were writing messages on the given
+ * cpu at the moment of the call, finish.
+ * 
+ * Writers which start later get timestamps not less than ones obtained
+ * by the reader before this call(see trace_buffer_write_lock()).
+ * 
+ * Messages of the nested writers become visible only when the outer
+ * writer commits its message. So the writer is counted as active since
+ * the space is reserved, not only while commiting.
+ * 
+ * The writers are never preempted while writing, so the wait is short.
+ */
+static void trace_buffer_wait_writers(struct trace_buffer* tb, int cpu)
+{
+	struct writers_state* writers = per_cpu_ptr(tb->writers, cpu);
+	unsigned long idle_seq = READ_ONCE(writers->idle_seq);
+	
+	smp_rmb();
+	if(READ_ONCE(writers->active) == 0) return;
+	
+	while(READ_ONCE(writers->idle_seq) == idle_seq)
+		cpu_relax();
+	/* Make messages commited by the writers visible for us. */
+	smp_rmb();
+}
+
+/*
+ * Return the oldest not-consumed event in the per-cpu buffer or NULL.
+ * 
+ * Messages in the old buffer(if it exists) are returned first.
+ * 'buffer' is set to the ring buffer which contains returned event.
+ * 
+ * Should be executed under mutex locked.
+ */
+static struct ring_buffer_event*
+trace_buffer_peek(struct trace_buffer* tb, int cpu,
+	struct ring_buffer** buffer)
+{
+	if(tb->buffer_old)
 	{
-		tb->last_messages[cpu].event = NULL;
-		ring_buffer_consume_compat(tb->buffer, cpu, NULL);
+		struct ring_buffer_event* event =
+			ring_buffer_peek_compat(tb->buffer_old, cpu, NULL);
+		if(event)
+		{
+			*buffer = tb->buffer_old;
+			return event;
+		}
 	}
+	
+	*buffer = tb->buffer;
+	return ring_buffer_peek_compat(tb->buffer, cpu, NULL);
+}
+
+/*
+ * Free old buffer.
+ * 
+ * Should be executed under mutex locked.
+ */
+static void trace_buffer_free_old(struct trace_buffer* tb)
+{
+	unsigned long flags;
+	struct ring_buffer* buffer_old = tb->buffer_old;
+	
+	/* trace_buffer_call_after_read() checks old buffer under cb_lock. */
+	spin_lock_irqsave(&tb->cb_lock, flags);
+	tb->buffer_old = NULL;
+	spin_unlock_irqrestore(&tb->cb_lock, flags);
+	
+	tb->lost_messages_freed += ring_buffer_overruns(buffer_old);
+	ring_buffer_free(buffer_old);
+}
+
+/*
+ * Free old buffer if all its messages are consumed.
+ * 
+ * Should be executed under mutex locked.
+ */
+static void trace_buffer_free_old_if_drained(struct trace_buffer* tb)
+{
+	if(tb->buffer_old && ring_buffer_empty(tb->buffer_old))
+		trace_buffer_free_old(tb);
 }
 
 /* 
@@ -232,12 +440,80 @@ static void trace_buffer_clear_internal(struct trace_buffer* tb)
 		trace_buffer_clear_last_message(tb, cpu);
 	}
 
+	if(tb->buffer_old) trace_buffer_free_old(tb);
 	ring_buffer_reset(tb->buffer);
 	spin_lock_irqsave(&tb->cb_lock, flags);
 	execute_callbacks_all(tb);
 	spin_unlock_irqrestore(&tb->cb_lock, flags);
 }
 
+/* Wake up the readers. Executed in hard interrupt context. */
+static void trace_buffer_wakeup_work_func(struct irq_work* work)
+{
+	struct trace_buffer* tb = container_of(work, struct trace_buffer,
+		wakeup_work);
+	
+	wake_up_all(&tb->rq);
+}
+
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(4, 15, 0)
+static void trace_buffer_wakeup_timer_func(struct timer_list* timer)
+{
+	struct trace_buffer* tb = from_timer(tb, timer, wakeup_timer);
+#else
+static void trace_buffer_wakeup_timer_func(unsigned long data)
+{
+	struct trace_buffer* tb = (struct trace_buffer*)data;
+#endif
+	
+	wake_up_all(&tb->rq);
+}
+
+static void trace_buffer_wakeup_timer_work_func(struct irq_work* work)
+{
+	struct trace_buffer* tb = container_of(work, struct trace_buffer,
+		wakeup_timer_work);
+	unsigned long timeout = tb->wakeup_timeout;
+	
+	/* 
+	 * Pending timer will wake up the readers anyway, do not move it
+	 * forward.
+	 */
+	if(timeout && !timer_pending(&tb->wakeup_timer))
+		mod_timer(&tb->wakeup_timer, jiffies + msecs_to_jiffies(timeout));
+}
+
+/*
+ * Account 'size' bytes written on the current CPU and schedule
+ * wakeup of the readers according to the wakeup policy.
+ * 
+ * Called only when someone waits on the buffer.
+ * 
+ * May be called in the atomic context.
+ */
+static void trace_buffer_wakeup_account(struct trace_buffer* tb,
+	size_t size)
+{
+	unsigned long flags;
+	struct wakeup_pending* pending;
+	bool wakeup = 0;
+	
+	local_irq_save(flags);
+	pending = this_cpu_ptr(tb->wakeup_pending);
+	pending->bytes += size;
+	if(pending->bytes >= tb->wakeup_watermark)
+	{
+		pending->bytes = 0;
+		wakeup = 1;
+	}
+	local_irq_restore(flags);
+	
+	if(wakeup)
+		irq_work_queue(&tb->wakeup_work);
+	else if(tb->wakeup_timeout && !timer_pending(&tb->wakeup_timer))
+		irq_work_queue(&tb->wakeup_timer_work);
+}
+
 /*
  * Allocate buffer.
  * 
@@ -259,7 +535,8 @@ struct trace_buffer* trace_buffer_alloc(size_t size, bool mode_overwrite)
 		return NULL;
 	}
 	
-	tb->buffer = ring_buffer_alloc(size, mode_overwrite? RB_FL_OVERWRITE : 0);
+	tb->ring_buffer_flags = mode_overwrite? RB_FL_OVERWRITE : 0;
+	tb->buffer = ring_buffer_alloc(size, tb->ring_buffer_flags);
 	if(tb->buffer == NULL)
 	{
 		pr_err("%s: Cannot allocate ring buffer.", __func__);
@@ -271,45 +548,105 @@ struct trace_buffer* trace_buffer_alloc(size_t size, bool mode_overwrite)
 	tb->clock = kedr_clock;
 	ts = tb->clock();
 
-	tb->last_messages = kmalloc(num_possible_cpus() * sizeof(struct last_message), GFP_KERNEL);
+	/* Array is indexed by cpu, which may be sparse. */
+	tb->last_messages = kmalloc(nr_cpu_ids * sizeof(struct last_message), GFP_KERNEL);
 	if(tb->last_messages == NULL)
 	{
 		pr_err("%s: Cannot allocate array of last messages.", __func__);
-		ring_buffer_free(tb->buffer);
-		kfree(tb);
-		return NULL;
+		goto fail_last_messages;
+	}
+	
+	tb->heap = kmalloc(num_possible_cpus() * sizeof(*tb->heap), GFP_KERNEL);
+	if(tb->heap == NULL)
+	{
+		pr_err("%s: Cannot allocate heap of last messages.", __func__);
+		goto fail_heap;
+	}
+	
+	tb->writers = alloc_percpu(struct writers_state);
+	if(tb->writers == NULL)
+	{
+		pr_err("%s: Cannot allocate writers state.", __func__);
+		goto fail_writers;
+	}
+	
+	tb->wakeup_pending = alloc_percpu(struct wakeup_pending);
+	if(tb->wakeup_pending == NULL)
+	{
+		pr_err("%s: Cannot allocate wakeup counters.", __func__);
+		goto fail_wakeup_pending;
 	}
 
-	INIT_LIST_HEAD(&tb->last_messages_ordered);
+	tb->buffer_old = NULL;
+	tb->lost_messages_freed = 0;
+	
+	tb->size_max = 0;
+	tb->autogrow_overruns = 0;
+	tb->autogrow_next_check = jiffies;
+
+	/* All timestamps are equal, so the heap is ordered. */
+	tb->heap_size = 0;
 	for_each_possible_cpu(cpu)
 	{
 		struct last_message* lm = &tb->last_messages[cpu];
 
 		lm->event = NULL;
+		lm->buffer = NULL;
 		lm->ts = ts;
-		list_add_tail(&lm->list, &tb->last_messages_ordered);
+		tb->heap[tb->heap_size++] = lm;
 	}
 
 	mutex_init(&tb->m);
 	spin_lock_init(&tb->cb_lock);
 
 	init_waitqueue_head(&tb->rq);
+	
+	tb->wakeup_watermark = 0;
+	tb->wakeup_timeout = 0;
+	init_irq_work(&tb->wakeup_work, trace_buffer_wakeup_work_func);
+	init_irq_work(&tb->wakeup_timer_work, trace_buffer_wakeup_timer_work_func);
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(4, 15, 0)
+	timer_setup(&tb->wakeup_timer, trace_buffer_wakeup_timer_func, 0);
+#else
+	setup_timer(&tb->wakeup_timer, trace_buffer_wakeup_timer_func,
+		(unsigned long)tb);
+#endif
 
 	tb->callback_first = NULL;
 	tb->callback_last_p = &tb->callback_first;
 	
 	return tb;
+
+fail_wakeup_pending:
+	free_percpu(tb->writers);
+fail_writers:
+	kfree(tb->heap);
+fail_heap:
+	kfree(tb->last_messages);
+fail_last_messages:
+	ring_buffer_free(tb->buffer);
+	kfree(tb);
+	return NULL;
 }
 /*
  * Destroy buffer, free all resources which it used.
  */
 void trace_buffer_destroy(struct trace_buffer* tb)
 {
+	/* There are no writers now, so the timer cannot be re-armed. */
+	irq_work_sync(&tb->wakeup_work);
+	irq_work_sync(&tb->wakeup_timer_work);
+	del_timer_sync(&tb->wakeup_timer);
+	free_percpu(tb->wakeup_pending);
+	
 	execute_callbacks_all(tb);
 	
 	mutex_destroy(&tb->m);
 
+	if(tb->buffer_old) ring_buffer_free(tb->buffer_old);
 	ring_buffer_free(tb->buffer);
+	free_percpu(tb->writers);
+	kfree(tb->heap);
 	kfree(tb->last_messages);
 	kfree(tb);
 }
@@ -330,10 +667,36 @@ void* trace_buffer_write_lock(struct trace_buffer* tb,
 	size_t size, void** msg)
 {
 	struct trace_data* msg_real;
-	struct ring_buffer_event* event =
-		ring_buffer_lock_reserve(tb->buffer, msg_to_event_size(size));
+	struct ring_buffer* buffer;
+	struct ring_buffer_event* event;
+	
+	/*
+	 * Reserving space in the ring buffer disables preemption until
+	 * the message is commited. So trace_buffer_resize() may wait
+	 * for all writers to the replaced buffer using synchronize_sched().
+	 */
+	preempt_disable_notrace();
+	
+	this_cpu_inc(tb->writers->active);
+	/* 
+	 * Paired with smp_mb() in trace_buffer_update_internal(): either
+	 * reader sees this writer as active, or the timestamp of the
+	 * message is greater than one obtained by the reader.
+	 */
+	smp_mb();
+	
+	buffer = rcu_dereference_sched(tb->buffer);
+	event = ring_buffer_lock_reserve(buffer, msg_to_event_size(size));
+	if(event == NULL)
+	{
+		if(this_cpu_dec_return(tb->writers->active) == 0)
+			this_cpu_inc(tb->writers->idle_seq);
+	}
+	preempt_enable_notrace();
+	
 	if(event == NULL) return NULL;
 	msg_real = ring_buffer_event_data(event);
+	msg_real->buffer = buffer;
 	*msg = (void*)msg_real->msg;
 	return event;
 }
@@ -349,12 +712,29 @@ void trace_buffer_write_unlock(struct trace_buffer* tb,
 {
 	struct ring_buffer_event* event = (struct ring_buffer_event*)id;
 	struct trace_data *msg_real = ring_buffer_event_data(event);
+	/* Event may be overwritten after it is commited. */
+	unsigned long size = ring_buffer_event_length(event);
+	
+	/* 
+	 * Keep the counters on the same cpu. Preemption is already
+	 * disabled by the ring buffer until commit.
+	 */
+	preempt_disable_notrace();
+	
+	/* The writer is counted as active by trace_buffer_write_lock(). */
 	msg_real->ts = tb->clock();
-	ring_buffer_unlock_commit(tb->buffer, event);
+	ring_buffer_unlock_commit(msg_real->buffer, event);
+	
+	/* Paired with smp_rmb() in trace_buffer_wait_writers(). */
+	smp_wmb();
+	if(this_cpu_dec_return(tb->writers->active) == 0)
+		this_cpu_inc(tb->writers->idle_seq);
+	
+	preempt_enable_notrace();
 	/* It is sufficient to check waitqueue emptiness without lock */
 	if(waitqueue_active(&tb->rq))
 	{
-		wake_up_all(&tb->rq);
+		trace_buffer_wakeup_account(tb, size);
 	}
 }
 
@@ -384,9 +764,13 @@ void trace_buffer_write_message(struct trace_buffer* tb,
  * If buffer is empty, return -EAGAIN.
  * 
  * Main principles of the implementation:
- * 1. syncronize_sched() is used only when it is neccessary.
+ * 1. Per-cpu buffers are merged using min-heap of their last messages,
+ * so cost of the update is O(log(number of cpus)) per message.
  * 2. Buffer may be treated as empty only if for every per-cpu buffer
  * its the last check reveales it is empty.
+ * 3. Timestamp of the empty per-cpu buffer is 'ts_empty': no message
+ * with lesser timestamp may appear in that buffer after we wait for the
+ * writers active on that cpu(see trace_buffer_wait_writers()).
  */
 
 static int trace_buffer_update_internal(struct trace_buffer* tb)
@@ -404,12 +788,10 @@ static int trace_buffer_update_internal(struct trace_buffer* tb)
 	while(1)
 	{
 		struct ring_buffer_event* event;
-		struct last_message* lm;
+		struct ring_buffer* buffer;
 		int cpu;
 		
-		
-		oldest_message = list_first_entry(&tb->last_messages_ordered,
-			struct last_message, list);
+		oldest_message = tb->heap[0];
 		
 		if(oldest_message->event) break; // Oldest message is already set.
 		
@@ -421,34 +803,24 @@ static int trace_buffer_update_internal(struct trace_buffer* tb)
 		 * 
 		 * Iterations are finite, see comments below.
 		 */
+		if(ts_empty_set)
+			trace_buffer_wait_writers(tb, cpu);
 		
-		event = ring_buffer_peek_compat(tb->buffer, cpu, NULL);
+		event = trace_buffer_peek(tb, cpu, &buffer);
 		
 		if(event)
 		{
-			last_message_set(oldest_message, event);
+			last_message_set(oldest_message, event, buffer);
 			
 			non_empty_buffer_found = 1;
 			
-			// Reorder given last message, if needed
-			lm = oldest_message;
-			list_for_each_entry_continue(lm, &tb->last_messages_ordered, list)
-			{
-				if(lm->ts >= oldest_message->ts) break;
-			}
-			
-			if(oldest_message->list.next != &lm->list)
-			{
-				// Reorder
-				list_move_tail(&oldest_message->list, &lm->list);
-			}
-			
 			/* 
 			 * Per-cpu buffer has message extracted, so it won't be
 			 * checked again.
 			 * 
 			 * So, next iteration will check another per-cpu buffer.
 			 */
+			trace_buffer_heap_sift_down(tb);
 			continue;
 		}
 
@@ -463,12 +835,14 @@ static int trace_buffer_update_internal(struct trace_buffer* tb)
 			/* 
 			 * All messages which is read previously has timestamp less
 			 * than given one.
+			 * 
+			 * Paired with smp_mb() in trace_buffer_write_lock().
 			 */
-			
-			synchronize_sched();
+			smp_mb();
 			/* 
-			 * Since now, if we found empty cpu-buffer, ts for its future
-			 * messages cannot be less than 'ts_empty'.
+			 * Since now, if we found empty cpu-buffer after waiting
+			 * for its writers, ts for its future messages cannot be less
+			 * than 'ts_empty'.
 			 */
 			ts_empty_set = 1;
 			
@@ -476,29 +850,17 @@ static int trace_buffer_update_internal(struct trace_buffer* tb)
 			continue;
 		}
 		
-		oldest_message->ts = ts_empty;
-				
-		// Reorder given last message, if needed
-		lm = oldest_message;
-		list_for_each_entry_continue(lm, &tb->last_messages_ordered, list)
-		{
-			if(lm->ts >= oldest_message->ts) break;
-		}
-		
-		if(oldest_message->list.next != &lm->list)
+		if(oldest_message->ts < ts_empty)
 		{
-			// Reorder
-			list_move_tail(&oldest_message->list, &lm->list);
-			
+			oldest_message->ts = ts_empty;
 			/*
 			 * Every per-cpu buffer which is found to be empty has
-			 * 'ts_empty' timestamp.
-			 * 
-			 * As next iterations checks only per-cpu buffer of
-			 * 'oldest_message', which has timestamp less than 'ts_empty'
-			 * current per-cpu buffer won't be checked again.
+			 * 'ts_empty' timestamp, so current per-cpu buffer won't be
+			 * checked again until all buffers with lesser timestamps
+			 * are checked.
 			 */
-			 continue;
+			trace_buffer_heap_sift_down(tb);
+			continue;
 		}
 
 		/* 
@@ -524,10 +886,10 @@ static int trace_buffer_update_internal(struct trace_buffer* tb)
 		 * impossible, and continue iterations.
 		 * 
 		 * This will re-read current per-cpu buffer and, possibly, some
-		 * other empty ones. But we never be here again.
+		 * other empty ones.
 		 */
 		ts_empty = tb->clock();
-		synchronize_sched();
+		smp_mb();
 	}
    
 	spin_lock_irqsave(&tb->cb_lock, flags);
@@ -537,6 +899,77 @@ static int trace_buffer_update_internal(struct trace_buffer* tb)
 	return 0;
 }
 
+/*
+ * Replace ring buffer with the new one of the given size.
+ * 
+ * Messages from the replaced buffer are not lost: it becomes 'old'
+ * buffer, from which messages are read before ones from the new buffer.
+ * 
+ * Only one old buffer may exist at any time, so -EBUSY is returned
+ * if previous old buffer is not drained yet.
+ * 
+ * Should be executed under mutex locked.
+ */
+static int trace_buffer_resize_internal(struct trace_buffer* tb,
+	unsigned long size)
+{
+	unsigned long flags;
+	struct ring_buffer* buffer_new;
+	
+	trace_buffer_free_old_if_drained(tb);
+	if(tb->buffer_old) return -EBUSY;
+	
+	buffer_new = ring_buffer_alloc(size, tb->ring_buffer_flags);
+	if(buffer_new == NULL) return -ENOMEM;
+	
+	/* trace_buffer_call_after_read() checks buffers under cb_lock. */
+	spin_lock_irqsave(&tb->cb_lock, flags);
+	tb->buffer_old = tb->buffer;
+	rcu_assign_pointer(tb->buffer, buffer_new);
+	spin_unlock_irqrestore(&tb->cb_lock, flags);
+	
+	/* 
+	 * Wait until all messages reserved in the old buffer are commited.
+	 * 
+	 * Since now, old buffer is read-only.
+	 */
+	synchronize_sched();
+	
+	tb->autogrow_overruns = 0;
+	
+	return 0;
+}
+
+/* 
+ * Grow buffer if messages have been lost since the last check.
+ * 
+ * Checks are performed not more often than once per second.
+ * 
+ * Should be executed under mutex locked.
+ */
+static void trace_buffer_autogrow(struct trace_buffer* tb)
+{
+	unsigned long overruns;
+	unsigned long size;
+	
+	if(!tb->size_max) return;
+	if(!time_after_eq(jiffies, tb->autogrow_next_check)) return;
+	
+	tb->autogrow_next_check = jiffies + HZ;
+	
+	overruns = ring_buffer_overruns(tb->buffer);
+	if(overruns == tb->autogrow_overruns) return;
+	tb->autogrow_overruns = overruns;
+	
+	size = ring_buffer_size_compat(tb->buffer);
+	if(size >= tb->size_max) return;
+	
+	size = (size > tb->size_max / 2) ? tb->size_max : size * 2;
+	
+	/* Failure is not fatal: next check will try again. */
+	trace_buffer_resize_internal(tb, size);
+}
+
 int
 trace_buffer_read(struct trace_buffer* tb,
 	int (*process_msg)(const void* msg, size_t size, int cpu,
@@ -552,11 +985,12 @@ trace_buffer_read(struct trace_buffer* tb,
 	if(mutex_lock_killable(&tb->m))
 		return -ERESTARTSYS;
 
+	trace_buffer_autogrow(tb);
 
 	err = trace_buffer_update_internal(tb);
 	if(err) goto out;
 
-	oldest_message = list_first_entry(&tb->last_messages_ordered, struct last_message, list);
+	oldest_message = tb->heap[0];
 	
 	BUG_ON(!oldest_message->event);
 	
@@ -575,6 +1009,7 @@ trace_buffer_read(struct trace_buffer* tb,
 	}
 	
 out:
+	trace_buffer_free_old_if_drained(tb);
 	mutex_unlock(&tb->m);
 	return err;
 }
@@ -586,13 +1021,66 @@ trace_buffer_get_wait_queue(struct trace_buffer* tb)
 	return &tb->rq;
 }
 
+/*
+ * Check whether buffer contains no messages.
+ * 
+ * Unlike trace_buffer_read(), neither waits for writers nor extracts
+ * messages, so the result is only a hint.
+ */
+bool trace_buffer_empty(struct trace_buffer* tb)
+{
+	unsigned long flags;
+	bool empty;
+	
+	/* Old buffer is freed after it is cleared under cb_lock. */
+	spin_lock_irqsave(&tb->cb_lock, flags);
+	empty = ring_buffer_empty(tb->buffer)
+		&& (!tb->buffer_old || ring_buffer_empty(tb->buffer_old));
+	spin_unlock_irqrestore(&tb->cb_lock, flags);
+	
+	return empty;
+}
+
+void trace_buffer_set_wakeup_watermark(struct trace_buffer* tb,
+	unsigned long watermark)
+{
+	tb->wakeup_watermark = watermark;
+}
+
+unsigned long trace_buffer_wakeup_watermark(struct trace_buffer* tb)
+{
+	return tb->wakeup_watermark;
+}
+
+void trace_buffer_set_wakeup_timeout(struct trace_buffer* tb,
+	unsigned long timeout)
+{
+	tb->wakeup_timeout = timeout;
+}
+
+unsigned long trace_buffer_wakeup_timeout(struct trace_buffer* tb)
+{
+	return tb->wakeup_timeout;
+}
+
 /*
  * Return number of messages lost due to the buffer overflow.
  */
 unsigned long
 trace_buffer_lost_messages(struct trace_buffer* tb)
 {
-	return ring_buffer_overruns(tb->buffer);
+	unsigned long lost_messages;
+	
+	mutex_lock(&tb->m);
+	
+	lost_messages = tb->lost_messages_freed
+		+ ring_buffer_overruns(tb->buffer);
+	if(tb->buffer_old)
+		lost_messages += ring_buffer_overruns(tb->buffer_old);
+	
+	mutex_unlock(&tb->m);
+	
+	return lost_messages;
 }
 
 /*
@@ -618,16 +1106,24 @@ trace_buffer_reset(struct trace_buffer* tb)
 unsigned long
 trace_buffer_size(struct trace_buffer* tb)
 {
-	return ring_buffer_size_compat(tb->buffer);
+	unsigned long size;
+	
+	mutex_lock(&tb->m);
+	size = ring_buffer_size_compat(tb->buffer);
+	mutex_unlock(&tb->m);
+	
+	return size;
 }
 
 /*
  * Change size of the buffer.
  *
- * Current messages in the buffer may be silently lost.
- * (in the current implementation, the buffer is forcibly reset).
+ * Messages currently in the buffer are preserved: new messages are
+ * written into the buffer of the new size, and they are read only after
+ * all messages from the previous buffer are read.
  *
- * Return new size on success, negative error code otherwise.
+ * Return 0 on success, negative error code otherwise.
+ * -EBUSY means that messages from the previous resize are not read yet.
  */
 
 int trace_buffer_resize(struct trace_buffer* tb,
@@ -639,17 +1135,36 @@ int trace_buffer_resize(struct trace_buffer* tb,
 		return -ERESTARTSYS;
 	}
 	
-	result = ring_buffer_resize_compat(tb->buffer, size);
-	
-	if(!result)
-	{
-		trace_buffer_clear_internal(tb);
-	}
+	result = trace_buffer_resize_internal(tb, size);
 	
 	mutex_unlock(&tb->m);
 	return result;
 }
 
+/*
+ * Set maximum size for auto-grow policy of the buffer.
+ * 
+ * If 'size_max' is not 0, buffer is grown(doubled) when messages are
+ * lost due to its overflow, until its size reaches 'size_max'.
+ */
+void trace_buffer_set_size_max(struct trace_buffer* tb,
+	unsigned long size_max)
+{
+	mutex_lock(&tb->m);
+	tb->size_max = size_max;
+	tb->autogrow_overruns = ring_buffer_overruns(tb->buffer);
+	mutex_unlock(&tb->m);
+}
+
+/*
+ * Return maximum size for auto-grow policy of the buffer.
+ */
+unsigned long
+trace_buffer_size_max(struct trace_buffer* tb)
+{
+	return tb->size_max;
+}
+
 void trace_buffer_call_after_read(struct trace_buffer* tb,
     kedr_trace_callback_func func,
     struct kedr_trace_callback_head* callback_head)
@@ -667,7 +1182,8 @@ void trace_buffer_call_after_read(struct trace_buffer* tb,
 	/* 
 	 * Fast check whether buffer is currently empty.
 	 */
-	if(ring_buffer_empty(tb->buffer))
+	if(ring_buffer_empty(tb->buffer)
+		&& (!tb->buffer_old || ring_buffer_empty(tb->buffer_old)))
 	{
 		execute_callbacks_all(tb);
 	}
@@ -103,6 +103,43 @@ trace_buffer_read(struct trace_buffer* tb,
 wait_queue_head_t*
 trace_buffer_get_wait_queue(struct trace_buffer* tb);
 
+/*
+ * Check whether buffer contains no messages.
+ * 
+ * This is cheap(no messages are extracted), but the result is only
+ * a hint: messages may be written concurrently.
+ * 
+ * Suitable for poll(). May be called in atomic context.
+ */
+bool
+trace_buffer_empty(struct trace_buffer* tb);
+
+/*
+ * Wakeup policy for the readers waiting on the wait queue.
+ * 
+ * Readers are woken up when 'watermark' bytes of messages are written on
+ * some CPU since the last wakeup, or when 'timeout'(in milliseconds)
+ * expires after the first message is written while readers are waiting.
+ * 
+ * 0 watermark means waking up after every message, 0 timeout disables
+ * the timeout. Note, that with non-zero watermark and 0 timeout readers
+ * may wait for messages which are already in the buffer.
+ * 
+ * Wakeups are deferred via irq_work, so writers never touch the wait
+ * queue themselves.
+ */
+void
+trace_buffer_set_wakeup_watermark(struct trace_buffer* tb,
+    unsigned long watermark);
+unsigned long
+trace_buffer_wakeup_watermark(struct trace_buffer* tb);
+
+void
+trace_buffer_set_wakeup_timeout(struct trace_buffer* tb,
+    unsigned long timeout);
+unsigned long
+trace_buffer_wakeup_timeout(struct trace_buffer* tb);
+
 
 /*
  * Return number of messages lost due to the buffer overflow.
@@ -127,15 +164,35 @@ trace_buffer_size(struct trace_buffer* tb);
 /*
  * Change size of the buffer.
  *
- * Current messages in the buffer may be silently lost.
- * (in current implementation buffer is forcibly reseted).
+ * Current messages in the buffer are preserved and will be read
+ * before messages written after resizing.
  *
- * Return new size on success, negative error code otherwise.
+ * Return 0 on success, negative error code otherwise.
+ * If messages written before previous resizing are not read yet,
+ * -EBUSY is returned.
  */
 
 int
 trace_buffer_resize(struct trace_buffer* tb, unsigned long size);
 
+/*
+ * Set maximum size of the buffer for auto-grow policy.
+ * 
+ * When messages are lost due to the buffer overflow, buffer is
+ * automatically grown(up to 'size_max'). Grow is performed while
+ * reading messages, without losing messages in the buffer.
+ * 
+ * 0 disables auto-grow policy.
+ */
+void
+trace_buffer_set_size_max(struct trace_buffer* tb, unsigned long size_max);
+
+/*
+ * Return maximum size of the buffer for auto-grow policy.
+ */
+unsigned long
+trace_buffer_size_max(struct trace_buffer* tb);
+
 
 /* 
  * Call 'func' after all messages, written into buffer until this moment,
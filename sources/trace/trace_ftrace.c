@@ -0,0 +1,173 @@
+#include "trace_ftrace.h"
+
+#include <linux/kernel.h>
+#include <linux/percpu.h>
+#include <linux/preempt.h>
+#include <linux/hardirq.h> /* in_nmi() */
+#include <linux/errno.h>
+#include <asm/atomic.h>
+
+#define CREATE_TRACE_POINTS
+#include "kedr_trace_events.h"
+
+/*
+ * Contexts in which the messages may be written on a CPU: task, softirq,
+ * hardirq and NMI. A message may be interrupted by a message from the
+ * context of the higher level only, so each level has its own scratch area.
+ */
+#define FTRACE_CONTEXT_LEVELS 4
+
+/* Message between "lock" and "commit". */
+struct ftrace_message
+{
+    /* Nonzero if the scratch area is used by a message. */
+    int in_use;
+
+    /* NULL for messages other than function calls. */
+    const char* function_name;
+    void* return_address;
+
+    kedr_trace_pp_function pp;
+    char data[TRACE_FTRACE_DATA_MAX];
+};
+
+struct ftrace_messages
+{
+    struct ftrace_message levels[FTRACE_CONTEXT_LEVELS];
+};
+
+static struct ftrace_messages __percpu* ftrace_messages;
+
+static atomic_long_t lost_messages = ATOMIC_LONG_INIT(0);
+
+int trace_ftrace_init(void)
+{
+#ifdef CONFIG_EVENT_TRACING
+    atomic_long_set(&lost_messages, 0);
+
+    /* The per-CPU data are zeroed. */
+    ftrace_messages = alloc_percpu(struct ftrace_messages);
+    if(ftrace_messages == NULL)
+    {
+        pr_err("Failed to allocate scratch areas for the trace events.\n");
+        return -ENOMEM;
+    }
+    return 0;
+#else
+    pr_err("Trace events are not supported by the kernel, "
+        "ftrace backend cannot be used.\n");
+    return -EINVAL;
+#endif
+}
+
+void trace_ftrace_destroy(void)
+{
+    /* The events are unregistered with the module. */
+    free_percpu(ftrace_messages);
+    ftrace_messages = NULL;
+}
+
+static int ftrace_context_level(void)
+{
+    if(in_nmi()) return 3;
+    if(hardirq_count()) return 2;
+    if(in_serving_softirq()) return 1;
+    return 0;
+}
+
+/*
+ * Pretty print for the messages which data do not fit into the scratch
+ * area.
+ */
+static int ftrace_too_large_pp(char* dest, size_t size, const void* data)
+{
+    return snprintf(dest, size, "<%zu bytes of data are not recorded>",
+        *(const size_t*)data);
+}
+
+/*
+ * Return scratch area for the message in the current context with
+ * preemption disabled, or NULL.
+ *
+ * If the data do not fit into the scratch area, the message is emitted
+ * without them, see ftrace_too_large_pp(), and NULL is returned.
+ */
+static struct ftrace_message* ftrace_message_lock(const char* function_name,
+    void* return_address, size_t size)
+{
+    struct ftrace_message* msg;
+
+    if(size > TRACE_FTRACE_DATA_MAX)
+    {
+        atomic_long_inc(&lost_messages);
+        if(function_name)
+            trace_kedr_function_call(function_name, return_address,
+                ftrace_too_large_pp, &size);
+        else
+            trace_kedr_message(ftrace_too_large_pp, &size);
+        return NULL;
+    }
+
+    preempt_disable_notrace();
+    msg = &this_cpu_ptr(ftrace_messages)->levels[ftrace_context_level()];
+    if(msg->in_use)
+    {
+        /* Recursion within the same context, e.g. from a pp function. */
+        preempt_enable_notrace();
+        atomic_long_inc(&lost_messages);
+        return NULL;
+    }
+    msg->in_use = 1;
+    /* The interrupting writers should see the area as used. */
+    barrier();
+
+    msg->function_name = function_name;
+    msg->return_address = return_address;
+    return msg;
+}
+
+void* trace_ftrace_lock(kedr_trace_pp_function pp,
+    size_t size, void** data)
+{
+    struct ftrace_message* msg = ftrace_message_lock(NULL, NULL, size);
+    if(msg == NULL) return NULL;
+
+    msg->pp = pp;
+
+    *data = msg->data;
+    return msg;
+}
+
+void* trace_ftrace_function_call_lock(const char* function_name,
+    void* return_address, kedr_trace_pp_function params_pp,
+    size_t params_size, void** params)
+{
+    struct ftrace_message* msg = ftrace_message_lock(function_name,
+        return_address, params_size);
+    if(msg == NULL) return NULL;
+
+    msg->pp = params_pp;
+
+    *params = msg->data;
+    return msg;
+}
+
+void trace_ftrace_unlock_commit(void* id)
+{
+    struct ftrace_message* msg = id;
+
+    if(msg->function_name)
+        trace_kedr_function_call(msg->function_name, msg->return_address,
+            msg->pp, msg->data);
+    else
+        trace_kedr_message(msg->pp, msg->data);
+
+    barrier();
+    msg->in_use = 0;
+    preempt_enable_notrace();
+}
+
+unsigned long trace_ftrace_lost_messages(void)
+{
+    return (unsigned long)atomic_long_read(&lost_messages);
+}
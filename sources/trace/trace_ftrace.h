@@ -0,0 +1,47 @@
+#ifndef TRACE_FTRACE_H
+#define TRACE_FTRACE_H
+
+/*
+ * Ftrace backend of KEDR tracing system.
+ *
+ * Instead of being stored in the trace buffer of KEDR, the messages are
+ * emitted as trace events (see kedr_trace_events.h). The messages are
+ * pretty printed when they are committed rather than when they are read,
+ * so pretty print functions are not used after that.
+ *
+ * Between "lock" and "commit", the data of the message are kept in the
+ * per-CPU scratch area of the current context (task, softirq, hardirq or
+ * NMI) with preemption disabled. The data larger than
+ * TRACE_FTRACE_DATA_MAX bytes are not recorded: the event is emitted with
+ * their size instead of the text, and the message is counted as lost. The
+ * text of the events is truncated to KEDR_TRACE_EVENT_TEXT_MAX bytes.
+ */
+
+#include <kedr/trace/trace.h>
+
+#define TRACE_FTRACE_DATA_MAX 512
+
+/* Returns 0 if trace events are supported by the kernel. */
+int trace_ftrace_init(void);
+void trace_ftrace_destroy(void);
+
+/*
+ * Same as kedr_trace_lock() and kedr_trace_function_call_lock().
+ *
+ * On success, preemption is disabled on the current CPU until
+ * trace_ftrace_unlock_commit() is called.
+ */
+void* trace_ftrace_lock(kedr_trace_pp_function pp,
+    size_t size, void** data);
+
+void* trace_ftrace_function_call_lock(const char* function_name,
+    void* return_address, kedr_trace_pp_function params_pp,
+    size_t params_size, void** params);
+
+/* Emit the trace event for the message. */
+void trace_ftrace_unlock_commit(void* id);
+
+/* Number of messages emitted without their data or dropped. */
+unsigned long trace_ftrace_lost_messages(void);
+
+#endif /* TRACE_FTRACE_H */